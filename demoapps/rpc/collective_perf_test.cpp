@@ -0,0 +1,113 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/util/timer.hpp>
+using namespace graphlab;
+
+/**
+ * Measures broadcast(), all_reduce() and all_gather() with the binomial
+ * tree and the pipelined ring for payloads from 8 bytes to 16MB.
+ * Run with any number of MPI nodes.
+ */
+
+#define TOTAL_BYTES (64 * 1024 * 1024)
+#define MAX_REPETITIONS 1000
+
+struct vector_plus_equal {
+  void operator()(std::vector<double>& a, const std::vector<double>& b) {
+    for (size_t i = 0; i < a.size(); ++i) a[i] += b[i];
+  }
+};
+
+const char* algorithm_name(collective_algorithm algorithm) {
+  switch(algorithm) {
+    case COLLECTIVE_TREE: return "tree";
+    case COLLECTIVE_RING: return "ring";
+    default: return "auto";
+  }
+}
+
+/// Repetitions of an operation moving bytes bytes
+size_t repetitions(size_t bytes) {
+  return std::max<size_t>(2, std::min<size_t>(MAX_REPETITIONS,
+                                              TOTAL_BYTES / bytes));
+}
+
+void print_res(distributed_control& dc, const char* op,
+               collective_algorithm algorithm, size_t bytes, double t,
+               size_t reps) {
+  if (dc.procid() == 0) {
+    std::cout << op << "\t" << algorithm_name(algorithm) << "\t"
+              << bytes << "\t" << t / reps * 1000000 << " us\t"
+              << double(bytes) * reps / t / 1024 / 1024 << " MB/s\n";
+  }
+}
+
+void run_broadcast(distributed_control& dc, collective_algorithm algorithm,
+                   size_t bytes) {
+  dc.set_collective_algorithm(algorithm);
+  std::string s(dc.procid() == 0 ? bytes : 0, 1);
+  size_t reps = repetitions(bytes);
+  dc.barrier();
+  timer ti;
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    dc.broadcast(s, dc.procid() == 0);
+  }
+  dc.barrier();
+  print_res(dc, "broadcast", algorithm, bytes, ti.current_time(), reps);
+}
+
+void run_all_reduce(distributed_control& dc, collective_algorithm algorithm,
+                    size_t bytes) {
+  dc.set_collective_algorithm(algorithm);
+  std::vector<double> v(std::max<size_t>(1, bytes / sizeof(double)), 1.0);
+  size_t reps = repetitions(bytes);
+  dc.barrier();
+  timer ti;
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    dc.all_reduce2(v, vector_plus_equal());
+  }
+  dc.barrier();
+  print_res(dc, "all_reduce", algorithm, bytes, ti.current_time(), reps);
+}
+
+void run_all_gather(distributed_control& dc, collective_algorithm algorithm,
+                    size_t bytes) {
+  dc.set_collective_algorithm(algorithm);
+  // bytes is the size of the result
+  std::vector<std::string> v(dc.numprocs());
+  v[dc.procid()].resize(bytes / dc.numprocs(), 1);
+  size_t reps = repetitions(bytes);
+  dc.barrier();
+  timer ti;
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    dc.all_gather(v);
+  }
+  dc.barrier();
+  print_res(dc, "all_gather", algorithm, bytes, ti.current_time(), reps);
+}
+
+int main(int argc, char** argv) {
+  // init MPI
+  mpi_tools::init(argc, argv);
+  distributed_control dc;
+
+  if (dc.procid() == 0) {
+    std::cout << "Collectives on " << dc.numprocs() << " machines\n";
+    std::cout << "operation\talgorithm\tbytes\ttime per call\tbandwidth\n";
+  }
+  collective_algorithm algorithms[2] = {COLLECTIVE_TREE, COLLECTIVE_RING};
+  for (size_t bytes = 8; bytes <= 16 * 1024 * 1024; bytes *= 8) {
+    for (size_t a = 0; a < 2; ++a) run_broadcast(dc, algorithms[a], bytes);
+    for (size_t a = 0; a < 2; ++a) run_all_reduce(dc, algorithms[a], bytes);
+    for (size_t a = 0; a < 2; ++a) run_all_gather(dc, algorithms[a], bytes);
+  }
+  dc.barrier();
+  mpi_tools::finalize();
+}
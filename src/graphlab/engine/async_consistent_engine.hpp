@@ -27,7 +27,11 @@
 #define GRAPHLAB_ASYNC_CONSISTENT_ENGINE
 
 #include <deque>
+#include <fstream>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
 
 #include <graphlab/scheduler/ischeduler.hpp>
 #include <graphlab/scheduler/scheduler_factory.hpp>
@@ -42,10 +46,12 @@
 
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/stl_util.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/rpc/async_consensus.hpp>
 #include <graphlab/engine/fake_chandy_misra.hpp>
 #include <graphlab/aggregation/distributed_aggregator.hpp>
+#include <graphlab/util/hdfs.hpp>
 
 #include <graphlab/macros_def.hpp>
 
@@ -203,6 +209,17 @@ namespace graphlab {
    * vertex program must either clear (\ref icontext::clear_gather_cache) 
    * or update (\ref icontext::post_delta) the cache values of 
    * neighboring vertices during the scatter phase.
+   * \li \b snapshot_interval (default: -1) If set to a positive value,
+   * a snapshot is taken every this number of seconds. Otherwise no
+   * snapshots are taken. Snapshots are taken while the engine runs
+   * using the Chandy-Lamport algorithm. Each machine briefly pauses its
+   * own threads to record its vertex data and pending messages, but
+   * the machines are never stopped together.
+   * See \ref async_consistent_engine::resume_snapshot.
+   * \li \b snapshot_path If snapshot_interval is positive, this is
+   * the prefix of the snapshot files. Snapshot i is saved with prefix
+   * [snapshot_path]_[i]. and the prefix of the last complete snapshot
+   * is written to [snapshot_path].latest.
    */
   template<typename VertexProgram>
   class async_consistent_engine: public iengine<VertexProgram> {
@@ -685,6 +702,9 @@ namespace graphlab {
       handler_intercept = rmi.numprocs() > 1;
       track_task_retire_time = false;
       disable_locks = false;
+      snapshot_interval = -1;
+      snapshot_requested = false;
+      snapshot_active = false;
       termination_reason = execution_status::UNSET;
       set_options(opts);
       
@@ -768,10 +788,24 @@ namespace graphlab {
           if (rmi.procid() == 0) 
             logstream(LOG_EMPH) << "Engine Option: track_task_time = " 
               << track_task_retire_time << std::endl;
+        } else if (opt == "snapshot_interval") {
+          opts.get_engine_args().get_option("snapshot_interval", snapshot_interval);
+          if (rmi.procid() == 0) 
+            logstream(LOG_EMPH) << "Engine Option: snapshot_interval = " 
+              << snapshot_interval << std::endl;
+        } else if (opt == "snapshot_path") {
+          opts.get_engine_args().get_option("snapshot_path", snapshot_path);
+          if (rmi.procid() == 0) 
+            logstream(LOG_EMPH) << "Engine Option: snapshot_path = " 
+              << snapshot_path << std::endl;
         } else {
           logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
         }
       }
+      if (snapshot_interval > 0 && snapshot_path.length() == 0) {
+        logstream(LOG_FATAL)
+          << "Snapshot interval specified, but no snapshot path" << std::endl;
+      }
       opts_copy = opts;
       // set a default scheduler if none
       if (opts_copy.get_scheduler_type() == "") {
@@ -888,6 +922,23 @@ namespace graphlab {
 
 
 
+    /**
+     * \internal
+     * Sends a message to the master of vid on another machine.
+     * If snapshots are enabled, the message is tagged with the
+     * snapshot epoch of this machine.
+     */
+    void send_signal(procid_t owner, vertex_id_type vid,
+                     const message_type& message) {
+      if (snapshot_interval > 0) {
+        snapshot_sent[owner].inc();
+        rmi.remote_call(owner, &engine_type::rpc_signal_tagged, vid, message,
+                        rmi.procid(), snapshot_epoch);
+      } else {
+        rmi.remote_call(owner, &engine_type::rpc_signal, vid, message);
+      }
+    }
+
     /**
      * \internal
      * This is used to receive a message forwarded from another machine
@@ -895,6 +946,36 @@ namespace graphlab {
     void rpc_signal(vertex_id_type vid,
                             const message_type& message) {
       if (force_stop) return;
+      deliver_signal(vid, message);
+    }
+
+    /**
+     * \internal
+     * Receives a message forwarded from another machine while snapshots
+     * are enabled. src is the sending machine and epoch its snapshot
+     * epoch when the message was sent.
+     */
+    void rpc_signal_tagged(vertex_id_type vid,
+                           const message_type& message,
+                           procid_t src, size_t epoch) {
+      if (force_stop) return;
+      snapshot_rwlock.readlock();
+      if (snapshot_receive(vid, message, src, epoch)) {
+        deliver_signal(vid, message);
+      } else {
+        snapshot_mutex.lock();
+        snapshot_deferred.push_back(std::make_pair(vid, message));
+        snapshot_mutex.unlock();
+      }
+      snapshot_rwlock.unlock();
+    }
+
+    /**
+     * \internal
+     * Injects a message forwarded from another machine
+     */
+    void deliver_signal(vertex_id_type vid,
+                        const message_type& message) {
       const lvid_type local_vid = graph.local_vid(vid);
       BEGIN_TRACEPOINT(disteng_scheduler_task_queue);
       bool direct_injection = false;
@@ -956,8 +1037,7 @@ namespace graphlab {
           const typename graph_type::vertex_record& rec = graph.l_get_vertex_record(vtx.local_id());
           const procid_t owner = rec.owner;
           if (owner != rmi.procid()) {
-            const vertex_id_type vid = rec.gvid;
-            rmi.remote_call(owner, &engine_type::rpc_signal, vid, message);
+            send_signal(owner, rec.gvid, message);
           }
           else {
             scheduler_ptr->schedule_from_execution_thread(thread::thread_id(),
@@ -1281,7 +1361,8 @@ namespace graphlab {
       vstate[lvid].vertex_program.init(context,
                                        vertex_type(graph.l_vertex(lvid)),
                                        vstate[lvid].current_message);
-      vstate[lvid].current_message = message_type();
+      // a snapshot restarts unfinished updates with their message
+      if (snapshot_interval <= 0) vstate[lvid].current_message = message_type();
       vstate[lvid].combined_gather.clear();
     }
     
@@ -1478,9 +1559,21 @@ namespace graphlab {
 
       const unsigned char prevkey =
         rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
-      rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
-                      &engine_type::rpc_begin_scattering,
-                      lvertex.global_id(), prog, central_vdata);
+      if (snapshot_interval > 0) {
+        // the scatter completes the update. Like forwarded messages it
+        // is part of the snapshot channels
+        foreach(const procid_t& mirror, lvertex.mirrors()) {
+          snapshot_sent[mirror].inc();
+        }
+        rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
+                        &engine_type::rpc_begin_scattering_tagged,
+                        lvertex.global_id(), prog, central_vdata,
+                        rmi.procid(), snapshot_epoch);
+      } else {
+        rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
+                        &engine_type::rpc_begin_scattering,
+                        lvertex.global_id(), prog, central_vdata);
+      }
       rmi.dc().set_sequentialization_key(prevkey);
       END_TRACEPOINT(disteng_init_scattering);
     }
@@ -1509,6 +1602,28 @@ namespace graphlab {
       vstate[lvid].unlock();
     }
 
+    /**
+     * \internal
+     * rpc_begin_scattering while snapshots are enabled. src is the
+     * master's machine and epoch its snapshot epoch.
+     */
+    void rpc_begin_scattering_tagged(vertex_id_type vid,
+                                     const vertex_program_type& prog,
+                                     const vertex_data_type &central_vdata,
+                                     procid_t src, size_t epoch) {
+      snapshot_rwlock.readlock();
+      // a scatter in a channel of the snapshot restarts the update
+      if (snapshot_receive(vid, message_type(), src, epoch)) {
+        rpc_begin_scattering(vid, prog, central_vdata);
+      } else {
+        snapshot_mutex.lock();
+        snapshot_deferred_scatters.push_back(
+            deferred_scatter_type(vid, prog, central_vdata));
+        snapshot_mutex.unlock();
+      }
+      snapshot_rwlock.unlock();
+    }
+
     
     /**
      * \internal
@@ -1734,6 +1849,8 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
                      message_type &msg) {
 
       if (handler_intercept) rmi.dc().handle_incoming_calls(threadid, ncpus);
+      // the snapshot must be recorded before this thread may leave
+      if (snapshot_requested) return false;
       static size_t ctr = 0;
       if (timer::approx_time_seconds() - engine_start_time > timed_termination) {
         termination_reason = execution_status::TIMEOUT;
@@ -1778,6 +1895,12 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
       if (handler_intercept) rmi.dc().start_handler_threads(threadid, ncpus);
       consensus->begin_done_critical_section(threadid);
 
+      if (snapshot_requested) {
+        consensus->cancel_critical_section(threadid);
+        if (handler_intercept) rmi.dc().stop_handler_threads(threadid, ncpus);
+        return false;
+      }
+
       BEGIN_TRACEPOINT(disteng_internal_task_queue);
       if (thrlocal[threadid].get_task(internal_lvid)) {
         logstream(LOG_DEBUG) << rmi.procid() << "-" << threadid <<  ": "
@@ -1878,9 +2001,13 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
         message_type msg;
         const typename graph_type::vertex_record& rec = graph.l_get_vertex_record(lvid);
         if (rec.owner != rmi.procid()) {
+          // may be called from a handler thread. The message must not
+          // leave the scheduler while a snapshot is being recorded
+          if (snapshot_interval > 0) snapshot_rwlock.readlock();
           if (scheduler_ptr->get_specific(lvid, msg) == sched_status::NEW_TASK) {
-            rmi.remote_call(rec.owner, &engine_type::rpc_signal, rec.gvid, msg);
+            send_signal(rec.owner, rec.gvid, msg);
           }
+          if (snapshot_interval > 0) snapshot_rwlock.unlock();
         }
       }
     }
@@ -1902,8 +2029,7 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
       const procid_t owner = rec.owner;
       bool acquirelock = false;
       if (owner != rmi.procid()) {
-        const vertex_id_type vid = rec.gvid;
-        rmi.remote_call(owner, &engine_type::rpc_signal, vid, msg);
+        send_signal(owner, rec.gvid, msg);
         return;
       }
 //      ASSERT_I_AM_OWNER(sched_lvid);
@@ -2017,6 +2143,15 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
       
         if (handler_intercept) rmi.dc().handle_incoming_calls(threadid, ncpus);
 
+        if (snapshot_interval > 0) {
+          if (threadid == 0 && rmi.procid() == 0 && !snapshot_active &&
+              timer::approx_time_seconds() - snapshot_last_time >= snapshot_interval) {
+            snapshot_active = true;
+            request_snapshot(snapshot_epoch + 1);
+          }
+          if (snapshot_requested) snapshot_pause(threadid);
+        }
+
         if (ti.current_time() >= next_processing_time && rmi.numprocs() > 1) {
           // every now and then, I ping one machine. This has the
           // effect of completely flushing the channel between me and
@@ -2146,6 +2281,473 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
 
 
 
+/**************************************************************************
+ *                         Distributed Snapshots                          *
+ * Consistent snapshots using the Chandy-Lamport algorithm. Proc 0 starts *
+ * a snapshot every snapshot_interval seconds. A machine records its      *
+ * local state as soon as it learns about the snapshot and then sends a   *
+ * marker to every other machine. Since the RPC layer does not guarantee  *
+ * FIFO channels, every forwarded message and scatter carries the         *
+ * snapshot epoch of its sender and the markers carry the number of       *
+ * messages sent before the local state was recorded. The state of the    *
+ * channel from p is the set of messages from p with an earlier epoch     *
+ * which arrive after the local state was recorded, and the channel is    *
+ * complete once the count in the marker from p is reached.               *
+ **************************************************************************/
+  private:
+    /// \internal pair of vertex id and message
+    typedef std::pair<vertex_id_type, message_type> vid_message_pair_type;
+
+    /// engine option. Seconds between snapshots. Disabled if <= 0
+    float snapshot_interval;
+    /// engine option. Prefix of the snapshot files
+    std::string snapshot_path;
+
+    /// The number of snapshots this machine has recorded.
+    size_t snapshot_epoch;
+    /// Set when this machine has to record its state at the next
+    /// task boundary.
+    volatile bool snapshot_requested;
+    /// Set once the local state of snapshot_epoch is written
+    bool snapshot_recorded;
+    /// Set once the local state and all the incoming channels of
+    /// snapshot_epoch are written
+    bool snapshot_complete;
+    /// Held for reading while a message from another machine is
+    /// injected, and for writing while the local state is recorded.
+    rwlock snapshot_rwlock;
+    /// Protects the snapshot state below
+    mutex snapshot_mutex;
+    /// snapshot_sent[p] is the number of messages sent to p
+    /// in the current epoch
+    std::vector<atomic<size_t> > snapshot_sent;
+    /// snapshot_recv[p] is the number of messages received from p
+    /// tagged with the current epoch
+    std::vector<atomic<size_t> > snapshot_recv;
+    /// snapshot_recv_prev[p] is the number of messages received from p
+    /// tagged with the previous epoch
+    std::vector<size_t> snapshot_recv_prev;
+    /// snapshot_recv_next[p] is the number of messages received from p
+    /// tagged with the next epoch. These are held back in snapshot_deferred
+    std::vector<size_t> snapshot_recv_next;
+    /// snapshot_marker[p] is the message count in the marker from p.
+    /// (size_t)(-1) if the marker has not arrived
+    std::vector<size_t> snapshot_marker;
+    /// Messages sent after their sender recorded a snapshot this machine
+    /// has not recorded yet
+    std::vector<vid_message_pair_type> snapshot_deferred;
+    /// \internal Arguments of a held back rpc_begin_scattering
+    struct deferred_scatter_type {
+      vertex_id_type vid;
+      vertex_program_type prog;
+      vertex_data_type vdata;
+      deferred_scatter_type(vertex_id_type vid,
+                            const vertex_program_type& prog,
+                            const vertex_data_type& vdata)
+        : vid(vid), prog(prog), vdata(vdata) { }
+    };
+    /// Scatters sent after their sender recorded a snapshot this machine
+    /// has not recorded yet
+    std::vector<deferred_scatter_type> snapshot_deferred_scatters;
+    /// The recorded messages of the snapshot in progress
+    std::vector<vid_message_pair_type> snapshot_messages;
+    /// Proc 0 only. Number of machines which completed the snapshot
+    atomic<size_t> snapshot_num_done;
+    /// Proc 0 only. True while a snapshot is in progress
+    volatile bool snapshot_active;
+    /// Proc 0 only. Time at which the last snapshot was completed
+    float snapshot_last_time;
+
+    /** \internal Returns the file prefix of snapshot epoch */
+    std::string snapshot_prefix(size_t epoch) const {
+      return snapshot_path + "_" + tostr(epoch) + ".";
+    }
+
+    /**
+     * \internal
+     * Writes obj to the gzip compressed file fname, which may be on HDFS.
+     */
+    template <typename T>
+    static void save_snapshot_file(const std::string& fname, const T& obj) {
+      if(boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        graphlab::hdfs::fstream out_file(hdfs, fname, true);
+        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+        fout.push(boost::iostreams::gzip_compressor());
+        fout.push(out_file);
+        if (!fout.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+        }
+        oarchive oarc(fout);
+        oarc << obj;
+        fout.pop();
+        fout.pop();
+        out_file.close();
+      } else {
+        std::ofstream out_file(fname.c_str(),
+                               std::ios_base::out | std::ios_base::binary);
+        if (!out_file.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+        }
+        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+        fout.push(boost::iostreams::gzip_compressor());
+        fout.push(out_file);
+        oarchive oarc(fout);
+        oarc << obj;
+        fout.pop();
+        fout.pop();
+        out_file.close();
+      }
+    }
+
+    /**
+     * \internal
+     * Reads obj from a file written by save_snapshot_file.
+     */
+    template <typename T>
+    static void load_snapshot_file(const std::string& fname, T& obj) {
+      if(boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        graphlab::hdfs::fstream in_file(hdfs, fname);
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        fin.push(boost::iostreams::gzip_decompressor());
+        fin.push(in_file);
+        if (!fin.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+        }
+        iarchive iarc(fin);
+        iarc >> obj;
+        fin.pop();
+        fin.pop();
+        in_file.close();
+      } else {
+        std::ifstream in_file(fname.c_str(),
+                              std::ios_base::in | std::ios_base::binary);
+        if (!in_file.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+        }
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        fin.push(boost::iostreams::gzip_decompressor());
+        fin.push(in_file);
+        iarchive iarc(fin);
+        iarc >> obj;
+        fin.pop();
+        fin.pop();
+        in_file.close();
+      }
+    }
+
+    /**
+     * \internal
+     * Resets the snapshot state. Called by start().
+     */
+    void reset_snapshots() {
+      snapshot_epoch = 0;
+      snapshot_requested = false;
+      snapshot_recorded = true;
+      snapshot_complete = true;
+      snapshot_sent.assign(rmi.numprocs(), atomic<size_t>(0));
+      snapshot_recv.assign(rmi.numprocs(), atomic<size_t>(0));
+      snapshot_recv_prev.assign(rmi.numprocs(), 0);
+      snapshot_recv_next.assign(rmi.numprocs(), 0);
+      snapshot_marker.assign(rmi.numprocs(), (size_t)(-1));
+      snapshot_deferred.clear();
+      snapshot_deferred_scatters.clear();
+      snapshot_messages.clear();
+      snapshot_num_done = 0;
+      snapshot_active = false;
+      snapshot_last_time = timer::approx_time_seconds();
+    }
+
+    /**
+     * \internal
+     * Asks this machine to record its state for snapshot epoch
+     * if it has not done so already.
+     */
+    void request_snapshot(size_t epoch) {
+      snapshot_mutex.lock();
+      if (epoch > snapshot_epoch) snapshot_requested = true;
+      snapshot_mutex.unlock();
+      // wake up threads waiting for termination
+      consensus->cancel();
+    }
+
+    /**
+     * \internal
+     * Snapshot bookkeeping of a signal or scatter received from
+     * machine src. Must be called with a read lock on snapshot_rwlock.
+     * If it belongs to the state of a channel, vid is recorded with
+     * message. Returns false if it was sent after the sender recorded a
+     * snapshot which this machine has not recorded yet. The caller must
+     * then hold it back until the local state is recorded.
+     */
+    bool snapshot_receive(vertex_id_type vid, const message_type& message,
+                          procid_t src, size_t epoch) {
+      if (epoch == snapshot_epoch) {
+        snapshot_recv[src].inc();
+        return true;
+      }
+      snapshot_mutex.lock();
+      if (epoch < snapshot_epoch) {
+        // sent before the sender recorded the snapshot: part of the
+        // state of the channel
+        snapshot_messages.push_back(std::make_pair(vid, message));
+        ++snapshot_recv_prev[src];
+        std::vector<vid_message_pair_type> messages;
+        size_t complete_epoch = 0;
+        const bool complete = try_complete_snapshot(messages, complete_epoch);
+        snapshot_mutex.unlock();
+        if (complete) write_snapshot_messages(complete_epoch, messages);
+        return true;
+      } else {
+        ++snapshot_recv_next[src];
+        snapshot_requested = true;
+        snapshot_mutex.unlock();
+        consensus->cancel();
+        return false;
+      }
+    }
+
+    /**
+     * \internal
+     * The marker of snapshot epoch from machine src. count is the
+     * number of messages src sent to this machine before recording.
+     */
+    void rpc_snapshot_marker(procid_t src, size_t epoch, size_t count) {
+      std::vector<vid_message_pair_type> messages;
+      size_t complete_epoch = 0;
+      snapshot_mutex.lock();
+      snapshot_marker[src] = count;
+      const bool complete = try_complete_snapshot(messages, complete_epoch);
+      snapshot_mutex.unlock();
+      if (complete) write_snapshot_messages(complete_epoch, messages);
+      request_snapshot(epoch);
+    }
+
+    /**
+     * \internal
+     * Called on proc 0 when machine src completed snapshot epoch.
+     */
+    void rpc_snapshot_done(procid_t src, size_t epoch) {
+      if (snapshot_num_done.inc() < rmi.numprocs()) return;
+      snapshot_num_done = 0;
+      // everything is written. Point to the new snapshot
+      save_snapshot_file(snapshot_path + ".latest", snapshot_prefix(epoch));
+      logstream(LOG_EMPH) << "Snapshot " << snapshot_prefix(epoch)
+                          << " complete" << std::endl;
+      snapshot_last_time = timer::approx_time_seconds();
+      snapshot_active = false;
+    }
+
+    /**
+     * \internal
+     * Completes the snapshot in progress once the local state is
+     * recorded and all incoming channels are complete. Returns true
+     * and moves the recorded messages and the epoch into messages and
+     * epoch if it did. The caller must then pass them to
+     * write_snapshot_messages() after releasing snapshot_mutex.
+     * Must be called with snapshot_mutex held.
+     */
+    bool try_complete_snapshot(std::vector<vid_message_pair_type>& messages,
+                               size_t& epoch) {
+      if (!snapshot_recorded || snapshot_complete) return false;
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (p == rmi.procid()) continue;
+        if (snapshot_marker[p] == (size_t)(-1) ||
+            snapshot_recv_prev[p] != snapshot_marker[p]) return false;
+      }
+      messages.swap(snapshot_messages);
+      snapshot_messages.clear();
+      snapshot_marker.assign(rmi.numprocs(), (size_t)(-1));
+      snapshot_recv_prev.assign(rmi.numprocs(), 0);
+      snapshot_complete = true;
+      epoch = snapshot_epoch;
+      return true;
+    }
+
+    /**
+     * \internal
+     * Writes the recorded messages of a completed snapshot epoch and
+     * reports it to proc 0. Called without snapshot_mutex held.
+     */
+    void write_snapshot_messages(size_t epoch,
+                                 const std::vector<vid_message_pair_type>& messages) {
+      save_snapshot_file(snapshot_prefix(epoch) +
+                         tostr(rmi.procid()) + ".msg", messages);
+      if (rmi.procid() == 0) rpc_snapshot_done(0, epoch);
+      else rmi.remote_call(0, &engine_type::rpc_snapshot_done,
+                           rmi.procid(), epoch);
+    }
+
+    /**
+     * \internal
+     * Records the local state of the next snapshot: the vertex data
+     * and the pending messages. Must be called while no other engine
+     * thread is executing tasks.
+     *
+     * Updates which have started but not finished are recorded as
+     * messages and are restarted on resume. The apply of a master
+     * vertex and its scatter run in a single task, so a master in
+     * progress has not modified its vertex data yet and is restarted
+     * with its original message. A mirror which may still have to
+     * scatter is recorded as an empty message to its master, so that
+     * the update is restarted if the apply on the master is already
+     * part of the recorded vertex data.
+     */
+    void record_snapshot() {
+      std::vector<vid_message_pair_type> deferred;
+      std::vector<deferred_scatter_type> deferred_scatters;
+      std::vector<size_t> marker_count(rmi.numprocs());
+      snapshot_rwlock.writelock();
+      snapshot_mutex.lock();
+      ASSERT_TRUE(snapshot_complete);
+      ++snapshot_epoch;
+      snapshot_requested = false;
+      snapshot_recorded = false;
+      snapshot_complete = false;
+      for (lvid_type lvid = 0; lvid < vstate.size(); ++lvid) {
+        const vertex_id_type gvid = graph.global_vid(lvid);
+        message_type msg;
+        if (scheduler_ptr->get_specific(lvid, msg) == sched_status::NEW_TASK) {
+          snapshot_messages.push_back(std::make_pair(gvid, msg));
+          scheduler_ptr->schedule(lvid, msg);
+        }
+        // the engine threads are waiting and the handlers which change
+        // the states below are blocked on snapshot_rwlock
+        const vertex_execution_state state = vstate[lvid].state;
+        if (graph.l_is_master(lvid)) {
+          if (state != NONE) {
+            snapshot_messages.push_back(
+                std::make_pair(gvid, vstate[lvid].current_message));
+          }
+        } else if (state == MIRROR_SCATTERING ||
+                   state == MIRROR_SCATTERING_AND_NEXT_LOCKING ||
+                   state == MIRROR_SCATTERING_AND_NEXT_GATHERING) {
+          snapshot_messages.push_back(std::make_pair(gvid, message_type()));
+        }
+      }
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        marker_count[p] = snapshot_sent[p].value;
+        snapshot_sent[p].value = 0;
+        snapshot_recv_prev[p] = snapshot_recv[p].value;
+        snapshot_recv[p].value = snapshot_recv_next[p];
+        snapshot_recv_next[p] = 0;
+      }
+      deferred.swap(snapshot_deferred);
+      deferred_scatters.swap(snapshot_deferred_scatters);
+      snapshot_mutex.unlock();
+      // the handlers which write vertex data are blocked on the
+      // rwlock, and the held back signals and scatters belong to the
+      // next epoch. Save the graph before either may run
+      graph.save_binary_local(snapshot_prefix(snapshot_epoch));
+      snapshot_rwlock.unlock();
+
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (p == rmi.procid()) continue;
+        rmi.remote_call(p, &engine_type::rpc_snapshot_marker,
+                        rmi.procid(), snapshot_epoch, marker_count[p]);
+      }
+      foreach(const vid_message_pair_type& pair, deferred) {
+        deliver_signal(pair.first, pair.second);
+      }
+      foreach(const deferred_scatter_type& scatter, deferred_scatters) {
+        rpc_begin_scattering(scatter.vid, scatter.prog, scatter.vdata);
+      }
+      std::vector<vid_message_pair_type> messages;
+      size_t complete_epoch = 0;
+      snapshot_mutex.lock();
+      snapshot_recorded = true;
+      const bool complete = try_complete_snapshot(messages, complete_epoch);
+      snapshot_mutex.unlock();
+      if (complete) write_snapshot_messages(complete_epoch, messages);
+    }
+
+    /**
+     * \internal
+     * Called by every engine thread when a snapshot is requested.
+     * The threads wait for each other and thread 0 records the state.
+     */
+    void snapshot_pause(size_t threadid) {
+      // keep receiving messages while the threads are waiting
+      if (handler_intercept) rmi.dc().start_handler_threads(threadid, ncpus);
+      thread_barrier.wait();
+      if (threadid == 0 && snapshot_requested) record_snapshot();
+      thread_barrier.wait();
+      if (handler_intercept) rmi.dc().stop_handler_threads(threadid, ncpus);
+    }
+
+    /**
+     * \internal
+     * Called after the engine threads stopped. Records the snapshots
+     * which were started but not recorded everywhere, and waits for
+     * the outstanding markers.
+     */
+    void finish_snapshots() {
+      while(1) {
+        rmi.full_barrier();
+        size_t nrequested = snapshot_requested;
+        if (snapshot_requested) record_snapshot();
+        rmi.all_reduce(nrequested);
+        if (nrequested == 0) break;
+      }
+      rmi.full_barrier();
+      if (!snapshot_complete) {
+        logstream(LOG_WARNING) << "Snapshot " << snapshot_prefix(snapshot_epoch)
+                               << " incomplete" << std::endl;
+      }
+    }
+
+  public:
+
+    /**
+     * \brief Returns the prefix of the last complete snapshot taken with
+     * the given snapshot_path, or an empty string if there is none.
+     */
+    static std::string latest_snapshot(const std::string& snapshot_path) {
+      const std::string fname = snapshot_path + ".latest";
+      std::string prefix;
+      if (!boost::starts_with(fname, "hdfs://")) {
+        std::ifstream fin(fname.c_str());
+        if (!fin.good()) return prefix;
+      }
+      load_snapshot_file(fname, prefix);
+      return prefix;
+    }
+
+    /**
+     * \brief Restores the pending messages of a snapshot.
+     *
+     * To resume from a snapshot, the graph is loaded from the snapshot
+     * with \ref distributed_graph::load_binary "graph.load_binary(prefix)"
+     * on the same number of machines which took the snapshot.
+     * Then the engine is constructed and resume_snapshot(prefix) is
+     * called in place of signal_all(), followed by start():
+     * \code
+     * std::string prefix = engine_type::latest_snapshot(snapshot_path);
+     * graph.load_binary(prefix);
+     * engine_type engine(dc, graph, clopts);
+     * engine.resume_snapshot(prefix);
+     * engine.start();
+     * \endcode
+     * Updates which were in progress when the snapshot was taken are
+     * executed again. This function must be called simultaneously on
+     * all machines.
+     */
+    void resume_snapshot(const std::string& prefix) {
+      rmi.barrier();
+      // mirrors may have been saved while their master was changing
+      graph.synchronize();
+      std::vector<vid_message_pair_type> messages;
+      load_snapshot_file(prefix + tostr(rmi.procid()) + ".msg", messages);
+      logstream(LOG_INFO) << rmi.procid() << ": Resuming " << messages.size()
+                          << " messages from " << prefix << std::endl;
+      foreach(const vid_message_pair_type& pair, messages) {
+        scheduler_ptr->schedule(graph.local_vid(pair.first), pair.second);
+      }
+      rmi.barrier();
+    }
+
+
 /**************************************************************************
  *                         Main engine start()                            *
  **************************************************************************/
@@ -2181,6 +2783,7 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
                    "Internal Queue IDs numeric overflow");
       }
       started = true;
+      if (snapshot_interval > 0) reset_snapshots();
 
       rmi.barrier();
 
@@ -2218,6 +2821,7 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
         thrgroup.launch(boost::bind(&engine_type::thread_start, this, i), i);
       }
       thrgroup.join();
+      if (snapshot_interval > 0) finish_snapshots();
       aggregator.stop();
       // if termination reason was not changed, then it must be depletion
       if (termination_reason == execution_status::RUNNING) {
@@ -26,7 +26,10 @@
 #define GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
 
 #include <deque>
+#include <fstream>
+#include <algorithm>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include <graphlab/engine/iengine.hpp>
 
@@ -42,12 +45,17 @@
 
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic_add_vector.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
+#include <graphlab/parallel/numa.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/hdfs.hpp>
+#include <graphlab/util/stl_util.hpp>
 
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/rpc/combining_buffered_exchange.hpp>
 
 
 
@@ -199,6 +207,59 @@ namespace graphlab {
    * for the snapshot. The path including folder and file prefix in
    * which the snapshots should be saved.
    *
+   * \li \b snapshot_deltas (default: 0) The number of incremental
+   * snapshots taken between two full snapshots. An incremental
+   * snapshot only holds the vertices modified by apply and the edges
+   * of the vertices that ran scatter since the previous snapshot.
+   * Edge data modified during gather is not tracked. The latest state
+   * is restored with \ref load_snapshot.
+   *
+   * \li \b frontier_mode (default: "auto") Determines how the gather
+   * and scatter minor-steps find their active vertices. "dense" always
+   * scans the active bitset a word at a time. "sparse" always iterates
+   * over an explicit (sorted) list of the activated local vertex ids.
+   * "auto" records the list while it is small and switches to the
+   * dense scan on each minor-step in which the active vertices and their
+   * edges exceed \c sparse_frontier_threshold of the local graph.
+   *
+   * \li \b sparse_frontier_threshold (default: 0.05) The fraction of
+   * the local vertices plus edges below which the "auto" frontier mode
+   * uses the sparse frontier.
+   *
+   * \li \b hub_degree_threshold (default: 0) Vertices with more
+   * gather (or scatter) edges than this are split into chunks of this
+   * many edges which are gathered (scattered) in parallel by all
+   * threads. The partial gathers are combined with operator+= before
+   * being sent to the master. 0 disables the splitting.
+   *
+   * \li \b numa (default: false) Partitions the local vertex ids into
+   * one contiguous range per NUMA node. The threads are bound to the
+   * cpus of their node, the per-vertex arrays of the engine are first
+   * touched by a thread on the node owning the range, and the threads
+   * of a node process the vertex blocks of their own range before
+   * taking blocks from the other ranges. Has no effect on machines
+   * with a single NUMA node.
+   *
+   * \li \b pipeline (default: false) Overlaps the gather exchange with
+   * the applys. A master vertex is applied as soon as its own gather
+   * and the gathers of all of its mirrors have arrived, instead of
+   * after all gathers of all machines have been exchanged. The applys
+   * wait for the local gathers to finish, since those read the vertex
+   * data the applys change.
+   *
+   * \li \b combine_exchange (default: false) Combines the gather
+   * accumulators and messages sent by a thread to the same vertex with
+   * operator+= before they are sent to the master, using a small hash
+   * table per thread and destination. The number of values sent and
+   * combined is logged at the end of the run.
+   *
+   * \li \b adaptive_exchange (default: false) Sizes the buffers of the
+   * exchanges to each machine from the rate of the data sent to it and
+   * the round trip time to it, between 4KB and 1MB, instead of sending
+   * every 64KB. Buffers are also sent once they were held for two round
+   * trips. The average buffer size and the reasons buffers were sent
+   * are logged at the end of the run.
+   *
    * \see graphlab::omni_engine
    * \see graphlab::async_consistent_engine
    * \see graphlab::semi_synchronous_engine
@@ -310,6 +371,11 @@ namespace graphlab {
      */
     typedef typename graph_type::local_edge_type      local_edge_type;
 
+    /**
+     * \brief Local edge list type used by the engine for fast indexing
+     */
+    typedef typename graph_type::local_edge_list_type local_edge_list_type;
+
     /**
      * \brief Local vertex id type used by the engine for fast indexing
      */
@@ -368,6 +434,32 @@ namespace graphlab {
     /// \brief The target base name the snapshot is saved in.
     std::string snapshot_path;
 
+    /**
+     * \brief The number of incremental snapshots taken between two
+     * full snapshots.
+     */
+    size_t snapshot_deltas;
+
+    /**
+     * \brief The number of incremental snapshots taken since the last
+     * full snapshot. Set to snapshot_deltas at the beginning of start()
+     * so that the first snapshot of a run is a full snapshot.
+     */
+    size_t deltas_since_full;
+
+    /**
+     * \brief The prefixes of the full snapshot and of the incremental
+     * snapshots taken after it, in the order they must be applied.
+     */
+    std::vector<std::string> snapshot_chain;
+
+    /**
+     * \brief Bitsets tracking the master vertices modified by apply,
+     * and the vertices whose in (out) edges were scattered on, since
+     * the last snapshot. Only used if snapshot_deltas > 0.
+     */
+    dense_bitset dirty_vertices, dirty_in_edges, dirty_out_edges;
+
     /**
      * \brief A counter that tracks the current iteration number since
      * start was last invoked.
@@ -454,6 +546,16 @@ namespace graphlab {
      */
     dense_bitset has_gather_accum;
 
+    /**
+     * \brief The number of out edges in the whole graph of each local
+     * vertex.
+     *
+     * Only allocated if the vertex program implements gather_batch,
+     * which reads the out degrees of the neighbors from this array
+     * instead of the vertex records.
+     */
+    std::vector<vertex_id_type> local_out_degree;
+
 
     /**
      * \brief This optional vector contains caches of previous gather
@@ -488,6 +590,74 @@ namespace graphlab {
      */
     dense_bitset active_minorstep;
 
+    /**
+     * \brief The sparse frontier: the local vertex ids whose
+     * active_minorstep bit was set during the current minor-step.
+     *
+     * Vertices are only recorded while there are at most
+     * frontier.size() of them. Beyond that the frontier is incomplete
+     * and the active_minorstep bitset must be scanned instead.
+     */
+    std::vector<lvid_type> frontier;
+
+    /**
+     * \brief The number of vertices activated in the current
+     * minor-step. If this exceeds frontier.size() the sparse frontier
+     * has overflowed.
+     */
+    atomic<size_t> frontier_size;
+
+    /**
+     * \brief True if the current gather or scatter minor-step iterates
+     * over the sparse frontier rather than the active_minorstep bitset.
+     */
+    bool use_sparse_frontier;
+
+    /**
+     * \brief The frontier mode: "auto", "sparse" or "dense".
+     */
+    std::string frontier_mode;
+
+    /**
+     * \brief The fraction of local vertices plus edges below which the
+     * "auto" frontier mode selects the sparse frontier.
+     */
+    double sparse_frontier_threshold;
+
+    /**
+     * \brief Vertices with more gather or scatter edges than this are
+     * split into chunks processed in parallel. 0 disables splitting.
+     */
+    size_t hub_degree_threshold;
+
+    /**
+     * \brief The high degree vertices deferred by the current gather
+     * or scatter minor-step.
+     */
+    std::vector<lvid_type> hubs;
+
+    /**
+     * \brief Protects hubs.
+     */
+    mutex hubs_lock;
+
+    /**
+     * \brief hub_chunk_begin[i] is the index of the first chunk of
+     * hubs[i]. The last entry is the total number of chunks.
+     */
+    std::vector<size_t> hub_chunk_begin;
+
+    /**
+     * \brief The partial gather of each hub chunk.
+     */
+    std::vector<gather_type> hub_chunk_accum;
+
+    /**
+     * \brief Whether the corresponding hub_chunk_accum was set. A
+     * char rather than a bool so that chunks can be set concurrently.
+     */
+    std::vector<char> hub_chunk_is_set;
+
     /**
      * \brief A counter measuring the number of applys that have been completed
      */
@@ -500,6 +670,83 @@ namespace graphlab {
      */
     atomic<size_t> shared_lvid_counter;
 
+    /**
+     * \brief True if the local vertex ids are partitioned across NUMA
+     * nodes. See the numa option.
+     */
+    bool use_numa;
+
+    /**
+     * \brief The NUMA node of each thread. Only used if use_numa.
+     */
+    std::vector<size_t> thread_node;
+
+    /**
+     * \brief numa_lvid_begin[k] is the first local vertex id of the range
+     * owned by NUMA node k. Has one more entry than there are nodes.
+     * The ranges start at word boundaries of the bitsets.
+     */
+    std::vector<lvid_type> numa_lvid_begin;
+
+    /**
+     * \brief The next unclaimed vertex of the range of each NUMA node.
+     * Replaces shared_lvid_counter for the dense vertex loops if
+     * use_numa.
+     */
+    std::vector<cache_line_pad<atomic<size_t> > > numa_lvid_counter;
+
+    /**
+     * \brief True if masters are applied as soon as all their gathers
+     * have arrived. See the pipeline option.
+     */
+    bool use_pipeline;
+
+    /**
+     * \brief The number of gathers each master vertex is waiting for in
+     * the pipelined mode. init_gather_countdown sets the expected
+     * number on every machine before the barrier which ends its
+     * run_synchronous, so no gather arrives before it and the count
+     * never goes below 0. The vertex is ready to be applied when the
+     * count returns to 0.
+     */
+    std::vector<atomic<int> > gather_countdown;
+
+    /**
+     * \brief The number of active masters not yet applied in the
+     * pipelined mode.
+     */
+    atomic<size_t> pipeline_pending;
+
+    /**
+     * \brief The masters ready to be applied in the pipelined mode, by
+     * the thread which received their last gather.
+     */
+    std::vector<std::vector<lvid_type> > ready_lvids;
+
+    /**
+     * \brief Protects ready_lvids.
+     */
+    std::vector<mutex> ready_locks;
+
+    /**
+     * \brief Counts the events a thread waiting for applies in the
+     * pipelined mode may be woken by: a gather buffer received, a
+     * master becoming ready, or the last master applied.
+     */
+    atomic<size_t> pipeline_events;
+
+    /**
+     * \brief The number of threads blocked in wait_for_pipeline().
+     */
+    atomic<size_t> pipeline_waiters;
+
+    /**
+     * \brief The lock and condition variable the threads waiting for
+     * applies in the pipelined mode block on.
+     */
+    mutex pipeline_wait_lock;
+    conditional pipeline_wait_cond;
+
 
     /**
      * \brief The pair type used to synchronize vertex programs across machines.
@@ -542,7 +789,8 @@ namespace graphlab {
      * \brief The type of the exchange used to synchronize gather
      * accumulators
      */
-    typedef buffered_exchange<vid_gather_pair_type> gather_exchange_type;
+    typedef combining_buffered_exchange<vertex_id_type, gather_type>
+    gather_exchange_type;
 
     /**
      * \brief The distributed exchange used to synchronize gather
@@ -550,6 +798,17 @@ namespace graphlab {
      */
     gather_exchange_type gather_exchange;
 
+    /**
+     * \brief The type of the exchange used by mirrors without a gather
+     * value to tell the master in the pipelined mode.
+     */
+    typedef buffered_exchange<vertex_id_type> gather_done_exchange_type;
+
+    /**
+     * \brief The distributed exchange of mirrors without a gather value.
+     */
+    gather_done_exchange_type gather_done_exchange;
+
     /**
      * \brief The pair type used to synchronize messages
      */
@@ -558,7 +817,8 @@ namespace graphlab {
     /**
      * \brief The type of the exchange used to synchronize messages
      */
-    typedef buffered_exchange<vid_message_pair_type> message_exchange_type;
+    typedef combining_buffered_exchange<vertex_id_type, message_type>
+    message_exchange_type;
 
     /**
      * \brief The distributed exchange used to synchronize messages
@@ -672,8 +932,27 @@ namespace graphlab {
      */
     aggregator_type* get_aggregator();
 
+    /**
+     * \brief Restores the graph from the latest snapshot taken with
+     * the given snapshot_path.
+     *
+     * Loads the last full snapshot with
+     * \ref distributed_graph::load_binary and applies the incremental
+     * snapshots taken after it (see the snapshot_deltas option). Must
+     * be called simultaneously on all machines, on the same number of
+     * machines which took the snapshot.
+     */
+    static void load_snapshot(graph_type& graph,
+                              const std::string& snapshot_path);
+
   private:
 
+    /**
+     * \brief Saves a full or an incremental snapshot of the graph and
+     * records it in [snapshot_path][procid].txt.
+     */
+    void take_snapshot();
+
     /**
      * \brief This internal stop function is called by the \ref graphlab::context to
      * terminate execution of the engine.
@@ -746,6 +1025,93 @@ namespace graphlab {
       DECREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
     }
 
+    /**
+     * \brief Binds the calling pool thread to the NUMA node of the
+     * engine thread id before running fn.
+     */
+    void thread_launch_numa_bound(boost::function<void(void)> fn,
+                                  size_t thread_id) {
+      numa::bind_current_thread(thread_node[thread_id]);
+      thread_launch_wrapped_event_counter(fn);
+    }
+
+    /**
+     * \brief Partitions the local vertex ids across the NUMA nodes and
+     * assigns the threads to the nodes. Disables use_numa if there is
+     * only one node.
+     */
+    void init_numa();
+
+    /**
+     * \brief Resizes a per-vertex array so that the part of each NUMA
+     * node is first touched by the constructing thread while it is
+     * bound to that node.
+     */
+    template <typename T>
+    void numa_resize(std::vector<T>& vec, size_t n, const T& value) {
+      if (!use_numa) {
+        vec.resize(n, value);
+        return;
+      }
+      std::vector<T>().swap(vec);
+      vec.reserve(n);
+      for (size_t k = 0; k + 1 < numa_lvid_begin.size(); ++k) {
+        numa::scoped_node_binding binding(k);
+        vec.resize(std::min(size_t(numa_lvid_begin[k + 1]), n), value);
+      }
+      vec.resize(n, value);
+    }
+
+    /**
+     * \brief Resizes and clears a per-vertex bitset, first touching
+     * the words of each NUMA node range on that node.
+     */
+    void numa_resize(dense_bitset& bitset, size_t n) {
+      bitset.resize(n);
+      if (!use_numa) {
+        bitset.clear();
+        return;
+      }
+      const size_t wordbits = 8 * sizeof(size_t);
+      for (size_t k = 0; k + 1 < numa_lvid_begin.size(); ++k) {
+        numa::scoped_node_binding binding(k);
+        for (size_t b = numa_lvid_begin[k];
+             b < std::min(size_t(numa_lvid_begin[k + 1]), n); b += wordbits) {
+          bitset.get_containing_word_and_zero(b);
+        }
+      }
+    }
+
+    /**
+     * \brief Claims the next block of 8 * sizeof(size_t) local vertex
+     * ids for a dense loop over the vertices.
+     *
+     * With use_numa, blocks of the range of the thread's own NUMA node
+     * are handed out first and then blocks of the other ranges.
+     *
+     * \return false once all the blocks have been claimed
+     */
+    bool next_lvid_block(size_t thread_id, lvid_type& lvid_block_start) {
+      const size_t wordbits = 8 * sizeof(size_t);
+      if (!use_numa) {
+        lvid_block_start = shared_lvid_counter.inc_ret_last(wordbits);
+        return lvid_block_start < graph.num_local_vertices();
+      }
+      const size_t nnodes = numa_lvid_counter.size();
+      const size_t node = thread_node[thread_id];
+      for (size_t i = 0; i < nnodes; ++i) {
+        const size_t k = (node + i) % nnodes;
+        atomic<size_t>& counter = numa_lvid_counter[k].value;
+        if (counter.value >= numa_lvid_begin[k + 1]) continue;
+        const size_t block = counter.inc_ret_last(wordbits);
+        if (block < numa_lvid_begin[k + 1]) {
+          lvid_block_start = block;
+          return true;
+        }
+      }
+      return false;
+    }
+
     /**
      * \brief Executes ncpus copies of a member function each with a
      * unique consecutive id (thread id).
@@ -767,6 +1133,9 @@ namespace graphlab {
     template<typename MemberFunction>
     void run_synchronous(MemberFunction member_fun) {
       shared_lvid_counter = 0;
+      for (size_t k = 0; k < numa_lvid_counter.size(); ++k) {
+        numa_lvid_counter[k].value = numa_lvid_begin[k];
+      }
       if (threads.size() <= 1) {
         INCREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
         ( (this)->*(member_fun))(0);
@@ -776,10 +1145,16 @@ namespace graphlab {
         // launch the initialization threads
         for(size_t i = 0; i < threads.size(); ++i) {
           boost::function<void(void)> invoke = boost::bind(member_fun, this, i);
-          threads.launch(boost::bind(
-                &synchronous_engine::thread_launch_wrapped_event_counter,
-                this,
-                invoke), i);
+          if (use_numa) {
+            threads.launch(boost::bind(
+                  &synchronous_engine::thread_launch_numa_bound,
+                  this, invoke, i), i);
+          } else {
+            threads.launch(boost::bind(
+                  &synchronous_engine::thread_launch_wrapped_event_counter,
+                  this,
+                  invoke), i);
+          }
         }
       }
       // Wait for all threads to finish
@@ -825,6 +1200,49 @@ namespace graphlab {
      */
     void execute_gathers(size_t thread_id);
 
+    /**
+     * \brief Compute the local gather for a single vertex and send it
+     * to the master.
+     */
+    void execute_gather(context_type& context, lvid_type lvid,
+                        size_t thread_id);
+
+    /**
+     * \brief Gather the edges [begin, end) of a vertex into accum.
+     * The in edges (if gathered) are numbered before the out edges.
+     *
+     * \return the number of edges gathered
+     */
+    size_t gather_edge_range(context_type& context, lvid_type lvid,
+                             size_t begin, size_t end,
+                             gather_type& accum, bool& accum_is_set);
+
+    /**
+     * \brief Gather the edges [begin, end) of a vertex through the
+     * batched gather of the vertex program, numbering the edges as in
+     * gather_edge_range.
+     *
+     * \return false if the edges are not stored contiguously, in
+     * which case nothing is gathered.
+     */
+    bool gather_edge_range_batch(context_type& context, lvid_type lvid,
+                                 size_t begin, size_t end,
+                                 gather_type& accum, bool& accum_is_set,
+                                 size_t& edges_touched);
+
+    /**
+     * \brief Finish the gather of a vertex: cache the accumulator,
+     * send it to the master and clear mirror vertex programs.
+     */
+    void finish_gather(lvid_type lvid, const gather_type& accum,
+                       bool accum_is_set, size_t thread_id);
+
+    /**
+     * \brief Gather the deferred hub vertices in parallel chunks.
+     * Must be called by all threads.
+     */
+    void execute_hub_gathers(context_type& context, size_t thread_id);
+
 
 
 
@@ -837,6 +1255,73 @@ namespace graphlab {
      */
     void execute_applys(size_t thread_id);
 
+    /**
+     * \brief Run the apply on a single master vertex and synchronize
+     * the result with its mirrors.
+     */
+    void apply_vertex(context_type& context, lvid_type lvid,
+                      size_t thread_id);
+
+    /**
+     * \brief Adds the number of gathers expected for each active master
+     * to its gather_countdown and counts the active masters in
+     * pipeline_pending. Used in the pipelined mode.
+     */
+    void init_gather_countdown(size_t thread_id);
+
+    /**
+     * \brief Counts count gathers of the master lvid, queueing it for
+     * its apply if that was the last one. A negative count adds
+     * expected gathers.
+     */
+    void report_gathers(lvid_type lvid, int count, size_t thread_id) {
+      if(gather_countdown[lvid].dec(count) != 0) return;
+      if(!active_superstep.get(lvid)) return;
+      ready_locks[thread_id].lock();
+      ready_lvids[thread_id].push_back(lvid);
+      ready_locks[thread_id].unlock();
+      notify_pipeline();
+    }
+
+    /**
+     * \brief Counts a pipeline event and wakes the threads blocked in
+     * wait_for_pipeline().
+     */
+    void notify_pipeline() {
+      pipeline_events.inc();
+      if(pipeline_waiters.value == 0) return;
+      pipeline_wait_lock.lock();
+      pipeline_wait_cond.broadcast();
+      pipeline_wait_lock.unlock();
+    }
+
+    /**
+     * \brief Blocks until a pipeline event follows the seen events.
+     */
+    void wait_for_pipeline(size_t seen) {
+      pipeline_wait_lock.lock();
+      pipeline_waiters.inc();
+      while(pipeline_events.value == seen) {
+        pipeline_wait_cond.wait(pipeline_wait_lock);
+      }
+      pipeline_waiters.dec();
+      pipeline_wait_lock.unlock();
+    }
+
+    /**
+     * \brief Moves the masters ready to be applied into ret, taking
+     * those of other threads if this thread has none.
+     */
+    void take_ready_lvids(size_t thread_id, std::vector<lvid_type>& ret);
+
+    /**
+     * \brief Apply the masters as their gathers arrive until all active
+     * masters are applied, then synchronize the mirrors as
+     * execute_applys() does. Ends the gather phase in the pipelined
+     * mode.
+     */
+    void execute_pipelined_applys(context_type& context, size_t thread_id);
+
     /**
      * \brief Execute the \ref graphlab::ivertex_program::scatter function on all
      * vertices that received messages for the edges specified by the
@@ -847,6 +1332,95 @@ namespace graphlab {
      */
     void execute_scatters(size_t thread_id);
 
+    /**
+     * \brief Run the scatter on a single vertex and clear its vertex
+     * program.
+     */
+    void execute_scatter(context_type& context, lvid_type lvid);
+
+    /**
+     * \brief Scatter on the edges [begin, end) of a vertex, numbered
+     * as in gather_edge_range.
+     *
+     * \return the number of edges scattered
+     */
+    size_t scatter_edge_range(context_type& context, lvid_type lvid,
+                              size_t begin, size_t end);
+
+    /**
+     * \brief Scatter the deferred hub vertices in parallel chunks.
+     * Must be called by all threads.
+     */
+    void execute_hub_scatters(context_type& context, size_t thread_id);
+
+    /**
+     * \brief Returns the number of edges in the given direction(s).
+     */
+    size_t num_dir_edges(local_vertex_type& local_vertex,
+                         edge_dir_type dir) const {
+      size_t nedges = 0;
+      if(dir == IN_EDGES || dir == ALL_EDGES)
+        nedges += local_vertex.num_in_edges();
+      if(dir == OUT_EDGES || dir == ALL_EDGES)
+        nedges += local_vertex.num_out_edges();
+      return nedges;
+    }
+
+    /**
+     * \brief Defers a vertex to the hub phase if it has more than
+     * hub_degree_threshold edges in the given direction(s).
+     *
+     * \return true if the vertex was deferred
+     */
+    bool defer_hub(local_vertex_type& local_vertex, lvid_type lvid,
+                   edge_dir_type dir) {
+      if(hub_degree_threshold == 0 ||
+         num_dir_edges(local_vertex, dir) <= hub_degree_threshold)
+        return false;
+      hubs_lock.lock();
+      hubs.push_back(lvid);
+      hubs_lock.unlock();
+      return true;
+    }
+
+    /**
+     * \brief Assign chunk ids to the deferred hubs. Called by a
+     * single thread.
+     */
+    void build_hub_chunks(const bool gather);
+
+    // Frontier Management ====================================================
+    /**
+     * \brief Set the active_minorstep bit of a vertex and record the
+     * vertex in the sparse frontier if it was not already active.
+     */
+    void activate_minorstep(lvid_type lvid) {
+      if(!active_minorstep.set_bit(lvid) &&
+         frontier_size.value <= frontier.size()) {
+        const size_t idx = frontier_size.inc_ret_last();
+        if(idx < frontier.size()) frontier[idx] = lvid;
+      }
+    }
+
+    /**
+     * \brief Clear all active_minorstep bits.  If the sparse frontier
+     * is complete only the recorded bits are cleared.
+     */
+    void clear_active_minorstep();
+
+    /**
+     * \brief Decide whether the next minor-step iterates over the
+     * sparse frontier or scans the active_minorstep bitset.
+     */
+    void select_frontier();
+
+    /**
+     * \brief Log the average size of the buffers an adaptive exchange
+     * sent, and why they were sent.
+     */
+    template <typename PeerStatsVector>
+    void log_exchange_stats(const char* name, const PeerStatsVector& stats);
+
     // Data Synchronization ===================================================
     /**
      * \brief Send the vertex program for the local vertex id to all
@@ -903,7 +1477,14 @@ namespace graphlab {
      * buffered exchange and should be called after the buffered
      * exchange has been flushed
      */
-    void recv_gathers(const bool try_to_recv = false);
+    void recv_gathers(const bool try_to_recv = false,
+                      const size_t thread_id = 0);
+
+    /**
+     * \brief Receive the mirrors without a gather value in the
+     * pipelined mode.
+     */
+    void recv_gather_done(const bool try_to_recv, const size_t thread_id);
 
     /**
      * \brief Send the accumulated message for the local vertex to its
@@ -976,17 +1557,24 @@ namespace graphlab {
     rmi(dc, this), graph(graph),
     threads(opts.get_ncpus()),
     thread_barrier(opts.get_ncpus()),
-    max_iterations(-1), snapshot_interval(-1), iteration_counter(0),
-    timeout(0), sched_allv(false),
+    max_iterations(-1), snapshot_interval(-1), snapshot_deltas(0),
+    deltas_since_full(0), iteration_counter(0),
+    timeout(0), sched_allv(false), use_sparse_frontier(false),
+    frontier_mode("auto"), sparse_frontier_threshold(0.05),
+    hub_degree_threshold(0), use_numa(false), use_pipeline(false),
     vprog_exchange(dc, opts.get_ncpus(), 64 * 1024),
     vdata_exchange(dc, opts.get_ncpus(), 64 * 1024),
     gather_exchange(dc, opts.get_ncpus(), 64 * 1024),
+    gather_done_exchange(dc, opts.get_ncpus(), 64 * 1024),
     message_exchange(dc, opts.get_ncpus(), 64 * 1024),
     aggregator(dc, graph, new context_type(*this, graph)) {
     // Process any additional options
     std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
     per_thread_compute_time.resize(opts.get_ncpus());
     bool use_cache = false;
+    // combining is enabled by the combine_exchange option
+    gather_exchange.set_combining(false);
+    message_exchange.set_combining(false);
     foreach(std::string opt, keys) {
       if (opt == "max_iterations") {
         opts.get_engine_args().get_option("max_iterations", max_iterations);
@@ -1013,11 +1601,64 @@ namespace graphlab {
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: snapshot_path = "
             << snapshot_path << std::endl;
+      } else if (opt == "snapshot_deltas") {
+        opts.get_engine_args().get_option("snapshot_deltas", snapshot_deltas);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: snapshot_deltas = "
+            << snapshot_deltas << std::endl;
       } else if (opt == "sched_allv") {
         opts.get_engine_args().get_option("sched_allv", sched_allv);
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: sched_allv = "
             << sched_allv << std::endl;
+      } else if (opt == "frontier_mode") {
+        opts.get_engine_args().get_option("frontier_mode", frontier_mode);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: frontier_mode = "
+            << frontier_mode << std::endl;
+      } else if (opt == "sparse_frontier_threshold") {
+        opts.get_engine_args().get_option("sparse_frontier_threshold",
+                                          sparse_frontier_threshold);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: sparse_frontier_threshold = "
+            << sparse_frontier_threshold << std::endl;
+      } else if (opt == "hub_degree_threshold") {
+        opts.get_engine_args().get_option("hub_degree_threshold",
+                                          hub_degree_threshold);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: hub_degree_threshold = "
+            << hub_degree_threshold << std::endl;
+      } else if (opt == "numa") {
+        opts.get_engine_args().get_option("numa", use_numa);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: numa = "
+            << use_numa << std::endl;
+      } else if (opt == "pipeline") {
+        opts.get_engine_args().get_option("pipeline", use_pipeline);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: pipeline = "
+            << use_pipeline << std::endl;
+      } else if (opt == "adaptive_exchange") {
+        bool adaptive_exchange = false;
+        opts.get_engine_args().get_option("adaptive_exchange",
+                                          adaptive_exchange);
+        const size_t max_size = adaptive_exchange ? 1024 * 1024 : 64 * 1024;
+        vprog_exchange.set_adaptive(adaptive_exchange, max_size);
+        vdata_exchange.set_adaptive(adaptive_exchange, max_size);
+        gather_exchange.set_adaptive(adaptive_exchange, max_size);
+        gather_done_exchange.set_adaptive(adaptive_exchange, max_size);
+        message_exchange.set_adaptive(adaptive_exchange, max_size);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: adaptive_exchange = "
+            << adaptive_exchange << std::endl;
+      } else if (opt == "combine_exchange") {
+        bool combine_exchange = false;
+        opts.get_engine_args().get_option("combine_exchange", combine_exchange);
+        gather_exchange.set_combining(combine_exchange);
+        message_exchange.set_combining(combine_exchange);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: combine_exchange = "
+            << combine_exchange << std::endl;
       } else {
         logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
       }
@@ -1027,6 +1668,11 @@ namespace graphlab {
       logstream(LOG_FATAL)
         << "Snapshot interval specified, but no snapshot path" << std::endl;
     }
+    if (frontier_mode != "auto" && frontier_mode != "sparse" &&
+        frontier_mode != "dense") {
+      logstream(LOG_FATAL)
+        << "Invalid frontier_mode: " << frontier_mode << std::endl;
+    }
     INITIALIZE_EVENT_LOG(dc);
     ADD_CUMULATIVE_EVENT(EVENT_APPLIES, "Applies", "Calls");
     ADD_CUMULATIVE_EVENT(EVENT_GATHERS , "Gathers", "Calls");
@@ -1036,30 +1682,61 @@ namespace graphlab {
     // Finalize the graph
     graph.finalize();
     memory_info::log_usage("Before Engine Initialization");
+    if (use_numa) init_numa();
     // Allocate vertex locks and vertex programs
-    vlocks.resize(graph.num_local_vertices());
-    vertex_programs.resize(graph.num_local_vertices());
+    numa_resize(vlocks, graph.num_local_vertices(), simple_spinlock());
+    numa_resize(vertex_programs, graph.num_local_vertices(),
+                vertex_program_type());
     // allocate the edge locks
     //elocks.resize(graph.num_local_edges());
     // Allocate messages and message bitset
-    messages.resize(graph.num_local_vertices(), message_type());
-    has_message.resize(graph.num_local_vertices());
-    has_message.clear();
+    numa_resize(messages, graph.num_local_vertices(), message_type());
+    numa_resize(has_message, graph.num_local_vertices());
     // Allocate gather accumulators and accumulator bitset
-    gather_accum.resize(graph.num_local_vertices(), gather_type());
-    has_gather_accum.resize(graph.num_local_vertices());
-    has_gather_accum.clear();
+    numa_resize(gather_accum, graph.num_local_vertices(), gather_type());
+    numa_resize(has_gather_accum, graph.num_local_vertices());
+    if (vertex_program_impl::implements_gather_batch<vertex_program_type>::value) {
+      numa_resize(local_out_degree, graph.num_local_vertices(),
+                  vertex_id_type(0));
+      for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+        local_out_degree[lvid] = graph.l_get_vertex_record(lvid).num_out_edges;
+      }
+    }
     // If caching is used then allocate cache data-structures
     if (use_cache) {
-      gather_cache.resize(graph.num_local_vertices(), gather_type());
-      has_cache.resize(graph.num_local_vertices());
-      has_cache.clear();
+      numa_resize(gather_cache, graph.num_local_vertices(), gather_type());
+      numa_resize(has_cache, graph.num_local_vertices());
     }
     // Allocate bitset to track active vertices on each bitset.
-    active_superstep.resize(graph.num_local_vertices());
-    active_superstep.clear();
-    active_minorstep.resize(graph.num_local_vertices());
-    active_minorstep.clear();
+    numa_resize(active_superstep, graph.num_local_vertices());
+    numa_resize(active_minorstep, graph.num_local_vertices());
+    // Allocate the gather countdowns of the pipelined mode
+    if (use_pipeline) {
+      numa_resize(gather_countdown, graph.num_local_vertices(), atomic<int>());
+      ready_lvids.resize(threads.size());
+      ready_locks.resize(threads.size());
+      gather_exchange.set_recv_notify(
+          boost::bind(&synchronous_engine::notify_pipeline, this));
+      gather_done_exchange.set_recv_notify(
+          boost::bind(&synchronous_engine::notify_pipeline, this));
+    }
+    // Allocate the bitsets tracking changes for incremental snapshots
+    if (snapshot_deltas > 0) {
+      numa_resize(dirty_vertices, graph.num_local_vertices());
+      numa_resize(dirty_in_edges, graph.num_local_vertices());
+      numa_resize(dirty_out_edges, graph.num_local_vertices());
+    }
+    // Allocate the sparse frontier. In the auto mode it only needs to
+    // hold as many vertices as could ever select the sparse frontier.
+    if (frontier_mode == "sparse") {
+      frontier.resize(graph.num_local_vertices());
+    } else if (frontier_mode == "auto") {
+      frontier.resize(std::min(graph.num_local_vertices(),
+                               size_t(sparse_frontier_threshold *
+                                      (graph.num_local_vertices() +
+                                       graph.num_local_edges()))));
+    }
+    frontier_size = 0;
     // Print memory usage after initialization
     memory_info::log_usage("After Engine Initialization");
     rmi.barrier();
@@ -1079,6 +1756,104 @@ namespace graphlab {
 
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::init_numa() {
+    const size_t nthreads = threads.size();
+    const size_t nnodes = std::min(numa::num_nodes(), nthreads);
+    if (nnodes <= 1) {
+      logstream(LOG_INFO) << "Single NUMA node. Ignoring the numa option"
+                          << std::endl;
+      use_numa = false;
+      return;
+    }
+    // consecutive threads share a node
+    thread_node.resize(nthreads);
+    for (size_t i = 0; i < nthreads; ++i) {
+      thread_node[i] = i * nnodes / nthreads;
+    }
+    // split the vertices evenly at word boundaries of the bitsets
+    const size_t wordbits = 8 * sizeof(size_t);
+    const size_t nverts = graph.num_local_vertices();
+    numa_lvid_begin.resize(nnodes + 1);
+    for (size_t k = 0; k < nnodes; ++k) {
+      numa_lvid_begin[k] = (k * nverts / nnodes) / wordbits * wordbits;
+    }
+    numa_lvid_begin[nnodes] = nverts;
+    numa_lvid_counter.resize(nnodes);
+    logstream(LOG_INFO) << "Partitioned " << nverts << " local vertices over "
+                        << nnodes << " NUMA nodes" << std::endl;
+  } // end of init_numa
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::take_snapshot() {
+    if (deltas_since_full >= snapshot_deltas) {
+      graph.save_binary(snapshot_path);
+      snapshot_chain.assign(1, snapshot_path);
+      deltas_since_full = 0;
+    } else {
+      ++deltas_since_full;
+      const std::string prefix =
+        snapshot_path + "delta" + tostr(deltas_since_full) + "_";
+      graph.save_binary_delta(prefix, dirty_vertices,
+                              dirty_in_edges, dirty_out_edges);
+      snapshot_chain.push_back(prefix);
+    }
+    if (snapshot_deltas > 0) {
+      dirty_vertices.clear();
+      dirty_in_edges.clear();
+      dirty_out_edges.clear();
+    }
+    // All parts are written. Point the manifest at the new snapshot.
+    const std::string fname = snapshot_path + tostr(rmi.procid()) + ".txt";
+    if (boost::starts_with(fname, "hdfs://")) {
+      graphlab::hdfs& hdfs = hdfs::get_hdfs();
+      graphlab::hdfs::fstream fout(hdfs, fname, true);
+      foreach(const std::string& prefix, snapshot_chain)
+        fout << prefix << "\n";
+      fout.close();
+    } else {
+      std::ofstream fout(fname.c_str());
+      if (!fout.good()) {
+        logstream(LOG_FATAL) << "Error opening file: " << fname << std::endl;
+      }
+      foreach(const std::string& prefix, snapshot_chain)
+        fout << prefix << "\n";
+      fout.close();
+    }
+    rmi.barrier();
+  } // end of take_snapshot
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  load_snapshot(graph_type& graph, const std::string& snapshot_path) {
+    const std::string fname =
+      snapshot_path + tostr(graph.procid()) + ".txt";
+    std::vector<std::string> chain;
+    std::string prefix;
+    if (boost::starts_with(fname, "hdfs://")) {
+      graphlab::hdfs& hdfs = hdfs::get_hdfs();
+      graphlab::hdfs::fstream fin(hdfs, fname);
+      while (std::getline(fin, prefix)) chain.push_back(prefix);
+      fin.close();
+    } else {
+      std::ifstream fin(fname.c_str());
+      while (std::getline(fin, prefix)) chain.push_back(prefix);
+      fin.close();
+    }
+    // snapshots taken before the manifest was introduced
+    if (chain.empty()) chain.push_back(snapshot_path);
+    graph.load_binary(chain[0]);
+    for (size_t i = 1; i < chain.size(); ++i) {
+      graph.load_binary_delta(chain[i]);
+    }
+  } // end of load_snapshot
+
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::internal_stop() {
     for (size_t i = 0; i < rmi.numprocs(); ++i)
@@ -1239,9 +2014,10 @@ namespace graphlab {
     //   run_synchronous( &synchronous_engine::initialize_vertex_programs );
     // }
     aggregator.start();
+    deltas_since_full = snapshot_deltas;
     rmi.barrier();
     if (snapshot_interval == 0) {
-      graph.save_binary(snapshot_path);
+      take_snapshot();
     }
 
     float last_print = -5;
@@ -1269,7 +2045,7 @@ namespace graphlab {
       // Reset Active vertices ----------------------------------------------
       // Clear the active super-step and minor-step bits which will
       // be set upon receiving messages
-      active_superstep.clear(); active_minorstep.clear();
+      active_superstep.clear(); clear_active_minorstep();
       has_gather_accum.clear();
       rmi.barrier();
 
@@ -1292,6 +2068,8 @@ namespace graphlab {
       run_synchronous( &synchronous_engine::receive_messages );
       if (sched_allv) {
         active_minorstep.fill();
+        // the sparse frontier no longer describes the active vertices
+        frontier_size = frontier.size() + 1;
       }
       has_message.clear();
       /**
@@ -1322,11 +2100,18 @@ namespace graphlab {
       // Execute the gather operation for all vertices that are active
       // in this minor-step (active-minorstep bit set).
       // if (rmi.procid() == 0) std::cout << "Gathering..." << std::endl;
+      // In the pipelined mode the masters are applied by
+      // execute_gathers as soon as their gathers have arrived, which
+      // also clears the minor step bits
+      if (use_pipeline) {
+        run_synchronous( &synchronous_engine::init_gather_countdown );
+      }
+      select_frontier();
       run_synchronous( &synchronous_engine::execute_gathers );
       // Clear the minor step bit since only super-step vertices
       // (only master vertices are required to participate in the
       // apply step)
-      active_minorstep.clear(); // rmi.barrier();
+      if (!use_pipeline) clear_active_minorstep(); // rmi.barrier();
       /**
        * Post conditions:
        *   1) gather_accum for all master vertices contains the
@@ -1338,7 +2123,9 @@ namespace graphlab {
       // Execute Apply Operations -------------------------------------------
       // Run the apply function on all active vertices
       // if (rmi.procid() == 0) std::cout << "Applying..." << std::endl;
-      run_synchronous( &synchronous_engine::execute_applys );
+      if (!use_pipeline) {
+        run_synchronous( &synchronous_engine::execute_applys );
+      }
       /**
        * Post conditions:
        *   1) any changes to the vertex data have been synchronized
@@ -1353,6 +2140,7 @@ namespace graphlab {
 
       // Execute Scatter Operations -----------------------------------------
       // Execute each of the scatters on all minor-step active vertices.
+      select_frontier();
       run_synchronous( &synchronous_engine::execute_scatters );
       /**
        * Post conditions:
@@ -1366,7 +2154,7 @@ namespace graphlab {
       ++iteration_counter;
 
       if (snapshot_interval > 0 && iteration_counter % snapshot_interval == 0) {
-        graph.save_binary(snapshot_path);
+        take_snapshot();
       }
     }
 
@@ -1394,6 +2182,28 @@ namespace graphlab {
       }
       logstream(LOG_INFO) << std::endl;
     }
+    if (gather_exchange.combining_enabled()) {
+      size_t gathers_sent = gather_exchange.num_sent();
+      size_t gathers_combined = gather_exchange.num_combined();
+      size_t messages_sent = message_exchange.num_sent();
+      size_t messages_combined = message_exchange.num_combined();
+      rmi.all_reduce(gathers_sent);
+      rmi.all_reduce(gathers_combined);
+      rmi.all_reduce(messages_sent);
+      rmi.all_reduce(messages_combined);
+      if (rmi.procid() == 0) {
+        logstream(LOG_INFO) << "Combined gathers: " << gathers_combined
+                            << " of " << gathers_sent
+                            << ", combined messages: " << messages_combined
+                            << " of " << messages_sent << std::endl;
+      }
+    }
+    if (gather_exchange.adaptive_enabled() && rmi.procid() == 0) {
+      log_exchange_stats("vprog", vprog_exchange.get_stats());
+      log_exchange_stats("vdata", vdata_exchange.get_stats());
+      log_exchange_stats("gather", gather_exchange.get_stats());
+      log_exchange_stats("message", message_exchange.get_stats());
+    }
     rmi.full_barrier();
     // Stop the aggregator
     aggregator.stop();
@@ -1415,9 +2225,8 @@ namespace graphlab {
     //     lvid += threads.size()) {
     while (1) {
       // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      lvid_type lvid_block_start;
+      if (!next_lvid_block(thread_id, lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1459,9 +2268,8 @@ namespace graphlab {
     fixed_dense_bitset<sizeof(size_t)> local_bitset;
     while (1) {
       // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      lvid_type lvid_block_start;
+      if (!next_lvid_block(thread_id, lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1489,7 +2297,7 @@ namespace graphlab {
           const vertex_type const_vertex = vertex;
           if(const_vprog.gather_edges(context, const_vertex) !=
               graphlab::NO_EDGES) {
-            active_minorstep.set_bit(lvid);
+            activate_minorstep(lvid);
             sync_vertex_program(lvid, thread_id);
           }
         }
@@ -1512,6 +2320,71 @@ namespace graphlab {
   } // end of receive messages
 
 
+  template<typename VertexProgram>
+  template<typename PeerStatsVector>
+  void synchronous_engine<VertexProgram>::
+  log_exchange_stats(const char* name, const PeerStatsVector& stats) {
+    size_t buffers = 0, bytes = 0, size_flushes = 0, deadline_flushes = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+      buffers += stats[i].buffers_sent;
+      bytes += stats[i].bytes_sent;
+      size_flushes += stats[i].flushes[gather_done_exchange_type::FLUSH_SIZE];
+      deadline_flushes +=
+        stats[i].flushes[gather_done_exchange_type::FLUSH_DEADLINE];
+    }
+    logstream(LOG_INFO) << "Exchange " << name << ": " << buffers
+                        << " buffers of " << (buffers == 0 ? 0 : bytes / buffers)
+                        << " bytes on average. Sent when full: " << size_flushes
+                        << ", on deadline: " << deadline_flushes
+                        << ", on flush: "
+                        << buffers - size_flushes - deadline_flushes
+                        << std::endl;
+  } // end of log_exchange_stats
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  clear_active_minorstep() {
+    const size_t nactive = frontier_size.value;
+    if(nactive <= frontier.size()) {
+      // the sparse frontier is complete so only clear its bits
+      for(size_t i = 0; i < nactive; ++i) {
+        active_minorstep.clear_bit_unsync(frontier[i]);
+      }
+    } else {
+      active_minorstep.clear();
+    }
+    frontier_size = 0;
+  } // end of clear_active_minorstep
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  select_frontier() {
+    use_sparse_frontier = false;
+    const size_t nactive = frontier_size.value;
+    if(frontier_mode == "dense" || nactive > frontier.size()) return;
+    if(frontier_mode == "auto") {
+      // Compare the work touched by the frontier (active vertices
+      // and their edges) against the size of the local graph scanned
+      // by the dense pass.
+      size_t frontier_edges = 0;
+      for(size_t i = 0; i < nactive; ++i) {
+        local_vertex_type local_vertex = graph.l_vertex(frontier[i]);
+        frontier_edges += local_vertex.num_in_edges() +
+                          local_vertex.num_out_edges();
+      }
+      const double dense_work = graph.num_local_vertices() +
+                                graph.num_local_edges();
+      if(nactive + frontier_edges >= sparse_frontier_threshold * dense_work)
+        return;
+    }
+    // visit the frontier in lvid order to preserve memory locality
+    std::sort(frontier.begin(), frontier.begin() + nactive);
+    use_sparse_frontier = true;
+  } // end of select_frontier
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   execute_gathers(const size_t thread_id) {
@@ -1519,96 +2392,53 @@ namespace graphlab {
     const bool TRY_TO_RECV = true;
     const size_t TRY_RECV_MOD = 1000;
     size_t vcount = 0;
-    const bool caching_enabled = !gather_cache.empty();
     // for(lvid_type lvid = thread_id; lvid < graph.num_local_vertices();
     //     lvid += threads.size()) {
     timer ti;
 
-    fixed_dense_bitset<sizeof(size_t)> local_bitset;
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
-      local_bitset.clear();
-      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
-
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
-        if (lvid >= graph.num_local_vertices()) break;
-
-        bool accum_is_set = false;
-        gather_type accum = gather_type();
-        // if caching is enabled and we have a cache entry then use
-        // that as the accum
-        if( caching_enabled && has_cache.get(lvid) ) {
-          accum = gather_cache[lvid];
-          accum_is_set = true;
-        } else {
-          // recompute the local contribution to the gather
-          const vertex_program_type& vprog = vertex_programs[lvid];
-          local_vertex_type local_vertex = graph.l_vertex(lvid);
-          const vertex_type vertex(local_vertex);
-          const edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
-          // Loop over in edges
-          size_t edges_touched = 0;
-          vprog.pre_local_gather(accum);
-          if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
-            foreach(local_edge_type local_edge, local_vertex.in_edges()) {
-              edge_type edge(local_edge);
-              // elocks[local_edge.id()].lock();
-              if(accum_is_set) { // \todo hint likely
-                accum += vprog.gather(context, vertex, edge);
-              } else {
-                accum = vprog.gather(context, vertex, edge);
-                accum_is_set = true;
-              }
-              ++edges_touched;
-              // elocks[local_edge.id()].unlock();
-            }
-          } // end of if in_edges/all_edges
-            // Loop over out edges
-          if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
-            foreach(local_edge_type local_edge, local_vertex.out_edges()) {
-              edge_type edge(local_edge);
-              // elocks[local_edge.id()].lock();
-              if(accum_is_set) { // \todo hint likely
-                accum += vprog.gather(context, vertex, edge);
-              } else {
-                accum = vprog.gather(context, vertex, edge);
-                accum_is_set = true;
-              }
-              // elocks[local_edge.id()].unlock();
-              ++edges_touched;
-            }
-            INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
-          } // end of if out_edges/all_edges
-          vprog.post_local_gather(accum);
-          // If caching is enabled then save the accumulator to the
-          // cache for future iterations.  Note that it is possible
-          // that the accumulator was never set in which case we are
-          // effectively "zeroing out" the cache.
-          if(caching_enabled && accum_is_set) {
-            gather_cache[lvid] = accum; has_cache.set_bit(lvid);
-          } // end of if caching enabled
-        }
-        // If the accum contains a value for the local gather we put
-        // that estimate in the gather exchange.
-        if(accum_is_set) sync_gather(lvid, accum, thread_id);
-        if(!graph.l_is_master(lvid)) {
-          // if this is not the master clear the vertex program
-          vertex_programs[lvid] = vertex_program_type();
-        }
-
+    if(use_sparse_frontier) {
+      const size_t nactive = frontier_size.value;
+      while (1) {
+        const size_t idx = shared_lvid_counter.inc_ret_last();
+        if (idx >= nactive) break;
+        execute_gather(context, frontier[idx], thread_id);
         // try to recv gathers if there are any in the buffer
-        if(++vcount % TRY_RECV_MOD == 0) recv_gathers(TRY_TO_RECV);
+        if(++vcount % TRY_RECV_MOD == 0) {
+          recv_gathers(TRY_TO_RECV, thread_id);
+          if(use_pipeline) recv_gather_done(TRY_TO_RECV, thread_id);
+        }
       }
-    } // end of loop over vertices to compute gather accumulators
+    } else {
+      fixed_dense_bitset<sizeof(size_t)> local_bitset;
+      while (1) {
+        // increment by a word at a time
+        lvid_type lvid_block_start;
+        if (!next_lvid_block(thread_id, lvid_block_start)) break;
+        // get the bit field from has_message
+        size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
+        if (lvid_bit_block == 0) continue;
+        // initialize a word sized bitfield
+        local_bitset.clear();
+        local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+
+        foreach(size_t lvid_block_offset, local_bitset) {
+          lvid_type lvid = lvid_block_start + lvid_block_offset;
+          if (lvid >= graph.num_local_vertices()) break;
+          execute_gather(context, lvid, thread_id);
+          // try to recv gathers if there are any in the buffer
+          if(++vcount % TRY_RECV_MOD == 0) {
+            recv_gathers(TRY_TO_RECV, thread_id);
+            if(use_pipeline) recv_gather_done(TRY_TO_RECV, thread_id);
+          }
+        }
+      } // end of loop over vertices to compute gather accumulators
+    }
+    if(hub_degree_threshold > 0) execute_hub_gathers(context, thread_id);
     per_thread_compute_time[thread_id] += ti.current_time();
+    if(use_pipeline) {
+      execute_pipelined_applys(context, thread_id);
+      return;
+    }
     gather_exchange.partial_flush(thread_id);
       // Finish sending and receiving all gather operations
     thread_barrier.wait();
@@ -1618,6 +2448,271 @@ namespace graphlab {
   } // end of execute_gathers
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_gather(context_type& context, const lvid_type lvid,
+                 const size_t thread_id) {
+    const bool caching_enabled = !gather_cache.empty();
+    bool accum_is_set = false;
+    gather_type accum = gather_type();
+    // if caching is enabled and we have a cache entry then use
+    // that as the accum
+    if( caching_enabled && has_cache.get(lvid) ) {
+      accum = gather_cache[lvid];
+      accum_is_set = true;
+    } else {
+      // recompute the local contribution to the gather
+      const vertex_program_type& vprog = vertex_programs[lvid];
+      local_vertex_type local_vertex = graph.l_vertex(lvid);
+      const vertex_type vertex(local_vertex);
+      const edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
+      // high degree vertices are gathered in parallel once all the
+      // other vertices are done
+      if(defer_hub(local_vertex, lvid, gather_dir)) return;
+      vprog.pre_local_gather(accum);
+      const size_t edges_touched =
+        gather_edge_range(context, lvid, 0, size_t(-1), accum, accum_is_set);
+      INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
+      vprog.post_local_gather(accum);
+      // If caching is enabled then save the accumulator to the
+      // cache for future iterations.  Note that it is possible
+      // that the accumulator was never set in which case we are
+      // effectively "zeroing out" the cache.
+      if(caching_enabled && accum_is_set) {
+        gather_cache[lvid] = accum; has_cache.set_bit(lvid);
+      } // end of if caching enabled
+    }
+    finish_gather(lvid, accum, accum_is_set, thread_id);
+  } // end of execute_gather
+
+
+  template<typename VertexProgram>
+  size_t synchronous_engine<VertexProgram>::
+  gather_edge_range(context_type& context, const lvid_type lvid,
+                    const size_t begin, const size_t end,
+                    gather_type& accum, bool& accum_is_set) {
+    size_t edges_touched = 0;
+    if(vertex_program_impl::implements_gather_batch<vertex_program_type>::value &&
+       gather_edge_range_batch(context, lvid, begin, end,
+                               accum, accum_is_set, edges_touched)) {
+      return edges_touched;
+    }
+    const vertex_program_type& vprog = vertex_programs[lvid];
+    local_vertex_type local_vertex = graph.l_vertex(lvid);
+    const vertex_type vertex(local_vertex);
+    const edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
+    size_t nin = 0;
+    // Loop over in edges
+    if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
+      nin = local_vertex.num_in_edges();
+      if(begin < nin) {
+        local_edge_list_type edges = local_vertex.in_edges();
+        typename local_edge_list_type::iterator it = edges.iterator_at(begin);
+        const typename local_edge_list_type::iterator it_end =
+          end >= nin ? edges.end() : edges.iterator_at(end);
+        for( ; it != it_end; ++it) {
+          edge_type edge(*it);
+          if(accum_is_set) { // \todo hint likely
+            accum += vprog.gather(context, vertex, edge);
+          } else {
+            accum = vprog.gather(context, vertex, edge);
+            accum_is_set = true;
+          }
+          ++edges_touched;
+        }
+      }
+    } // end of if in_edges/all_edges
+    // Loop over out edges
+    if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
+      const size_t nout = local_vertex.num_out_edges();
+      if(end > nin && begin < nin + nout) {
+        local_edge_list_type edges = local_vertex.out_edges();
+        typename local_edge_list_type::iterator it =
+          edges.iterator_at(begin > nin ? begin - nin : 0);
+        const typename local_edge_list_type::iterator it_end =
+          end >= nin + nout ? edges.end() : edges.iterator_at(end - nin);
+        for( ; it != it_end; ++it) {
+          edge_type edge(*it);
+          if(accum_is_set) { // \todo hint likely
+            accum += vprog.gather(context, vertex, edge);
+          } else {
+            accum = vprog.gather(context, vertex, edge);
+            accum_is_set = true;
+          }
+          ++edges_touched;
+        }
+      }
+    } // end of if out_edges/all_edges
+    return edges_touched;
+  } // end of gather_edge_range
+
+
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  gather_edge_range_batch(context_type& context, const lvid_type lvid,
+                          const size_t begin, const size_t end,
+                          gather_type& accum, bool& accum_is_set,
+                          size_t& edges_touched) {
+    typedef typename vertex_program_type::edge_batch_type edge_batch_type;
+    const vertex_program_type& vprog = vertex_programs[lvid];
+    local_vertex_type local_vertex = graph.l_vertex(lvid);
+    const vertex_type vertex(local_vertex);
+    const edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
+    typename graph_type::local_graph_type& lgraph = graph.get_local_graph();
+    const bool gather_in = gather_dir == IN_EDGES || gather_dir == ALL_EDGES;
+    const bool gather_out = gather_dir == OUT_EDGES || gather_dir == ALL_EDGES;
+    // Find the arrays first so that nothing is gathered if the
+    // adjacency is not stored contiguously
+    const lvid_type* in_nbr = NULL; const edge_id_type* in_eid = NULL;
+    const lvid_type* out_nbr = NULL; size_t out_first_eid = 0;
+    size_t nin = 0, nout = 0;
+    if(gather_in && !lgraph.in_edge_arrays(lvid, in_nbr, in_eid, nin))
+      return false;
+    if(gather_out && !lgraph.out_edge_arrays(lvid, out_nbr, out_first_eid, nout))
+      return false;
+    edge_batch_type batch;
+    batch.vdata = &(lgraph.vertex_data(0));
+    batch.edata = lgraph.edge_data_array();
+    batch.out_degree = &(local_out_degree[0]);
+    batch.graph = &graph;
+    // in edges occupy [0, nin) and out edges [nin, nin + nout)
+    for(size_t part = 0; part < 2; ++part) {
+      const size_t offset = part == 0 ? 0 : nin;
+      const size_t nedges = part == 0 ? nin : nout;
+      const size_t first = std::max(begin, offset) - offset;
+      const size_t last = std::min(end, offset + nedges);
+      if(last <= offset || first >= last - offset) continue;
+      batch.size = last - offset - first;
+      if(part == 0) {
+        batch.dir = IN_EDGES;
+        batch.nbr = in_nbr + first;
+        batch.eid = in_eid + first;
+      } else {
+        batch.dir = OUT_EDGES;
+        batch.nbr = out_nbr + first;
+        batch.eid = NULL;
+        batch.edata = lgraph.edge_data_array() + out_first_eid + first;
+      }
+      if(accum_is_set) {
+        accum += vertex_program_impl::gather_batch(vprog, context, vertex, batch);
+      } else {
+        accum = vertex_program_impl::gather_batch(vprog, context, vertex, batch);
+        accum_is_set = true;
+      }
+      edges_touched += batch.size;
+    }
+    return true;
+  } // end of gather_edge_range_batch
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  finish_gather(const lvid_type lvid, const gather_type& accum,
+                const bool accum_is_set, const size_t thread_id) {
+    // If the accum contains a value for the local gather we put
+    // that estimate in the gather exchange.
+    if(accum_is_set) sync_gather(lvid, accum, thread_id);
+    if(use_pipeline) {
+      // the master counts its own gather and one from each mirror
+      if(graph.l_is_master(lvid)) {
+        report_gathers(lvid, 1, thread_id);
+      } else if(!accum_is_set) {
+        gather_done_exchange.send(graph.l_master(lvid),
+                                  graph.global_vid(lvid), thread_id);
+      }
+    }
+    if(!graph.l_is_master(lvid)) {
+      // if this is not the master clear the vertex program
+      vertex_programs[lvid] = vertex_program_type();
+    }
+  } // end of finish_gather
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  build_hub_chunks(const bool gather) {
+    context_type context(*this, graph);
+    hub_chunk_begin.resize(hubs.size() + 1);
+    hub_chunk_begin[0] = 0;
+    for(size_t i = 0; i < hubs.size(); ++i) {
+      const vertex_program_type& vprog = vertex_programs[hubs[i]];
+      local_vertex_type local_vertex = graph.l_vertex(hubs[i]);
+      const vertex_type vertex(local_vertex);
+      const edge_dir_type dir = gather ? vprog.gather_edges(context, vertex) :
+                                         vprog.scatter_edges(context, vertex);
+      const size_t nedges = num_dir_edges(local_vertex, dir);
+      hub_chunk_begin[i + 1] = hub_chunk_begin[i] +
+        (nedges + hub_degree_threshold - 1) / hub_degree_threshold;
+    }
+    if(gather) {
+      hub_chunk_accum.assign(hub_chunk_begin.back(), gather_type());
+      hub_chunk_is_set.assign(hub_chunk_begin.back(), false);
+    }
+    shared_lvid_counter = 0;
+  } // end of build_hub_chunks
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_hub_gathers(context_type& context, const size_t thread_id) {
+    // wait for all the hubs of this minor-step to be deferred
+    thread_barrier.wait();
+    // every thread sees the same hubs here so all take the same path
+    if(hubs.empty()) return;
+    if(thread_id == 0) build_hub_chunks(true);
+    thread_barrier.wait();
+    // gather the chunks
+    const size_t nchunks = hub_chunk_begin.back();
+    size_t edges_touched = 0;
+    while (1) {
+      const size_t chunk = shared_lvid_counter.inc_ret_last();
+      if (chunk >= nchunks) break;
+      const size_t hub = std::upper_bound(hub_chunk_begin.begin(),
+                                          hub_chunk_begin.end(), chunk) -
+                         hub_chunk_begin.begin() - 1;
+      const size_t begin = (chunk - hub_chunk_begin[hub]) * hub_degree_threshold;
+      bool accum_is_set = false;
+      edges_touched += gather_edge_range(context, hubs[hub],
+                                         begin, begin + hub_degree_threshold,
+                                         hub_chunk_accum[chunk], accum_is_set);
+      hub_chunk_is_set[chunk] = accum_is_set;
+    }
+    INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
+    thread_barrier.wait();
+    if(thread_id == 0) shared_lvid_counter = 0;
+    thread_barrier.wait();
+    // combine the partial gathers of each hub
+    const bool caching_enabled = !gather_cache.empty();
+    while (1) {
+      const size_t hub = shared_lvid_counter.inc_ret_last();
+      if (hub >= hubs.size()) break;
+      const lvid_type lvid = hubs[hub];
+      const vertex_program_type& vprog = vertex_programs[lvid];
+      bool accum_is_set = false;
+      gather_type accum = gather_type();
+      vprog.pre_local_gather(accum);
+      for(size_t chunk = hub_chunk_begin[hub];
+          chunk < hub_chunk_begin[hub + 1]; ++chunk) {
+        if(!hub_chunk_is_set[chunk]) continue;
+        if(accum_is_set) {
+          accum += hub_chunk_accum[chunk];
+        } else {
+          accum = hub_chunk_accum[chunk];
+          accum_is_set = true;
+        }
+        hub_chunk_accum[chunk] = gather_type();
+      }
+      vprog.post_local_gather(accum);
+      if(caching_enabled && accum_is_set) {
+        gather_cache[lvid] = accum; has_cache.set_bit(lvid);
+      }
+      finish_gather(lvid, accum, accum_is_set, thread_id);
+    }
+    thread_barrier.wait();
+    if(thread_id == 0) hubs.clear();
+  } // end of execute_hub_gathers
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   execute_applys(const size_t thread_id) {
@@ -1632,9 +2727,8 @@ namespace graphlab {
     fixed_dense_bitset<sizeof(size_t)> local_bitset;
     while (1) {
       // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      lvid_type lvid_block_start;
+      if (!next_lvid_block(thread_id, lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = active_superstep.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1644,31 +2738,7 @@ namespace graphlab {
       foreach(size_t lvid_block_offset, local_bitset) {
         lvid_type lvid = lvid_block_start + lvid_block_offset;
         if (lvid >= graph.num_local_vertices()) break;
-
-        // Only master vertices can be active in a super-step
-        ASSERT_TRUE(graph.l_is_master(lvid));
-        vertex_type vertex(graph.l_vertex(lvid));
-        // Get the local accumulator.  Note that it is possible that
-        // the gather_accum was not set during the gather.
-        const gather_type& accum = gather_accum[lvid];
-        INCREMENT_EVENT(EVENT_APPLIES, 1);
-        vertex_programs[lvid].apply(context, vertex, accum);
-        // record an apply as a completed task
-        ++completed_applys;
-        // Clear the accumulator to save some memory
-        gather_accum[lvid] = gather_type();
-        // synchronize the changed vertex data with all mirrors
-        sync_vertex_data(lvid, thread_id);
-        // determine if a scatter operation is needed
-        const vertex_program_type& const_vprog = vertex_programs[lvid];
-        const vertex_type const_vertex = vertex;
-        if(const_vprog.scatter_edges(context, const_vertex) !=
-           graphlab::NO_EDGES) {
-          active_minorstep.set_bit(lvid);
-          sync_vertex_program(lvid, thread_id);
-        } else { // we are done so clear the vertex program
-          vertex_programs[lvid] = vertex_program_type();
-        }
+        apply_vertex(context, lvid, thread_id);
       // try to receive vertex data
         if(++vcount % TRY_RECV_MOD == 0) {
           recv_vertex_programs(TRY_TO_RECV);
@@ -1690,66 +2760,269 @@ namespace graphlab {
   } // end of execute_applys
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  apply_vertex(context_type& context, const lvid_type lvid,
+               const size_t thread_id) {
+    // Only master vertices can be active in a super-step
+    ASSERT_TRUE(graph.l_is_master(lvid));
+    vertex_type vertex(graph.l_vertex(lvid));
+    // Get the local accumulator.  Note that it is possible that
+    // the gather_accum was not set during the gather.
+    const gather_type& accum = gather_accum[lvid];
+    INCREMENT_EVENT(EVENT_APPLIES, 1);
+    vertex_programs[lvid].apply(context, vertex, accum);
+    if (snapshot_deltas > 0) dirty_vertices.set_bit(lvid);
+    // record an apply as a completed task
+    ++completed_applys;
+    // Clear the accumulator to save some memory
+    gather_accum[lvid] = gather_type();
+    // synchronize the changed vertex data with all mirrors
+    sync_vertex_data(lvid, thread_id);
+    // determine if a scatter operation is needed
+    const vertex_program_type& const_vprog = vertex_programs[lvid];
+    const vertex_type const_vertex = vertex;
+    if(const_vprog.scatter_edges(context, const_vertex) !=
+       graphlab::NO_EDGES) {
+      activate_minorstep(lvid);
+      sync_vertex_program(lvid, thread_id);
+    } else { // we are done so clear the vertex program
+      vertex_programs[lvid] = vertex_program_type();
+    }
+  } // end of apply_vertex
 
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
-  execute_scatters(const size_t thread_id) {
-    context_type context(*this, graph);
-    // for(lvid_type lvid = thread_id; lvid < graph.num_local_vertices();
-    //      lvid += threads.size()) {
-    timer ti;
+  init_gather_countdown(const size_t thread_id) {
+    size_t npending = 0;
     fixed_dense_bitset<sizeof(size_t)> local_bitset;
     while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
+      lvid_type lvid_block_start;
+      if (!next_lvid_block(thread_id, lvid_block_start)) break;
+      // the masters which are applied or gathered
+      size_t lvid_bit_block =
+        active_superstep.containing_word(lvid_block_start) |
+        active_minorstep.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
       foreach(size_t lvid_block_offset, local_bitset) {
         lvid_type lvid = lvid_block_start + lvid_block_offset;
         if (lvid >= graph.num_local_vertices()) break;
+        if (!graph.l_is_master(lvid)) continue;
+        if (active_superstep.get(lvid)) ++npending;
+        // a gathering master and each of its mirrors report once
+        const int expected = !active_minorstep.get(lvid) ? 0 :
+          int(graph.l_vertex(lvid).num_mirrors() + 1);
+        report_gathers(lvid, -expected, thread_id);
+      }
+    }
+    pipeline_pending.inc(npending);
+  } // end of init_gather_countdown
 
-        const vertex_program_type& vprog = vertex_programs[lvid];
-        local_vertex_type local_vertex = graph.l_vertex(lvid);
-        const vertex_type vertex(local_vertex);
-        const edge_dir_type scatter_dir = vprog.scatter_edges(context, vertex);
-				size_t edges_touched = 0;
-        // Loop over in edges
-        if(scatter_dir == IN_EDGES || scatter_dir == ALL_EDGES) {
-          foreach(local_edge_type local_edge, local_vertex.in_edges()) {
-            edge_type edge(local_edge);
-            // elocks[local_edge.id()].lock();
-            vprog.scatter(context, vertex, edge);
-            // elocks[local_edge.id()].unlock();
-          }
-					++edges_touched;
-        } // end of if in_edges/all_edges
-        // Loop over out edges
-        if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES) {
-          foreach(local_edge_type local_edge, local_vertex.out_edges()) {
-            edge_type edge(local_edge);
-            // elocks[local_edge.id()].lock();
-            vprog.scatter(context, vertex, edge);
-            // elocks[local_edge.id()].unlock();
-          }
-					++edges_touched;
-        } // end of if out_edges/all_edges
-				INCREMENT_EVENT(EVENT_SCATTERS, edges_touched);
-        // Clear the vertex program
-        vertex_programs[lvid] = vertex_program_type();
-      } // end of if active on this minor step
-    } // end of loop over vertices to complete scatter operation
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  take_ready_lvids(const size_t thread_id, std::vector<lvid_type>& ret) {
+    for(size_t i = 0; i < ready_lvids.size() && ret.empty(); ++i) {
+      const size_t t = (thread_id + i) % ready_lvids.size();
+      if(ready_lvids[t].empty()) continue;
+      ready_locks[t].lock();
+      ret.swap(ready_lvids[t]);
+      ready_locks[t].unlock();
+    }
+  } // end of take_ready_lvids
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_pipelined_applys(context_type& context, const size_t thread_id) {
+    const bool TRY_TO_RECV = true;
+    gather_exchange.partial_flush(thread_id);
+    gather_done_exchange.partial_flush(thread_id);
+    // No thread gathers past this point, so the vertex data read by
+    // the gathers may change
+    thread_barrier.wait();
+    if(thread_id == 0) {
+      rmi.dc().flush();
+      clear_active_minorstep();
+    }
+    thread_barrier.wait();
+    std::vector<lvid_type> ready;
+    while(pipeline_pending.value > 0) {
+      // read before receiving so that no later event is missed
+      const size_t seen = pipeline_events.value;
+      recv_gathers(TRY_TO_RECV, thread_id);
+      recv_gather_done(TRY_TO_RECV, thread_id);
+      take_ready_lvids(thread_id, ready);
+      if(ready.empty()) {
+        // wait for the gathers of the other machines
+        recv_vertex_programs(TRY_TO_RECV);
+        recv_vertex_data(TRY_TO_RECV);
+        if(pipeline_pending.value > 0) wait_for_pipeline(seen);
+        continue;
+      }
+      timer ti;
+      foreach(const lvid_type lvid, ready) {
+        apply_vertex(context, lvid, thread_id);
+      }
+      per_thread_compute_time[thread_id] += ti.current_time();
+      if(pipeline_pending.dec(ready.size()) == 0) notify_pipeline();
+      ready.clear();
+    }
+    vprog_exchange.partial_flush(thread_id);
+    vdata_exchange.partial_flush(thread_id);
+    // Finish sending and receiving all changes due to apply operations
+    thread_barrier.wait();
+    if(thread_id == 0) { vprog_exchange.flush(); vdata_exchange.flush(); }
+    thread_barrier.wait();
+    recv_vertex_programs();
+    recv_vertex_data();
+  } // end of execute_pipelined_applys
+
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_scatters(const size_t thread_id) {
+    context_type context(*this, graph);
+    // for(lvid_type lvid = thread_id; lvid < graph.num_local_vertices();
+    //      lvid += threads.size()) {
+    timer ti;
+    if(use_sparse_frontier) {
+      const size_t nactive = frontier_size.value;
+      while (1) {
+        const size_t idx = shared_lvid_counter.inc_ret_last();
+        if (idx >= nactive) break;
+        execute_scatter(context, frontier[idx]);
+      }
+    } else {
+      fixed_dense_bitset<sizeof(size_t)> local_bitset;
+      while (1) {
+        // increment by a word at a time
+        lvid_type lvid_block_start;
+        if (!next_lvid_block(thread_id, lvid_block_start)) break;
+        // get the bit field from has_message
+        size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
+        if (lvid_bit_block == 0) continue;
+        // initialize a word sized bitfield
+        local_bitset.clear();
+        local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+        foreach(size_t lvid_block_offset, local_bitset) {
+          lvid_type lvid = lvid_block_start + lvid_block_offset;
+          if (lvid >= graph.num_local_vertices()) break;
+          execute_scatter(context, lvid);
+        } // end of if active on this minor step
+      } // end of loop over vertices to complete scatter operation
+    }
+    if(hub_degree_threshold > 0) execute_hub_scatters(context, thread_id);
     per_thread_compute_time[thread_id] += ti.current_time();
   } // end of execute_scatters
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_scatter(context_type& context, const lvid_type lvid) {
+    const vertex_program_type& vprog = vertex_programs[lvid];
+    local_vertex_type local_vertex = graph.l_vertex(lvid);
+    const vertex_type vertex(local_vertex);
+    const edge_dir_type scatter_dir = vprog.scatter_edges(context, vertex);
+    if(snapshot_deltas > 0) {
+      if(scatter_dir == IN_EDGES || scatter_dir == ALL_EDGES)
+        dirty_in_edges.set_bit(lvid);
+      if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES)
+        dirty_out_edges.set_bit(lvid);
+    }
+    // high degree vertices are scattered in parallel once all the
+    // other vertices are done
+    if(defer_hub(local_vertex, lvid, scatter_dir)) return;
+    const size_t edges_touched =
+      scatter_edge_range(context, lvid, 0, size_t(-1));
+    INCREMENT_EVENT(EVENT_SCATTERS, edges_touched);
+    // Clear the vertex program
+    vertex_programs[lvid] = vertex_program_type();
+  } // end of execute_scatter
+
+
+  template<typename VertexProgram>
+  size_t synchronous_engine<VertexProgram>::
+  scatter_edge_range(context_type& context, const lvid_type lvid,
+                     const size_t begin, const size_t end) {
+    const vertex_program_type& vprog = vertex_programs[lvid];
+    local_vertex_type local_vertex = graph.l_vertex(lvid);
+    const vertex_type vertex(local_vertex);
+    const edge_dir_type scatter_dir = vprog.scatter_edges(context, vertex);
+    size_t edges_touched = 0;
+    size_t nin = 0;
+    // Loop over in edges
+    if(scatter_dir == IN_EDGES || scatter_dir == ALL_EDGES) {
+      nin = local_vertex.num_in_edges();
+      if(begin < nin) {
+        local_edge_list_type edges = local_vertex.in_edges();
+        typename local_edge_list_type::iterator it = edges.iterator_at(begin);
+        const typename local_edge_list_type::iterator it_end =
+          end >= nin ? edges.end() : edges.iterator_at(end);
+        for( ; it != it_end; ++it) {
+          edge_type edge(*it);
+          vprog.scatter(context, vertex, edge);
+          ++edges_touched;
+        }
+      }
+    } // end of if in_edges/all_edges
+    // Loop over out edges
+    if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES) {
+      const size_t nout = local_vertex.num_out_edges();
+      if(end > nin && begin < nin + nout) {
+        local_edge_list_type edges = local_vertex.out_edges();
+        typename local_edge_list_type::iterator it =
+          edges.iterator_at(begin > nin ? begin - nin : 0);
+        const typename local_edge_list_type::iterator it_end =
+          end >= nin + nout ? edges.end() : edges.iterator_at(end - nin);
+        for( ; it != it_end; ++it) {
+          edge_type edge(*it);
+          vprog.scatter(context, vertex, edge);
+          ++edges_touched;
+        }
+      }
+    } // end of if out_edges/all_edges
+    return edges_touched;
+  } // end of scatter_edge_range
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_hub_scatters(context_type& context, const size_t thread_id) {
+    // wait for all the hubs of this minor-step to be deferred
+    thread_barrier.wait();
+    // every thread sees the same hubs here so all take the same path
+    if(hubs.empty()) return;
+    if(thread_id == 0) build_hub_chunks(false);
+    thread_barrier.wait();
+    const size_t nchunks = hub_chunk_begin.back();
+    size_t edges_touched = 0;
+    while (1) {
+      const size_t chunk = shared_lvid_counter.inc_ret_last();
+      if (chunk >= nchunks) break;
+      const size_t hub = std::upper_bound(hub_chunk_begin.begin(),
+                                          hub_chunk_begin.end(), chunk) -
+                         hub_chunk_begin.begin() - 1;
+      const size_t begin = (chunk - hub_chunk_begin[hub]) * hub_degree_threshold;
+      edges_touched += scatter_edge_range(context, hubs[hub], begin,
+                                          begin + hub_degree_threshold);
+    }
+    INCREMENT_EVENT(EVENT_SCATTERS, edges_touched);
+    thread_barrier.wait();
+    // all chunks are done so the vertex programs can be cleared
+    for(size_t hub = thread_id; hub < hubs.size(); hub += threads.size()) {
+      vertex_programs[hubs[hub]] = vertex_program_type();
+    }
+    thread_barrier.wait();
+    if(thread_id == 0) hubs.clear();
+  } // end of execute_hub_scatters
+
+
 
   // Data Synchronization ===================================================
   template<typename VertexProgram>
@@ -1771,13 +3044,13 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_vertex_programs(const bool try_to_recv) {
     procid_t procid(-1);
-    typename vprog_exchange_type::buffer_type buffer;
+    typename vprog_exchange_type::view_type buffer;
     while(vprog_exchange.recv(procid, buffer, try_to_recv)) {
       foreach(const vid_prog_pair_type& pair, buffer) {
         const lvid_type lvid = graph.local_vid(pair.first);
   //      ASSERT_FALSE(graph.l_is_master(lvid));
         vertex_programs[lvid] = pair.second;
-        active_minorstep.set_bit(lvid);
+        activate_minorstep(lvid);
       }
     }
   } // end of recv vertex programs
@@ -1802,7 +3075,7 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_vertex_data(bool try_to_recv) {
     procid_t procid(-1);
-    typename vdata_exchange_type::buffer_type buffer;
+    typename vdata_exchange_type::view_type buffer;
     while(vdata_exchange.recv(procid, buffer, try_to_recv)) {
       foreach(const vid_vdata_pair_type& pair, buffer) {
         const lvid_type lvid = graph.local_vid(pair.first);
@@ -1828,15 +3101,15 @@ namespace graphlab {
     } else {
       const procid_t master = graph.l_master(lvid);
       const vertex_id_type vid = graph.global_vid(lvid);
-      gather_exchange.send(master, std::make_pair(vid, accum), thread_id);
+      gather_exchange.send(master, vid, accum, thread_id);
     }
   } // end of sync_gather
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
-  recv_gathers(const bool try_to_recv) {
+  recv_gathers(const bool try_to_recv, const size_t thread_id) {
     procid_t procid(-1);
-    typename gather_exchange_type::buffer_type buffer;
+    typename gather_exchange_type::view_type buffer;
     while(gather_exchange.recv(procid, buffer, try_to_recv)) {
       foreach(const vid_gather_pair_type& pair, buffer) {
         const lvid_type lvid = graph.local_vid(pair.first);
@@ -1850,18 +3123,32 @@ namespace graphlab {
           has_gather_accum.set_bit(lvid);
         }
         vlocks[lvid].unlock();
+        if(use_pipeline) report_gathers(lvid, 1, thread_id);
       }
     }
   } // end of recv_gather
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  recv_gather_done(const bool try_to_recv, const size_t thread_id) {
+    procid_t procid(-1);
+    typename gather_done_exchange_type::view_type buffer;
+    while(gather_done_exchange.recv(procid, buffer, try_to_recv)) {
+      foreach(const vertex_id_type& vid, buffer) {
+        report_gathers(graph.local_vid(vid), 1, thread_id);
+      }
+    }
+  } // end of recv_gather_done
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   sync_message(lvid_type lvid, const size_t thread_id) {
     ASSERT_FALSE(graph.l_is_master(lvid));
     const procid_t master = graph.l_master(lvid);
     const vertex_id_type vid = graph.global_vid(lvid);
-    message_exchange.send(master, std::make_pair(vid, messages[lvid]), thread_id);
+    message_exchange.send(master, vid, messages[lvid], thread_id);
   } // end of send_message
 
 
@@ -1871,7 +3158,7 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_messages(const bool try_to_recv) {
     procid_t procid(-1);
-    typename message_exchange_type::buffer_type buffer;
+    typename message_exchange_type::view_type buffer;
     while(message_exchange.recv(procid, buffer, try_to_recv)) {
       foreach(const vid_message_pair_type& pair, buffer) {
         const lvid_type lvid = graph.local_vid(pair.first);
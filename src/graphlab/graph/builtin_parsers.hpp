@@ -25,6 +25,10 @@
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #if defined(__cplusplus) && __cplusplus >= 201103L
 // do not include spirit
@@ -38,6 +42,7 @@
 
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab/logger/logger.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 
 
@@ -163,6 +168,193 @@ namespace graphlab {
     } // end of adj parser
 #endif
 
+    /**
+     * \internal
+     * Helpers of the block parsers, which parse a buffer of whole lines
+     * at once rather than one std::string per line.
+     */
+    namespace block_impl {
+
+      /// The number of edges passed to Graph::add_edges() at once
+      static const size_t EDGE_BATCH_SIZE = 4096;
+
+      /// Returns the first newline in [p, end), or end if there is none
+      inline const char* find_newline(const char* p, const char* end) {
+#ifdef __SSE2__
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; p + 16 <= end; p += 16) {
+          const __m128i chars = _mm_loadu_si128((const __m128i*)p);
+          const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, newline));
+          if (mask != 0) return p + __builtin_ctz(mask);
+        }
+#endif
+        while (p < end && *p != '\n') ++p;
+        return p;
+      }
+
+      inline bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+      }
+
+      inline const char* skip_blanks(const char* p, const char* end) {
+        while (p < end && is_blank(*p)) ++p;
+        return p;
+      }
+
+      /**
+       * Reads an unsigned decimal number at p and advances p past it.
+       * Returns false if there are no digits, or too many to fit a size_t
+       * safely.
+       */
+      inline bool parse_uint(const char*& p, const char* end, size_t& value) {
+        const char* begin = p;
+        size_t v = 0;
+        for (; p < end; ++p) {
+          const unsigned digit = (unsigned char)(*p) - '0';
+          if (digit > 9) break;
+          v = v * 10 + digit;
+        }
+        value = v;
+        return p != begin && p - begin <= 19;
+      }
+
+      /// Collects edges and adds them to the graph in batches
+      template <typename Graph>
+      struct edge_batch {
+        Graph& graph;
+        std::vector<vertex_id_type> sources, targets;
+        edge_batch(Graph& graph) : graph(graph) {
+          sources.reserve(EDGE_BATCH_SIZE);
+          targets.reserve(EDGE_BATCH_SIZE);
+        }
+        void add(size_t source, size_t target) {
+          if (source == target) return;
+          sources.push_back(source);
+          targets.push_back(target);
+          if (sources.size() == EDGE_BATCH_SIZE) flush();
+        }
+        void flush() {
+          if (sources.empty()) return;
+          graph.add_edges(sources, targets);
+          sources.clear();
+          targets.clear();
+        }
+      };
+
+      /**
+       * Hands a line the fast path does not recognize to the line parser,
+       * which decides whether it is valid.
+       */
+      template <typename Graph, typename LineParser>
+      bool parse_line(Graph& graph, const std::string& srcfilename,
+                      const char* begin, const char* end,
+                      LineParser line_parser) {
+        const std::string line(begin, end);
+        if (line_parser(graph, srcfilename, line)) return true;
+        logstream(LOG_WARNING)
+          << "Error parsing line in " << srcfilename << ": " << std::endl
+          << "\t\"" << line << "\"" << std::endl;
+        return false;
+      }
+
+      /**
+       * Parses the lines of "source target" pairs in [begin, end). Lines
+       * with anything else, and the '#' comments if comments is set, are
+       * passed to line_parser.
+       */
+      template <typename Graph, typename LineParser>
+      bool parse_edge_lines(Graph& graph, const std::string& srcfilename,
+                            const char* begin, const char* end,
+                            bool comments, LineParser line_parser) {
+        edge_batch<Graph> batch(graph);
+        for (const char* line = begin; line < end; ) {
+          const char* eol = find_newline(line, end);
+          const char* p = skip_blanks(line, eol);
+          size_t source, target;
+          if (line == eol) {
+            // empty line
+          } else if (!(comments && *line == '#') &&
+                     parse_uint(p, eol, source) && p < eol && is_blank(*p) &&
+                     parse_uint(p = skip_blanks(p, eol), eol, target) &&
+                     skip_blanks(p, eol) == eol) {
+            batch.add(source, target);
+          } else if (!parse_line(graph, srcfilename, line, eol, line_parser)) {
+            batch.flush();
+            return false;
+          }
+          line = eol + 1;
+        }
+        batch.flush();
+        return true;
+      }
+
+    } // namespace block_impl
+
+
+    /**
+     * \brief Parses a buffer of whole lines in the SNAP format. Gives the
+     * same graph as snap_parser() applied to each line.
+     */
+    template <typename Graph>
+    bool snap_block_parser(Graph& graph, const std::string& srcfilename,
+                           const char* begin, const char* end) {
+      return block_impl::parse_edge_lines(graph, srcfilename, begin, end,
+                                          true, snap_parser<Graph>);
+    } // end of snap block parser
+
+    /**
+     * \brief Parses a buffer of whole lines in the tsv format. Gives the
+     * same graph as tsv_parser() applied to each line.
+     */
+    template <typename Graph>
+    bool tsv_block_parser(Graph& graph, const std::string& srcfilename,
+                          const char* begin, const char* end) {
+      return block_impl::parse_edge_lines(graph, srcfilename, begin, end,
+                                          false, tsv_parser<Graph>);
+    } // end of tsv block parser
+
+    /**
+     * \brief Parses a buffer of whole lines in the adjacency list format.
+     * Gives the same graph as adj_parser() applied to each line.
+     */
+    template <typename Graph>
+    bool adj_block_parser(Graph& graph, const std::string& srcfilename,
+                          const char* begin, const char* end) {
+      block_impl::edge_batch<Graph> batch(graph);
+      std::vector<size_t> targets;
+      for (const char* line = begin; line < end; ) {
+        const char* eol = block_impl::find_newline(line, end);
+        const char* p = block_impl::skip_blanks(line, eol);
+        size_t source, n;
+        targets.clear();
+        bool fast = block_impl::parse_uint(p, eol, source) &&
+                    p < eol && block_impl::is_blank(*p) &&
+                    block_impl::parse_uint(p = block_impl::skip_blanks(p, eol),
+                                           eol, n);
+        while (fast && (p = block_impl::skip_blanks(p, eol)) < eol) {
+          size_t target;
+          fast = block_impl::is_blank(p[-1]) &&
+                 block_impl::parse_uint(p, eol, target);
+          if (fast) targets.push_back(target);
+        }
+        if (line == eol) {
+          // empty line
+        } else if (fast && targets.size() == n) {
+          for (size_t i = 0; i < targets.size(); ++i) {
+            batch.add(source, targets[i]);
+          }
+        } else if (!block_impl::parse_line(graph, srcfilename, line, eol,
+                                           adj_parser<Graph>)) {
+          batch.flush();
+          return false;
+        }
+        line = eol + 1;
+      }
+      batch.flush();
+      return true;
+    } // end of adj block parser
+
+
     template <typename Graph>
     struct tsv_writer{
       typedef typename Graph::vertex_type vertex_type;
@@ -28,6 +28,7 @@
 #endif
 
 #include <cmath>
+#include <cstring>
 
 #include <string>
 #include <list>
@@ -35,6 +36,7 @@
 #include <set>
 #include <map>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/procid_set.hpp>
 
 
 #include <queue>
@@ -60,6 +62,8 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/branch_hints.hpp>
 #include <graphlab/util/generics/conditional_addition_wrapper.hpp>
@@ -69,12 +73,14 @@
 #include <graphlab/vertex_program/op_plus_eq_concept.hpp>
 
 #include <graphlab/graph/local_graph.hpp>
+#include <graphlab/graph/vertex_reordering.hpp>
 #include <graphlab/graph/ingress/idistributed_ingress.hpp>
 #include <graphlab/graph/ingress/distributed_ingress_base.hpp>
 #include <graphlab/graph/ingress/distributed_batch_ingress.hpp>
 #include <graphlab/graph/ingress/distributed_oblivious_ingress.hpp>
 #include <graphlab/graph/ingress/distributed_random_ingress.hpp>
 #include <graphlab/graph/ingress/distributed_identity_ingress.hpp>
+#include <graphlab/graph/ingress/distributed_hybrid_ingress.hpp>
 
 #include <graphlab/graph/ingress/sharding_constraint.hpp>
 #include <graphlab/graph/ingress/distributed_constrained_random_ingress.hpp>
@@ -374,8 +380,19 @@ namespace graphlab {
     typedef boost::function<bool(distributed_graph&, const std::string&,
                                  const std::string&)> line_parser_type;
 
+    /**
+       \internal
+       \brief The type of a parser of a buffer of whole lines.
 
-    typedef fixed_dense_bitset<RPC_MAX_N_PROCS> mirror_type;
+       Like the line parser, but takes the lines in [begin, end), separated
+       by '\n'. Used by the built-in text formats to avoid building a
+       std::string for every line.
+     */
+    typedef boost::function<bool(distributed_graph&, const std::string&,
+                                 const char*, const char*)> block_parser_type;
+
+
+    typedef procid_set mirror_type;
 
     /// The type of the local graph used to store the graph data 
     typedef graphlab::local_graph<VertexData, EdgeData> local_graph_type;
@@ -581,6 +598,20 @@ namespace graphlab {
      *                Defaults to 50,000. Increasing this number will
      *                decrease partitioning time with a penalty to partitioning
      *                quality.
+     * \li \c reorder Relabels the local vertices on finalize so that
+     *                neighboring vertices are stored close together.
+     *                May be "none" (default), "degree" (decreasing
+     *                degree), "rcm" (reverse Cuthill-McKee) or
+     *                "hub_cluster" (high degree vertices first).
+     * \li \c compress_adjacency Stores the local adjacency lists as
+     *                varint encoded deltas, decoded on the fly while
+     *                iterating. Reduces the memory used by the graph
+     *                structure at a small decoding cost. Defaults to 0.
+     *                Set to 1 to enable.
+     * \li \c loading_threads The number of threads parsing the graph
+     *                files on each machine. Defaults to the number of
+     *                cores for the builtin formats, and to 1 for user
+     *                line parsers, which need not be thread safe.
      *
      * \param [in] dc Distributed controller to associate with
      * \param [in] opts A graphlab::graphlab_options object specifying engine
@@ -591,7 +622,8 @@ namespace graphlab {
                       const graphlab_options& opts = graphlab_options()) : 
       rpc(dc, this), finalized(false), vid2lvid(-1),
       nverts(0), nedges(0), local_own_nverts(0), nreplicas(0),
-      ingress_ptr(NULL), vertex_exchange(dc), vset_exchange(dc), parallel_ingress(true) {
+      ingress_ptr(NULL), vertex_exchange(dc), vset_exchange(dc), parallel_ingress(true),
+      loading_threads(0), reorder_method("none") {
       rpc.barrier();
       set_options(opts);
     }
@@ -601,6 +633,7 @@ namespace graphlab {
       size_t bufsize = 50000;
       bool usehash = false;
       bool userecent = false;
+      size_t threshold = 100;
       std::string ingress_method = "random";
       std::vector<std::string> keys = opts.get_graph_args().get_option_keys();
       foreach(std::string opt, keys) {
@@ -624,16 +657,48 @@ namespace graphlab {
            if (rpc.procid() == 0) 
             logstream(LOG_EMPH) << "Graph Option: userecent = " 
               << userecent << std::endl;
+        } else if (opt == "threshold") {
+          opts.get_graph_args().get_option("threshold", threshold);
+          if (rpc.procid() == 0) 
+            logstream(LOG_EMPH) << "Graph Option: threshold = " 
+              << threshold << std::endl;
         }  else if (opt == "parallel_ingress") {
          opts.get_graph_args().get_option("parallel_ingress", parallel_ingress);
           if (!parallel_ingress && rpc.procid() == 0) 
             logstream(LOG_EMPH) << "Disable parallel ingress. Graph will be streamed through one node." 
               << std::endl;
+        } else if (opt == "loading_threads") {
+          opts.get_graph_args().get_option("loading_threads", loading_threads);
+          if (loading_threads == 0) {
+            logstream(LOG_FATAL) << "Invalid Graph Option: loading_threads = "
+              << loading_threads << std::endl;
+          }
+          if (rpc.procid() == 0) 
+            logstream(LOG_EMPH) << "Graph Option: loading_threads = " 
+              << loading_threads << std::endl;
+        } else if (opt == "reorder") {
+          opts.get_graph_args().get_option("reorder", reorder_method);
+          if (!vertex_reordering::is_valid_method(reorder_method)) {
+            logstream(LOG_FATAL) << "Invalid Graph Option: reorder = "
+              << reorder_method << std::endl;
+          }
+          if (rpc.procid() == 0) 
+            logstream(LOG_EMPH) << "Graph Option: reorder = " 
+              << reorder_method << std::endl;
+        } else if (opt == "compress_adjacency") {
+          bool compress_adjacency = false;
+          opts.get_graph_args().get_option("compress_adjacency", 
+                                           compress_adjacency);
+          local_graph.set_use_compression(compress_adjacency);
+          if (rpc.procid() == 0) 
+            logstream(LOG_EMPH) << "Graph Option: compress_adjacency = " 
+              << compress_adjacency << std::endl;
         } else {
           logstream(LOG_ERROR) << "Unexpected Graph Option: " << opt << std::endl;
         }
     }
-      set_ingress_method(ingress_method, bufsize, usehash, userecent);
+      set_ingress_method(ingress_method, bufsize, usehash, userecent,
+                         threshold);
     }
 
   public:
@@ -778,6 +843,42 @@ namespace graphlab {
      */
     void add_edge(vertex_id_type source, vertex_id_type target, 
                   const EdgeData& edata = EdgeData()) {
+      check_new_edge(source, target);
+      ASSERT_NE(ingress_ptr, NULL);
+
+      ingress_ptr->add_edge(source, target, edata);
+    }
+
+
+    /**
+     * \brief Creates the edges source_arr[i] -> target_arr[i].
+     *
+     * Equivalent to calling add_edge() on each pair, with the edge data
+     * taken from edata_arr if it is not empty, but the edges are handed
+     * to the ingress at once, which sends them to each machine together.
+     * Has the same parallel semantics as add_edge().
+     */
+    void add_edges(const std::vector<vertex_id_type>& source_arr,
+                   const std::vector<vertex_id_type>& target_arr,
+                   const std::vector<EdgeData>& edata_arr =
+                     std::vector<EdgeData>()) {
+      ASSERT_EQ(source_arr.size(), target_arr.size());
+      if (!edata_arr.empty()) {
+        ASSERT_EQ(source_arr.size(), edata_arr.size());
+      }
+      for (size_t i = 0; i < source_arr.size(); ++i) {
+        check_new_edge(source_arr[i], target_arr[i]);
+      }
+      ASSERT_NE(ingress_ptr, NULL);
+      ingress_ptr->add_edges(source_arr, target_arr, edata_arr);
+    }
+
+
+    /**
+     * \internal
+     * Fails if the edge source -> target may not be added.
+     */
+    void check_new_edge(vertex_id_type source, vertex_id_type target) {
       if(finalized) {
         logstream(LOG_FATAL) 
           << "\n\tAttempting to add an edge to a finalized graph."
@@ -806,9 +907,6 @@ namespace graphlab {
           << "\n\tSelf edges are not allowed."
           << std::endl;
       }
-      ASSERT_NE(ingress_ptr, NULL);
-
-      ingress_ptr->add_edge(source, target, edata);
     }
 
 
@@ -1375,39 +1473,20 @@ namespace graphlab {
      * 
      * A graph loaded using load_binary() is already finalized and
      * structure modifications are not permitted after loading.
+     *
+     * Files saved with save_binary_mapped() are recognized and loaded
+     * from a memory mapping instead.
      */
     void load_binary(const std::string& prefix) {
       rpc.full_barrier();
       std::string fname = prefix + tostr(rpc.procid()) + ".bin";
 
       logstream(LOG_INFO) << "Load graph from " << fname << std::endl;
-      if(boost::starts_with(fname, "hdfs://")) {
-        graphlab::hdfs hdfs;
-        graphlab::hdfs::fstream in_file(hdfs, fname);
-        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
-        fin.push(boost::iostreams::gzip_decompressor());
-        fin.push(in_file);
-        
-        if(!fin.good()) {
-          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
-          exit(-1);
-        }
-        iarchive iarc(fin);
-        iarc >> *this;
-        fin.pop();
-        fin.pop();
-        in_file.close();
+      if (!boost::starts_with(fname, "hdfs://") &&
+          mapped_graph_reader::is_mapped_graph_file(fname)) {
+        load_mapped_file(fname);
       } else {
-        std::ifstream in_file(fname.c_str(),
-                              std::ios_base::in | std::ios_base::binary);
-        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
-        fin.push(boost::iostreams::gzip_decompressor());
-        fin.push(in_file);
-        iarchive iarc(fin);
-        iarc >> *this;
-        fin.pop();
-        fin.pop();
-        in_file.close();
+        load_binary_file(fname, *this);
       }
       logstream(LOG_INFO) << "Finish loading graph from " << fname << std::endl;
       rpc.full_barrier();
@@ -1434,47 +1513,196 @@ namespace graphlab {
      * this function will finalize the graph. 
      */
     void save_binary(const std::string& prefix) {
+      rpc.full_barrier();
+      finalize();
+      save_binary_local(prefix);
+      rpc.full_barrier();
+    } // end of save
+
+
+    /** \brief Saves a distributed graph to a page aligned binary format
+     * which load_binary() memory maps. This function must be called
+     * simultaneously on all machines.
+     *
+     * Like save_binary(), this function saves a sequence of files
+     * \li [prefix]0.bin
+     * \li [prefix]1.bin
+     * \li etc.
+     *
+     * which can be loaded with load_binary() using the <b>same number of
+     * machines</b>. The files are not compressed. The local graph
+     * structure, and the vertex and edge data if they are POD types, are
+     * stored as raw arrays, so loading maps the file and copies each array
+     * in one piece instead of decompressing and deserializing it. The
+     * mapping is shared, so jobs loading the same files reuse the page
+     * cache. Other vertex and edge data types are serialized.
+     *
+     * The files can only be written to and loaded from the local
+     * filesystem, on machines with the same byte order and vertex id
+     * size. If the graph is not already finalized, this function will
+     * finalize it.
+     */
+    void save_binary_mapped(const std::string& prefix) {
       rpc.full_barrier();
       finalize();
       timer savetime;  savetime.start();
       std::string fname = prefix + tostr(rpc.procid()) + ".bin";
+      if (boost::starts_with(fname, "hdfs://")) {
+        logstream(LOG_FATAL)
+          << "\n\tMapped binary graphs cannot be saved to HDFS: "
+          << fname << std::endl;
+      }
+      logstream(LOG_INFO) << "Save mapped graph to " << fname << std::endl;
+      mapped_graph_writer writer(fname);
+      std::vector<size_t> sizes(6);
+      sizes[0] = rpc.numprocs();
+      sizes[1] = nverts;
+      sizes[2] = nedges;
+      sizes[3] = local_own_nverts;
+      sizes[4] = nreplicas;
+      sizes[5] = begin_eid;
+      writer.add_vector(sizes);
+      // the vertex records, with the mirrors of record i in
+      // mirror_procs[mirror_begin[i], mirror_begin[i + 1])
+      std::vector<mapped_vertex_record> records(lvid2record.size());
+      std::vector<size_t> mirror_begin(lvid2record.size() + 1, 0);
+      std::vector<procid_t> mirror_procs;
+      for (size_t i = 0; i < lvid2record.size(); ++i) {
+        const vertex_record& rec = lvid2record[i];
+        records[i].owner = rec.owner;
+        records[i].gvid = rec.gvid;
+        records[i].num_in_edges = rec.num_in_edges;
+        records[i].num_out_edges = rec.num_out_edges;
+        foreach(size_t proc, rec.mirrors()) mirror_procs.push_back(proc);
+        mirror_begin[i + 1] = mirror_procs.size();
+      }
+      writer.add_vector(records);
+      writer.add_vector(mirror_begin);
+      writer.add_vector(mirror_procs);
+      local_graph.save_mapped(writer);
+      writer.close();
+      logstream(LOG_INFO) << "Finished saving mapped binary graph: "
+                          << savetime.current_time() << std::endl;
+      rpc.full_barrier();
+    } // end of save_binary_mapped
+
+
+    /** \brief Saves the part of the graph on this machine to
+     * [prefix][procid].bin in the format of save_binary().
+     *
+     * Unlike save_binary() this function does not synchronize with
+     * the other machines and may be called by one machine alone, for
+     * instance by an engine recording a snapshot while the other
+     * machines keep computing. The graph must already be finalized
+     * and the caller must ensure that the local vertex and edge data
+     * are not modified while the file is written. Calling
+     * save_binary_local() on every machine with the same prefix
+     * produces the same files as save_binary(prefix) and they can be
+     * loaded with load_binary().
+     */
+    void save_binary_local(const std::string& prefix) const {
+      ASSERT_TRUE(finalized);
+      timer savetime;  savetime.start();
+      std::string fname = prefix + tostr(rpc.procid()) + ".bin";
       logstream(LOG_INFO) << "Save graph to " << fname << std::endl;
-      if(boost::starts_with(fname, "hdfs://")) {
-        graphlab::hdfs hdfs;
-        graphlab::hdfs::fstream out_file(hdfs, fname, true);
-        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
-        fout.push(boost::iostreams::gzip_compressor());        
-        fout.push(out_file);
-        if (!fout.good()) {
-          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
-          exit(-1);
+      save_binary_file(fname, *this);
+      logstream(LOG_INFO) << "Finish saving graph to " << fname << std::endl
+                          << "Finished saving binary graph: " 
+                          << savetime.current_time() << std::endl;
+    } // end of save_binary_local
+
+
+    /** \brief Saves the data of the given vertices and edges as a delta
+     * to a graph previously saved with save_binary(). This function
+     * must be called simultaneously on all machines.
+     *
+     * This function saves a sequence of files numbered
+     * \li [prefix]0.bin
+     * \li [prefix]1.bin
+     * \li etc.
+     *
+     * The delta holds the data of every master vertex whose bit is set
+     * in vertices, and of the in (out) edges of every local vertex whose
+     * bit is set in in_edges (out_edges). All three bitsets are indexed
+     * by local vertex id. The delta is applied with load_binary_delta()
+     * to a graph loaded with load_binary(), and therefore refers to the
+     * vertices and edges by local id. It can only be applied on the
+     * same number of machines, to the graph saved with save_binary()
+     * before the data changed.
+     */
+    void save_binary_delta(const std::string& prefix,
+                           const dense_bitset& vertices,
+                           const dense_bitset& in_edges,
+                           const dense_bitset& out_edges) {
+      rpc.full_barrier();
+      ASSERT_TRUE(finalized);
+      timer savetime;  savetime.start();
+      binary_delta delta;
+      dense_bitset edge_in_delta(local_graph.num_edges());
+      edge_in_delta.clear();
+      for(lvid_type lvid = 0; lvid < local_graph.num_vertices(); ++lvid) {
+        if (vertices.get(lvid) && l_is_master(lvid)) {
+          delta.lvids.push_back(lvid);
+          delta.vdata.push_back(local_graph.vertex_data(lvid));
         }
-        oarchive oarc(fout);
-        oarc << *this;
-        fout.pop();
-        fout.pop();
-        out_file.close();
-      } else {
-        std::ofstream out_file(fname.c_str(),
-                               std::ios_base::out | std::ios_base::binary);
-        if (!out_file.good()) {
-          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
-          exit(-1);
+        if (in_edges.get(lvid)) {
+          foreach(const typename local_graph_type::edge_type& e,
+                  local_graph.in_edges(lvid)) {
+            edge_in_delta.set_bit(e.id());
+          }
+        }
+        if (out_edges.get(lvid)) {
+          foreach(const typename local_graph_type::edge_type& e,
+                  local_graph.out_edges(lvid)) {
+            edge_in_delta.set_bit(e.id());
+          }
         }
-        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
-        fout.push(boost::iostreams::gzip_compressor());        
-        fout.push(out_file);
-        oarchive oarc(fout);
-        oarc << *this;
-        fout.pop();
-        fout.pop();
-        out_file.close();
       }
-      logstream(LOG_INFO) << "Finish saving graph to " << fname << std::endl
-                          << "Finished saving binary graph: " 
+      const std::vector<edge_data_type>& edata =
+        local_graph.get_edge_data_storage();
+      foreach(size_t eid, edge_in_delta) {
+        delta.eids.push_back(eid);
+        delta.edata.push_back(edata[eid]);
+      }
+      std::string fname = prefix + tostr(rpc.procid()) + ".bin";
+      logstream(LOG_INFO) << "Save graph delta to " << fname << ": "
+                          << delta.lvids.size() << " vertices, "
+                          << delta.eids.size() << " edges" << std::endl;
+      save_binary_file(fname, delta);
+      logstream(LOG_INFO) << "Finished saving binary graph delta: "
                           << savetime.current_time() << std::endl;
       rpc.full_barrier();
-    } // end of save
+    } // end of save_binary_delta
+
+
+    /** \brief Applies a delta saved with save_binary_delta(). This
+     * function must be called simultaneously on all machines.
+     *
+     * The graph must have been loaded with load_binary() from the
+     * graph the delta refers to, and all earlier deltas must have been
+     * applied in order. The mirrors are synchronized with the masters
+     * afterwards.
+     */
+    void load_binary_delta(const std::string& prefix) {
+      rpc.full_barrier();
+      ASSERT_TRUE(finalized);
+      std::string fname = prefix + tostr(rpc.procid()) + ".bin";
+      logstream(LOG_INFO) << "Load graph delta from " << fname << std::endl;
+      binary_delta delta;
+      load_binary_file(fname, delta);
+      for (size_t i = 0; i < delta.lvids.size(); ++i) {
+        ASSERT_LT(delta.lvids[i], local_graph.num_vertices());
+        local_graph.vertex_data(delta.lvids[i]) = delta.vdata[i];
+      }
+      edge_data_type* edata = local_graph.edge_data_array();
+      for (size_t i = 0; i < delta.eids.size(); ++i) {
+        ASSERT_LT(delta.eids[i], local_graph.num_edges());
+        edata[delta.eids[i]] = delta.edata[i];
+      }
+      rpc.full_barrier();
+      synchronize();
+    } // end of load_binary_delta
+
 
 
     /**
@@ -1780,13 +2008,14 @@ namespace graphlab {
      *               If prefix begins with "hdfs://", the output is written to
      *               HDFS.
      * \param format The file format to save in. 
-     *               Either "tsv", "snap", "graphjrl" or "bin". 
+     *               Either "tsv", "snap", "graphjrl", "bintsv4", "bintsv8",
+     *               "binweighted", "bin" or "binmap". 
      * \param gzip If gzip compression should be used. If set, all files will be
      *             appended with the .gz suffix. Defaults to true. Ignored 
-     *             if format == "bin".
+     *             if format == "bin" or "binmap".
      * \param files_per_machine Number of files to write simultaneously in
-     *                          parallel per machine. Defaults to 4. Ignored if
-     *                          format == "bin".
+     *                          parallel per machine. Defaults to 4. Ignored
+     *                          by the binary formats.
      */
     void save_format(const std::string& prefix, const std::string& format,
                         bool gzip = true, size_t files_per_machine = 4) {
@@ -1798,8 +2027,13 @@ namespace graphlab {
              gzip, true, true, files_per_machine);
       } else if (format == "bin") {
          save_binary(prefix);
-      } else if (format == "bintsv4") {
-         save_direct(prefix, gzip, &graph_type::save_bintsv4_to_stream);
+      } else if (format == "binmap") {
+         save_binary_mapped(prefix);
+      } else if (format == "bintsv4" || format == "bintsv8" ||
+                 format == "binweighted") {
+         save_direct(prefix, gzip,
+                     boost::bind(&graph_type::save_binary_edges_to_stream,
+                                 _1, _2, get_binary_edge_format(format)));
       } else {
         logstream(LOG_FATAL)
           << "Unrecognized Format \"" << format << "\"!" << std::endl;
@@ -1814,53 +2048,34 @@ namespace graphlab {
      *  \brief Load a graph from a collection of files in stored on
      *  the filesystem using the user defined line parser. Like 
      *  \ref load(const std::string& path, line_parser_type line_parser) 
-     *  but only loads from the filesystem. 
+     *  but only loads from the filesystem. If block_parser is given, it
+     *  parses the uncompressed files instead of line_parser.
+     *  builtin_parser is true for the thread safe builtin parsers, which
+     *  run on all the cores unless the loading_threads option is set.
      */
     void load_from_posixfs(std::string prefix, 
-                           line_parser_type line_parser) {
-      std::string directory_name; std::string original_path(prefix);
-      boost::filesystem::path path(prefix);
-      std::string search_prefix;
-      if (boost::filesystem::is_directory(path)) {
-        // if this is a directory
-        // force a "/" at the end of the path
-        // make sure to check that the path is non-empty. (you do not
-        // want to make the empty path "" the root path "/" )
-        directory_name = path.native();
-      }
-      else {
-        directory_name = path.parent_path().native();
-        search_prefix = path.filename().native();
-        directory_name = (directory_name.empty() ? "." : directory_name);
-      }
-      std::vector<std::string> graph_files;
-      fs_util::list_files_with_prefix(directory_name, search_prefix, graph_files);
-      if (graph_files.size() == 0) {
-        logstream(LOG_WARNING) << "No files found matching " << original_path << std::endl;
-      }
-      for(size_t i = 0; i < graph_files.size(); ++i) {
-        if ((parallel_ingress && (i % rpc.numprocs() == rpc.procid()))
-            || (!parallel_ingress && (rpc.procid() == 0))) {
-          logstream(LOG_EMPH) << "Loading graph from file: " << graph_files[i] << std::endl;
-          // is it a gzip file ?
-          const bool gzip = boost::ends_with(graph_files[i], ".gz");
-          // open the stream
-          std::ifstream in_file(graph_files[i].c_str(), 
-                                std::ios_base::in | std::ios_base::binary);
-          // attach gzip if the file is gzip
-          boost::iostreams::filtering_stream<boost::iostreams::input> fin;  
-          // Using gzip filter
-          if (gzip) fin.push(boost::iostreams::gzip_decompressor());
-          fin.push(in_file);
-          const bool success = load_from_stream(graph_files[i], fin, line_parser);
-          if(!success) {
-            logstream(LOG_FATAL) 
-              << "\n\tError parsing file: " << graph_files[i] << std::endl;
-          }
-          fin.pop();
-          if (gzip) fin.pop();
-        }
-      }
+                           line_parser_type line_parser,
+                           block_parser_type block_parser =
+                             block_parser_type(),
+                           bool builtin_parser = false) {
+      const size_t nthreads = num_loading_threads(builtin_parser);
+      const std::vector<file_range> my_ranges =
+        local_file_ranges(list_posixfs_files(prefix), 1, nthreads);
+      if (!my_ranges.empty()) {
+        logstream(LOG_EMPH) << "Loading " << my_ranges.size()
+                            << " file ranges with "
+                            << std::min(nthreads, my_ranges.size())
+                            << " threads" << std::endl;
+      }
+      atomic<size_t> next_range(0);
+      thread_group loaders;
+      for (size_t i = 0; i < std::min(nthreads, my_ranges.size()); ++i) {
+        loaders.launch(boost::bind(&graph_type::load_ranges, this,
+                                   boost::cref(my_ranges),
+                                   boost::ref(next_range), line_parser,
+                                   block_parser));
+      }
+      loaders.join();
       rpc.full_barrier();
     } // end of load from posixfs
 
@@ -1954,6 +2169,11 @@ namespace graphlab {
      *  on failure. Since the parsing may be parallelized,
      *  the parser should treat each line independently
      *  and not depend on a sequential pass through a file. 
+     *  Uncompressed files on the filesystem are split into byte ranges.
+     *  They are parsed by a single thread on each machine, unless the
+     *  loading_threads graph option is set, in which case the parser
+     *  is called concurrently by that many threads and must be thread
+     *  safe.
      *
      *  For instance, if the graph is in a simple edge list format, a parser
      *  could be:
@@ -1982,12 +2202,24 @@ namespace graphlab {
      *  \param line_parser A user defined parsing function
      */  
     void load(std::string prefix, line_parser_type line_parser) {
+      load(prefix, line_parser, block_parser_type(), false);
+    } // end of load
+
+    /**
+     *  \internal
+     *  Like load(std::string prefix, line_parser_type line_parser), but
+     *  parses files on the filesystem with the block parser if given.
+     *  builtin_parser is true for the builtin parsers, which are thread
+     *  safe. See load_from_posixfs().
+     */
+    void load(std::string prefix, line_parser_type line_parser,
+              block_parser_type block_parser, bool builtin_parser) {
       rpc.full_barrier();
       if (prefix.length() == 0) return;
       if(boost::starts_with(prefix, "hdfs://")) {
         load_from_hdfs(prefix, line_parser);
       } else {
-        load_from_posixfs(prefix, line_parser);
+        load_from_posixfs(prefix, line_parser, block_parser, builtin_parser);
       }
       rpc.full_barrier();
     } // end of load
@@ -2064,19 +2296,23 @@ namespace graphlab {
       line_parser_type line_parser;
       if (format == "snap") {
         line_parser = builtin_parsers::snap_parser<distributed_graph>;
-        load(path, line_parser);
+        load(path, line_parser,
+             builtin_parsers::snap_block_parser<distributed_graph>, true);
       } else if (format == "adj") {
         line_parser = builtin_parsers::adj_parser<distributed_graph>;
-        load(path, line_parser);
+        load(path, line_parser,
+             builtin_parsers::adj_block_parser<distributed_graph>, true);
       } else if (format == "tsv") {
         line_parser = builtin_parsers::tsv_parser<distributed_graph>;
-        load(path, line_parser);
+        load(path, line_parser,
+             builtin_parsers::tsv_block_parser<distributed_graph>, true);
       } else if (format == "graphjrl") {
         line_parser = builtin_parsers::graphjrl_parser<distributed_graph>;
-        load(path, line_parser);
-      } else if (format == "bintsv4") {
-         load_direct(path,&graph_type::load_bintsv4_from_stream);
-      } else if (format == "bin") {
+        load(path, line_parser, block_parser_type(), true);
+      } else if (format == "bintsv4" || format == "bintsv8" ||
+                 format == "binweighted") {
+         load_binary_edges(path, get_binary_edge_format(format));
+      } else if (format == "bin" || format == "binmap") {
          load_binary(path);
       } else {
         logstream(LOG_ERROR)
@@ -2710,6 +2946,15 @@ namespace graphlab {
       
       /// \brief Random access to the list elements
       local_edge_type operator[](size_t i) const { return me_functor(elist[i]); }
+
+      /** \brief Returns an iterator to the i'th edge of the list.
+       *
+       * Equivalent to begin() + i, but seeks through the block index
+       * when the adjacency is compressed instead of decoding the i
+       * preceding edges.
+       */
+      iterator iterator_at(size_t i) const { return
+          boost::make_transform_iterator(elist.iterator_at(i), me_functor); }
       
       /** \brief Returns an iterator to the beginning of the list. 
        * 
@@ -2751,6 +2996,141 @@ namespace graphlab {
     
 
   private:
+
+    /** \internal The part of a vertex_record stored in a mapped graph
+     * file. The mirrors are stored separately. */
+    struct mapped_vertex_record : public IS_POD_TYPE {
+      procid_t owner;
+      vertex_id_type gvid, num_in_edges, num_out_edges;
+    };
+
+    /** \internal Loads the local part of the graph from a file written
+     * by save_binary_mapped() */
+    void load_mapped_file(const std::string& fname) {
+      clear();
+      mapped_graph_reader reader(fname);
+      std::vector<size_t> sizes;
+      reader.read_vector(sizes);
+      ASSERT_EQ(sizes.size(), 6);
+      if (sizes[0] != rpc.numprocs()) {
+        logstream(LOG_FATAL)
+          << "\n\t" << fname << " was saved by " << sizes[0]
+          << " machines and must be loaded by as many." << std::endl;
+      }
+      nverts = sizes[1];
+      nedges = sizes[2];
+      local_own_nverts = sizes[3];
+      nreplicas = sizes[4];
+      begin_eid = sizes[5];
+      std::vector<mapped_vertex_record> records;
+      std::vector<size_t> mirror_begin;
+      std::vector<procid_t> mirror_procs;
+      reader.read_vector(records);
+      reader.read_vector(mirror_begin);
+      reader.read_vector(mirror_procs);
+      ASSERT_EQ(mirror_begin.size(), records.size() + 1);
+      lvid2record.resize(records.size());
+      vid2lvid.reserve(records.size() * 1.5);
+      for (size_t i = 0; i < records.size(); ++i) {
+        vertex_record& rec = lvid2record[i];
+        rec.owner = records[i].owner;
+        rec.gvid = records[i].gvid;
+        rec.num_in_edges = records[i].num_in_edges;
+        rec.num_out_edges = records[i].num_out_edges;
+        for (size_t j = mirror_begin[i]; j < mirror_begin[i + 1]; ++j) {
+          rec._mirrors.set_bit(mirror_procs[j]);
+        }
+        vid2lvid[rec.gvid] = i;
+      }
+      local_graph.load_mapped(reader);
+      finalized = true;
+    } // end of load_mapped_file
+
+    /** \internal The contents of a file saved by save_binary_delta() */
+    struct binary_delta {
+      std::vector<lvid_type> lvids;
+      std::vector<vertex_data_type> vdata;
+      std::vector<edge_id_type> eids;
+      std::vector<edge_data_type> edata;
+      void save(oarchive& arc) const {
+        arc << lvids << vdata << eids << edata;
+      }
+      void load(iarchive& arc) {
+        arc >> lvids >> vdata >> eids >> edata;
+      }
+    }; // end of binary_delta
+
+    /** \internal Serializes obj to the gzip compressed file fname, which
+     * may be on HDFS */
+    template <typename T>
+    static void save_binary_file(const std::string& fname, const T& obj) {
+      if(boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        graphlab::hdfs::fstream out_file(hdfs, fname, true);
+        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+        fout.push(boost::iostreams::gzip_compressor());        
+        fout.push(out_file);
+        if (!fout.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+          exit(-1);
+        }
+        oarchive oarc(fout);
+        oarc << obj;
+        fout.pop();
+        fout.pop();
+        out_file.close();
+      } else {
+        std::ofstream out_file(fname.c_str(),
+                               std::ios_base::out | std::ios_base::binary);
+        if (!out_file.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+          exit(-1);
+        }
+        boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+        fout.push(boost::iostreams::gzip_compressor());        
+        fout.push(out_file);
+        oarchive oarc(fout);
+        oarc << obj;
+        fout.pop();
+        fout.pop();
+        out_file.close();
+      }
+    } // end of save_binary_file
+
+    /** \internal Deserializes obj from a file written by
+     * save_binary_file() */
+    template <typename T>
+    static void load_binary_file(const std::string& fname, T& obj) {
+      if(boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        graphlab::hdfs::fstream in_file(hdfs, fname);
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        fin.push(boost::iostreams::gzip_decompressor());
+        fin.push(in_file);
+        
+        if(!fin.good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: " << fname << std::endl;
+          exit(-1);
+        }
+        iarchive iarc(fin);
+        iarc >> obj;
+        fin.pop();
+        fin.pop();
+        in_file.close();
+      } else {
+        std::ifstream in_file(fname.c_str(),
+                              std::ios_base::in | std::ios_base::binary);
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        fin.push(boost::iostreams::gzip_decompressor());
+        fin.push(in_file);
+        iarchive iarc(fin);
+        iarc >> obj;
+        fin.pop();
+        fin.pop();
+        in_file.close();
+      }
+    } // end of load_binary_file
+
       
     // PRIVATE DATA MEMBERS ===================================================> 
     /** The rpc interface for this class */
@@ -2796,8 +3176,16 @@ namespace graphlab {
     /** Command option to disable parallel ingress. Used for simulating single node ingress */
     bool parallel_ingress; 
 
+    /** The number of threads parsing files on each machine, or 0 if
+        the loading_threads option is not set. See num_loading_threads() */
+    size_t loading_threads;
+
+    /** The local vertex reordering applied on finalize. See vertex_reordering.hpp */
+    std::string reorder_method;
+
     void set_ingress_method(const std::string& method,
-        size_t bufsize = 50000, bool usehash = false, bool userecent = false) {
+        size_t bufsize = 50000, bool usehash = false, bool userecent = false,
+        size_t threshold = 100) {
       if(ingress_ptr != NULL) { delete ingress_ptr; ingress_ptr = NULL; }
       if (method == "batch") {
         logstream(LOG_EMPH) << "Use batch ingress, bufsize: " << bufsize
@@ -2818,6 +3206,11 @@ namespace graphlab {
       } else if (method == "pds") {
         logstream(LOG_EMPH) << "Use random pds ingress" << std::endl;
         ingress_ptr = new distributed_constrained_random_ingress<VertexData, EdgeData>(rpc.dc(), *this, "pds");
+      } else if (method == "hybrid") {
+        logstream(LOG_EMPH) << "Use hybrid ingress, threshold: " << threshold
+          << std::endl;
+        ingress_ptr = new distributed_hybrid_ingress<VertexData, EdgeData>(rpc.dc(), *this,
+                                                          threshold);
       }else {
         logstream(LOG_EMPH) << "Use random ingress" << std::endl;
         ingress_ptr = new distributed_random_ingress<VertexData, EdgeData>(rpc.dc(), *this);
@@ -2857,6 +3250,248 @@ namespace graphlab {
     } // end of load from stream
 
 
+    /**
+       \internal
+       A part of a file loaded by one thread. The range holds the lines
+       which begin in [begin, end). end is size_t(-1) for a gzip file,
+       which is loaded whole.
+     */
+    struct file_range {
+      std::string filename;
+      size_t begin, end;
+      file_range(const std::string& filename, size_t begin, size_t end) :
+        filename(filename), begin(begin), end(end) { }
+    };
+
+    /**
+       \internal
+       Lists the files on the filesystem matching the prefix, which is
+       either a directory or a path followed by a file name prefix.
+     */
+    std::vector<std::string> list_posixfs_files(const std::string& prefix) {
+      std::string directory_name;
+      boost::filesystem::path path(prefix);
+      std::string search_prefix;
+      if (boost::filesystem::is_directory(path)) {
+        // if this is a directory
+        // force a "/" at the end of the path
+        // make sure to check that the path is non-empty. (you do not
+        // want to make the empty path "" the root path "/" )
+        directory_name = path.native();
+      }
+      else {
+        directory_name = path.parent_path().native();
+        search_prefix = path.filename().native();
+        directory_name = (directory_name.empty() ? "." : directory_name);
+      }
+      std::vector<std::string> graph_files;
+      fs_util::list_files_with_prefix(directory_name, search_prefix, graph_files);
+      if (graph_files.size() == 0) {
+        logstream(LOG_WARNING) << "No files found matching " << prefix << std::endl;
+      }
+      return graph_files;
+    } // end of list posixfs files
+
+    /**
+       \internal
+       The number of threads parsing files on each machine: the
+       loading_threads option if set, otherwise the number of cores for
+       the builtin parsers and 1 for user parsers, which may not be
+       thread safe.
+     */
+    size_t num_loading_threads(bool builtin_parser) const {
+      if (loading_threads > 0) return loading_threads;
+      return builtin_parser ? thread::cpu_count() : 1;
+    }
+
+    /**
+       \internal
+       Returns the ranges of the files this machine loads. Every machine
+       computes the same list of ranges: gzip files are loaded whole,
+       while the uncompressed files are cut into about numprocs *
+       nthreads ranges of equal size, but no smaller than 4MB.
+       The range boundaries are multiples of alignment within each file.
+       The ranges are dealt round robin to the machines.
+     */
+    std::vector<file_range>
+    local_file_ranges(const std::vector<std::string>& graph_files,
+                      size_t alignment, size_t nthreads) {
+      std::vector<file_range> ranges;
+      size_t total_bytes = 0;
+      for(size_t i = 0; i < graph_files.size(); ++i) {
+        if (!boost::ends_with(graph_files[i], ".gz")) {
+          total_bytes += boost::filesystem::file_size(graph_files[i]);
+        }
+      }
+      const size_t nloaders = parallel_ingress ? rpc.numprocs() : 1;
+      size_t range_size =
+        std::max<size_t>(4 * 1024 * 1024,
+                         total_bytes / (nloaders * nthreads) + 1);
+      range_size += alignment - 1 - (range_size - 1) % alignment;
+      for(size_t i = 0; i < graph_files.size(); ++i) {
+        if (boost::ends_with(graph_files[i], ".gz")) {
+          ranges.push_back(file_range(graph_files[i], 0, size_t(-1)));
+          continue;
+        }
+        const size_t file_bytes = boost::filesystem::file_size(graph_files[i]);
+        for (size_t begin = 0; begin < file_bytes; begin += range_size) {
+          ranges.push_back(file_range(graph_files[i], begin,
+                                      std::min(begin + range_size, file_bytes)));
+        }
+      }
+      std::vector<file_range> my_ranges;
+      for(size_t i = 0; i < ranges.size(); ++i) {
+        if ((parallel_ingress && (i % rpc.numprocs() == rpc.procid()))
+            || (!parallel_ingress && (rpc.procid() == 0))) {
+          my_ranges.push_back(ranges[i]);
+        }
+      }
+      return my_ranges;
+    } // end of local file ranges
+
+    /**
+       \internal
+       Run by each loading thread: loads ranges, taken in turn with
+       next_range, until there are none left.
+     */
+    void load_ranges(const std::vector<file_range>& ranges,
+                     atomic<size_t>& next_range,
+                     line_parser_type line_parser,
+                     block_parser_type block_parser) {
+      std::vector<char> filebuf(1024 * 1024);
+      while(1) {
+        const size_t i = next_range.inc_ret_last();
+        if (i >= ranges.size()) break;
+        const file_range& range = ranges[i];
+        std::ifstream in_file;
+        in_file.rdbuf()->pubsetbuf(&(filebuf[0]), filebuf.size());
+        in_file.open(range.filename.c_str(),
+                     std::ios_base::in | std::ios_base::binary);
+        bool success;
+        if (range.end == size_t(-1)) {
+          logstream(LOG_EMPH) << "Loading graph from file: "
+                              << range.filename << std::endl;
+          boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+          fin.push(boost::iostreams::gzip_decompressor());
+          fin.push(in_file);
+          success = block_parser.empty() ?
+            load_from_stream(range.filename, fin, line_parser) :
+            load_blocks_from_range(range, fin, block_parser);
+          fin.pop(); fin.pop();
+        } else if (block_parser.empty()) {
+          success = load_from_range(range, in_file, line_parser);
+        } else {
+          success = load_blocks_from_range(range, in_file, block_parser);
+        }
+        if(!success) {
+          logstream(LOG_FATAL)
+            << "\n\tError parsing file: " << range.filename << std::endl;
+        }
+      }
+    } // end of load ranges
+
+
+    /**
+       \internal
+       Loads the lines of the file which begin in the range. The line
+       crossing the start of the range belongs to the previous range and
+       the line crossing the end is read completely.
+     */
+    bool load_from_range(const file_range& range, std::istream& fin,
+                         line_parser_type& line_parser) {
+      std::string line;
+      size_t pos = range.begin;
+      if (pos > 0) {
+        // skip the rest of the line containing the byte before the range.
+        // If that byte is a newline, a line begins exactly at pos.
+        fin.seekg(pos - 1);
+        std::getline(fin, line);
+        pos += line.length();
+      }
+      size_t linecount = 0;
+      timer ti; ti.start();
+      while(pos < range.end && fin.good()) {
+        std::getline(fin, line);
+        if(fin.fail()) break;
+        pos += line.length() + 1;
+        if(line.empty()) continue;
+        const bool success = line_parser(*this, range.filename, line);
+        if (!success) {
+          logstream(LOG_WARNING)
+            << "Error parsing line " << linecount << " after byte "
+            << range.begin << " in " << range.filename << ": " << std::endl
+            << "\t\"" << line << "\"" << std::endl;
+          return false;
+        }
+        ++linecount;
+        if (ti.current_time() > 5.0) {
+          logstream(LOG_INFO) << linecount << " Lines read" << std::endl;
+          ti.start();
+        }
+      }
+      return true;
+    } // end of load from range
+
+
+    /**
+       \internal
+       Like load_from_range() but reads the range in large blocks and
+       hands each block of whole lines to the block parser.
+     */
+    bool load_blocks_from_range(const file_range& range, std::istream& fin,
+                                block_parser_type& block_parser) {
+      size_t pos = range.begin;
+      if (pos > 0) {
+        std::string line;
+        fin.seekg(pos - 1);
+        std::getline(fin, line);
+        pos += line.length();
+      }
+      // a line started before the range covers all of it
+      if (pos >= range.end) return true;
+      // buf[0, filled) holds the bytes of the file from pos
+      std::vector<char> buf(4 * 1024 * 1024);
+      size_t filled = 0;
+      bool eof = !fin.good();
+      while(1) {
+        if (!eof) {
+          if (filled == buf.size()) buf.resize(2 * buf.size());
+          fin.read(&(buf[filled]), buf.size() - filled);
+          filled += fin.gcount();
+          eof = !fin.good();
+        }
+        const char* data = &(buf[0]);
+        // the end of the last line to parse in this block
+        const char* stop = NULL;
+        bool last = eof;
+        if (range.end != size_t(-1) && pos + filled >= range.end) {
+          // the line holding the last byte of the range is the last one
+          const char* lastbyte = data + (range.end - pos) - 1;
+          stop = std::find(lastbyte, data + filled, '\n');
+          if (stop < data + filled) last = true;
+          else stop = NULL;
+        } else if (eof) {
+          stop = data + filled;
+        } else {
+          for (size_t i = filled; i > 0; --i) {
+            if (data[i - 1] == '\n') { stop = data + i - 1; break; }
+          }
+        }
+        if (stop == NULL) {
+          if (!eof) continue;
+          stop = data + filled;
+        }
+        if (!block_parser(*this, range.filename, data, stop)) return false;
+        if (last) break;
+        const size_t consumed = std::min<size_t>(stop - data + 1, filled);
+        pos += consumed;
+        filled -= consumed;
+        memmove(&(buf[0]), &(buf[consumed]), filled);
+      }
+      return true;
+    } // end of load blocks from range
+
+
     template<typename Fstream, typename Writer>
     void save_vertex_to_stream(vertex_type& vertex, Fstream& fout, Writer writer) {
       fout << writer.save_vertex(vertex);
@@ -2870,40 +3505,257 @@ namespace graphlab {
     } // end of save_edge_to_stream
   
 
-    void save_bintsv4_to_stream(std::ostream& out) {
-      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-        uint32_t src = l_vertex(i).global_id();
+    /**
+       \internal
+       The layout of the records of a binary edge list. A record holds the
+       source and the target vertex ids, of id_bytes each in little endian
+       order, followed by the raw bytes of the edge data if weighted. A
+       record whose target id has all bits set holds a vertex without
+       edges.
+     */
+    struct binary_edge_format {
+      size_t id_bytes;
+      bool weighted;
+      binary_edge_format(size_t id_bytes, bool weighted) :
+        id_bytes(id_bytes), weighted(weighted) { }
+      size_t record_size() const {
+        return 2 * id_bytes + (weighted ? sizeof(EdgeData) : 0);
+      }
+    };
+
+    /**
+       \internal
+       Returns the record layout of the bintsv4, bintsv8 or binweighted
+       format.
+     */
+    static binary_edge_format get_binary_edge_format(const std::string& format) {
+      if (format == "bintsv4") return binary_edge_format(4, false);
+      if (format == "bintsv8") return binary_edge_format(8, false);
+      if (!gl_is_pod<EdgeData>::value) {
+        logstream(LOG_FATAL)
+          << "\n\tThe binweighted format stores the raw bytes of the edge data"
+          << "\n\tand requires the edge data type to be POD." << std::endl;
+      }
+      return binary_edge_format(8, true);
+    }
+
+    /// \internal Reads a vertex id of a binary edge list record
+    static vertex_id_type read_binary_edge_id(const char* ptr, size_t id_bytes) {
+      uint64_t vid;
+      if (id_bytes == 4) {
+        uint32_t vid32;
+        memcpy(&vid32, ptr, 4);
+        vid = (vid32 == uint32_t(-1)) ? uint64_t(-1) : vid32;
+      } else {
+        memcpy(&vid, ptr, 8);
+      }
+      if (vid != uint64_t(-1) && vid >= uint64_t(vertex_id_type(-1))) {
+        logstream(LOG_FATAL)
+          << "\n\tVertex id " << vid << " does not fit in vertex_id_type."
+          << "\n\tGraphLab must be built with VID64 to load vertex ids of"
+          << "\n\t2^32 - 1 or more." << std::endl;
+      }
+      return vertex_id_type(vid);
+    }
+
+    /// \internal Writes a vertex id of a binary edge list record
+    static void write_binary_edge_id(char* ptr, vertex_id_type vid,
+                                     size_t id_bytes) {
+      if (id_bytes == 4) {
+        if (vid != vertex_id_type(-1) && uint64_t(vid) >= uint32_t(-1)) {
+          logstream(LOG_FATAL)
+            << "\n\tVertex id " << vid << " does not fit in 32 bits."
+            << "\n\tUse the bintsv8 format instead of bintsv4." << std::endl;
+        }
+        const uint32_t vid32 = vid;
+        memcpy(ptr, &vid32, 4);
+      } else {
+        const uint64_t vid64 = (vid == vertex_id_type(-1)) ? uint64_t(-1) : vid;
+        memcpy(ptr, &vid64, 8);
+      }
+    }
+
+    /**
+       \internal
+       Writes the out edges of the local vertices, and the vertices without
+       edges this machine owns, as a binary edge list. The records are
+       gathered in large blocks before they are written.
+     */
+    void save_binary_edges_to_stream(std::ostream& out,
+                                     const binary_edge_format& format) {
+      const size_t record_size = format.record_size();
+      std::vector<char> buf((4 * 1024 * 1024 / record_size) * record_size);
+      size_t filled = 0;
+      for (lvid_type i = 0; i < local_graph.num_vertices(); ++i) {
+        const vertex_id_type src = l_vertex(i).global_id();
         foreach(local_edge_type e, l_vertex(i).out_edges()) {
-          uint32_t dest = e.target().global_id();
-          out.write(reinterpret_cast<char*>(&src), 4);
-          out.write(reinterpret_cast<char*>(&dest), 4);
+          if (filled == buf.size()) {
+            out.write(&(buf[0]), filled);
+            filled = 0;
+          }
+          char* record = &(buf[filled]);
+          write_binary_edge_id(record, src, format.id_bytes);
+          write_binary_edge_id(record + format.id_bytes,
+                               e.target().global_id(), format.id_bytes);
+          if (format.weighted) {
+            memcpy(record + 2 * format.id_bytes, &(e.data()), sizeof(EdgeData));
+          }
+          filled += record_size;
         }
         if (l_vertex(i).owner() == rpc.procid()) {
           vertex_type gv = vertex_type(l_vertex(i));
           // store disconnected vertices if I am the master of the vertex
           if (gv.num_in_edges() == 0 && gv.num_out_edges() == 0) {
-            out.write(reinterpret_cast<char*>(&src), 4);
-            uint32_t dest = (uint32_t)(-1); 
-            out.write(reinterpret_cast<char*>(&dest), 4);
+            if (filled == buf.size()) {
+              out.write(&(buf[0]), filled);
+              filled = 0;
+            }
+            char* record = &(buf[filled]);
+            memset(record, 0, record_size);
+            write_binary_edge_id(record, src, format.id_bytes);
+            write_binary_edge_id(record + format.id_bytes, vertex_id_type(-1),
+                                 format.id_bytes);
+            filled += record_size;
           }
         }
-      } 
-    }
+      }
+      if (filled > 0) out.write(&(buf[0]), filled);
+    } // end of save binary edges to stream
 
-    bool load_bintsv4_from_stream(std::istream& in) {
-      while(in.good()) {
-        uint32_t src, dest;
-        in.read(reinterpret_cast<char*>(&src), 4);
-        in.read(reinterpret_cast<char*>(&dest), 4);
-        if (in.fail()) break;
-        if (dest == (uint32_t)(-1)) {
-          add_vertex(src);
-        }
-        else {
-          add_edge(src, dest);
+    /**
+       \internal
+       Loads nbytes, or all if nbytes is size_t(-1), of a binary edge list
+       from the stream. The stream is read in large blocks and the edges
+       are added in batches with add_edges(), so that the ingress sends
+       each batch with one exchange send per machine. Returns false if
+       the data ends in a partial record.
+     */
+    bool load_binary_edges_from_stream(std::istream& in,
+                                       const binary_edge_format& format,
+                                       size_t nbytes) {
+      const size_t batch_size = builtin_parsers::block_impl::EDGE_BATCH_SIZE;
+      const size_t record_size = format.record_size();
+      std::vector<char> buf((4 * 1024 * 1024 / record_size) * record_size);
+      std::vector<vertex_id_type> source_arr, target_arr;
+      std::vector<EdgeData> edata_arr;
+      source_arr.reserve(batch_size);
+      target_arr.reserve(batch_size);
+      if (format.weighted) edata_arr.reserve(batch_size);
+      size_t filled = 0;
+      while(nbytes > 0 && in.good()) {
+        in.read(&(buf[filled]), std::min(buf.size() - filled, nbytes));
+        const size_t nread = in.gcount();
+        filled += nread;
+        if (nbytes != size_t(-1)) nbytes -= nread;
+        const size_t nrecords = filled / record_size;
+        for (size_t i = 0; i < nrecords; ++i) {
+          const char* record = &(buf[i * record_size]);
+          const vertex_id_type source =
+            read_binary_edge_id(record, format.id_bytes);
+          const vertex_id_type target =
+            read_binary_edge_id(record + format.id_bytes, format.id_bytes);
+          if (target == vertex_id_type(-1)) {
+            add_vertex(source);
+            continue;
+          }
+          source_arr.push_back(source);
+          target_arr.push_back(target);
+          if (format.weighted) {
+            EdgeData edata;
+            memcpy(&edata, record + 2 * format.id_bytes, sizeof(EdgeData));
+            edata_arr.push_back(edata);
+          }
+          if (source_arr.size() == batch_size) {
+            add_edges(source_arr, target_arr, edata_arr);
+            source_arr.clear(); target_arr.clear(); edata_arr.clear();
+          }
         }
-      } 
+        filled -= nrecords * record_size;
+        memmove(&(buf[0]), &(buf[nrecords * record_size]), filled);
+      }
+      add_edges(source_arr, target_arr, edata_arr);
+      if (filled > 0) {
+        logstream(LOG_WARNING)
+          << "Binary edge list ends in a partial record of " << filled
+          << " bytes" << std::endl;
+        return false;
+      }
       return true;
+    } // end of load binary edges from stream
+
+    /**
+       \internal
+       Run by each loading thread: loads binary edge list ranges, taken
+       in turn with next_range, until there are none left.
+     */
+    void load_binary_edge_ranges(const std::vector<file_range>& ranges,
+                                 atomic<size_t>& next_range,
+                                 const binary_edge_format& format) {
+      while(1) {
+        const size_t i = next_range.inc_ret_last();
+        if (i >= ranges.size()) break;
+        const file_range& range = ranges[i];
+        std::ifstream in_file(range.filename.c_str(),
+                              std::ios_base::in | std::ios_base::binary);
+        bool success;
+        if (range.end == size_t(-1)) {
+          logstream(LOG_EMPH) << "Loading graph from file: "
+                              << range.filename << std::endl;
+          boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+          fin.push(boost::iostreams::gzip_decompressor());
+          fin.push(in_file);
+          success = load_binary_edges_from_stream(fin, format, size_t(-1));
+          fin.pop(); fin.pop();
+        } else {
+          in_file.seekg(range.begin);
+          success = load_binary_edges_from_stream(in_file, format,
+                                                  range.end - range.begin);
+        }
+        if(!success) {
+          logstream(LOG_FATAL)
+            << "\n\tError parsing file: " << range.filename << std::endl;
+        }
+      }
+    } // end of load binary edge ranges
+
+    /**
+       \internal
+       Loads a graph in one of the binary edge list formats. The
+       uncompressed files on the filesystem are split on record
+       boundaries and loaded by num_loading_threads(true) threads per
+       machine.
+     */
+    void load_binary_edges(const std::string& prefix,
+                           const binary_edge_format& format) {
+      if(boost::starts_with(prefix, "hdfs://")) {
+        load_direct(prefix,
+                    boost::bind(&graph_type::load_binary_edges_from_stream,
+                                _1, _2, format, size_t(-1)));
+        return;
+      }
+      rpc.full_barrier();
+      const size_t nthreads = num_loading_threads(true);
+      const std::vector<file_range> my_ranges =
+        local_file_ranges(list_posixfs_files(prefix), format.record_size(),
+                          nthreads);
+      atomic<size_t> next_range(0);
+      thread_group loaders;
+      for (size_t i = 0; i < std::min(nthreads, my_ranges.size()); ++i) {
+        loaders.launch(boost::bind(&graph_type::load_binary_edge_ranges, this,
+                                   boost::cref(my_ranges),
+                                   boost::ref(next_range), boost::cref(format)));
+      }
+      loaders.join();
+      rpc.full_barrier();
+    } // end of load binary edges
+
+    void save_bintsv4_to_stream(std::ostream& out) {
+      save_binary_edges_to_stream(out, get_binary_edge_format("bintsv4"));
+    }
+
+    bool load_bintsv4_from_stream(std::istream& in) {
+      return load_binary_edges_from_stream(in, get_binary_edge_format("bintsv4"),
+                                           size_t(-1));
     }
 
 
@@ -2956,7 +3808,7 @@ namespace graphlab {
         out_file.close();
       }
       logstream(LOG_INFO) << "Finish saving graph to " << fname << std::endl
-                          << "Finished saving bintsv4 graph: " 
+                          << "Finished saving graph: " 
                           << savetime.current_time() << std::endl;
       rpc.full_barrier();
     } // end of save
@@ -64,7 +64,9 @@
 
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/generics/shuffle.hpp>
+#include <graphlab/util/varint.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/graph/mapped_graph_file.hpp>
 
 
 #include <graphlab/parallel/atomic.hpp>
@@ -205,7 +207,8 @@ namespace graphlab {
     public:
       // Cosntructors
       /** \brief Creates an empty iterator. */
-      edge_iterator () : offset(-1), empty(true) { }
+      edge_iterator () : offset(-1), vid_arr(NULL), pos(NULL), base(0),
+                         empty(true) { }
       /** \brief Creates an iterator at a specific edge.
        * The edge location is defined by the follows: 
        * A center vertex id,  an offset to the center, the direction and the
@@ -213,7 +216,19 @@ namespace graphlab {
       edge_iterator (lvid_type _center, size_t _offset, 
                      edge_dir_type _itype, const lvid_type* _vid_arr) :
         center(_center), offset(_offset), itype(_itype), vid_arr(_vid_arr), 
-        empty(false) { }
+        pos(NULL), base(0), empty(false) { }
+      /** \brief Creates an iterator at a specific edge of a compressed
+       * adjacency list. pos points to the encoded delta of the edge
+       * and base is the vertex id of the preceding edge in the list
+       * (0 at the start of the list). Compressed iterators can only
+       * move forward. */
+      edge_iterator (lvid_type _center, size_t _offset,
+                     edge_dir_type _itype, const unsigned char* _pos,
+                     lvid_type _base) :
+        center(_center), offset(_offset), itype(_itype), vid_arr(NULL),
+        pos(_pos), base(_base), empty(false) { 
+        if (pos != NULL) base += varint::read(pos);
+      }
       /** \brief Returns the value of the iterator. An empty iterator always returns empty edge type*/ 
       inline edge_type operator*() const  {
         //  ASSERT_TRUE(!empty);
@@ -249,6 +264,7 @@ namespace graphlab {
       inline edge_iterator& operator++() {
         //ASSERT_TRUE(!empty);
         ++offset;
+        if (pos != NULL) base += varint::read(pos);
         return *this;
       }
 
@@ -267,18 +283,26 @@ namespace graphlab {
 
       /** \brief Returns a new iterator whose value is increased by i difference units. */
       inline edge_iterator operator+(difference_type i) const {
-        return edge_iterator(center, offset+i, itype, vid_arr);
+        edge_iterator ret(*this);
+        ret += i;
+        return ret;
       }
 
-      /** \brief Increases the iterator by i difference units. */
+      /** \brief Increases the iterator by i difference units. 
+       * This is O(i) on a compressed adjacency list. */
       inline edge_iterator& operator+=(difference_type i) {
         offset+=i;
+        if (pos != NULL) {
+          for (; i > 0; --i) base += varint::read(pos);
+        }
         return *this;
       }
 
       /** \brief Generate the return value of the iterator. */
       inline edge_type make_value() const {
-        return empty ? edge_type() : edge_type(center, vid_arr[offset], offset, itype);
+        if (empty) return edge_type();
+        return edge_type(center, (pos == NULL) ? vid_arr[offset] : base, 
+                         offset, itype);
       }
 
     private:
@@ -286,7 +310,14 @@ namespace graphlab {
       size_t offset;
       edge_dir_type itype;
       const lvid_type* vid_arr;
+      /** Position of the next encoded delta in the compressed
+       * adjacency. NULL if not compressed. */
+      const unsigned char* pos;
+      /** The decoded vertex id of the current edge if compressed. */
+      lvid_type base;
       bool empty;
+
+      friend class graph_storage;
     }; // end of class edge_iterator.
 
     /** Represents an iteratable list of edge_types. */
@@ -297,13 +328,26 @@ namespace graphlab {
       typedef edge_type value_type;
     private:
       edge_iterator begin_iter, end_iter;
+      /** The storage of a compressed list, used to seek into it. NULL
+       * if not compressed. */
+      const graph_storage* storage;
     public:
       /** Cosntructs an edge_list with begin and end.  */
       edge_list(const edge_iterator begin_iter = edge_iterator(), 
-                const edge_iterator end_iter = edge_iterator()) : 
-        begin_iter(begin_iter), end_iter(end_iter) { }
+                const edge_iterator end_iter = edge_iterator(),
+                const graph_storage* storage = NULL) : 
+        begin_iter(begin_iter), end_iter(end_iter), storage(storage) { }
       inline size_t size() const { return end_iter - begin_iter;}            
+      /** O(i) on a compressed adjacency list. Iterate instead. */
       inline edge_type operator[](size_t i) const {return *(begin_iter + i);}
+      /** Returns an iterator to the i'th edge of the list. Unlike
+       * begin() + i, this seeks through the block index on a compressed
+       * adjacency list, decoding at most COMPRESSED_BLOCK_SIZE edges. */
+      iterator iterator_at(size_t i) const {
+        if (i >= size()) return end_iter;
+        if (storage == NULL || i == 0) return begin_iter + i;
+        return storage->seek_edge(begin_iter, begin_iter.offset + i);
+      }
       iterator begin() const { return begin_iter; }
       iterator end() const { return end_iter; }
       bool empty() const { return size() == 0; }
@@ -312,7 +356,8 @@ namespace graphlab {
 
   public:
     // CONSTRUCTORS ============================================================>
-    graph_storage() : use_skip_list(false) {  }
+    graph_storage(bool use_compression = false) : 
+      use_skip_list(false), use_compression(use_compression) {  }
 
     // METHODS =================================================================>
    
@@ -321,6 +366,17 @@ namespace graphlab {
      * */ 
     void set_use_skip_list (bool x) { use_skip_list = x;}
 
+    /** \brief Set graph storage to compress the adjacency lists.
+     * The neighbor ids of every vertex are stored as varint encoded
+     * deltas and decoded on the fly by the edge iterators. Edge data
+     * is not affected. Must be set before finalize.
+     *
+     * Iterating the edges of a vertex costs the same as before, but
+     * random access into an edge list and find() become linear in the
+     * degree of the vertex.
+     * */
+    void set_use_compression (bool x) { use_compression = x;}
+
     /** \brief Returns the number of edges in the graph. */
     size_t edge_size() const { return num_edges; }
 
@@ -411,6 +467,14 @@ namespace graphlab {
         edge_range_type range = rangePair.second;
         edge_dir_type dir = IN_EDGES;
 
+        if (compressed()) {
+          const unsigned char* pos = 
+            locate(CSC_src_enc, CSC_src_block, range.first);
+          return edge_list(edge_iterator(v, range.first, dir, pos, 0),
+                           edge_iterator(v, range.second+1, dir, 
+                                         (const unsigned char*)NULL, 0),
+                           this);
+        }
         edge_iterator begin (v, range.first, dir, &(CSC_src[0]));
         edge_iterator end (v, range.second+1, dir, &(CSC_src[0]));
         // std::cout << "in range (" << range.first << "," <<
@@ -428,6 +492,14 @@ namespace graphlab {
       std::pair<bool, edge_range_type> rangePair = outEdgeRange(v);
       if (rangePair.first) {
         edge_range_type range = rangePair.second;
+        if (compressed()) {
+          const unsigned char* pos = 
+            locate(CSR_dst_enc, CSR_dst_block, range.first);
+          return edge_list(edge_iterator(v, range.first, OUT_EDGES, pos, 0),
+                           edge_iterator(v, range.second+1, OUT_EDGES, 
+                                         (const unsigned char*)NULL, 0),
+                           this);
+        }
         edge_iterator begin (v, range.first, OUT_EDGES, &(CSR_dst[0]));
         edge_iterator end (v, range.second+1, OUT_EDGES, &(CSR_dst[0]));
         // std::cout << "out range (" << range.first << "," <<
@@ -455,14 +527,18 @@ namespace graphlab {
         if ((srcRange.second - srcRange.first) < 
             (dstRange.second - dstRange.first)) {
           // Out edge candidate size is smaller, search CSC.
-          size_t efind =  binary_search(CSC_src, srcRange.first, 
-                                        srcRange.second, src);
+          size_t efind = compressed() ?
+            linear_search(CSC_src_enc, CSC_src_block, srcRange.first,
+                          srcRange.second, src) :
+            binary_search(CSC_src, srcRange.first, srcRange.second, src);
           return efind >= num_edges ? 
             edge_type() : edge_type(dst, src, efind, IN_EDGES);
         } else {
           // In edge candidate size is smaller, search CSR.
-          size_t efind = binary_search(CSR_dst, dstRange.first, 
-                                       dstRange.second, dst);
+          size_t efind = compressed() ?
+            linear_search(CSR_dst_enc, CSR_dst_block, dstRange.first,
+                          dstRange.second, dst) :
+            binary_search(CSR_dst, dstRange.first, dstRange.second, dst);
           return efind >= num_edges ? 
             edge_type() : edge_type(src, dst, efind, OUT_EDGES);
         }
@@ -703,6 +779,7 @@ namespace graphlab {
       CSR_dst.swap(edges.target_arr);
       // Swap edge data and perserve c2r_map.
       edge_data_list.swap(edges.data);
+      compress_adjacency();
 #ifdef DEBGU_GRAPH
       logstream(LOG_DEBUG) << "End of finalize." << std::endl;
 #endif
@@ -747,6 +824,12 @@ namespace graphlab {
       CSC_dst_skip.clear();
       c2r_map.clear();
       edge_data_list.clear();
+      CSR_dst_enc.clear();
+      CSR_dst_block.clear();
+      CSR_dst_block_base.clear();
+      CSC_src_enc.clear();
+      CSC_src_block.clear();
+      CSC_src_block_base.clear();
     }
 
     /** \brief Reset the storage and free the reserved memory. */
@@ -759,6 +842,12 @@ namespace graphlab {
       std::vector<EdgeData>().swap(edge_data_list);
       std::vector<edge_id_type>().swap(CSR_src_skip);
       std::vector<edge_id_type>().swap(CSC_dst_skip);
+      std::vector<unsigned char>().swap(CSR_dst_enc);
+      std::vector<size_t>().swap(CSR_dst_block);
+      std::vector<lvid_type>().swap(CSR_dst_block_base);
+      std::vector<unsigned char>().swap(CSC_src_enc);
+      std::vector<size_t>().swap(CSC_src_block);
+      std::vector<lvid_type>().swap(CSC_src_block_base);
     }
 
     size_t estimate_sizeof() const {
@@ -771,11 +860,19 @@ namespace graphlab {
       const size_t CSC_size = eid_size *CSC_dst.capacity() + 
         vid_size * CSC_src.capacity() + eid_size * c2r_map.capacity();
       const size_t edata_size = sizeof(EdgeData) * edge_data_list.capacity();
+      // Compressed adjacency size;
+      const size_t compressed_size = CSR_dst_enc.capacity() + 
+        CSC_src_enc.capacity() + 
+        sizeof(size_t) * (CSR_dst_block.capacity() + CSC_src_block.capacity()) +
+        vid_size * (CSR_dst_block_base.capacity() +
+                    CSC_src_block_base.capacity());
 
       // Container size;
       const size_t container_size = sizeof(CSR_src) + sizeof(CSR_dst) + 
         sizeof(CSC_src) + sizeof(CSC_dst) + sizeof(c2r_map) + 
-        sizeof(edge_data_list);
+        sizeof(edge_data_list) + sizeof(CSR_dst_enc) + sizeof(CSR_dst_block) +
+        sizeof(CSR_dst_block_base) + sizeof(CSC_src_enc) +
+        sizeof(CSC_src_block) + sizeof(CSC_src_block_base);
       // Skip list size:
       const size_t skip_list_size = sizeof(CSR_src_skip) + 
         sizeof(CSC_dst_skip) + CSR_src_skip.capacity() * vid_size + 
@@ -787,15 +884,18 @@ namespace graphlab {
                 << (double)CSC_size/(1024*1024) 
                 << " edata size: "
                 << (double)edata_size/(1024*1024)
+                << " compressed adjacency size: "
+                << (double)compressed_size/(1024*1024)
                 << " skiplist size: " 
                 << (double)(skip_list_size)/(1024*1024)
                 << " container size: " 
                 << (double)container_size/(1024*1024) 
                 << " \n Total size: " 
-                << double(CSR_size + CSC_size + container_size + skip_list_size) << std::endl;
+                << double(CSR_size + CSC_size + compressed_size + 
+                          container_size + skip_list_size) << std::endl;
 
-      return CSR_size + CSC_size + edata_size + container_size + 
-        skip_list_size;
+      return CSR_size + CSC_size + compressed_size + edata_size + 
+        container_size + skip_list_size;
     } // end of estimate_sizeof
 
     /** To be deprecated. */
@@ -813,6 +913,14 @@ namespace graphlab {
     // Use edge_list instead.
     lvid_type target(edge_id_type eid) const {
       ASSERT_LT(eid, num_edges);
+      if (compressed()) {
+        // Decode the out edge list of the source up to eid
+        const size_t start = CSR_src[lookup_source(eid)];
+        const unsigned char* pos = locate(CSR_dst_enc, CSR_dst_block, start);
+        size_t vid = 0;
+        for (size_t e = start; e <= eid; ++e) vid += varint::read(pos);
+        return vid;
+      }
       return CSR_dst[eid];
     }
 
@@ -867,8 +975,42 @@ namespace graphlab {
      * Col index of CSC, corresponding to the source vertices. */
     std::vector<lvid_type> CSC_src;
 
+    /** \internal
+     * Compressed CSR_dst. Each out edge list is stored as the varint
+     * encoded differences between consecutive target ids, the first
+     * relative to 0. Replaces CSR_dst if use_compression is set. */
+    std::vector<unsigned char> CSR_dst_enc;
+
+    /** \internal
+     * Byte offset into CSR_dst_enc of every COMPRESSED_BLOCK_SIZE'th
+     * edge. Used to find the start of an edge list. */
+    std::vector<size_t> CSR_dst_block;
+
+    /** \internal
+     * The vertex id of the edge preceding each block of CSR_dst_enc in
+     * its edge list, 0 if the block starts a list. Used with
+     * CSR_dst_block to seek into the middle of an edge list. */
+    std::vector<lvid_type> CSR_dst_block_base;
+
+    /** \internal
+     * Compressed CSC_src, encoded in the same way as CSR_dst_enc. */
+    std::vector<unsigned char> CSC_src_enc;
+
+    /** \internal
+     * Byte offset into CSC_src_enc of every COMPRESSED_BLOCK_SIZE'th
+     * edge. */
+    std::vector<size_t> CSC_src_block;
+
+    /** \internal
+     * The block bases of CSC_src_enc. See CSR_dst_block_base. */
+    std::vector<lvid_type> CSC_src_block_base;
+
+    /** Number of edges between two entries of the block index. */
+    static const size_t COMPRESSED_BLOCK_SIZE = 32;
+
     /** Graph storage traits. */
     bool use_skip_list;
+    bool use_compression;
 
 
  /****************************************************************************
@@ -978,6 +1120,111 @@ namespace graphlab {
       return -1;
     }// End of binary_search
 
+    /** \internal
+     * Returns true if the adjacency lists are stored compressed. */
+    inline bool compressed() const { return !CSR_dst_enc.empty(); }
+
+    /** \internal
+     * Returns the position of the encoded edge e which must be the
+     * first edge of an edge list. */
+    inline const unsigned char* 
+    locate(const std::vector<unsigned char>& enc, 
+           const std::vector<size_t>& block, size_t e) const {
+      const unsigned char* pos = &(enc[0]) + block[e / COMPRESSED_BLOCK_SIZE];
+      for (size_t i = 0; i < e % COMPRESSED_BLOCK_SIZE; ++i) varint::skip(pos);
+      return pos;
+    }
+
+    /** \internal
+     * Returns an iterator to the edge e of the compressed edge list
+     * starting at first, which must be before e. Decodes forward from
+     * first or from the block containing e, whichever is closer. */
+    edge_iterator seek_edge(const edge_iterator& first, size_t e) const {
+      const bool out = first.itype == OUT_EDGES;
+      const size_t b = e / COMPRESSED_BLOCK_SIZE;
+      const unsigned char* pos = first.pos;
+      lvid_type base = first.base;
+      size_t next = first.offset + 1;
+      if (b * COMPRESSED_BLOCK_SIZE > first.offset) {
+        // the block starts inside the list
+        pos = &((out ? CSR_dst_enc : CSC_src_enc)[0]) +
+          (out ? CSR_dst_block : CSC_src_block)[b];
+        base = (out ? CSR_dst_block_base : CSC_src_block_base)[b];
+        next = b * COMPRESSED_BLOCK_SIZE;
+      }
+      // pos is at the delta of edge next, base the id of edge next - 1
+      for (; next < e; ++next) base += varint::read(pos);
+      return edge_iterator(first.center, e, first.itype, pos, base);
+    } // End of seek_edge
+
+    /** \internal
+     *  Linear search vfind in a compressed edge list
+     *  within range [start, end]. Returns (size_t)(-1) if not found. */
+    size_t linear_search(const std::vector<unsigned char>& enc,
+                         const std::vector<size_t>& block,
+                         size_t start, size_t end, 
+                         lvid_type vfind) const {
+      ASSERT_LT(vfind, num_vertices);
+      const unsigned char* pos = locate(enc, block, start);
+      size_t vpoke = 0;
+      for (size_t e = start; e <= end; ++e) {
+        vpoke += varint::read(pos);
+        if (vpoke == vfind) return e;
+        if (vpoke > vfind) break;
+      }
+      // Not found;
+      return -1;
+    } // End of linear_search
+
+    /** \internal
+     * Delta and varint encodes the edge lists in vid_arr. list_begin
+     * is the matching row index (CSR_src or CSC_dst). */
+    void encode_adjacency(const std::vector<lvid_type>& vid_arr,
+                          const std::vector<edge_id_type>& list_begin,
+                          std::vector<unsigned char>& enc,
+                          std::vector<size_t>& block,
+                          std::vector<lvid_type>& block_base) const {
+      std::vector<bool> list_start(num_edges, false);
+      foreach(edge_id_type e, list_begin) 
+        if (e < num_edges) list_start[e] = true;
+      enc.clear(); enc.reserve(num_edges);
+      block.clear(); block.reserve(num_edges / COMPRESSED_BLOCK_SIZE + 1);
+      block_base.clear();
+      block_base.reserve(num_edges / COMPRESSED_BLOCK_SIZE + 1);
+      lvid_type prev = 0;
+      for (size_t e = 0; e < num_edges; ++e) {
+        if (list_start[e]) prev = 0;
+        ASSERT_GE(vid_arr[e], prev);
+        if (e % COMPRESSED_BLOCK_SIZE == 0) {
+          block.push_back(enc.size());
+          block_base.push_back(prev);
+        }
+        varint::append(enc, vid_arr[e] - prev);
+        prev = vid_arr[e];
+      }
+      // Padding, so that iterators may read one delta past the last edge
+      enc.push_back(0);
+      std::vector<unsigned char>(enc).swap(enc);
+    } // End of encode_adjacency
+
+    /** \internal
+     * Inverse of encode_adjacency. */
+    void decode_adjacency(const std::vector<unsigned char>& enc,
+                          const std::vector<edge_id_type>& list_begin,
+                          std::vector<lvid_type>& vid_arr) const {
+      std::vector<bool> list_start(num_edges, false);
+      foreach(edge_id_type e, list_begin) 
+        if (e < num_edges) list_start[e] = true;
+      vid_arr.resize(num_edges);
+      const unsigned char* pos = enc.empty() ? NULL : &(enc[0]);
+      lvid_type prev = 0;
+      for (size_t e = 0; e < num_edges; ++e) {
+        if (list_start[e]) prev = 0;
+        prev += varint::read(pos);
+        vid_arr[e] = prev;
+      }
+    } // End of decode_adjacency
+
     /** \internal
      * To be deprecated. */
     // This is a log(V) operation.
@@ -1081,18 +1328,31 @@ namespace graphlab {
 
   public:
 
+    /** \internal
+     * Replaces CSR_dst and CSC_src by their compressed form if
+     * use_compression is set. Called at the end of finalize and load. */
+    void compress_adjacency() {
+      if (!use_compression || num_edges == 0 || compressed()) return;
+      encode_adjacency(CSR_dst, CSR_src, CSR_dst_enc, CSR_dst_block,
+                       CSR_dst_block_base);
+      encode_adjacency(CSC_src, CSC_dst, CSC_src_enc, CSC_src_block,
+                       CSC_src_block_base);
+      std::vector<lvid_type>().swap(CSR_dst);
+      std::vector<lvid_type>().swap(CSC_src);
+    } // End of compress_adjacency
+
     /** \internal
      * Returns a reference of CSR_src.*/
     const std::vector<lvid_type>& get_csr_src() const {
       return CSR_src;
     }
     /** \internal
-     * Returns a reference of CSR_dst.*/
+     * Returns a reference of CSR_dst. Empty if compressed.*/
     const std::vector<edge_id_type>& get_csr_dst() const {
       return CSR_dst;
     }
     /** \internal
-     * Returns a reference of CSC_src.*/
+     * Returns a reference of CSC_src. Empty if compressed.*/
     const std::vector<edge_id_type>& get_csc_src() const {
       return CSC_src;
     }
@@ -1101,6 +1361,50 @@ namespace graphlab {
     const std::vector<lvid_type>& get_csc_dst() const {
       return CSC_dst;
     }
+    /** \internal
+     * Exposes the in edges of v as contiguous arrays: nbr[i] is the
+     * source of the i'th in edge and eid[i] the index of its data in
+     * edge_data_array(). Returns false if the adjacency is compressed,
+     * in which case no arrays exist. */
+    bool in_edge_arrays(lvid_type v, const lvid_type*& nbr,
+                        const edge_id_type*& eid, size_t& size) const {
+      if (compressed()) return false;
+      std::pair<bool, edge_range_type> rangePair = inEdgeRange(v);
+      size = 0; nbr = NULL; eid = NULL;
+      if (rangePair.first) {
+        const edge_range_type range = rangePair.second;
+        nbr = &(CSC_src[range.first]);
+        eid = &(c2r_map[range.first]);
+        size = range.second - range.first + 1;
+      }
+      return true;
+    }
+
+    /** \internal
+     * Exposes the out edges of v as contiguous arrays: nbr[i] is the
+     * target of the i'th out edge and its data is at index
+     * first_eid + i of edge_data_array(). Returns false if the
+     * adjacency is compressed. */
+    bool out_edge_arrays(lvid_type v, const lvid_type*& nbr,
+                         size_t& first_eid, size_t& size) const {
+      if (compressed()) return false;
+      std::pair<bool, edge_range_type> rangePair = outEdgeRange(v);
+      size = 0; nbr = NULL; first_eid = 0;
+      if (rangePair.first) {
+        const edge_range_type range = rangePair.second;
+        nbr = &(CSR_dst[range.first]);
+        first_eid = range.first;
+        size = range.second - range.first + 1;
+      }
+      return true;
+    }
+
+    /** \internal
+     * Returns a pointer to the edge data array. */
+    EdgeData* edge_data_array() {
+      return edge_data_list.empty() ? NULL : &(edge_data_list[0]);
+    }
+
     /** \internal
      * Returns a reference of edge_data_list.*/
     const std::vector<EdgeData>& get_edge_data() const {
@@ -1121,23 +1425,76 @@ namespace graphlab {
           >> c2r_map
           >> CSR_src_skip
           >> CSC_dst_skip;
+      compress_adjacency();
     }
 
-    /** \brief Save the graph to an archive */
+    /** \brief Save the graph to an archive. Compressed adjacency
+     * lists are written in the uncompressed format. */
     void save(oarchive& arc) const {
+      std::vector<lvid_type> csr_dst, csc_src;
+      if (compressed()) {
+        decode_adjacency(CSR_dst_enc, CSR_src, csr_dst);
+        decode_adjacency(CSC_src_enc, CSC_dst, csc_src);
+      }
       arc << use_skip_list
           << num_vertices
           << num_edges
           << edge_data_list
           << CSR_src
-          << CSR_dst
-          << CSC_src
+          << (compressed() ? csr_dst : CSR_dst)
+          << (compressed() ? csc_src : CSC_src)
           << CSC_dst
           << c2r_map
           << CSR_src_skip
           << CSC_dst_skip;
     }
 
+    /** \internal
+     * Writes the storage to a mapped graph file. Like save(), compressed
+     * adjacency lists are written in the uncompressed format. */
+    void save_mapped(mapped_graph_writer& writer) const {
+      std::vector<lvid_type> csr_dst, csc_src;
+      if (compressed()) {
+        decode_adjacency(CSR_dst_enc, CSR_src, csr_dst);
+        decode_adjacency(CSC_src_enc, CSC_dst, csc_src);
+      }
+      std::vector<size_t> sizes(3);
+      sizes[0] = use_skip_list;
+      sizes[1] = num_vertices;
+      sizes[2] = num_edges;
+      writer.add_vector(sizes);
+      writer.add_vector(edge_data_list);
+      writer.add_vector(CSR_src);
+      writer.add_vector(compressed() ? csr_dst : CSR_dst);
+      writer.add_vector(compressed() ? csc_src : CSC_src);
+      writer.add_vector(CSC_dst);
+      writer.add_vector(c2r_map);
+      writer.add_vector(CSR_src_skip);
+      writer.add_vector(CSC_dst_skip);
+    }
+
+    /** \internal
+     * Reads the storage from a mapped graph file written by
+     * save_mapped(). */
+    void load_mapped(mapped_graph_reader& reader) {
+      clear();
+      std::vector<size_t> sizes;
+      reader.read_vector(sizes);
+      ASSERT_EQ(sizes.size(), 3);
+      use_skip_list = sizes[0];
+      num_vertices = sizes[1];
+      num_edges = sizes[2];
+      reader.read_vector(edge_data_list);
+      reader.read_vector(CSR_src);
+      reader.read_vector(CSR_dst);
+      reader.read_vector(CSC_src);
+      reader.read_vector(CSC_dst);
+      reader.read_vector(c2r_map);
+      reader.read_vector(CSR_src_skip);
+      reader.read_vector(CSC_dst_skip);
+      compress_adjacency();
+    }
+
     /** swap two graph storage*/
     void swap(graph_storage& other) {
       std::swap(use_skip_list, other.use_skip_list);
@@ -1151,6 +1508,13 @@ namespace graphlab {
       std::swap(c2r_map, other.c2r_map);
       std::swap(CSR_src_skip, other.CSR_src_skip);
       std::swap(CSC_dst_skip, other.CSC_dst_skip);
+      std::swap(use_compression, other.use_compression);
+      std::swap(CSR_dst_enc, other.CSR_dst_enc);
+      std::swap(CSR_dst_block, other.CSR_dst_block);
+      std::swap(CSR_dst_block_base, other.CSR_dst_block_base);
+      std::swap(CSC_src_enc, other.CSC_src_enc);
+      std::swap(CSC_src_block, other.CSC_src_block);
+      std::swap(CSC_src_block_base, other.CSC_src_block_base);
     }
 
   };// End of graph store;
@@ -30,7 +30,7 @@
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
-#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/procid_set.hpp>
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
   template<typename VertexData, typename EdgeData>
@@ -55,10 +55,10 @@ namespace graphlab {
     mutex local_graph_lock;
     mutex lvid2record_lock;
 
-    typedef fixed_dense_bitset<RPC_MAX_N_PROCS> bin_counts_type;
+    typedef procid_set bin_counts_type;
 
     /** Type of the degree hash table: 
-     * a map from vertex id to a bitset of length num_procs. */
+     * a map from vertex id to the set of procs holding its edges. */
     typedef typename boost::unordered_map<vertex_id_type, bin_counts_type> 
     dht_degree_table_type;
 
@@ -128,21 +128,33 @@ namespace graphlab {
     void add_edge(vertex_id_type source, vertex_id_type target, const EdgeData& edata) {
       BEGIN_TRACEPOINT(batch_ingress_add_edge);
       edgesend_lock.lock();
-      ASSERT_LT(edgesend.size(), bufsize);
-      edgesend.push_back(std::make_pair(source, target)); 
-      edatasend.push_back(edata);        
-      query_set[base_type::vertex_to_proc(source)].insert(source);
-      query_set[base_type::vertex_to_proc(target)].insert(target);
-      ++num_edges;
+      buffer_edge(source, target, edata);
       edgesend_lock.unlock();
       END_TRACEPOINT(batch_ingress_add_edge);
-      if (is_full()) flush();
     } // end of add_edge
 
+    /** Adds many edges to the batch ingress buffer, taking the lock once. */
+    void add_edges(const std::vector<vertex_id_type>& source_arr,
+                   const std::vector<vertex_id_type>& target_arr,
+                   const std::vector<EdgeData>& edata_arr) {
+      BEGIN_TRACEPOINT(batch_ingress_add_edge);
+      ASSERT_EQ(source_arr.size(), target_arr.size());
+      ASSERT_TRUE(edata_arr.empty() || edata_arr.size() == source_arr.size());
+      edgesend_lock.lock();
+      for (size_t i = 0; i < source_arr.size(); ++i) {
+        buffer_edge(source_arr[i], target_arr[i],
+                    edata_arr.empty() ? EdgeData() : edata_arr[i]);
+      }
+      edgesend_lock.unlock();
+      END_TRACEPOINT(batch_ingress_add_edge);
+    } // end of add_edges
+
     /** Flush the buffer and call base finalize. */; 
     void finalize() { 
       rpc.full_barrier();
+      edgesend_lock.lock();
       flush(); 
+      edgesend_lock.unlock();
       rpc.full_barrier();
       base_type::finalize();
     } // end of finalize
@@ -152,7 +164,7 @@ namespace graphlab {
 
     // HELPER ROUTINES =======================================================>    
     /** Add edges in block to the local current graph. */
-    void add_edges(const std::vector<vertex_id_type>& source_arr, 
+    void add_local_edges(const std::vector<vertex_id_type>& source_arr, 
         const std::vector<vertex_id_type>& target_arr, 
         const std::vector<EdgeData>& edata_arr) {
 
@@ -241,10 +253,16 @@ namespace graphlab {
     /** Updates the local part of the distributed table. */
     void block_add_degree_counts (procid_t pid, std::vector<vertex_id_type>& whohas) {
       BEGIN_TRACEPOINT(batch_ingress_update_degree_table);
-      dht_degree_table_lock.readlock();
+      // set_bit may reallocate the entry, so concurrent updates must
+      // be serialized
+      dht_degree_table_lock.writelock();
       foreach (vertex_id_type& vid, whohas) {
-        size_t idx = vid_to_dht_entry_with_readlock(vid);
-        dht_degree_table[idx].set_bit_unsync(pid);
+        size_t idx = (vid - rpc.procid()) / rpc.numprocs();
+        if (dht_degree_table.size() <= idx) {
+          size_t newsize = std::max(dht_degree_table.size() * 2, idx + 1);
+          dht_degree_table.resize(newsize);
+        }
+        dht_degree_table[idx].set_bit(pid);
       }
       dht_degree_table_lock.unlock();
       END_TRACEPOINT(batch_ingress_update_degree_table);
@@ -265,18 +283,13 @@ namespace graphlab {
     }  // end of block get degree table
 
 
-    /** Assign edges in the buffer greedily using the recent query of DHT. */
+    /** Assign edges in the buffer greedily using the recent query of DHT.
+     * Must be called with edgesend_lock held. */
    void assign_edges(std::vector<std::vector<vertex_id_type> >& proc_src,
                      std::vector<std::vector<vertex_id_type> >& proc_dst,
                      std::vector<std::vector<EdgeData> >& proc_edata) {
      ASSERT_EQ(num_edges, edgesend.size());
-
-     edgesend_lock.lock();
-     
-     if (num_edges == 0) {
-      edgesend_lock.unlock();
-      return;
-     }
+     if (num_edges == 0) return;
      BEGIN_TRACEPOINT(batch_ingress_request_degree_table);
      std::vector<dht_degree_table_type> degree_table(rpc.numprocs());
      
@@ -317,10 +330,25 @@ namespace graphlab {
      // Clear the sending buffer.
      edgesend.clear();
      edatasend.clear();
-     edgesend_lock.unlock();
    } // end assign edge
 
-    /** Flushes all edges in the buffer. */
+    /** Adds an edge to the buffer, and updates the query set.
+     * Must be called with edgesend_lock held. */
+    void buffer_edge(vertex_id_type source, vertex_id_type target,
+                     const EdgeData& edata) {
+      ASSERT_LT(edgesend.size(), bufsize);
+      edgesend.push_back(std::make_pair(source, target)); 
+      edatasend.push_back(edata);        
+      query_set[base_type::vertex_to_proc(source)].insert(source);
+      query_set[base_type::vertex_to_proc(target)].insert(target);
+      ++num_edges;
+      // several loader threads may add edges. The buffer is flushed
+      // with the lock held so that no edge is added while it is full
+      if (is_full()) flush();
+    } // end of buffer_edge
+
+    /** Flushes all edges in the buffer.
+     * Must be called with edgesend_lock held. */
     void flush() {
       std::vector< std::vector<vertex_id_type> > proc_src(rpc.numprocs());
       std::vector< std::vector<vertex_id_type> > proc_dst(rpc.numprocs());
@@ -330,10 +358,10 @@ namespace graphlab {
         if (proc_src[i].size() == 0) 
           continue;
         if (i == rpc.procid()) {
-          add_edges(proc_src[i], proc_dst[i], proc_edata[i]);
+          add_local_edges(proc_src[i], proc_dst[i], proc_edata[i]);
           num_edges -= proc_src[i].size();
         } else {
-          rpc.remote_call(i, &distributed_batch_ingress::add_edges,
+          rpc.remote_call(i, &distributed_batch_ingress::add_local_edges,
               proc_src[i], proc_dst[i], proc_edata[i]);
           num_edges -= proc_src[i].size();
         } // end if
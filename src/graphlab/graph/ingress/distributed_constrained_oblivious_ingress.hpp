@@ -31,7 +31,7 @@
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
-#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/procid_set.hpp>
 #include <graphlab/util/cuckoo_map_pow2.hpp>
 #include <graphlab/graph/ingress/sharding_constraint.hpp>
 #include <graphlab/macros_def.hpp>
@@ -57,16 +57,19 @@ namespace graphlab {
 
     typedef distributed_ingress_base<VertexData, EdgeData> base_type;
     // typedef typename boost::unordered_map<vertex_id_type, std::vector<size_t> > degree_hash_table_type;
-    typedef fixed_dense_bitset<RPC_MAX_N_PROCS> bin_counts_type; 
+    typedef procid_set bin_counts_type; 
 
     /** Type of the degree hash table: 
-     * a map from vertex id to a bitset of length num_procs. */
+     * a map from vertex id to the set of procs holding its edges. */
     typedef cuckoo_map_pow2<vertex_id_type, bin_counts_type,3,uint32_t> degree_hash_table_type;
     degree_hash_table_type dht;
 
     /** Array of number of edges on each proc. */
     std::vector<size_t> proc_num_edges;
 
+    /** Protects the greedy state when edges are added in parallel. */
+    mutex greedy_lock;
+
     /** Ingress tratis. */
     bool usehash;
     bool userecent;
@@ -85,18 +88,17 @@ namespace graphlab {
       delete constraint;
     }
 
-    /** Add an edge to the ingress object using oblivious greedy assignment. */
-    void add_edge(vertex_id_type source, vertex_id_type target,
-                  const EdgeData& edata) {
+    /** Assign an edge using oblivious greedy assignment. */
+    procid_t edge_to_proc(vertex_id_type source, vertex_id_type target) {
+      greedy_lock.lock();
       dht[source]; dht[target];
       std::vector<procid_t> candidates;
       constraint->get_joint_neighbors(get_master(source), get_master(target), candidates);
       const procid_t owning_proc = 
         base_type::edge_decision.edge_to_proc_greedy(source, target, dht[source], dht[target], candidates, proc_num_edges, usehash, userecent);
-      typedef typename base_type::edge_buffer_record edge_buffer_record;
-      edge_buffer_record record(source, target, edata);
-      base_type::edge_exchange.send(owning_proc, record);
-    } // end of add edge
+      greedy_lock.unlock();
+      return owning_proc;
+    } // end of edge to proc
 
     virtual void finalize() {
      dht.clear();
@@ -69,21 +69,13 @@ namespace graphlab {
       delete constraint;
     }
 
-    /** Add an edge to the ingress object using random assignment. */
-    void add_edge(vertex_id_type source, vertex_id_type target,
-                  const EdgeData& edata) {
-      typedef typename base_type::edge_buffer_record edge_buffer_record;
-
+    /** Assign an edge using random assignment. */
+    procid_t edge_to_proc(vertex_id_type source, vertex_id_type target) {
       std::vector<procid_t> candidates;
       constraint->get_joint_neighbors(get_master(source), get_master(target), candidates);
 
-      const procid_t owning_proc = 
-          base_type::edge_decision.edge_to_proc_random(source, target, candidates);
-
-
-      const edge_buffer_record record(source, target, edata);
-      base_type::edge_exchange.send(owning_proc, record);
-    } // end of add edge
+      return base_type::edge_decision.edge_to_proc_random(source, target, candidates);
+    } // end of edge to proc
 
   private:
     procid_t get_master (vertex_id_type vid) {
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_DISTRIBUTED_HYBRID_INGRESS_HPP
+#define GRAPHLAB_DISTRIBUTED_HYBRID_INGRESS_HPP
+
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/graph/ingress/idistributed_ingress.hpp>
+#include <graphlab/graph/ingress/distributed_ingress_base.hpp>
+#include <graphlab/graph/distributed_graph.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+  template<typename VertexData, typename EdgeData>
+  class distributed_graph;
+
+  /**
+   * \brief Ingress object cutting the edges of low degree vertices
+   * and the vertices of high degree vertices.
+   *
+   * Every edge is first sent to the machine of its target, so that each
+   * machine receives all the in edges of the vertices it is responsible
+   * for and counts their in degrees exactly. On finalize, the in edges
+   * of a vertex with at most threshold in edges stay on that machine,
+   * which places the vertex with all its in edges like an edge-cut. The
+   * in edges of a vertex with more than threshold in edges are spread
+   * out by sending each to the machine of its source, so that only the
+   * high degree vertices are cut. The low degree vertices are mastered
+   * on the machine holding their in edges.
+   */
+  template<typename VertexData, typename EdgeData>
+  class distributed_hybrid_ingress :
+    public distributed_ingress_base<VertexData, EdgeData> {
+  public:
+    typedef distributed_graph<VertexData, EdgeData> graph_type;
+    /// The type of the vertex data stored in the graph
+    typedef VertexData vertex_data_type;
+    /// The type of the edge data stored in the graph
+    typedef EdgeData   edge_data_type;
+
+
+    typedef distributed_ingress_base<VertexData, EdgeData> base_type;
+    typedef typename base_type::edge_buffer_record edge_buffer_record;
+    typedef typename buffered_exchange<edge_buffer_record>::buffer_type
+      edge_buffer_type;
+
+    /// The in degree above which the in edges of a vertex are cut
+    size_t threshold;
+
+    /// Carries every edge to the machine of its target
+    buffered_exchange<edge_buffer_record> target_exchange;
+
+    /// The vertices of this machine with more than threshold in edges
+    boost::unordered_set<vertex_id_type> high_degree_vertices;
+
+  public:
+    distributed_hybrid_ingress(distributed_control& dc, graph_type& graph,
+                               size_t threshold = 100) :
+      base_type(dc, graph), threshold(threshold),
+      target_exchange(dc, base_type::num_send_threads,
+                      base_type::exchange_buffer_size(
+                        base_type::num_send_threads)) {
+    } // end of constructor
+
+    ~distributed_hybrid_ingress() { }
+
+    /** Send an edge to the machine of its target. */
+    procid_t edge_to_proc(vertex_id_type source, vertex_id_type target) {
+      return base_type::vertex_to_proc(target);
+    } // end of edge to proc
+
+    /** Add an edge to the ingress object, on the machine of its target. */
+    void add_edge(vertex_id_type source, vertex_id_type target,
+                  const EdgeData& edata) {
+      const edge_buffer_record record(source, target, edata);
+      target_exchange.send(edge_to_proc(source, target), record,
+                           base_type::send_thread());
+    } // end of add edge
+
+    /** Add many edges to the ingress object, on the machines of their
+     * targets. */
+    void add_edges(const std::vector<vertex_id_type>& source_arr,
+                   const std::vector<vertex_id_type>& target_arr,
+                   const std::vector<EdgeData>& edata_arr) {
+      base_type::send_edges(target_exchange, source_arr, target_arr,
+                            edata_arr);
+    } // end of add edges
+
+    /** Place the edges by the in degree of their target and call base
+     * finalize. */
+    void finalize() {
+      base_type::rpc.full_barrier();
+      target_exchange.flush();
+      // Receive the in edges of the vertices of this machine and count
+      // their in degrees
+      std::vector<edge_buffer_type> edge_buffers;
+      boost::unordered_map<vertex_id_type, size_t> in_degree;
+      {
+        edge_buffer_type edge_buffer;
+        procid_t proc;
+        while(target_exchange.recv(proc, edge_buffer)) {
+          foreach(const edge_buffer_record& rec, edge_buffer) {
+            ++in_degree[rec.target];
+          }
+          edge_buffers.push_back(edge_buffer_type());
+          edge_buffers.back().swap(edge_buffer);
+        }
+        target_exchange.clear();
+      }
+      typedef boost::unordered_map<vertex_id_type, size_t>::value_type
+        degree_pair_type;
+      foreach(const degree_pair_type& pair, in_degree) {
+        if (pair.second > threshold) high_degree_vertices.insert(pair.first);
+      }
+      logstream(LOG_INFO) << high_degree_vertices.size() << " of "
+                          << in_degree.size()
+                          << " vertices have more than " << threshold
+                          << " in edges" << std::endl;
+      // Keep the edges of the low degree vertices and send the edges of
+      // the high degree vertices to the machine of their source
+      for (size_t i = 0; i < edge_buffers.size(); ++i) {
+        foreach(const edge_buffer_record& rec, edge_buffers[i]) {
+          const procid_t owning_proc = in_degree[rec.target] > threshold ?
+            base_type::vertex_to_proc(rec.source) : base_type::rpc.procid();
+          base_type::edge_exchange.send(owning_proc, rec);
+        }
+        edge_buffer_type().swap(edge_buffers[i]);
+      }
+      base_type::finalize();
+      boost::unordered_set<vertex_id_type>().swap(high_degree_vertices);
+    } // end of finalize
+
+    /** The low degree vertices are mastered with their in edges, on the
+     * machine which negotiates them. */
+    bool master_on_negotiator(vertex_id_type vid) const {
+      return high_degree_vertices.count(vid) == 0;
+    }
+  }; // end of distributed_hybrid_ingress
+}; // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+
+#endif
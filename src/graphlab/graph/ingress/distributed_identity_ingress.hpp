@@ -59,14 +59,10 @@ namespace graphlab {
 
     ~distributed_identity_ingress() { }
 
-    /** Add an edge to the ingress object and assign the edge to itself. */
-    void add_edge(vertex_id_type source, vertex_id_type target,
-                  const EdgeData& edata) {
-      typedef typename base_type::edge_buffer_record edge_buffer_record;
-      const procid_t owning_proc = base_type::rpc.procid();
-      const edge_buffer_record record(source, target, edata);
-      base_type::edge_exchange.send(owning_proc, record);
-    } // end of add edge
+    /** Assign an edge to the loading machine itself. */
+    procid_t edge_to_proc(vertex_id_type source, vertex_id_type target) {
+      return base_type::rpc.procid();
+    } // end of edge to proc
   }; // end of distributed_identity_ingress
 }; // end of namespace graphlab
 #include <graphlab/macros_undef.hpp>
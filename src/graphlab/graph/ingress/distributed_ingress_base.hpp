@@ -26,6 +26,7 @@
 #include <boost/functional/hash.hpp>
 
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/graph/ingress/idistributed_ingress.hpp>
@@ -61,6 +62,13 @@ namespace graphlab {
     /// The underlying distributed graph object that is being loaded
     graph_type& graph;
 
+    /**
+     * The number of send buffers per machine in the exchanges. Threads
+     * adding edges concurrently use different buffers, picked by
+     * send_thread(), so the parallel loaders do not contend on a lock.
+     */
+    const size_t num_send_threads;
+
     /// Temporary buffers used to store vertex data on ingress
     struct vertex_buffer_record {
       vertex_id_type vid;
@@ -117,30 +125,100 @@ namespace graphlab {
 
   public:
     distributed_ingress_base(distributed_control& dc, graph_type& graph) :
-      rpc(dc, this), graph(graph), vertex_exchange(dc), edge_exchange(dc),
+      rpc(dc, this), graph(graph), num_send_threads(thread::cpu_count()),
+      vertex_exchange(dc, num_send_threads,
+                      exchange_buffer_size(num_send_threads)),
+      edge_exchange(dc, num_send_threads,
+                    exchange_buffer_size(num_send_threads)),
       edge_decision(dc) {
       rpc.barrier();
     } // end of constructor
 
     ~distributed_ingress_base() { }
 
+    /** \brief The exchange send buffers used by the calling thread. */
+    size_t send_thread() const {
+      return thread::thread_id() % num_send_threads;
+    }
+
+    /**
+     * \brief The size of each exchange send buffer, split from 1MB per
+     * machine so that the total buffered data does not grow with the
+     * number of threads.
+     */
+    static size_t exchange_buffer_size(size_t nthreads) {
+      return std::max<size_t>(64 * 1024, 1024 * 1024 / nthreads);
+    }
+
+    /** \brief Returns the machine an edge is sent to. */
+    virtual procid_t edge_to_proc(vertex_id_type source,
+                                  vertex_id_type target) {
+      return edge_decision.edge_to_proc_random(source, target, rpc.numprocs());
+    } // end of edge to proc
+
+
     /** \brief Add an edge to the ingress object. */
     virtual void add_edge(vertex_id_type source, vertex_id_type target,
                           const EdgeData& edata) {
-      const procid_t owning_proc = 
-        edge_decision.edge_to_proc_random(source, target, rpc.numprocs());
+      const procid_t owning_proc = edge_to_proc(source, target);
       const edge_buffer_record record(source, target, edata);
-      edge_exchange.send(owning_proc, record);
+      edge_exchange.send(owning_proc, record, send_thread());
     } // end of add edge
 
 
+    /** \brief Add many edges to the ingress object. */
+    virtual void add_edges(const std::vector<vertex_id_type>& source_arr,
+                           const std::vector<vertex_id_type>& target_arr,
+                           const std::vector<EdgeData>& edata_arr) {
+      send_edges(edge_exchange, source_arr, target_arr, edata_arr);
+    } // end of add edges
+
+
+  protected:
+    /**
+     * \brief Sends edges through the exchange, grouped by the machine
+     * edge_to_proc() returns, with one exchange send per machine.
+     */
+    void send_edges(buffered_exchange<edge_buffer_record>& exchange,
+                    const std::vector<vertex_id_type>& source_arr,
+                    const std::vector<vertex_id_type>& target_arr,
+                    const std::vector<EdgeData>& edata_arr) {
+      ASSERT_EQ(source_arr.size(), target_arr.size());
+      ASSERT_TRUE(edata_arr.empty() || edata_arr.size() == source_arr.size());
+      std::vector<std::vector<edge_buffer_record> > proc_records(rpc.numprocs());
+      for (size_t i = 0; i < source_arr.size(); ++i) {
+        const procid_t owning_proc = edge_to_proc(source_arr[i], target_arr[i]);
+        proc_records[owning_proc].push_back(
+            edge_buffer_record(source_arr[i], target_arr[i],
+                               edata_arr.empty() ? EdgeData() : edata_arr[i]));
+      }
+      const size_t thread = send_thread();
+      for (procid_t p = 0; p < rpc.numprocs(); ++p) {
+        if (proc_records[p].empty()) continue;
+        exchange.send(p, &(proc_records[p][0]), proc_records[p].size(),
+                      thread);
+      }
+    } // end of send edges
+
+  public:
+
     /** \brief Add an vertex to the ingress object. */
     virtual void add_vertex(vertex_id_type vid, const VertexData& vdata)  { 
       const procid_t owning_proc = vertex_to_proc(vid);
       const vertex_buffer_record record(vid, vdata);
-      vertex_exchange.send(owning_proc, record);
+      vertex_exchange.send(owning_proc, record, send_thread());
     } // end of add vertex
 
+
+    /**
+     * \brief Returns true if a vertex negotiated by this machine must
+     * be mastered by this machine. Otherwise finalize() picks the least
+     * loaded machine holding an edge of the vertex.
+     */
+    virtual bool master_on_negotiator(vertex_id_type vid) const {
+      return false;
+    }
+
     
     /** \brief Finalize completes the local graph data structure 
      * and the vertex record information. 
@@ -149,7 +227,8 @@ namespace graphlab {
      * The finalization goes through 5 steps:
      *
      * 1. Construct local graph using the received edges, during which
-     * the vid2lvid map is built.
+     * the vid2lvid map is built. If requested, the local vertex ids
+     * are then permuted for locality.
      *
      * 2. Construct lvid2record map (of empty entries) using the received vertices. 
      *
@@ -220,6 +299,9 @@ namespace graphlab {
       ASSERT_EQ(graph.vid2lvid.size(), graph.local_graph.num_vertices());
       logstream(LOG_INFO) << "Vid2lvid size: " << graph.vid2lvid.size() << "\t" << "Max lvid : " << graph.local_graph.maxlvid() << std::endl;
       ASSERT_EQ(graph.vid2lvid.size(), graph.local_graph.maxlvid() + 1);
+
+      // Relabel the local vertices before the CSR/CSC is constructed
+      if (graph.reorder_method != "none") reorder_local_vertices();
       
       // Finalize local graph
       logstream(LOG_INFO) << "Graph Finalize: finalizing local graph." 
@@ -310,7 +392,11 @@ namespace graphlab {
           vertex_negotiator_record& rec = pair.second;          
           // Determine the master
           procid_t master(-1);
-          if(rec.mirrors.popcount() == 0) {
+          if (master_on_negotiator(pair.first)) {
+            master = rpc.procid();
+            // the master is added like a singleton if it has no local edge
+            if (!rec.mirrors.get(master)) ++num_singletons;
+          } else if(rec.mirrors.popcount() == 0) {
             // // random assign a singleton vertex to a proc
             // const vertex_id_type vid = pair.first;
             // master = vid % rpc.numprocs();        
@@ -452,6 +538,36 @@ namespace graphlab {
     } // end of finalize
 
 
+    /* Permute the local vertex ids of the (not yet finalized) local
+     * graph using graph.reorder_method and update vid2lvid to match.
+     * Vertices without local edges are added later and keep trailing
+     * ids. */
+    void reorder_local_vertices() {
+      typedef typename cuckoo_map_pow2<vertex_id_type, lvid_type, 3, 
+                                       uint32_t>::value_type
+        vid2lvid_pair_type;
+      timer ti; ti.start();
+      std::vector<lvid_type> old2new;
+      const typename graph_type::local_graph_type::edge_info& edges = 
+        graph.local_graph.get_edge_info();
+      vertex_reordering::compute_permutation(graph.reorder_method,
+                                             graph.local_graph.num_vertices(),
+                                             edges.source_arr,
+                                             edges.target_arr,
+                                             old2new);
+      graph.local_graph.permute_vertices(old2new);
+      std::vector<std::pair<vertex_id_type, lvid_type> > relabeled;
+      relabeled.reserve(graph.vid2lvid.size());
+      foreach(const vid2lvid_pair_type& pair, graph.vid2lvid) 
+        relabeled.push_back(std::make_pair(pair.first, old2new[pair.second]));
+      for (size_t i = 0; i < relabeled.size(); ++i) 
+        graph.vid2lvid[relabeled[i].first] = relabeled[i].second;
+      logstream(LOG_INFO) << "Graph Finalize: " << graph.reorder_method
+                          << " vertex reordering in " << ti.current_time()
+                          << " secs" << std::endl;
+    } // end of reorder_local_vertices
+
+
     /* Exchange graph statistics among all nodes and compute
      * global statistics for the distributed graph. */
     void exchange_global_info () {
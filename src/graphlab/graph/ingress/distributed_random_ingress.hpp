@@ -60,14 +60,10 @@ namespace graphlab {
 
     ~distributed_random_ingress() { }
 
-    /** Add an edge to the ingress object using random assignment. */
-    void add_edge(vertex_id_type source, vertex_id_type target,
-                  const EdgeData& edata) {
-      typedef typename base_type::edge_buffer_record edge_buffer_record;
-      const procid_t owning_proc = base_type::edge_decision.edge_to_proc_random(source, target, base_type::rpc.numprocs());
-      const edge_buffer_record record(source, target, edata);
-      base_type::edge_exchange.send(owning_proc, record);
-    } // end of add edge
+    /** Assign an edge using random assignment. */
+    procid_t edge_to_proc(vertex_id_type source, vertex_id_type target) {
+      return base_type::edge_decision.edge_to_proc_random(source, target, base_type::rpc.numprocs());
+    } // end of edge to proc
   }; // end of distributed_random_ingress
 }; // end of namespace graphlab
 #include <graphlab/macros_undef.hpp>
@@ -44,6 +44,13 @@ namespace graphlab {
      */
     virtual void add_edge(vertex_id_type source, vertex_id_type target,
                           const EdgeData& edata) = 0;
+    /**
+     * Add the edges source_arr[i] -> target_arr[i] to the ingress object,
+     * with the data edata_arr[i], or EdgeData() if edata_arr is empty.
+     */
+    virtual void add_edges(const std::vector<vertex_id_type>& source_arr,
+                           const std::vector<vertex_id_type>& target_arr,
+                           const std::vector<EdgeData>& edata_arr) = 0;
     /**
      * Add an vertex to the ingress object.
      */
@@ -24,7 +24,7 @@
 
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
-#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/procid_set.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 
@@ -38,7 +38,7 @@ namespace graphlab {
     public:
       typedef graphlab::vertex_id_type vertex_id_type;
       typedef distributed_graph<VertexData, EdgeData> graph_type;
-      typedef fixed_dense_bitset<RPC_MAX_N_PROCS> bin_counts_type; 
+      typedef procid_set bin_counts_type; 
 
       boost::random::mt19937 gen;
       boost::random::uniform_int_distribution<> edgernd;
@@ -77,8 +77,8 @@ namespace graphlab {
 
 
       /** Greedy assign (source, target) to a machine using: 
-       *  bitset<MAX_MACHINE> src_degree : the degree presence of source over machines
-       *  bitset<MAX_MACHINE> dst_degree : the degree presence of target over machines
+       *  procid_set src_degree : the machines holding an edge of source
+       *  procid_set dst_degree : the machines holding an edge of target
        *  vector<size_t>      proc_num_edges : the edge counts over machines
        * */
       procid_t edge_to_proc_greedy (const vertex_id_type source, 
@@ -130,8 +130,8 @@ namespace graphlab {
       };
 
       /** Greedy assign (source, target) to a machine using: 
-       *  bitset<MAX_MACHINE> src_degree : the degree presence of source over machines
-       *  bitset<MAX_MACHINE> dst_degree : the degree presence of target over machines
+       *  procid_set src_degree : the machines holding an edge of source
+       *  procid_set dst_degree : the machines holding an edge of target
        *  vector<size_t>      proc_num_edges : the edge counts over machines
        * */
       procid_t edge_to_proc_greedy (const vertex_id_type source, 
@@ -283,6 +283,7 @@ class json_parser {
     ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.c2r_map.size());
     ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.CSR_dst.size());
     ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.CSC_src.size());
+    local_graph.gstore.compress_adjacency();
 
     graph.lvid2record.reserve(local_graph.gstore.num_vertices);
     graph.lvid2record.resize(local_graph.gstore.num_vertices);
@@ -183,6 +183,10 @@ namespace graphlab {
       size_t size() const { return elist.size(); }
       /// \brief Random access to the list elements. 
       edge_type operator[](size_t i) const {return me_functor(elist[i]);}
+      /// \brief Returns an iterator to the i'th edge of the list. Cheaper
+      /// than begin() + i on a compressed adjacency list.
+      iterator iterator_at(size_t i) const { return
+          boost::make_transform_iterator(elist.iterator_at(i), me_functor); }
       /// \brief Returns an iterator to the beginning of the list.
       iterator begin() const { return
           boost::make_transform_iterator(elist.begin(), me_functor); }
@@ -209,6 +213,15 @@ namespace graphlab {
 
     // METHODS =================================================================>
 
+    /**
+     * \brief Store the adjacency lists compressed. 
+     * See graph_storage::set_use_compression. Must be called before
+     * finalize.
+     */
+    void set_use_compression(bool x) {
+      gstore.set_use_compression(x);
+    }
+
     /**
      * \brief Resets the local_graph state.
      */
@@ -451,6 +464,21 @@ namespace graphlab {
           << finalized;
     } // end of save
     
+    /** \internal Writes the finalized local_graph to a mapped graph file */
+    void save_mapped(mapped_graph_writer& writer) const {
+      ASSERT_TRUE(finalized);
+      writer.add_vector(vertices);
+      gstore.save_mapped(writer);
+    } // end of save_mapped
+
+    /** \internal Reads the local_graph from a mapped graph file */
+    void load_mapped(mapped_graph_reader& reader) {
+      clear();
+      reader.read_vector(vertices);
+      gstore.load_mapped(reader);
+      finalized = true;
+    } // end of load_mapped
+
     /** swap two graphs */
     void swap(local_graph& other) {
       std::swap(vertices, other.vertices);
@@ -585,6 +613,34 @@ namespace graphlab {
     const std::vector<lvid_type>& get_in_edge_storage() const {
       return gstore.get_csc_src();
     }
+    /** \internal
+     * \brief Exposes the in edges of v as contiguous arrays. See
+     * graph_storage::in_edge_arrays.
+     */
+    bool in_edge_arrays(lvid_type v, const lvid_type*& nbr,
+                        const edge_id_type*& eid, size_t& size) const {
+      ASSERT_TRUE(finalized);
+      return gstore.in_edge_arrays(v, nbr, eid, size);
+    }
+
+    /** \internal
+     * \brief Exposes the out edges of v as contiguous arrays. See
+     * graph_storage::out_edge_arrays.
+     */
+    bool out_edge_arrays(lvid_type v, const lvid_type*& nbr,
+                         size_t& first_eid, size_t& size) const {
+      ASSERT_TRUE(finalized);
+      return gstore.out_edge_arrays(v, nbr, first_eid, size);
+    }
+
+    /** \internal
+     * \brief Returns a pointer to the edge data array stored in the
+     * internal local_graph storage.
+     */
+    EdgeData* edge_data_array() {
+      return gstore.edge_data_array();
+    }
+
     /** \internal
      * \brief Returns the reference of edge data list stored in the
      * internal local_graph storage.
@@ -608,7 +664,33 @@ namespace graphlab {
         return lvid_type(-1);
       }
     }
-   
+
+    /** \internal
+     * \brief Returns the temporary edge storage which holds the edges
+     * added since construction. Only meaningful before finalize().
+     */
+    const edge_info& get_edge_info() const {
+      return edges_tmp;
+    }
+
+    /** \internal
+     * \brief Relabels the vertices of a graph which has not yet been
+     * finalized such that vertex v becomes vertex old2new[v].
+     * old2new must be a permutation of the vertex ids.
+     */
+    void permute_vertices(const std::vector<lvid_type>& old2new) {
+      ASSERT_FALSE(finalized);
+      ASSERT_EQ(old2new.size(), vertices.size());
+      std::vector<VertexData> new_vertices(vertices.size());
+      for(size_t i = 0; i < vertices.size(); ++i)
+        new_vertices[old2new[i]] = vertices[i];
+      vertices.swap(new_vertices);
+      for(size_t i = 0; i < edges_tmp.size(); ++i) {
+        edges_tmp.source_arr[i] = old2new[edges_tmp.source_arr[i]];
+        edges_tmp.target_arr[i] = old2new[edges_tmp.target_arr[i]];
+      }
+    } // end of permute_vertices
+
   private:    
     /** Internal edge class  */   
 
@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_MAPPED_GRAPH_FILE_HPP
+#define GRAPHLAB_GRAPH_MAPPED_GRAPH_FILE_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <boost/type_traits/integral_constant.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief The first page of a file written by mapped_graph_writer.
+   *
+   * The file is a sequence of sections, each starting on a page
+   * boundary. A section holds either a raw array of a POD type, which
+   * the reader copies out of the mapped file in one piece, or an object
+   * in the graphlab serialization format.
+   */
+  struct mapped_graph_header {
+    static const size_t MAX_SECTIONS = 64;
+    char magic[8];
+    uint64_t version;
+    uint64_t num_sections;
+    /// the offset and length in bytes of each section
+    uint64_t offset[MAX_SECTIONS];
+    uint64_t length[MAX_SECTIONS];
+    /// the element size of an array section, or 0 for a serialized object
+    uint64_t element_size[MAX_SECTIONS];
+  };
+
+  /// \internal The alignment of the sections in a mapped graph file
+  static const size_t MAPPED_GRAPH_PAGE_SIZE = 4096;
+  /// \internal Identifies a mapped graph file
+  static const char MAPPED_GRAPH_MAGIC[8] = {'G', 'L', 'M', 'A',
+                                             'P', 'G', 'R', 'F'};
+  static const uint64_t MAPPED_GRAPH_VERSION = 1;
+
+
+  /**
+   * \internal
+   * \brief Writes the sections of a mapped graph file in order.
+   *
+   * The sections must be read by mapped_graph_reader in the order they
+   * were written.
+   */
+  class mapped_graph_writer {
+   public:
+    explicit mapped_graph_writer(const std::string& fname) :
+      fname(fname), fout(fname.c_str(),
+                         std::ios_base::out | std::ios_base::binary),
+      pos(MAPPED_GRAPH_PAGE_SIZE) {
+      if (!fout.good()) {
+        logstream(LOG_FATAL) << "\n\tError opening file: " << fname
+                             << std::endl;
+      }
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, MAPPED_GRAPH_MAGIC, sizeof(header.magic));
+      header.version = MAPPED_GRAPH_VERSION;
+      // the header page is written by close()
+      pad_to(pos);
+    }
+
+    ~mapped_graph_writer() {
+      if (fout.is_open()) close();
+    }
+
+    /// Writes an array section, raw if T is a POD type
+    template <typename T>
+    void add_vector(const std::vector<T>& vec) {
+      add_vector(vec, boost::integral_constant<bool, gl_is_pod<T>::value>());
+    }
+
+    /// Writes an object section with the graphlab serialization
+    template <typename T>
+    void add_object(const T& obj) {
+      std::stringstream strm;
+      oarchive oarc(strm);
+      oarc << obj;
+      strm.flush();
+      const std::string data = strm.str();
+      add_section(data.c_str(), data.length(), 0);
+    }
+
+    /// Writes the header. No sections may be added afterwards.
+    void close() {
+      fout.seekp(0);
+      fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      fout.close();
+      if (fout.fail()) {
+        logstream(LOG_FATAL) << "\n\tError writing file: " << fname
+                             << std::endl;
+      }
+    }
+
+   private:
+    std::string fname;
+    std::ofstream fout;
+    mapped_graph_header header;
+    size_t pos;
+
+    template <typename T>
+    void add_vector(const std::vector<T>& vec, boost::true_type) {
+      add_section(vec.empty() ? NULL : reinterpret_cast<const char*>(&vec[0]),
+                  vec.size() * sizeof(T), sizeof(T));
+    }
+
+    template <typename T>
+    void add_vector(const std::vector<T>& vec, boost::false_type) {
+      add_object(vec);
+    }
+
+    void add_section(const char* data, size_t len, size_t element_size) {
+      ASSERT_LT(header.num_sections, mapped_graph_header::MAX_SECTIONS);
+      const size_t i = header.num_sections++;
+      header.offset[i] = pos;
+      header.length[i] = len;
+      header.element_size[i] = element_size;
+      if (len > 0) fout.write(data, len);
+      pos += len;
+      pad_to((pos + MAPPED_GRAPH_PAGE_SIZE - 1) & ~(MAPPED_GRAPH_PAGE_SIZE - 1));
+    }
+
+    void pad_to(size_t newpos) {
+      static const char zeros[MAPPED_GRAPH_PAGE_SIZE] = {0};
+      const size_t current = fout.tellp();
+      if (newpos > current) fout.write(zeros, newpos - current);
+      pos = newpos;
+    }
+  }; // end of mapped_graph_writer
+
+
+  /**
+   * \internal
+   * \brief Maps a file written by mapped_graph_writer and reads its
+   * sections in order.
+   *
+   * The file is mapped shared and read only, so that machines and jobs
+   * loading the same file share its pages in the page cache. Array
+   * sections are copied out of the mapping with a single memcpy.
+   */
+  class mapped_graph_reader {
+   public:
+    explicit mapped_graph_reader(const std::string& fname) :
+      fname(fname), data(NULL), size(0), next_section(0) {
+      int fd = ::open(fname.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0) {
+        logstream(LOG_FATAL) << "\n\tError opening file: " << fname
+                             << std::endl;
+      }
+      size = st.st_size;
+      if (size >= sizeof(mapped_graph_header)) {
+        void* ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr != MAP_FAILED) {
+          data = reinterpret_cast<const char*>(ptr);
+          madvise(ptr, size, MADV_WILLNEED);
+        }
+      }
+      ::close(fd);
+      if (data == NULL || !is_mapped_graph(data, size)) {
+        logstream(LOG_FATAL) << "\n\tNot a mapped graph file: " << fname
+                             << std::endl;
+      }
+      memcpy(&header, data, sizeof(header));
+      if (header.version != MAPPED_GRAPH_VERSION ||
+          header.num_sections > mapped_graph_header::MAX_SECTIONS) {
+        logstream(LOG_FATAL) << "\n\tUnsupported mapped graph file: " << fname
+                             << std::endl;
+      }
+      for (size_t i = 0; i < header.num_sections; ++i) {
+        if (header.offset[i] + header.length[i] > size) {
+          logstream(LOG_FATAL) << "\n\tTruncated mapped graph file: " << fname
+                               << std::endl;
+        }
+      }
+    }
+
+    ~mapped_graph_reader() {
+      if (data != NULL) munmap(const_cast<char*>(data), size);
+    }
+
+    /// Returns true if the file was written by mapped_graph_writer
+    static bool is_mapped_graph_file(const std::string& fname) {
+      char magic[sizeof(MAPPED_GRAPH_MAGIC)];
+      std::ifstream fin(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+      fin.read(magic, sizeof(magic));
+      return fin.good() && is_mapped_graph(magic, sizeof(magic));
+    }
+
+    /// Reads an array section written by mapped_graph_writer::add_vector()
+    template <typename T>
+    void read_vector(std::vector<T>& vec) {
+      read_vector(vec, boost::integral_constant<bool, gl_is_pod<T>::value>());
+    }
+
+    /// Reads an object section written by mapped_graph_writer::add_object()
+    template <typename T>
+    void read_object(T& obj) {
+      const size_t i = section(0);
+      boost::iostreams::stream<boost::iostreams::array_source>
+        strm(data + header.offset[i], header.length[i]);
+      iarchive iarc(strm);
+      iarc >> obj;
+    }
+
+   private:
+    std::string fname;
+    const char* data;
+    size_t size;
+    mapped_graph_header header;
+    size_t next_section;
+
+    static bool is_mapped_graph(const char* data, size_t len) {
+      return len >= sizeof(MAPPED_GRAPH_MAGIC) &&
+        memcmp(data, MAPPED_GRAPH_MAGIC, sizeof(MAPPED_GRAPH_MAGIC)) == 0;
+    }
+
+    /// Returns the next section, checking its element size
+    size_t section(size_t element_size) {
+      if (next_section >= header.num_sections ||
+          header.element_size[next_section] != element_size) {
+        logstream(LOG_FATAL)
+          << "\n\tMapped graph file " << fname << " does not match the "
+          << "graph type. Section " << next_section << " was expected to "
+          << "have elements of " << element_size << " bytes." << std::endl;
+      }
+      return next_section++;
+    }
+
+    template <typename T>
+    void read_vector(std::vector<T>& vec, boost::true_type) {
+      const size_t i = section(sizeof(T));
+      const T* begin = reinterpret_cast<const T*>(data + header.offset[i]);
+      vec.assign(begin, begin + header.length[i] / sizeof(T));
+    }
+
+    template <typename T>
+    void read_vector(std::vector<T>& vec, boost::false_type) {
+      read_object(vec);
+    }
+  }; // end of mapped_graph_reader
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * \file vertex_reordering.hpp
+ *
+ * Computes permutations of the local vertex ids of a graph which
+ * place neighboring vertices close together. The permutations are
+ * computed from the temporary source/target edge arrays before the
+ * CSR/CSC structure is built so that finalize lays out the graph in
+ * the new order.
+ */
+
+#ifndef GRAPHLAB_VERTEX_REORDERING_HPP
+#define GRAPHLAB_VERTEX_REORDERING_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  namespace vertex_reordering {
+
+    /** \internal Orders vertex ids by a degree array */
+    struct degree_less {
+      const std::vector<size_t>& degree;
+      degree_less(const std::vector<size_t>& degree) : degree(degree) { }
+      bool operator()(lvid_type a, lvid_type b) const {
+        return degree[a] < degree[b];
+      }
+    };
+
+    /** \internal Orders vertex ids by decreasing degree */
+    struct degree_greater {
+      const std::vector<size_t>& degree;
+      degree_greater(const std::vector<size_t>& degree) : degree(degree) { }
+      bool operator()(lvid_type a, lvid_type b) const {
+        return degree[a] > degree[b];
+      }
+    };
+
+    /**
+     * \brief Computes the total (in + out) degree of every vertex.
+     */
+    inline void compute_degrees(size_t nverts,
+                                const std::vector<lvid_type>& source_arr,
+                                const std::vector<lvid_type>& target_arr,
+                                std::vector<size_t>& degree) {
+      degree.assign(nverts, 0);
+      for (size_t i = 0; i < source_arr.size(); ++i) {
+        ++degree[source_arr[i]];
+        ++degree[target_arr[i]];
+      }
+    } // end of compute_degrees
+
+    /**
+     * \brief Orders the vertices by decreasing degree. Vertices of
+     * equal degree keep their original relative order.
+     *
+     * \param [out] order order[i] is the old id of the vertex placed at i.
+     */
+    inline void degree_order(size_t nverts,
+                             const std::vector<lvid_type>& source_arr,
+                             const std::vector<lvid_type>& target_arr,
+                             std::vector<lvid_type>& order) {
+      std::vector<size_t> degree;
+      compute_degrees(nverts, source_arr, target_arr, degree);
+      order.resize(nverts);
+      for (size_t i = 0; i < nverts; ++i) order[i] = i;
+      std::stable_sort(order.begin(), order.end(), degree_greater(degree));
+    } // end of degree_order
+
+    /**
+     * \brief Groups the hub vertices (degree above the average) at
+     * the front, keeping the original relative order within the hubs
+     * and within the remaining vertices.
+     *
+     * \param [out] order order[i] is the old id of the vertex placed at i.
+     */
+    inline void hub_cluster_order(size_t nverts,
+                                  const std::vector<lvid_type>& source_arr,
+                                  const std::vector<lvid_type>& target_arr,
+                                  std::vector<lvid_type>& order) {
+      std::vector<size_t> degree;
+      compute_degrees(nverts, source_arr, target_arr, degree);
+      const double avg_degree =
+        nverts == 0 ? 0 : 2.0 * source_arr.size() / nverts;
+      order.clear(); order.reserve(nverts);
+      for (size_t i = 0; i < nverts; ++i)
+        if (degree[i] > avg_degree) order.push_back(i);
+      for (size_t i = 0; i < nverts; ++i)
+        if (degree[i] <= avg_degree) order.push_back(i);
+    } // end of hub_cluster_order
+
+    /**
+     * \brief Reverse Cuthill-McKee ordering of the undirected version
+     * of the graph. Every connected component is traversed breadth
+     * first starting from its lowest degree vertex, visiting
+     * neighbors in increasing degree order.
+     *
+     * Temporarily builds an undirected adjacency list and therefore
+     * requires 2|E| additional vertex ids of memory.
+     *
+     * \param [out] order order[i] is the old id of the vertex placed at i.
+     */
+    inline void rcm_order(size_t nverts,
+                          const std::vector<lvid_type>& source_arr,
+                          const std::vector<lvid_type>& target_arr,
+                          std::vector<lvid_type>& order) {
+      std::vector<size_t> degree;
+      compute_degrees(nverts, source_arr, target_arr, degree);
+      // Build the undirected adjacency lists
+      std::vector<size_t> adj_begin(nverts + 1, 0);
+      for (size_t i = 0; i < nverts; ++i)
+        adj_begin[i + 1] = adj_begin[i] + degree[i];
+      std::vector<lvid_type> adj(adj_begin[nverts]);
+      {
+        std::vector<size_t> fill(adj_begin.begin(), adj_begin.end() - 1);
+        for (size_t i = 0; i < source_arr.size(); ++i) {
+          adj[fill[source_arr[i]]++] = target_arr[i];
+          adj[fill[target_arr[i]]++] = source_arr[i];
+        }
+      }
+      // Seed the traversal of each component from the lowest degree vertex
+      std::vector<lvid_type> seeds(nverts);
+      for (size_t i = 0; i < nverts; ++i) seeds[i] = i;
+      std::stable_sort(seeds.begin(), seeds.end(), degree_less(degree));
+
+      std::vector<bool> visited(nverts, false);
+      order.clear(); order.reserve(nverts);
+      foreach(lvid_type seed, seeds) {
+        if (visited[seed]) continue;
+        visited[seed] = true;
+        size_t head = order.size();
+        order.push_back(seed);
+        // order doubles as the breadth first queue
+        while (head < order.size()) {
+          const lvid_type v = order[head++];
+          const size_t frontier_begin = order.size();
+          for (size_t j = adj_begin[v]; j < adj_begin[v + 1]; ++j) {
+            const lvid_type u = adj[j];
+            if (!visited[u]) { visited[u] = true; order.push_back(u); }
+          }
+          std::stable_sort(order.begin() + frontier_begin, order.end(),
+                           degree_less(degree));
+        }
+      }
+      std::reverse(order.begin(), order.end());
+    } // end of rcm_order
+
+    /**
+     * \brief Returns true if the method names a valid reordering.
+     */
+    inline bool is_valid_method(const std::string& method) {
+      return method == "none" || method == "degree" ||
+        method == "rcm" || method == "hub_cluster";
+    }
+
+    /**
+     * \brief Computes the permutation of the vertex ids for the given
+     * reordering method.
+     *
+     * \param [in] method One of "degree", "rcm" or "hub_cluster".
+     * \param [out] old2new old2new[v] is the new id of vertex v.
+     */
+    inline void compute_permutation(const std::string& method,
+                                    size_t nverts,
+                                    const std::vector<lvid_type>& source_arr,
+                                    const std::vector<lvid_type>& target_arr,
+                                    std::vector<lvid_type>& old2new) {
+      ASSERT_EQ(source_arr.size(), target_arr.size());
+      std::vector<lvid_type> order;
+      if (method == "degree") {
+        degree_order(nverts, source_arr, target_arr, order);
+      } else if (method == "rcm") {
+        rcm_order(nverts, source_arr, target_arr, order);
+      } else if (method == "hub_cluster") {
+        hub_cluster_order(nverts, source_arr, target_arr, order);
+      } else {
+        logstream(LOG_FATAL) << "Unknown vertex reordering: " << method
+                             << std::endl;
+      }
+      ASSERT_EQ(order.size(), nverts);
+      old2new.resize(nverts);
+      for (size_t i = 0; i < nverts; ++i) old2new[order[i]] = i;
+    } // end of compute_permutation
+
+  } // end of namespace vertex_reordering
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_CHASE_LEV_DEQUE_HPP
+#define GRAPHLAB_PARALLEL_CHASE_LEV_DEQUE_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A lock free work stealing deque (Chase and Lev, "Dynamic Circular
+   * Work-Stealing Deque", SPAA 2005).
+   *
+   * One thread, the owner, pushes and pops elements at the bottom of
+   * the deque. Any number of other threads may concurrently steal
+   * elements from the top. T must be a small POD type which can be
+   * read and written atomically (such as an integer or a pointer).
+   *
+   * The circular buffer grows on demand. Buffers which were replaced
+   * are only freed on destruction since a stealer may still be reading
+   * from them.
+   */
+  template <typename T>
+  class chase_lev_deque {
+  public:
+    /// The possible results of steal()
+    enum steal_status {
+      STEAL_SUCCESS, ///< An element was stolen
+      STEAL_EMPTY,   ///< The deque was empty
+      STEAL_ABORT    ///< Lost a race with another thread. Try again.
+    };
+
+  private:
+    struct circular_array {
+      int64_t mask;
+      T* data;
+      circular_array(int64_t size) : mask(size - 1), data(new T[size]) { }
+      ~circular_array() { delete [] data; }
+      int64_t size() const { return mask + 1; }
+      T get(int64_t i) const { return data[i & mask]; }
+      void put(int64_t i, const T& value) { data[i & mask] = value; }
+    };
+
+    volatile int64_t top;
+    volatile int64_t bottom;
+    circular_array* volatile array;
+    // replaced buffers, owned by the owner thread
+    std::vector<circular_array*> retired;
+
+    /** Not copyable */
+    chase_lev_deque(const chase_lev_deque&);
+    void operator=(const chase_lev_deque&);
+
+    /** Doubles the buffer, copying the elements in [t, b) */
+    circular_array* grow(circular_array* a, int64_t t, int64_t b) {
+      circular_array* newarray = new circular_array(2 * a->size());
+      for (int64_t i = t; i < b; ++i) newarray->put(i, a->get(i));
+      retired.push_back(a);
+      __sync_synchronize();
+      array = newarray;
+      return newarray;
+    }
+
+  public:
+    /**
+     * Constructs an empty deque. The initial capacity is rounded up
+     * to a power of two.
+     */
+    explicit chase_lev_deque(size_t initial_capacity = 64) :
+      top(0), bottom(0) {
+      int64_t size = 2;
+      while (size < (int64_t)initial_capacity) size *= 2;
+      array = new circular_array(size);
+    }
+
+    ~chase_lev_deque() {
+      delete array;
+      for (size_t i = 0; i < retired.size(); ++i) delete retired[i];
+    }
+
+    /** Pushes an element to the bottom. Owner only. */
+    void push(const T& value) {
+      const int64_t b = bottom;
+      const int64_t t = top;
+      circular_array* a = array;
+      if (b - t >= a->size() - 1) a = grow(a, t, b);
+      a->put(b, value);
+      // the element must be visible before the new bottom
+      __sync_synchronize();
+      bottom = b + 1;
+    }
+
+    /**
+     * Pops an element from the bottom. Owner only.
+     * Returns false if the deque is empty.
+     */
+    bool pop(T& ret) {
+      const int64_t b = bottom - 1;
+      circular_array* a = array;
+      bottom = b;
+      // the new bottom must be visible before top is read
+      __sync_synchronize();
+      const int64_t t = top;
+      if (t > b) {
+        bottom = t;
+        return false;
+      }
+      ret = a->get(b);
+      if (t == b) {
+        // last element. race the stealers for it
+        const bool success = atomic_compare_and_swap(top, t, t + 1);
+        bottom = t + 1;
+        return success;
+      }
+      return true;
+    }
+
+    /** Steals an element from the top. May be called by any thread. */
+    steal_status steal(T& ret) {
+      const int64_t t = top;
+      __sync_synchronize();
+      const int64_t b = bottom;
+      if (t >= b) return STEAL_EMPTY;
+      circular_array* a = array;
+      ret = a->get(t);
+      if (!atomic_compare_and_swap(top, t, t + 1)) return STEAL_ABORT;
+      return STEAL_SUCCESS;
+    }
+
+    /** Returns true if the deque is empty. Only a hint if called
+     * concurrently with other operations. */
+    bool empty() const {
+      return bottom <= top;
+    }
+
+    /** Returns the number of elements. Only a hint if called
+     * concurrently with other operations. */
+    size_t size() const {
+      const int64_t n = bottom - top;
+      return n < 0 ? 0 : (size_t)n;
+    }
+  }; // end of chase_lev_deque
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * \file numa.hpp
+ *
+ * Discovers the NUMA nodes of the machine from
+ * /sys/devices/system/node and binds threads to the cpus of a node.
+ * Memory is placed with the default first-touch policy of the kernel:
+ * a page is allocated on the node of the thread which first writes
+ * it. No NUMA library is required. If the topology cannot be read the
+ * machine is treated as a single node.
+ */
+
+#ifndef GRAPHLAB_PARALLEL_NUMA_HPP
+#define GRAPHLAB_PARALLEL_NUMA_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+  namespace numa {
+
+    /** \internal Parses a cpu list such as "0-7,16-23" */
+    inline std::vector<size_t> parse_cpu_list(const std::string& str) {
+      std::vector<size_t> cpus;
+      std::stringstream strm(str);
+      std::string range;
+      while (std::getline(strm, range, ',')) {
+        if (range.empty() || range[0] < '0' || range[0] > '9') continue;
+        const size_t dash = range.find('-');
+        const size_t first = atol(range.substr(0, dash).c_str());
+        const size_t last = dash == std::string::npos ?
+          first : atol(range.substr(dash + 1).c_str());
+        for (size_t c = first; c <= last; ++c) cpus.push_back(c);
+      }
+      return cpus;
+    }
+
+    /**
+     * \brief Returns the cpus of every NUMA node. Nodes without cpus
+     * are skipped. Read once and cached.
+     */
+    inline const std::vector<std::vector<size_t> >& node_cpus() {
+      static std::vector<std::vector<size_t> > nodes;
+      static bool initialized = false;
+      if (!initialized) {
+        // node ids may have holes. stop after a run of missing nodes
+        for (size_t node = 0, missing = 0; missing < 64; ++node) {
+          std::stringstream fname;
+          fname << "/sys/devices/system/node/node" << node << "/cpulist";
+          std::ifstream fin(fname.str().c_str());
+          std::string line;
+          if (!fin.good() || !std::getline(fin, line)) {
+            ++missing;
+            continue;
+          }
+          missing = 0;
+          std::vector<size_t> cpus = parse_cpu_list(line);
+          if (!cpus.empty()) nodes.push_back(cpus);
+        }
+        initialized = true;
+      }
+      return nodes;
+    }
+
+    /** \brief Returns the number of NUMA nodes (at least 1) */
+    inline size_t num_nodes() {
+      return std::max(node_cpus().size(), size_t(1));
+    }
+
+    /**
+     * \brief Restricts the calling thread to the cpus of a node.
+     * Returns false if thread affinity is not supported.
+     */
+    inline bool bind_current_thread(size_t node) {
+#ifdef HAS_NUMA_AFFINITY
+      if (node >= node_cpus().size()) return false;
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      const std::vector<size_t>& cpus = node_cpus()[node];
+      for (size_t i = 0; i < cpus.size(); ++i) {
+        CPU_SET(cpus[i] % CPU_SETSIZE, &cpu_set);
+      }
+      return pthread_setaffinity_np(pthread_self(),
+                                    sizeof(cpu_set), &cpu_set) == 0;
+#else
+      return false;
+#endif
+    }
+
+    /**
+     * \brief Binds the calling thread to a node for the lifetime of
+     * the object and restores the previous affinity afterwards.
+     */
+    class scoped_node_binding {
+#ifdef HAS_NUMA_AFFINITY
+      cpu_set_t saved;
+      bool restore;
+    public:
+      explicit scoped_node_binding(size_t node) {
+        restore = pthread_getaffinity_np(pthread_self(),
+                                         sizeof(saved), &saved) == 0 &&
+          bind_current_thread(node);
+      }
+      ~scoped_node_binding() {
+        if (restore) {
+          pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+        }
+      }
+#else
+    public:
+      explicit scoped_node_binding(size_t node) { }
+#endif
+    }; // end of scoped_node_binding
+
+  } // end of namespace numa
+
+} // end of namespace graphlab
+
+#endif
@@ -24,9 +24,14 @@
 #ifndef GRAPHLAB_BUFFERED_EXCHANGE_HPP
 #define GRAPHLAB_BUFFERED_EXCHANGE_HPP
 
+#include <time.h>
+#include <algorithm>
+#include <boost/function.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_compile_parameters.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/dc_recv_buffer.hpp>
 #include <graphlab/util/mpi_tools.hpp>
 
 
@@ -36,16 +41,117 @@ namespace graphlab {
   /**
    * \ingroup rpc
    * \internal
+   * Sends values to other machines in buffers, one per sending thread
+   * and destination. A buffer is sent when it reaches max_buffer_size
+   * bytes, and on partial_flush() and flush().
+   *
+   * With set_adaptive(), the size at which the buffers to a machine
+   * are sent follows the rate of the values sent to that machine and
+   * the round trip time to it: a buffer is sent when it holds as many
+   * bytes as are sent in one deadline of two round trip times (at
+   * least RPC_EXCHANGE_MIN_DEADLINE_US), within
+   * [RPC_EXCHANGE_MIN_BUFFER_SIZE, max_buffer_size]. A buffer held
+   * for longer than one deadline is also sent by the next send() to it,
+   * whatever the number of values in it. Busy machines therefore get
+   * large buffers, and lightly used ones low latency. Each sending
+   * thread reads the clock on every 32nd send, so the deadline is
+   * checked against a time at most 32 sends of the thread old. Values
+   * which are not followed by another send() wait for partial_flush()
+   * or flush(). The round trip time is measured by having the
+   * receiver acknowledge one buffer per round trip.
+   *
+   * get_stats() returns the buffer sizes, the measurements and the
+   * reasons the buffers were sent, per destination.
    */
   template<typename T>
   class buffered_exchange {
   public:
     typedef std::vector<T> buffer_type;
 
+    /// Why a buffer was sent
+    enum flush_reason {
+      FLUSH_SIZE,      ///< the buffer was full
+      FLUSH_DEADLINE,  ///< the buffer was held for longer than the deadline
+      FLUSH_EXPLICIT,  ///< partial_flush() or flush()
+      NUM_FLUSH_REASONS
+    };
+
+    /// The sending statistics of one destination machine
+    struct peer_stats {
+      /// the size at which buffers are sent
+      size_t buffer_size;
+      /// the smoothed round trip time. 0 if not measured
+      double rtt_us;
+      /// the smoothed rate of the values sent. 0 if not measured
+      double bytes_per_second;
+      size_t buffers_sent;
+      size_t bytes_sent;
+      /// the number of buffers sent for each flush_reason
+      size_t flushes[NUM_FLUSH_REASONS];
+
+      /// the average number of bytes in the buffers sent
+      double average_buffer_bytes() const {
+        return buffers_sent == 0 ? 0.0 : double(bytes_sent) / buffers_sent;
+      }
+    };
+
+    /**
+     * The serialized values of one received buffer. The values are
+     * deserialized one at a time while iterating, straight from the
+     * received RPC buffer, so a view avoids building a buffer_type.
+     */
+    class view_type {
+    public:
+      view_type() : numel(0) { }
+
+      /// The number of values
+      size_t size() const { return numel; }
+
+      struct iterator {
+        typedef std::input_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T& reference;
+        typedef const T* pointer;
+        iarchive iarc;
+        size_t remaining;
+        T value;
+        iterator(const char* buf, size_t len, size_t numel) :
+          iarc(buf, len), remaining(numel) {
+          if (remaining > 0) iarc >> value;
+        }
+        const T& operator*() const { return value; }
+        const T* operator->() const { return &value; }
+        iterator& operator++() {
+          if (--remaining > 0) iarc >> value;
+          return *this;
+        }
+        bool operator==(const iterator& other) const {
+          return remaining == other.remaining;
+        }
+        bool operator!=(const iterator& other) const {
+          return remaining != other.remaining;
+        }
+      };
+      typedef iterator const_iterator;
+
+      iterator begin() const {
+        return iterator(data.data(), data.size(), numel);
+      }
+      iterator end() const {
+        return iterator(NULL, 0, 0);
+      }
+
+    private:
+      dc_impl::recv_view data;
+      size_t numel;
+      friend class buffered_exchange;
+    }; // end of view_type
+
   private:
     struct buffer_record {
       procid_t proc;
-      buffer_type buffer;
+      view_type view;
       buffer_record() : proc(-1)  { }
     }; // end of buffer record
 
@@ -61,12 +167,48 @@ namespace graphlab {
     struct send_record {
       oarchive* oarc;
       size_t numinserts;
+      /// when the first value was written, if adaptive
+      size_t start_us;
     };
 
     std::vector<send_record> send_buffers;
     std::vector< mutex >  send_locks;
     const size_t num_threads;
-    const size_t max_buffer_size;
+    size_t max_buffer_size;
+
+    /// The state of the adaptive policy for one destination
+    struct peer_state {
+      mutex lock;
+      peer_stats stats;
+      size_t deadline_us;
+      size_t window_start_us;
+      size_t window_bytes;
+      /// whether a buffer waits to be acknowledged
+      bool sample_outstanding;
+    };
+    std::vector<peer_state> peers;
+    bool adaptive;
+
+    /// The number of stamped buffers not yet acknowledged
+    atomic<size_t> acks_outstanding;
+    /// Signalled by rpc_ack when acks_outstanding drops
+    mutex ack_lock;
+    conditional ack_cond;
+
+    /// The time last read by a sending thread and its sends since. A
+    /// thread id used by several threads only makes the time less fresh
+    struct thread_clock {
+      volatile size_t sends;
+      volatile size_t time_us;
+      char pad[64 - 2 * sizeof(size_t)];
+    };
+    std::vector<thread_clock> thread_clocks;
+
+    /// where the send time is written in a buffer acknowledged by the receiver
+    const size_t stamp_offset;
+
+    /// Called after each buffer is received. See set_recv_notify()
+    boost::function<void()> recv_notify;
 
 
     // typedef boost::function<void (const T& tref)> handler_type;
@@ -80,20 +222,56 @@ namespace graphlab {
       send_buffers(num_threads *  dc.numprocs()),
       send_locks(num_threads *  dc.numprocs()),
       num_threads(num_threads),
-      max_buffer_size(max_buffer_size) {
+      max_buffer_size(max_buffer_size),
+      peers(dc.numprocs()), adaptive(false),
+      thread_clocks(num_threads), stamp_offset(compute_stamp_offset()) {
        //
        for (size_t i = 0;i < send_buffers.size(); ++i) {
          // initialize the split call
          send_buffers[i].oarc = rpc.split_call_begin(&buffered_exchange::rpc_recv);
          send_buffers[i].numinserts = 0;
-         // begin by writing the src proc.
-         (*(send_buffers[i].oarc)) << rpc.procid();
+         send_buffers[i].start_us = 0;
+         write_buffer_header(send_buffers[i].oarc);
+       }
+       for (size_t i = 0;i < peers.size(); ++i) {
+         peer_stats& stats = peers[i].stats;
+         stats.buffer_size = max_buffer_size;
+         stats.rtt_us = 0;
+         stats.bytes_per_second = 0;
+         stats.buffers_sent = 0;
+         stats.bytes_sent = 0;
+         std::fill(stats.flushes, stats.flushes + NUM_FLUSH_REASONS, 0);
+         peers[i].deadline_us = RPC_EXCHANGE_MIN_DEADLINE_US;
+         peers[i].window_start_us = 0;
+         peers[i].window_bytes = 0;
+         peers[i].sample_outstanding = false;
+       }
+       for (size_t i = 0;i < thread_clocks.size(); ++i) {
+         thread_clocks[i].sends = 0;
+         thread_clocks[i].time_us = 0;
        }
        rpc.barrier();
       }
 
 
+    /**
+     * Must be called by all machines. Waits until every buffer sent by
+     * any machine is received and every acknowledgement has arrived, so
+     * that no call reaches the exchange after it is destroyed.
+     */
     ~buffered_exchange() {
+      // all the buffers sent are received, and the stamped ones
+      // acknowledged by their receiver
+      rpc.full_barrier();
+      // but the acknowledgements are control calls, which the barrier
+      // does not wait for
+      ack_lock.lock();
+      while (acks_outstanding.value > 0) ack_cond.wait(ack_lock);
+      ack_lock.unlock();
+      // nor may another machine go on to create the next object before
+      // every acknowledgement arrived: calls to an object not yet
+      // created hold up the handler thread the acknowledgement needs
+      rpc.barrier();
       // clear the send buffers
       for (size_t i = 0;i < send_buffers.size(); ++i) {
         rpc.split_call_cancel(send_buffers[i].oarc);
@@ -105,24 +283,92 @@ namespace graphlab {
     // max_buffer_size(buffer_size), recv_handler(recv_handler) { rpc.barrier(); }
 
 
+    /**
+     * Enables or disables the adaptive buffer sizes. A non-zero
+     * max_size replaces the max_buffer_size given to the constructor.
+     * Must not be called while sending.
+     */
+    void set_adaptive(bool enable, size_t max_size = 0) {
+      adaptive = enable;
+      if (max_size > 0) max_buffer_size = max_size;
+      for (size_t i = 0;i < peers.size(); ++i) {
+        peers[i].stats.buffer_size = enable ? 
+          std::min<size_t>(RPC_EXCHANGE_MIN_BUFFER_SIZE, max_buffer_size) :
+          max_buffer_size;
+      }
+    }
+
+    bool adaptive_enabled() const {
+      return adaptive;
+    }
+
+    /**
+     * Sets a function called by the RPC handler after each buffer is
+     * received, for instance to wake a thread waiting for something to
+     * recv(). Must not be called while receiving.
+     */
+    void set_recv_notify(const boost::function<void()>& notify) {
+      recv_notify = notify;
+    }
+
+    /// Returns the sending statistics of each destination machine
+    std::vector<peer_stats> get_stats() const {
+      std::vector<peer_stats> ret(peers.size());
+      for (size_t i = 0;i < peers.size(); ++i) {
+        peer_state& peer = const_cast<peer_state&>(peers[i]);
+        peer.lock.lock();
+        ret[i] = peer.stats;
+        peer.lock.unlock();
+      }
+      return ret;
+    }
+
     void send(const procid_t proc, const T& value, const size_t thread_id = 0) {
+      send(proc, &value, 1, thread_id);
+    } // end of send
+
+
+    /**
+     * Sends values[0], ..., values[n - 1] to proc, taking the send lock
+     * once. Buffers are sent whenever they fill, as with n calls to
+     * send(), but the deadline is only checked after the last value.
+     */
+    void send(const procid_t proc, const T* values, const size_t n,
+              const size_t thread_id = 0) {
       ASSERT_LT(proc, rpc.numprocs());
       ASSERT_LT(thread_id, num_threads);
       const size_t index = thread_id * rpc.numprocs() + proc;
       ASSERT_LT(index, send_locks.size());
       send_locks[index].lock();
+      for (size_t i = 0; i < n; ++i) {
+        send_record& rec = send_buffers[index];
+        if (adaptive && rec.numinserts == 0) {
+          rec.start_us = now_us();
+          thread_clocks[thread_id].time_us = rec.start_us;
+        }
 
-      (*(send_buffers[index].oarc)) << value;
-      ++send_buffers[index].numinserts;
+        (*(rec.oarc)) << values[i];
+        ++rec.numinserts;
 
-      if(send_buffers[index].oarc->off >= max_buffer_size) {
-        oarchive* prevarc = swap_buffer(index);
-        send_locks[index].unlock();
-        // complete the send
-        rpc.split_call_end(proc, prevarc);
-      } else {
-        send_locks[index].unlock();
+        flush_reason reason = NUM_FLUSH_REASONS;
+        if(rec.oarc->off >= peers[proc].stats.buffer_size) {
+          reason = FLUSH_SIZE;
+        } else if (adaptive && i + 1 == n && rec.numinserts > 1 &&
+                   thread_now_us(thread_id) >=
+                   rec.start_us + peers[proc].deadline_us) {
+          reason = FLUSH_DEADLINE;
+        }
+        if (reason != NUM_FLUSH_REASONS) {
+          bool urgent = false;
+          oarchive* prevarc = swap_buffer(index, reason, urgent);
+          send_locks[index].unlock();
+          // complete the send
+          rpc.split_call_end(proc, prevarc);
+          if (urgent) rpc.dc().flush(proc);
+          send_locks[index].lock();
+        }
       }
+      send_locks[index].unlock();
     } // end of send
 
 
@@ -131,11 +377,13 @@ namespace graphlab {
         const size_t index = thread_id * rpc.numprocs() + proc;
         ASSERT_LT(proc, rpc.numprocs());
         if (send_buffers[index].numinserts > 0) {
+          bool urgent = false;
           send_locks[index].lock();
-          oarchive* prevarc = swap_buffer(index);
+          oarchive* prevarc = swap_buffer(index, FLUSH_EXPLICIT, urgent);
           send_locks[index].unlock();
           // complete the send
           rpc.split_call_end(proc, prevarc);
+          if (urgent) rpc.dc().flush(proc);
         }
       }
     }
@@ -146,7 +394,8 @@ namespace graphlab {
         ASSERT_LT(proc, rpc.numprocs());
         send_locks[i].lock();
         if (send_buffers[i].numinserts > 0) {
-          oarchive* prevarc = swap_buffer(i);
+          bool urgent = false;
+          oarchive* prevarc = swap_buffer(i, FLUSH_EXPLICIT, urgent);
           // complete the send
           rpc.split_call_end(proc, prevarc);
         }
@@ -156,9 +405,29 @@ namespace graphlab {
     } // end of flush
 
 
+    /**
+     * Receives one buffer, deserializing it into ret_buffer. Returns
+     * false if there is nothing to receive.
+     */
     bool recv(procid_t& ret_proc, buffer_type& ret_buffer,
               const bool try_lock = false) {
-      dc_impl::blob read_buffer;
+      view_type view;
+      if (!recv(ret_proc, view, try_lock)) return false;
+      ret_buffer.resize(view.size());
+      iarchive iarc(view.data.data(), view.data.size());
+      for (size_t i = 0;i < ret_buffer.size(); ++i) {
+        iarc >> ret_buffer[i];
+      }
+      return true;
+    } // end of recv
+
+
+    /**
+     * Receives one buffer as a view of the received data, which is not
+     * copied. Returns false if there is nothing to receive.
+     */
+    bool recv(procid_t& ret_proc, view_type& ret_view,
+              const bool try_lock = false) {
       bool has_lock = false;
       if(try_lock) {
         if (recv_buffers.empty()) return false;
@@ -174,7 +443,7 @@ namespace graphlab {
           buffer_record& rec =  recv_buffers.front();
           // read the record
           ret_proc = rec.proc;
-          ret_buffer.swap(rec.buffer);
+          ret_view = rec.view;
           ASSERT_LT(ret_proc, rpc.numprocs());
           recv_buffers.pop_front();
         }
@@ -194,7 +463,7 @@ namespace graphlab {
       recv_lock.lock();
       size_t count = 0;
       foreach(const buffer_record& rec, recv_buffers) {
-        count += rec.buffer.size();
+        count += rec.view.size();
       }
       recv_lock.unlock();
       return count;
@@ -205,44 +474,153 @@ namespace graphlab {
     void clear() { }
   private:
     void rpc_recv(size_t len, wild_pointer w) {
-      buffer_type tmp;
       iarchive iarc(reinterpret_cast<const char*>(w.ptr), len);
       // first desrialize the source process
       procid_t src_proc; iarc >> src_proc;
       ASSERT_LT(src_proc, rpc.numprocs());
+      size_t stamp; iarc >> stamp;
+      if (stamp != 0) {
+        rpc.control_call(src_proc, &buffered_exchange::rpc_ack,
+                         rpc.procid(), stamp);
+      }
       // create an iarchive which just points to the last size_t bytes
       // to get the number of elements
       iarchive numel_iarc(reinterpret_cast<const char*>(w.ptr) + len - sizeof(size_t),
                           sizeof(size_t));
       size_t numel; numel_iarc >> numel;
       //std::cout << "Receiving: " << numel << "\n";
-      tmp.resize(numel);
-      for (size_t i = 0;i < numel; ++i) {
-        iarc >> tmp[i];
-      }
+      // keep the values in the received buffer. They are deserialized
+      // by the receiver
+      view_type view;
+      view.data.assign(iarc.buf + iarc.off, len - iarc.off - sizeof(size_t));
+      view.numel = numel;
 
       recv_lock.lock();
       recv_buffers.push_back(buffer_record());
       buffer_record& rec = recv_buffers.back();
       rec.proc = src_proc;
-      rec.buffer.swap(tmp);
+      rec.view = view;
       recv_lock.unlock();
+      if (recv_notify) recv_notify();
     } // end of rpc rcv
 
 
-    // create a new buffer for send_buffer[index], returning the old buffer
-    oarchive* swap_buffer(size_t index) {
+    /// The acknowledgement of the buffer sent to proc at stamp
+    void rpc_ack(procid_t proc, size_t stamp) {
+      const double rtt = double(now_us() - stamp);
+      peer_state& peer = peers[proc];
+      peer.lock.lock();
+      peer.stats.rtt_us = peer.stats.rtt_us == 0 ?
+                            rtt : 0.75 * peer.stats.rtt_us + 0.25 * rtt;
+      peer.sample_outstanding = false;
+      update_buffer_size(peer);
+      peer.lock.unlock();
+      // the destructor may go on as soon as the lock is released
+      ack_lock.lock();
+      acks_outstanding.dec();
+      ack_cond.signal();
+      ack_lock.unlock();
+    }
+
+    /// Recomputes the deadline and the buffer size. The peer lock is held
+    void update_buffer_size(peer_state& peer) {
+      peer.deadline_us = std::max<size_t>(RPC_EXCHANGE_MIN_DEADLINE_US,
+                                          2 * peer.stats.rtt_us);
+      const size_t target =
+        peer.stats.bytes_per_second * peer.deadline_us / 1000000;
+      peer.stats.buffer_size =
+        std::max<size_t>(RPC_EXCHANGE_MIN_BUFFER_SIZE,
+                         std::min<size_t>(max_buffer_size, target));
+    }
+
+    /**
+     * Records a buffer of len bytes sent to proc, returning the time to
+     * write into it if the receiver should acknowledge it, or 0.
+     */
+    size_t record_flush(procid_t proc, size_t len, flush_reason reason) {
+      peer_state& peer = peers[proc];
+      size_t stamp = 0;
+      peer.lock.lock();
+      ++peer.stats.buffers_sent;
+      peer.stats.bytes_sent += len;
+      ++peer.stats.flushes[reason];
+      if (adaptive) {
+        const size_t now = now_us();
+        peer.window_bytes += len;
+        if (peer.window_start_us == 0) {
+          peer.window_start_us = now;
+        } else if (now - peer.window_start_us >= RPC_EXCHANGE_RATE_WINDOW_US) {
+          const double rate =
+            peer.window_bytes * 1000000.0 / (now - peer.window_start_us);
+          peer.stats.bytes_per_second = peer.stats.bytes_per_second == 0 ?
+            rate : 0.75 * peer.stats.bytes_per_second + 0.25 * rate;
+          peer.window_start_us = now;
+          peer.window_bytes = 0;
+          update_buffer_size(peer);
+        }
+        if (!peer.sample_outstanding) {
+          peer.sample_outstanding = true;
+          acks_outstanding.inc();
+          stamp = now;
+        }
+      }
+      peer.lock.unlock();
+      return stamp;
+    }
+
+    /// Writes the header of a new buffer: the procid and the stamp
+    void write_buffer_header(oarchive* oarc) {
+      (*oarc) << rpc.procid();
+      ASSERT_EQ(oarc->off, stamp_offset);
+      (*oarc) << size_t(0);
+    }
+
+    /// Returns where write_buffer_header() writes the stamp
+    size_t compute_stamp_offset() {
+      oarchive* oarc = rpc.split_call_begin(&buffered_exchange::rpc_recv);
+      (*oarc) << rpc.procid();
+      const size_t offset = oarc->off;
+      rpc.split_call_cancel(oarc);
+      return offset;
+    }
+
+    static size_t now_us() {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return size_t(t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+    }
+
+    /// The time seen by a sending thread, read on every 32nd send
+    size_t thread_now_us(size_t thread_id) {
+      thread_clock& clock = thread_clocks[thread_id];
+      if ((++clock.sends & 31) == 0) clock.time_us = now_us();
+      return clock.time_us;
+    }
+
+    /**
+     * Creates a new buffer for send_buffer[index], returning the old
+     * buffer. urgent is set if the old buffer should not wait in the
+     * RPC send buffers.
+     */
+    oarchive* swap_buffer(size_t index, flush_reason reason, bool& urgent) {
+      const procid_t proc = index % rpc.numprocs();
       oarchive* swaparc = rpc.split_call_begin(&buffered_exchange::rpc_recv);
-      swaparc->expand_buf(max_buffer_size * 1.2);
+      swaparc->expand_buf(std::min(peers[proc].stats.buffer_size,
+                                   max_buffer_size) * 1.2);
       std::swap(send_buffers[index].oarc, swaparc);
       // write the length at the end of the buffere are returning
       (*swaparc) << (size_t)(send_buffers[index].numinserts);
+      const size_t stamp = record_flush(proc, swaparc->off, reason);
+      if (stamp != 0) {
+        memcpy(swaparc->buf + stamp_offset, &stamp, sizeof(size_t));
+      }
+      urgent = stamp != 0 || reason == FLUSH_DEADLINE;
 
       //std::cout << "Sending : " << (send_buffers[index].numinserts)<< "\n";
       // reset the insertion count
       send_buffers[index].numinserts = 0;
       // write the current procid into the new buffer
-      (*(send_buffers[index].oarc)) << rpc.procid();
+      write_buffer_header(send_buffers[index].oarc);
       return swaparc;
     }
 
@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_COMBINING_BUFFERED_EXCHANGE_HPP
+#define GRAPHLAB_COMBINING_BUFFERED_EXCHANGE_HPP
+
+#include <utility>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup rpc
+   * \internal
+   * A buffered_exchange of (key, value) pairs which combines the values
+   * sent to the same key with operator+= before they are sent.
+   *
+   * Each sending thread keeps a hash table per destination. A value
+   * sent to a key which is already in the table is added to the
+   * existing value instead of taking another entry in the message.
+   * The tables are moved into the underlying buffered_exchange when
+   * they reach max_entries, and on partial_flush() and flush(). The
+   * receiving side is exactly that of a
+   * buffered_exchange<std::pair<Key, Value> >.
+   *
+   * Combining can be switched off with set_combining(), in which case
+   * send() goes straight to the underlying exchange. num_sent() and
+   * num_combined() count the values sent and the values which were
+   * merged into another one.
+   */
+  template<typename Key, typename Value>
+  class combining_buffered_exchange {
+  public:
+    typedef std::pair<Key, Value> pair_type;
+    typedef buffered_exchange<pair_type> exchange_type;
+    typedef typename exchange_type::buffer_type buffer_type;
+    typedef typename exchange_type::view_type view_type;
+    typedef typename exchange_type::peer_stats peer_stats;
+
+  private:
+    typedef boost::unordered_map<Key, Value> table_type;
+
+    exchange_type exchange;
+    const size_t numprocs;
+    const size_t num_threads;
+    const size_t max_entries;
+    bool combining;
+
+    /// tables[thread_id * numprocs + proc]
+    std::vector<table_type> tables;
+    std::vector<mutex> table_locks;
+
+    /// counters of each sending thread, padded to a cache line
+    struct thread_counters {
+      size_t sent;
+      size_t combined;
+      char pad[64 - 2 * sizeof(size_t)];
+      thread_counters() : sent(0), combined(0) { }
+    };
+    std::vector<thread_counters> counters;
+
+  public:
+    combining_buffered_exchange(distributed_control& dc,
+                                const size_t num_threads = 1,
+                                const size_t max_buffer_size = 1024 * 1024,
+                                const size_t max_entries = 4096) :
+      exchange(dc, num_threads, max_buffer_size),
+      numprocs(dc.numprocs()), num_threads(num_threads),
+      max_entries(max_entries), combining(true),
+      tables(num_threads * dc.numprocs()),
+      table_locks(num_threads * dc.numprocs()),
+      counters(num_threads) { }
+
+    /// Enables or disables combining. Must not be called while sending
+    void set_combining(bool enable) {
+      combining = enable;
+    }
+
+    bool combining_enabled() const {
+      return combining;
+    }
+
+    /// See buffered_exchange::set_adaptive()
+    void set_adaptive(bool enable, size_t max_size = 0) {
+      exchange.set_adaptive(enable, max_size);
+    }
+
+    bool adaptive_enabled() const {
+      return exchange.adaptive_enabled();
+    }
+
+    /// See buffered_exchange::set_recv_notify()
+    void set_recv_notify(const boost::function<void()>& notify) {
+      exchange.set_recv_notify(notify);
+    }
+
+    /// See buffered_exchange::get_stats()
+    std::vector<peer_stats> get_stats() const {
+      return exchange.get_stats();
+    }
+
+    void send(const procid_t proc, const Key& key, const Value& value,
+              const size_t thread_id = 0) {
+      ASSERT_LT(thread_id, num_threads);
+      ++counters[thread_id].sent;
+      if (!combining) {
+        exchange.send(proc, pair_type(key, value), thread_id);
+        return;
+      }
+      const size_t index = thread_id * numprocs + proc;
+      table_locks[index].lock();
+      std::pair<typename table_type::iterator, bool> ins =
+        tables[index].insert(std::make_pair(key, value));
+      if (!ins.second) {
+        ins.first->second += value;
+        ++counters[thread_id].combined;
+      }
+      if (tables[index].size() >= max_entries) drain(index);
+      table_locks[index].unlock();
+    } // end of send
+
+    void partial_flush(size_t thread_id) {
+      for(procid_t proc = 0; proc < numprocs; ++proc) {
+        const size_t index = thread_id * numprocs + proc;
+        if (tables[index].empty()) continue;
+        table_locks[index].lock();
+        drain(index);
+        table_locks[index].unlock();
+      }
+      exchange.partial_flush(thread_id);
+    }
+
+    void flush() {
+      for(size_t i = 0; i < tables.size(); ++i) {
+        table_locks[i].lock();
+        drain(i);
+        table_locks[i].unlock();
+      }
+      exchange.flush();
+    }
+
+    bool recv(procid_t& ret_proc, buffer_type& ret_buffer,
+              const bool try_lock = false) {
+      return exchange.recv(ret_proc, ret_buffer, try_lock);
+    }
+
+    bool recv(procid_t& ret_proc, view_type& ret_view,
+              const bool try_lock = false) {
+      return exchange.recv(ret_proc, ret_view, try_lock);
+    }
+
+    size_t size() const { return exchange.size(); }
+
+    bool empty() const { return exchange.empty(); }
+
+    /// The number of values passed to send()
+    size_t num_sent() const {
+      size_t ret = 0;
+      for (size_t i = 0; i < counters.size(); ++i) ret += counters[i].sent;
+      return ret;
+    }
+
+    /// The number of values added to another value instead of being sent
+    size_t num_combined() const {
+      size_t ret = 0;
+      for (size_t i = 0; i < counters.size(); ++i) ret += counters[i].combined;
+      return ret;
+    }
+
+  private:
+    /// moves the table into the exchange. The table lock must be held
+    void drain(size_t index) {
+      const size_t thread_id = index / numprocs;
+      const procid_t proc = index % numprocs;
+      typedef typename table_type::value_type entry_type;
+      foreach(const entry_type& entry, tables[index]) {
+        exchange.send(proc, pair_type(entry.first, entry.second), thread_id);
+      }
+      tables[index].clear();
+    }
+  }; // end of combining_buffered_exchange
+
+}; // end of graphlab namespace
+#include <graphlab/macros_undef.hpp>
+
+#endif
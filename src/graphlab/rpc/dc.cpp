@@ -31,6 +31,7 @@
 
 #include <map>
 #include <sstream>
+#include <fstream>
 
 #include <boost/unordered_map.hpp>
 #include <boost/bind.hpp>
@@ -42,6 +43,7 @@
 
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_tcp_comm.hpp>
+#include <graphlab/rpc/dc_shm_comm.hpp>
 //#include <graphlab/rpc/dc_sctp_comm.hpp>
 #include <graphlab/rpc/dc_buffered_stream_send2.hpp>
 #include <graphlab/rpc/dc_stream_receive.hpp>
@@ -50,6 +52,7 @@
 
 #include <graphlab/rpc/dc_init_from_env.hpp>
 #include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/ui/metrics_server.hpp>
 
 
 // If this option is turned on,
@@ -78,6 +81,36 @@ distributed_control* get_last_dc() {
   return last_dc;
 }
 
+/// the distributed_control shown on the rpc_profile.json page
+static distributed_control* profiled_dc = NULL;
+
+/// Returns the RPC call profile of the machine. Called by machine 0
+static std::string local_rpc_profile_json() {
+  return profiled_dc == NULL ? std::string() : profiled_dc->rpc_profile_json();
+}
+
+/// The rpc_profile.json page: the profiles of all machines
+static std::pair<std::string, std::string>
+rpc_profile_page(std::map<std::string, std::string>& varmap) {
+  std::stringstream strm;
+  strm << "{\"machines\":[";
+  distributed_control* dc = profiled_dc;
+  if (dc != NULL) {
+    bool first = true;
+    for (procid_t i = 0; i < dc->numprocs(); ++i) {
+      std::string profile = (i == dc->procid()) ? local_rpc_profile_json() :
+                              dc->remote_request(i, local_rpc_profile_json);
+      // empty if the machine is shutting down
+      if (profile.empty()) continue;
+      if (!first) strm << ",\n";
+      first = false;
+      strm << profile;
+    }
+  }
+  strm << "]}";
+  return std::make_pair(std::string("application/json"), strm.str());
+}
+
 
 
 
@@ -153,9 +186,12 @@ distributed_control::distributed_control(dc_init_param initparam) {
 
 distributed_control::~distributed_control() {
   distributed_services->full_barrier();
+  if (profiler != NULL) dump_rpc_profile();
   logstream(LOG_INFO) << "Shutting down distributed control " << std::endl;
   FREE_CALLBACK_EVENT(EVENT_NETWORK_BYTES);
   FREE_CALLBACK_EVENT(EVENT_RPC_CALLS);  
+  FREE_CALLBACK_EVENT(EVENT_COMPRESSION_INPUT);
+  FREE_CALLBACK_EVENT(EVENT_COMPRESSION_OUTPUT);
   // call all deletion callbacks
   for (size_t i = 0; i < deletion_callbacks.size(); ++i) {
     deletion_callbacks[i]();
@@ -188,6 +224,7 @@ distributed_control::~distributed_control() {
   logstream(LOG_INFO) << "Calls Received: " << calls_received() << std::endl;
   
   delete comm;
+  if (profiler != NULL) delete profiler;
 
 }
   
@@ -197,6 +234,8 @@ void distributed_control::exec_function_call(procid_t source,
                                             const char* data,
                                             const size_t len) {
   BEGIN_TRACEPOINT(dc_call_dispatch);
+  const size_t start_ns = profiler == NULL ? 0 :
+                            dc_impl::call_profiler::now_ns();
   // not a POD call
   if ((packet_type_mask & POD_CALL) == 0) {
     // extract the dispatch function
@@ -212,15 +251,45 @@ void distributed_control::exec_function_call(procid_t source,
     dispatch2(*this, source, packet_type_mask, data, len);
   }
   if ((packet_type_mask & CONTROL_PACKET) == 0) inc_calls_received(source);
+  if (profiler != NULL) {
+    profiler->record_received(source, packet_type_mask, data, len,
+                              dc_impl::call_profiler::now_ns() - start_ns);
+  }
   END_TRACEPOINT(dc_call_dispatch);
 }
 
-void distributed_control::deferred_function_call_chunk(char* buf, size_t len, procid_t src) {
+
+std::string distributed_control::rpc_profile_json() const {
+  if (profiler == NULL) return std::string();
+  return profiler->json(procid());
+}
+
+
+void distributed_control::dump_rpc_profile() {
+  if (dc_impl::profiled_dc == this) dc_impl::profiled_dc = NULL;
+  std::vector<std::string> profiles(numprocs());
+  profiles[procid()] = rpc_profile_json();
+  logstream(LOG_INFO) << "RPC profile:\n" << profiler->summary(10);
+  distributed_services->gather(profiles, 0);
+  if (procid() == 0) {
+    std::ofstream fout("rpc_profile.json");
+    fout << "{\"machines\":[";
+    for (size_t i = 0; i < profiles.size(); ++i) {
+      if (i > 0) fout << ",\n";
+      fout << profiles[i];
+    }
+    fout << "]}\n";
+    logstream(LOG_EMPH) << "RPC profile written to rpc_profile.json" 
+                        << std::endl;
+  }
+}
+
+void distributed_control::deferred_function_call_chunk(dc_impl::recv_buffer* buf,
+                                                       size_t len, procid_t src) {
   BEGIN_TRACEPOINT(dc_receive_queuing);
   fcallqueue_entry* fc = new fcallqueue_entry;
-  fc->chunk_src = buf;
+  fc->chunk = buf;
   fc->chunk_len = len;
-  fc->chunk_ref_counter = NULL;
   fc->is_chunk = true;
   fc->source = src;
   fcallqueue_length.inc();
@@ -230,25 +299,23 @@ void distributed_control::deferred_function_call_chunk(char* buf, size_t len, pr
 
 
 void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
+  // let the calls keep views of the buffer
+  dc_impl::set_current_recv_buffer(fcallblock.chunk);
   if (fcallblock.is_chunk == false) {
     for (size_t i = 0;i < fcallblock.calls.size(); ++i) {
       fcallqueue_length.dec();
       exec_function_call(fcallblock.source, fcallblock.calls[i].packet_mask,
                         fcallblock.calls[i].data, fcallblock.calls[i].len);
     }
-    if (fcallblock.chunk_ref_counter != NULL) {
-      if (fcallblock.chunk_ref_counter->dec(fcallblock.calls.size()) == 0) {
-        delete fcallblock.chunk_ref_counter;
-        free(fcallblock.chunk_src);
-      }
-    }
+    dc_impl::set_current_recv_buffer(NULL);
+    dc_impl::release_recv_buffer(fcallblock.chunk);
   }
 #ifdef RPC_FAST_DISPATCH
   else {
     fcallqueue_length.dec();
    
     //parse the data in fcallblock.data
-    char* data = fcallblock.chunk_src;
+    char* data = fcallblock.chunk->data();
     size_t remaininglen = fcallblock.chunk_len;
     //PERMANENT_ACCUMULATE_DIST_EVENT(eventlog, BYTES_EVENT, remaininglen);
     while(remaininglen > 0) {
@@ -262,34 +329,33 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
       data += sizeof(dc_impl::packet_hdr) + hdr.len;
       remaininglen -= sizeof(dc_impl::packet_hdr) + hdr.len;
     }
-    free(fcallblock.chunk_src);
+    dc_impl::set_current_recv_buffer(NULL);
+    dc_impl::release_recv_buffer(fcallblock.chunk);
   }
 #else
   else {
     fcallqueue_length.dec();
+    dc_impl::set_current_recv_buffer(NULL);
     BEGIN_TRACEPOINT(dc_receive_multiplexing);
     fcallqueue_entry* queuebufs[fcallqueue.size()];
-    atomic<size_t>* refctr = new atomic<size_t>(0);
 
     fcallqueue_entry immediate_queue;
 
-    immediate_queue.chunk_src = fcallblock.chunk_src;
-    immediate_queue.chunk_ref_counter = refctr;
+    immediate_queue.chunk = fcallblock.chunk;
     immediate_queue.chunk_len = 0;
     immediate_queue.source = fcallblock.source;
     immediate_queue.is_chunk = false;
 
     for (size_t i = 0;i < fcallqueue.size(); ++i) {
       queuebufs[i] = new fcallqueue_entry;
-      queuebufs[i]->chunk_src = fcallblock.chunk_src;
-      queuebufs[i]->chunk_ref_counter = refctr;
+      queuebufs[i]->chunk = fcallblock.chunk;
       queuebufs[i]->chunk_len = 0;
       queuebufs[i]->source = fcallblock.source;
       queuebufs[i]->is_chunk = false;
     }
     
     //parse the data in fcallblock.data
-    char* data = fcallblock.chunk_src;
+    char* data = fcallblock.chunk->data();
     size_t remaininglen = fcallblock.chunk_len;
     //PERMANENT_ACCUMULATE_DIST_EVENT(eventlog, BYTES_EVENT, remaininglen);
     size_t stripe = 0;
@@ -297,9 +363,6 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
       ASSERT_GE(remaininglen, sizeof(dc_impl::packet_hdr));
       dc_impl::packet_hdr hdr = *reinterpret_cast<dc_impl::packet_hdr*>(data);
       ASSERT_LE(hdr.len, remaininglen);
-      
-      refctr->value++;
-
 
       if ((hdr.packet_type_mask & CONTROL_PACKET)) {
         // control calls are handled immediately with priority.
@@ -334,6 +397,7 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
     for (size_t i = 0;i < fcallqueue.size(); ++i) { 
       if (queuebufs[i]->calls.size() > 0) {
         fcallqueue_length.inc(queuebufs[i]->calls.size());
+        dc_impl::retain_recv_buffer(fcallblock.chunk);
         fcallqueue[i].enqueue(queuebufs[i]);
       }
       else {
@@ -341,7 +405,12 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
       }
     }
     END_TRACEPOINT(dc_receive_queuing);
-    if (immediate_queue.calls.size() > 0) process_fcall_block(immediate_queue);
+    if (immediate_queue.calls.size() > 0) {
+      dc_impl::retain_recv_buffer(fcallblock.chunk);
+      process_fcall_block(immediate_queue);
+    }
+    // every queue entry now holds its own reference
+    dc_impl::release_recv_buffer(fcallblock.chunk);
   }
 #endif
 }
@@ -442,8 +511,9 @@ void distributed_control::init(const std::vector<std::string> &machines,
     else numhandlerthreads = 2;
   }
   dc_impl::last_dc = this;
-  ASSERT_MSG(machines.size() <= RPC_MAX_N_PROCS, 
-             "Number of processes exceeded hard limit of %d", RPC_MAX_N_PROCS);
+  profiler = NULL;
+  ASSERT_MSG(machines.size() < size_t(procid_t(-1)),
+             "Number of processes exceeded hard limit of %d", int(procid_t(-1)) - 1);
     
   // initialize thread local storage
     if (dc_impl::thrlocal_sequentialization_key_initialized == false) {
@@ -471,6 +541,9 @@ void distributed_control::init(const std::vector<std::string> &machines,
   if (commtype == TCP_COMM) {
     comm = new dc_impl::dc_tcp_comm();
   }
+  else if (commtype == SHM_COMM) {
+    comm = new dc_impl::dc_shm_comm();
+  }
 /*  else if (commtype == SCTP_COMM) {
     #ifdef HAS_SCTP
     comm = new dc_impl::dc_sctp_comm();
@@ -489,6 +562,34 @@ void distributed_control::init(const std::vector<std::string> &machines,
       senders.push_back(new dc_impl::dc_buffered_stream_send2(this, comm, i));
     }
   }
+  // wire compression
+  std::map<std::string,std::string>::const_iterator compiter =
+    options.find("compression");
+  if (compiter != options.end()) {
+    size_t mode = 0;
+    if (compiter->second == "auto") mode = 1;
+    else if (compiter->second == "always") mode = 2;
+    else if (compiter->second != "no") {
+      logstream(LOG_FATAL) << "Invalid value for compression: "
+                           << compiter->second
+                           << ". Expected no, auto or always" << std::endl;
+    }
+    for (procid_t i = 0; i < senders.size(); ++i) {
+      senders[i]->set_option("compression", mode);
+    }
+  }
+  // call profiling
+  std::map<std::string,std::string>::const_iterator profiter =
+    options.find("rpc_profile");
+  if (profiter != options.end()) {
+    if (profiter->second == "yes") {
+      profiler = new dc_impl::call_profiler(machines.size());
+    } else if (profiter->second != "no") {
+      logstream(LOG_FATAL) << "Invalid value for rpc_profile: "
+                           << profiter->second
+                           << ". Expected no or yes" << std::endl;
+    }
+  }
   // create the handler threads
   // store the threads in the threadgroup
   fcall_handler_active.resize(numhandlerthreads);
@@ -535,6 +636,14 @@ void distributed_control::init(const std::vector<std::string> &machines,
       "MB", boost::bind(&distributed_control::network_megabytes_sent, this));
   ADD_CUMULATIVE_CALLBACK_EVENT(EVENT_RPC_CALLS, "RPC Calls", 
       "Calls", boost::bind(&distributed_control::calls_sent, this));
+  ADD_CUMULATIVE_CALLBACK_EVENT(EVENT_COMPRESSION_INPUT, "Compression Input",
+      "MB", boost::bind(&distributed_control::compression_input_megabytes, this));
+  ADD_CUMULATIVE_CALLBACK_EVENT(EVENT_COMPRESSION_OUTPUT, "Compression Output",
+      "MB", boost::bind(&distributed_control::compression_output_megabytes, this));
+  if (profiler != NULL) {
+    dc_impl::profiled_dc = this;
+    add_metric_server_callback("rpc_profile.json", dc_impl::rpc_profile_page);
+  }
 }
 
 
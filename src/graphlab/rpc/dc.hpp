@@ -39,6 +39,8 @@
 #include <graphlab/rpc/dc_receive.hpp>
 #include <graphlab/rpc/dc_send.hpp>
 #include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_recv_buffer.hpp>
+#include <graphlab/rpc/dc_call_profiler.hpp>
 #include <graphlab/rpc/dc_dist_object_base.hpp>
 
 #include <graphlab/rpc/is_rpc_call.hpp>
@@ -83,7 +85,22 @@ struct dc_init_param{
   /** Additional construction options of the form
     "key1=value1,key2=value2".
 
-    There are no available options at this time.
+    \li \b compression=no|auto|always Compresses the blocks sent over
+        TCP. "auto" compresses while the data compresses well and the
+        network is backed up. Compression to a machine is only used if
+        that machine also enabled it. Defaults to no.
+    \li \b tcp_io=event|uring How the TCP sockets are driven. "uring"
+        batches the sends and receives of all sockets into io_uring
+        system calls, which cuts the latency of small messages. It
+        falls back to "event" (libevent) where io_uring is not
+        available. Defaults to event.
+    \li \b rpc_profile=no|yes Counts the calls and bytes sent and
+        received per RPC call site and per machine, and the time spent
+        running the received calls. The profile of all machines is on
+        the rpc_profile.json page of the metrics server, and is written
+        to rpc_profile.json by machine 0 when the distributed_control
+        is destroyed. Function names need the program to be linked with
+        -rdynamic. Defaults to no.
 
     Internal options which should not be used
     \li \b __socket__=NUMBER Forces TCP comm to use this socket number for its
@@ -105,8 +122,9 @@ struct dc_init_param{
    * \param numhandlerthreads Optional Argument. The number of handler
    *                          threads to create. Defaults to
    *                          \ref RPC_DEFAULT_NUMHANDLERTHREADS
-   * \param commtype The Communication type. The only accepted value now is
-   *                 TCP_COMM
+   * \param commtype The Communication type. Either TCP_COMM, or
+   *                 SHM_COMM to use shared memory between processes
+   *                 on the same host
    */
   dc_init_param(size_t numhandlerthreads = RPC_DEFAULT_NUMHANDLERTHREADS,
                 dc_comm_type commtype = RPC_DEFAULT_COMMTYPE):
@@ -232,9 +250,9 @@ class distributed_control{
 
   struct fcallqueue_entry {
     std::vector<function_call_block> calls;
-    char* chunk_src;
+    /// the received buffer. Each entry holds one reference to it
+    dc_impl::recv_buffer* chunk;
     size_t chunk_len;
-    atomic<size_t>* chunk_ref_counter;
     procid_t source;
     bool is_chunk;
   };
@@ -265,6 +283,12 @@ class distributed_control{
 
   std::vector<boost::function<void(void)> > deletion_callbacks;
 
+  /// the RPC call profile. NULL unless the rpc_profile option is set
+  dc_impl::call_profiler* profiler;
+
+  /// Writes the profile of all machines to rpc_profile.json on machine 0
+  void dump_rpc_profile();
+
   template <typename T> friend class dc_dist_object;
   friend class dc_impl::dc_stream_receive;
   friend class dc_impl::dc_buffered_stream_send2;
@@ -287,6 +311,8 @@ class distributed_control{
 
   DECLARE_EVENT(EVENT_NETWORK_BYTES);
   DECLARE_EVENT(EVENT_RPC_CALLS);
+  DECLARE_EVENT(EVENT_COMPRESSION_INPUT);
+  DECLARE_EVENT(EVENT_COMPRESSION_OUTPUT);
  public:
 
   /**
@@ -638,9 +664,10 @@ class distributed_control{
   /**
    * \internal
    * Receive a collection of serialized function calls.
-   * This function will take ownership of the pointer
+   * This function will take ownership of the reference to the buffer
    */
-  void deferred_function_call_chunk(char* buf, size_t len, procid_t src);
+  void deferred_function_call_chunk(dc_impl::recv_buffer* buf, size_t len,
+                                    procid_t src);
 
   /**
    * \internal
@@ -704,6 +731,15 @@ class distributed_control{
   /// \endcond
 
  private:
+  /// Records a call of len bytes at data in the profile, if profiling
+  inline void profile_call_sent(procid_t procid,
+                                unsigned char packet_type_mask,
+                                const char* data, size_t len) {
+    if (profiler != NULL) {
+      profiler->record_sent(procid, packet_type_mask, data, len);
+    }
+  }
+
   inline void inc_calls_sent(procid_t procid) {
     //PERMANENT_ACCUMULATE_DIST_EVENT(eventlog, CALLS_EVENT, 1);
     global_calls_sent[procid].inc();
@@ -802,6 +838,49 @@ class distributed_control{
     return double(comm->network_bytes_sent()) / (1024 * 1024);
   }
 
+  /** \brief Returns the total number of bytes which were compressed
+   * before sending. Also see compression_output_bytes()
+   */
+  inline size_t compression_input_bytes() const {
+    size_t ret = 0;
+    for (size_t i = 0;i < senders.size(); ++i) {
+      ret += senders[i]->compression_input_bytes();
+    }
+    return ret;
+  }
+
+  /** \brief Returns the total number of bytes sent in place of the
+   * compression_input_bytes()
+   */
+  inline size_t compression_output_bytes() const {
+    size_t ret = 0;
+    for (size_t i = 0;i < senders.size(); ++i) {
+      ret += senders[i]->compression_output_bytes();
+    }
+    return ret;
+  }
+
+  /// \internal compression_input_bytes() in megabytes for the event log
+  inline double compression_input_megabytes() const {
+    return double(compression_input_bytes()) / (1024 * 1024);
+  }
+
+  /// \brief Returns true if the rpc_profile option is set
+  inline bool rpc_profiling() const {
+    return profiler != NULL;
+  }
+
+  /**
+   * \brief Returns the RPC call profile of this machine as a JSON
+   * object, or an empty string if the rpc_profile option is not set.
+   */
+  std::string rpc_profile_json() const;
+
+  /// \internal compression_output_bytes() in megabytes for the event log
+  inline double compression_output_megabytes() const {
+    return double(compression_output_bytes()) / (1024 * 1024);
+  }
+
 
 
   /** \brief Returns the total number of bytes received excluding all headers
@@ -853,6 +932,13 @@ class distributed_control{
    */
   void flush();
 
+  /**
+   * \brief Performs a local flush of the send buffer to one machine
+   */
+  inline void flush(procid_t target) {
+    senders[target]->flush();
+  }
+
 
   /**
    * \brief Sends an object to a target machine and blocks until the
@@ -948,8 +1034,11 @@ class distributed_control{
    * The originator will then return 'data'. All other machines
    * will receive the originator's transmission in the "data" parameter.
    *
-   * This call is guaranteed to have barrier-like behavior. That is to say,
-   * this call will block until all machines enter the broadcast function.
+   * The machines which are not the originator block until the
+   * originator enters the broadcast function and their data has arrived.
+   * The originator does not wait for the other machines. Small objects
+   * are sent down a binomial tree, large ones around a pipelined ring.
+   * See set_collective_algorithm().
    *
    * Example:
    * \code
@@ -1138,6 +1227,25 @@ class distributed_control{
   template <typename U, typename PlusEqual>
   inline void all_reduce2(U& data, PlusEqual plusequal, bool control = false);
 
+  /**
+   * \brief Sets how broadcast(), all_gather() and all_reduce() distribute
+   * their result from its root to the other machines.
+   *
+   * all_gather() and all_reduce() first combine the data of all machines
+   * up a binomial tree rooted at machine 0, which then distributes the
+   * result. A broadcast is rooted at its originator. Only the setting of
+   * the root is used, so machines do not need to agree on it.
+   *
+   * COLLECTIVE_TREE sends the result down a binomial tree, which takes
+   * log2(numprocs()) steps, each sending the whole payload.
+   * COLLECTIVE_RING splits the result into segments which each machine
+   * forwards to the next one, so that no machine sends more than the
+   * payload. COLLECTIVE_AUTO, the default, uses the ring for payloads of
+   * at least RPC_COLLECTIVE_RING_MIN_BYTES on at least
+   * RPC_COLLECTIVE_RING_MIN_PROCS machines.
+   */
+  inline void set_collective_algorithm(collective_algorithm algorithm);
+
 
    /**
     \brief A distributed barrier which waits for all machines to call the
@@ -1288,6 +1396,11 @@ inline void distributed_control::all_reduce2(U& data, PlusEqual plusequal, bool
   distributed_services->all_reduce2(data, plusequal, control);
 }
 
+inline void distributed_control::set_collective_algorithm(
+    collective_algorithm algorithm) {
+  distributed_services->set_collective_algorithm(algorithm);
+}
+
 
 
 namespace dc_impl {
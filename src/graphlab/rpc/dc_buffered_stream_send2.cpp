@@ -27,6 +27,7 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_buffered_stream_send2.hpp>
 #include <graphlab/util/branch_hints.hpp>
+#include <graphlab/util/lz_block_codec.hpp>
 namespace graphlab {
 namespace dc_impl {
 
@@ -41,6 +42,9 @@ namespace dc_impl {
       }
     }
     writebuffer_totallen.inc(actual_data_len + sizeof(packet_hdr));
+    dc->profile_call_sent(target, packet_type_mask,
+                          data + sizeof(size_t) + sizeof(packet_hdr),
+                          actual_data_len);
 
     // build the packet header
     packet_hdr* hdr = reinterpret_cast<packet_hdr*>(data + sizeof(size_t));
@@ -89,6 +93,27 @@ namespace dc_impl {
     approx_send_queue_size = 0;
     size_t real_send_len = 0;
 
+    if (compression_mode > 0 && comm->accepts_compressed(target)) {
+      // measure the block to decide whether to compress it
+      char* cur = sendqueue_head;
+      while(!sendqueue.end_of_dequeue_list(cur)) {
+        packet_hdr* hdr = reinterpret_cast<packet_hdr*>(cur + sizeof(size_t));
+        real_send_len += hdr->len + sizeof(packet_hdr);
+        while(__unlikely__(inplace_lf_queue::get_next(cur) == NULL)) {
+          asm volatile("pause\n": : :"memory");
+        }
+        cur = inplace_lf_queue::get_next(cur);
+      }
+      if (should_compress(real_send_len)) {
+        size_t ret = write_combined_block(sendqueue_head, real_send_len,
+                                          outdata);
+        lock.unlock();
+        writebuffer_totallen.dec(real_send_len);
+        return ret;
+      }
+      real_send_len = 0;
+    }
+
     // construct the block msg header
     block_header_type* blockheader = new block_header_type;
     // now I don't really know what is the size of it yet.
@@ -123,6 +148,80 @@ namespace dc_impl {
     writebuffer_totallen.dec(real_send_len);
     return real_send_len + sizeof(block_header_type);
   }
+
+
+  size_t dc_buffered_stream_send2::set_option(std::string opt, size_t val) {
+    if (opt == "compression") {
+      size_t prevval = compression_mode;
+      compression_mode = val;
+      return prevval;
+    }
+    return 0;
+  }
+
+
+  bool dc_buffered_stream_send2::should_compress(size_t len) {
+    // the flag bit must remain free in the block header
+    if (len < RPC_COMPRESSION_MIN_BLOCK || len >= COMPRESSED_BLOCK_FLAG) {
+      return false;
+    }
+    if (compression_mode >= 2) return true;
+    if (++blocks_since_probe >= RPC_COMPRESSION_PROBE_INTERVAL) {
+      blocks_since_probe = 0;
+      return true;
+    }
+    return compression_ratio < 0.8 &&
+      comm->send_queue_length() >= RPC_COMPRESSION_MIN_QUEUE;
+  }
+
+
+  size_t dc_buffered_stream_send2::write_combined_block(
+                                        char* sendqueue_head, size_t len,
+                                        circular_iovec_buffer& outdata) {
+    const size_t hdrlen = sizeof(block_header_type);
+    // gather the packets behind room for an uncompressed block header
+    char* raw = (char*)malloc(hdrlen + len);
+    size_t pos = hdrlen;
+    while(!sendqueue.end_of_dequeue_list(sendqueue_head)) {
+      packet_hdr* hdr = reinterpret_cast<packet_hdr*>(sendqueue_head + sizeof(size_t));
+      size_t packetlen = hdr->len + sizeof(packet_hdr);
+      memcpy(raw + pos, hdr, packetlen);
+      pos += packetlen;
+      char* next = inplace_lf_queue::get_next(sendqueue_head);
+      free(sendqueue_head);
+      sendqueue_head = next;
+    }
+    ASSERT_EQ(pos, hdrlen + len);
+
+    // it must save at least an eighth to be worth decompressing
+    const size_t limit = len - len / 8;
+    char* compressed = (char*)malloc(hdrlen + sizeof(uint32_t) + limit);
+    size_t clen = lz_block::compress(raw + hdrlen, len,
+                                     compressed + hdrlen + sizeof(uint32_t),
+                                     limit);
+    compression_ratio = 0.8 * compression_ratio +
+      0.2 * (clen == 0 ? 1.0 : double(clen) / len);
+
+    iovec block;
+    if (clen == 0) {
+      free(compressed);
+      *reinterpret_cast<block_header_type*>(raw) = block_header_type(len);
+      block.iov_base = raw;
+      block.iov_len = hdrlen + len;
+    } else {
+      free(raw);
+      *reinterpret_cast<block_header_type*>(compressed) =
+        block_header_type(sizeof(uint32_t) + clen) | COMPRESSED_BLOCK_FLAG;
+      uint32_t rawlen = uint32_t(len);
+      memcpy(compressed + hdrlen, &rawlen, sizeof(uint32_t));
+      block.iov_base = compressed;
+      block.iov_len = hdrlen + sizeof(uint32_t) + clen;
+      compressed_input.inc(len);
+      compressed_output.inc(sizeof(uint32_t) + clen);
+    }
+    outdata.write(block);
+    return block.iov_len;
+  }
 } // namespace dc_impl
 } // namespace graphlab
 
@@ -58,6 +58,14 @@ Sender for the dc class.
 
   dc_buffered_stream_send22 is similar, but does not perform write combining.
 
+  Each block returned by get_outgoing_data() may be compressed with
+  lz_block if the comm reports that the target accepts compressed
+  blocks. The "compression" option selects when: 0 never, 1 adaptive
+  and 2 always. The adaptive mode compresses only while the ratio
+  achieved on recent blocks is good and enough data is queued in the
+  comm that the network, not the CPU, is the bottleneck. A block is
+  occasionally compressed regardless to keep the ratio current.
+
 */
 
 class dc_buffered_stream_send2: public dc_send{
@@ -69,6 +77,10 @@ class dc_buffered_stream_send2: public dc_send{
                   writebuffer_totallen(0) {
     writebuffer_totallen.value = 0;
     approx_send_queue_size = 0;
+    compression_mode = 0;
+    compression_ratio = 0;
+    // measure the ratio on the first block
+    blocks_since_probe = RPC_COMPRESSION_PROBE_INTERVAL - 1;
   }
 
   ~dc_buffered_stream_send2() {
@@ -106,6 +118,16 @@ class dc_buffered_stream_send2: public dc_send{
 
   void flush();
 
+  size_t set_option(std::string opt, size_t val);
+
+  size_t compression_input_bytes() const {
+    return compressed_input.value;
+  }
+
+  size_t compression_output_bytes() const {
+    return compressed_output.value;
+  }
+
  private:
   /// pointer to the owner
   distributed_control* dc;
@@ -120,6 +142,25 @@ class dc_buffered_stream_send2: public dc_send{
   volatile size_t approx_send_queue_size;
 
   mutex lock;
+
+  /// 0 never compress, 1 adaptive, 2 always
+  size_t compression_mode;
+  /// moving average of compressed size / uncompressed size
+  double compression_ratio;
+  size_t blocks_since_probe;
+  atomic<size_t> compressed_input;
+  atomic<size_t> compressed_output;
+
+  /// decides if a block of this many bytes should be compressed
+  bool should_compress(size_t len);
+
+  /**
+   * Copies the packets of the list into a single block, compressing it
+   * if worthwhile, and writes the block into outdata. Frees the packets.
+   * Returns the number of bytes written.
+   */
+  size_t write_combined_block(char* sendqueue_head, size_t len,
+                              circular_iovec_buffer& outdata);
 };
 
 
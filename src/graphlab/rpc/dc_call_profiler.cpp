@@ -0,0 +1,254 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <graphlab/rpc/dc_packet_mask.hpp>
+#include <graphlab/rpc/dc_call_profiler.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+call_site get_call_site(unsigned char packet_type_mask,
+                        const char* data, size_t len) {
+  call_site site;
+  if (len >= sizeof(size_t)) memcpy(&site.dispatch, data, sizeof(size_t));
+  // a POD call is a struct of the dispatch function, the object id and
+  // the function. Other calls serialize the function after the dispatch
+  // function.
+  const size_t funcoff = (packet_type_mask & POD_CALL) ?
+                            2 * sizeof(size_t) : sizeof(size_t);
+  if (len >= funcoff + sizeof(size_t)) {
+    memcpy(&site.function, data + funcoff, sizeof(size_t));
+  }
+  return site;
+}
+
+
+std::string function_name(size_t address) {
+  Dl_info info;
+  if (address == 0 || dladdr(reinterpret_cast<void*>(address), &info) == 0 ||
+      info.dli_sname == NULL ||
+      reinterpret_cast<size_t>(info.dli_saddr) != address) {
+    return "";
+  }
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+  if (demangled == NULL) return info.dli_sname;
+  std::string ret = demangled;
+  free(demangled);
+  return ret;
+}
+
+
+/// Writes s as a JSON string
+static void write_json_string(std::ostream& out, const std::string& s) {
+  out << '"';
+  for (size_t i = 0; i < s.length(); ++i) {
+    if (s[i] == '"' || s[i] == '\\') out << '\\';
+    out << s[i];
+  }
+  out << '"';
+}
+
+static std::string hex_string(size_t v) {
+  std::stringstream strm;
+  strm << "0x" << std::hex << v;
+  return strm.str();
+}
+
+
+call_profiler::call_stats::call_stats(procid_t numprocs) :
+  calls_sent(numprocs, 0), bytes_sent(numprocs, 0),
+  calls_received(numprocs, 0), bytes_received(numprocs, 0), handler_ns(0) {
+  memset(histogram, 0, sizeof(histogram));
+}
+
+
+call_profiler::call_profiler(procid_t numprocs) :
+  numprocs(numprocs), stripes(NUM_STRIPES) { }
+
+
+call_profiler::~call_profiler() {
+  for (size_t i = 0; i < stripes.size(); ++i) {
+    site_map_type::iterator iter = stripes[i].sites.begin();
+    for (; iter != stripes[i].sites.end(); ++iter) delete iter->second;
+  }
+}
+
+
+call_profiler::call_stats* call_profiler::find_locked(const call_site& site,
+                                                      stripe*& s) {
+  s = &stripes[(hash_value(site) >> 7) % NUM_STRIPES];
+  s->lock.lock();
+  site_map_type::iterator iter = s->sites.find(site);
+  if (iter != s->sites.end()) return iter->second;
+  call_stats* stats = new call_stats(numprocs);
+  s->sites[site] = stats;
+  return stats;
+}
+
+
+void call_profiler::record_sent(procid_t target,
+                                unsigned char packet_type_mask,
+                                const char* data, size_t len) {
+  stripe* s;
+  call_stats* stats = find_locked(get_call_site(packet_type_mask, data, len),
+                                  s);
+  ++stats->calls_sent[target];
+  stats->bytes_sent[target] += len;
+  s->lock.unlock();
+}
+
+
+void call_profiler::record_received(procid_t source,
+                                    unsigned char packet_type_mask,
+                                    const char* data, size_t len,
+                                    size_t handler_ns) {
+  size_t bucket = handler_ns < 2 ? 0 : 63 - __builtin_clzll(handler_ns);
+  bucket = std::min(bucket, NUM_BUCKETS - 1);
+  stripe* s;
+  call_stats* stats = find_locked(get_call_site(packet_type_mask, data, len),
+                                  s);
+  ++stats->calls_received[source];
+  stats->bytes_received[source] += len;
+  stats->handler_ns += handler_ns;
+  ++stats->histogram[bucket];
+  s->lock.unlock();
+}
+
+
+/// \internal sums a per machine vector
+static size_t total(const std::vector<size_t>& v) {
+  size_t ret = 0;
+  for (size_t i = 0; i < v.size(); ++i) ret += v[i];
+  return ret;
+}
+
+
+namespace {
+  struct more_bytes {
+    template <typename T>
+    bool operator()(const T& a, const T& b) const {
+      return total(a.second.bytes_sent) + total(a.second.bytes_received) >
+             total(b.second.bytes_sent) + total(b.second.bytes_received);
+    }
+  };
+}
+
+
+void call_profiler::snapshot(
+    std::vector<std::pair<call_site, call_stats> >& out) const {
+  out.clear();
+  for (size_t i = 0; i < stripes.size(); ++i) {
+    stripe& s = const_cast<stripe&>(stripes[i]);
+    s.lock.lock();
+    site_map_type::const_iterator iter = s.sites.begin();
+    for (; iter != s.sites.end(); ++iter) {
+      out.push_back(std::make_pair(iter->first, *(iter->second)));
+    }
+    s.lock.unlock();
+  }
+  std::sort(out.begin(), out.end(), more_bytes());
+}
+
+
+std::string call_profiler::json(procid_t procid) const {
+  std::vector<std::pair<call_site, call_stats> > sites;
+  snapshot(sites);
+  std::stringstream strm;
+  strm << "{\"procid\":" << procid << ",\"call_sites\":[";
+  for (size_t i = 0; i < sites.size(); ++i) {
+    const call_site& site = sites[i].first;
+    const call_stats& stats = sites[i].second;
+    if (i > 0) strm << ",";
+    strm << "\n{\"dispatch\":\"" << hex_string(site.dispatch) << "\","
+         << "\"dispatch_name\":";
+    write_json_string(strm, function_name(site.dispatch));
+    strm << ",\"function\":\"" << hex_string(site.function) << "\","
+         << "\"function_name\":";
+    write_json_string(strm, function_name(site.function));
+    strm << ",\"calls_sent\":" << total(stats.calls_sent)
+         << ",\"bytes_sent\":" << total(stats.bytes_sent)
+         << ",\"calls_received\":" << total(stats.calls_received)
+         << ",\"bytes_received\":" << total(stats.bytes_received)
+         << ",\"handler_ns\":" << stats.handler_ns
+         << ",\"handler_histogram\":[";
+    bool first = true;
+    for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+      if (stats.histogram[b] == 0) continue;
+      if (!first) strm << ",";
+      first = false;
+      strm << "{\"below_ns\":" << (size_t(2) << b)
+           << ",\"calls\":" << stats.histogram[b] << "}";
+    }
+    strm << "],\"machines\":[";
+    first = true;
+    for (procid_t p = 0; p < numprocs; ++p) {
+      if (stats.calls_sent[p] == 0 && stats.calls_received[p] == 0) continue;
+      if (!first) strm << ",";
+      first = false;
+      strm << "{\"procid\":" << p
+           << ",\"calls_sent\":" << stats.calls_sent[p]
+           << ",\"bytes_sent\":" << stats.bytes_sent[p]
+           << ",\"calls_received\":" << stats.calls_received[p]
+           << ",\"bytes_received\":" << stats.bytes_received[p] << "}";
+    }
+    strm << "]}";
+  }
+  strm << "]}";
+  return strm.str();
+}
+
+
+std::string call_profiler::summary(size_t num_sites) const {
+  std::vector<std::pair<call_site, call_stats> > sites;
+  snapshot(sites);
+  std::stringstream strm;
+  strm << std::setw(12) << "calls sent" << std::setw(14) << "bytes sent"
+       << std::setw(12) << "calls recv" << std::setw(14) << "bytes recv"
+       << std::setw(12) << "handler ms" << "  function\n";
+  for (size_t i = 0; i < std::min(num_sites, sites.size()); ++i) {
+    const call_site& site = sites[i].first;
+    const call_stats& stats = sites[i].second;
+    std::string name = function_name(site.function);
+    if (name.empty()) name = function_name(site.dispatch);
+    if (name.empty()) name = hex_string(site.dispatch) + " " +
+                             hex_string(site.function);
+    strm << std::setw(12) << total(stats.calls_sent)
+         << std::setw(14) << total(stats.bytes_sent)
+         << std::setw(12) << total(stats.calls_received)
+         << std::setw(14) << total(stats.bytes_received)
+         << std::setw(12) << stats.handler_ns / 1000000
+         << "  " << name << "\n";
+  }
+  return strm.str();
+}
+
+} // namespace dc_impl
+} // namespace graphlab
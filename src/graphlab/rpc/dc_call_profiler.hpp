@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_RPC_DC_CALL_PROFILER_HPP
+#define GRAPHLAB_RPC_DC_CALL_PROFILER_HPP
+
+#include <time.h>
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc
+ * \internal
+ * Identifies the code an RPC call runs: the dispatch function, which is
+ * instantiated for the type of the called function, and the called
+ * function itself (the first word of the member function pointer for
+ * object calls).
+ */
+struct call_site {
+  size_t dispatch;
+  size_t function;
+  call_site() : dispatch(0), function(0) { }
+  bool operator==(const call_site& other) const {
+    return dispatch == other.dispatch && function == other.function;
+  }
+};
+
+/// \internal
+inline size_t hash_value(const call_site& site) {
+  return site.dispatch * 0x9E3779B97F4A7C15ULL ^ site.function;
+}
+
+
+/**
+ * \ingroup rpc
+ * \internal
+ * Counts the calls and the bytes sent and received per call site and
+ * per machine, and keeps a histogram of the time spent running the
+ * received calls of each call site.
+ *
+ * The call site is read from the start of the serialized call, so the
+ * profiler sees all calls whichever issue function made them. The
+ * function addresses are translated to names where the symbols are
+ * available, which needs the executable to be linked with -rdynamic.
+ */
+class call_profiler {
+ public:
+  /// The histogram bucket i counts the calls of less than 2^(i+1) ns
+  static const size_t NUM_BUCKETS = 40;
+
+  explicit call_profiler(procid_t numprocs);
+
+  ~call_profiler();
+
+  /// Records a call of len bytes at data sent to target
+  void record_sent(procid_t target, unsigned char packet_type_mask,
+                   const char* data, size_t len);
+
+  /// Records a call of len bytes at data received from source
+  void record_received(procid_t source, unsigned char packet_type_mask,
+                       const char* data, size_t len, size_t handler_ns);
+
+  /**
+   * Returns a JSON object with the profile of every call site, the
+   * sites with the most bytes first.
+   */
+  std::string json(procid_t procid) const;
+
+  /// Returns a table of the num_sites call sites with the most bytes
+  std::string summary(size_t num_sites) const;
+
+  /// Returns a monotonic time in nanoseconds for timing the handlers
+  static inline size_t now_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return size_t(t.tv_sec) * 1000000000 + t.tv_nsec;
+  }
+
+ private:
+  struct call_stats {
+    std::vector<size_t> calls_sent, bytes_sent;
+    std::vector<size_t> calls_received, bytes_received;
+    size_t handler_ns;
+    size_t histogram[NUM_BUCKETS];
+    explicit call_stats(procid_t numprocs);
+  };
+
+  typedef boost::unordered_map<call_site, call_stats*> site_map_type;
+
+  /// the call sites are spread over stripes to reduce lock contention
+  struct stripe {
+    mutex lock;
+    site_map_type sites;
+  };
+
+  static const size_t NUM_STRIPES = 64;
+
+  procid_t numprocs;
+  std::vector<stripe> stripes;
+
+  /// Returns the stats of the site with the stripe lock held
+  call_stats* find_locked(const call_site& site, stripe*& s);
+
+  /// A copy of the profile, sorted by total bytes
+  void snapshot(std::vector<std::pair<call_site, call_stats> >& out) const;
+};
+
+/// Reads the call site of a serialized call
+call_site get_call_site(unsigned char packet_type_mask,
+                        const char* data, size_t len);
+
+/// Returns the demangled name of the function at the address, or ""
+std::string function_name(size_t address);
+
+} // namespace dc_impl
+} // namespace graphlab
+
+#endif
@@ -89,6 +89,14 @@ class dc_comm_base {
   virtual size_t network_bytes_received() const = 0;
   virtual size_t send_queue_length() const = 0;
 
+  /**
+   Returns true if compressed blocks may be sent to the target. This is
+   negotiated with the target when the connection is established.
+  */
+  virtual bool accepts_compressed(procid_t target) const {
+    return false;
+  }
+
 };
 
 } // namespace dc_impl
@@ -33,16 +33,14 @@
 /**
   \ingroup rpc
   \def RPC_DEFAULT_COMMTYPE
-  \brief default communication method
+  \brief default communication method.
+  May be overridden at run time through the GRAPHLAB_COMMTYPE
+  environment variable ("tcp" or "shm").
  */
+#ifndef RPC_DEFAULT_COMMTYPE
 #define RPC_DEFAULT_COMMTYPE TCP_COMM
+#endif
 
-/**
-  \ingroup rpc
-  \def RPC_MAX_N_PROCS
-  \brief Maximum number of processes supported
- */
-#define RPC_MAX_N_PROCS 128
 
 /**
  * \ingroup rpc
@@ -52,4 +50,90 @@
  */
 #define BUFFER_RELINQUISH_LIMIT 131072
 
+/**
+ * \ingroup rpc
+ * \def RPC_COMPRESSION_MIN_BLOCK
+ * Blocks smaller than this many bytes are never compressed.
+ */
+#define RPC_COMPRESSION_MIN_BLOCK 4096
+
+/**
+ * \ingroup rpc
+ * \def RPC_COMPRESSION_MIN_QUEUE
+ * With compression=auto, blocks are compressed only while at least
+ * this many bytes are waiting to be written to the network.
+ */
+#define RPC_COMPRESSION_MIN_QUEUE 65536
+
+/**
+ * \ingroup rpc
+ * \def RPC_COMPRESSION_PROBE_INTERVAL
+ * With compression=auto, one in this many blocks is compressed
+ * regardless of the send queue to keep the compression ratio current.
+ */
+#define RPC_COMPRESSION_PROBE_INTERVAL 64
+
+/**
+ * \ingroup rpc
+ * \def RPC_RECV_BUFFER_POOL_MIN
+ * Received blocks of at least this many bytes are placed in pooled
+ * buffers which are reused instead of being returned to the allocator.
+ */
+#define RPC_RECV_BUFFER_POOL_MIN 65536
+
+/**
+ * \ingroup rpc
+ * \def RPC_RECV_BUFFER_POOL_LIMIT
+ * The largest number of bytes held by free pooled receive buffers.
+ */
+#define RPC_RECV_BUFFER_POOL_LIMIT (64 * 1024 * 1024)
+
+/**
+ * \ingroup rpc
+ * \def RPC_COLLECTIVE_RING_MIN_BYTES
+ * With COLLECTIVE_AUTO, broadcasts of at least this many serialized
+ * bytes use the pipelined ring instead of the binomial tree.
+ */
+#define RPC_COLLECTIVE_RING_MIN_BYTES (1024 * 1024)
+
+/**
+ * \ingroup rpc
+ * \def RPC_COLLECTIVE_RING_MIN_PROCS
+ * With COLLECTIVE_AUTO, the pipelined ring is only used with at least
+ * this many machines. On fewer the tree is as deep as the ring.
+ */
+#define RPC_COLLECTIVE_RING_MIN_PROCS 4
+
+/**
+ * \ingroup rpc
+ * \def RPC_COLLECTIVE_MIN_SEGMENT
+ * The smallest segment a ring broadcast splits its payload into.
+ */
+#define RPC_COLLECTIVE_MIN_SEGMENT 65536
+
+/**
+ * \ingroup rpc
+ * \def RPC_EXCHANGE_MIN_BUFFER_SIZE
+ * The smallest buffer an adaptive buffered_exchange sends to a machine
+ * before the deadline expires.
+ */
+#define RPC_EXCHANGE_MIN_BUFFER_SIZE 4096
+
+/**
+ * \ingroup rpc
+ * \def RPC_EXCHANGE_MIN_DEADLINE_US
+ * The shortest time in microseconds an adaptive buffered_exchange
+ * holds values before sending them. The deadline is otherwise two
+ * round trip times to the machine.
+ */
+#define RPC_EXCHANGE_MIN_DEADLINE_US 500
+
+/**
+ * \ingroup rpc
+ * \def RPC_EXCHANGE_RATE_WINDOW_US
+ * The interval in microseconds over which an adaptive
+ * buffered_exchange measures the rate of the values sent to a machine.
+ */
+#define RPC_EXCHANGE_RATE_WINDOW_US 10000
+
 #endif
@@ -28,6 +28,7 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_dist_object_base.hpp>
@@ -226,10 +227,9 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
 
     parent =  (procid_t)((dc_.procid() - 1) / BARRIER_BRANCH_FACTOR)   ;
 
-    //-------- Initialize all gather --------------
-    ab_child_barrier_counter.value = 0;
-    ab_barrier_sense = 1;
-    ab_barrier_release = -1;
+    //-------- Initialize the collectives --------------
+    coll_seq = 0;
+    coll_algorithm = COLLECTIVE_AUTO;
 
 
     //-------- Initialize the full barrier ---------
@@ -807,62 +807,214 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
 
 
 /*****************************************************************************
-                      Implementation of Broadcast
+                      Implementation of Collectives
  *****************************************************************************/
 
-private:
+/*
+ * broadcast(), all_gather() and all_reduce() exchange strings through a
+ * mailbox. Every machine numbers its collective operations in the order
+ * it calls them, which is the same order on all machines, and each
+ * message is tagged with the number of the operation and its position
+ * in the operation. A message may thus arrive before its receiver
+ * enters the operation.
+ *
+ * all_gather() and all_reduce() collect the data up a binomial tree
+ * rooted at machine 0, and all three distribute the result from their
+ * root with coll_broadcast_root(). The root picks a binomial tree, which
+ * takes log2(numprocs) steps, or for large payloads a pipelined ring in
+ * which every machine forwards segments of the payload to the next one,
+ * so no machine sends the payload more than once.
+ */
+
+ private:
+  /// A message of a collective operation
+  struct coll_message {
+    /// the root of the broadcast
+    procid_t root;
+    /// 0 if sent down the binomial tree, or the number of ring segments
+    size_t nsegments;
+    std::string data;
+  };
 
-  std::string broadcast_receive;
+  /// the number of collective operations this machine has started
+  size_t coll_seq;
+  /// the algorithm broadcasts rooted at this machine use
+  collective_algorithm coll_algorithm;
+  mutex coll_mut;
+  conditional coll_cond;
+  /// received messages by operation number and tag
+  std::map<std::pair<size_t, size_t>, coll_message> coll_mailbox;
 
-  void set_broadcast_receive(const std::string &s) {
-    broadcast_receive = s;
+  /**
+   * Stores a message of operation key.first with tag key.second.
+   * source is the sender if the message counts as a call to this
+   * object, or -1 for control messages.
+   */
+  void __coll_deliver(std::pair<size_t, size_t> key, procid_t root,
+                      size_t nsegments, procid_t source, std::string data) {
+    // Count the call before the receiver is woken up. The receiver may
+    // return from the collective and destroy this object, so the count
+    // the dispatcher makes after the call would be too late.
+    if (source != procid_t(-1)) inc_calls_received(source);
+    coll_mut.lock();
+    coll_message& msg = coll_mailbox[key];
+    msg.root = root;
+    msg.nsegments = nsegments;
+    msg.data.swap(data);
+    coll_cond.broadcast();
+    coll_mut.unlock();
   }
 
+  void coll_send(procid_t target, size_t seq, size_t tag, procid_t root,
+                 size_t nsegments, const std::string& data, bool control) {
+    // always sent as a control call, and counted here and in
+    // __coll_deliver() unless control is set
+    if (!control) inc_calls_sent(target);
+    internal_control_call(target, &dc_dist_object<T>::__coll_deliver,
+                          std::make_pair(seq, tag), root, nsegments,
+                          control ? procid_t(-1) : procid(), data);
+  }
+
+  /// Waits for the message with the tag of operation seq
+  void coll_recv(size_t seq, size_t tag, coll_message& ret) {
+    const std::pair<size_t, size_t> key(seq, tag);
+    coll_mut.lock();
+    typename std::map<std::pair<size_t, size_t>, coll_message>::iterator it;
+    while((it = coll_mailbox.find(key)) == coll_mailbox.end()) {
+      coll_cond.wait(coll_mut);
+    }
+    ret.root = it->second.root;
+    ret.nsegments = it->second.nsegments;
+    ret.data.swap(it->second.data);
+    coll_mailbox.erase(it);
+    coll_mut.unlock();
+  }
+
+  /**
+   * The binomial subtree of the machine with the given rank relative to
+   * the root covers the ranks [rank, rank + coll_span(rank)). Its
+   * children are rank + coll_span(rank) / 2, rank + coll_span(rank) / 4,
+   * ..., rank + 1, as far as they are below numprocs().
+   */
+  size_t coll_span(size_t rank) const {
+    if (rank > 0) return rank & (~rank + 1);
+    size_t span = 1;
+    while (span < numprocs()) span <<= 1;
+    return span;
+  }
+
+  /// The tag of the broadcast messages of an operation
+  size_t coll_broadcast_tag(size_t segment) const {
+    return numprocs() + segment;
+  }
+
+  /// Sends data to all other machines. The receivers call coll_broadcast_recv()
+  void coll_broadcast_root(size_t seq, const std::string& data, bool control) {
+    const size_t n = numprocs();
+    bool ring = false;
+    if (coll_algorithm == COLLECTIVE_RING) ring = true;
+    else if (coll_algorithm == COLLECTIVE_AUTO) {
+      ring = n >= RPC_COLLECTIVE_RING_MIN_PROCS &&
+             data.length() >= RPC_COLLECTIVE_RING_MIN_BYTES;
+    }
+    if (ring) {
+      // enough segments to fill the ring a few times over
+      const size_t segsize =
+          std::max<size_t>(RPC_COLLECTIVE_MIN_SEGMENT, data.length() / (4 * n));
+      const size_t nsegments =
+          std::max<size_t>(1, (data.length() + segsize - 1) / segsize);
+      const procid_t next = (procid() + 1) % n;
+      for (size_t i = 0; i < nsegments; ++i) {
+        const size_t begin = std::min(i * segsize, data.length());
+        coll_send(next, seq, coll_broadcast_tag(i), procid(), nsegments,
+                  data.substr(begin, segsize), control);
+      }
+    }
+    else {
+      // largest subtree first
+      for (size_t step = coll_span(0) >> 1; step > 0; step >>= 1) {
+        if (step >= n) continue;
+        coll_send((procid() + step) % n, seq, coll_broadcast_tag(0), procid(),
+                  0, data, control);
+      }
+    }
+  }
+
+  /// Receives the data sent by coll_broadcast_root(), forwarding it as needed
+  void coll_broadcast_recv(size_t seq, std::string& data, bool control) {
+    const size_t n = numprocs();
+    coll_message msg;
+    coll_recv(seq, coll_broadcast_tag(0), msg);
+    const size_t rank = (procid() + n - msg.root) % n;
+    if (msg.nsegments == 0) {
+      for (size_t step = coll_span(rank) >> 1; step > 0; step >>= 1) {
+        if (rank + step >= n) continue;
+        coll_send((procid() + step) % n, seq, coll_broadcast_tag(0), msg.root,
+                  0, msg.data, control);
+      }
+      data.swap(msg.data);
+    }
+    else {
+      const procid_t root = msg.root;
+      const size_t nsegments = msg.nsegments;
+      const procid_t next = (procid() + 1) % n;
+      data.clear();
+      for (size_t i = 0; i < nsegments; ++i) {
+        if (i > 0) coll_recv(seq, coll_broadcast_tag(i), msg);
+        if (rank + 1 < n) {
+          coll_send(next, seq, coll_broadcast_tag(i), root, nsegments,
+                    msg.data, control);
+        }
+        data.append(msg.data);
+      }
+    }
+  }
+
+  /**
+   * Collects the strings of the binomial subtree of this machine in
+   * rank order, appending them to data. The root of the tree is
+   * machine 0. Returns once the data of the subtree is complete, after
+   * sending it to the parent.
+   */
+  void coll_gather_subtree(size_t seq, std::string& data, bool control) {
+    const size_t rank = procid();
+    const size_t span = coll_span(rank);
+    coll_message msg;
+    for (size_t step = 1; step < span && rank + step < numprocs(); step <<= 1) {
+      coll_recv(seq, rank + step, msg);
+      data.append(msg.data);
+    }
+    if (rank > 0) coll_send(rank - span, seq, rank, 0, 0, data, control);
+  }
 
  public:
 
+  /**
+   * \copydoc distributed_control::set_collective_algorithm()
+   */
+  void set_collective_algorithm(collective_algorithm algorithm) {
+    coll_algorithm = algorithm;
+  }
+
   /// \copydoc distributed_control::broadcast()
   template <typename U>
   void broadcast(U& data, bool originator, bool control = false) {
+    if (numprocs() == 1) return;
+    const size_t seq = coll_seq++;
     if (originator) {
-      // construct the data stream
-      std::stringstream strm;
+      charstream strm(128);
       oarchive oarc(strm);
       oarc << data;
       strm.flush();
-      broadcast_receive = strm.str();
-      if (control == false) {
-        for (size_t i = 0;i < numprocs(); ++i) {
-          if (i != procid()) {
-            internal_request(i,
-                            &dc_dist_object<T>::set_broadcast_receive,
-                            broadcast_receive);
-          }
-        }
-      }
-      else {
-        for (size_t i = 0;i < numprocs(); ++i) {
-          if (i != procid()) {
-            internal_control_request(i,
-                                    &dc_dist_object<T>::set_broadcast_receive,
-                                    broadcast_receive);
-          }
-        }
-      }
+      coll_broadcast_root(seq, std::string(strm->c_str(), strm->size()),
+                          control);
     }
-
-    // by the time originator gets here, all machines
-    // will have received the data due to the broadcast_receive
-    // set a barrier here.
-    barrier();
-
-    // all machines will now deserialize the data
-    if (!originator) {
-      std::stringstream strm(broadcast_receive);
-      iarchive iarc(strm);
+    else {
+      std::string received;
+      coll_broadcast_recv(seq, received, control);
+      iarchive iarc(received.c_str(), received.length());
       iarc >> data;
     }
-    barrier();
   }
 
 
@@ -923,207 +1075,29 @@ private:
   }
 
 /********************************************************************
-             Implementation of all gather
+             Implementation of all gather and all reduce
 *********************************************************************/
 
-
-
- private:
-  // ------- Sense reversing barrier data ----------
-  /// The next value of the barrier. either +1 or -1
-  int ab_barrier_sense;
-  /// When this flag == the current barrier value. The barrier is complete
-  int ab_barrier_release;
-  /** when barrier sense is 1, barrier clears when
-   * child_barrier_counter == numchild. When barrier sense is -1, barrier
-   * clears when child_barrier_counter == 0;
-   */
-  atomic<int> ab_child_barrier_counter;
-  /// condition variable and mutex protecting the barrier variables
-  conditional ab_barrier_cond;
-  mutex ab_barrier_mut;
-  std::string ab_children_data[BARRIER_BRANCH_FACTOR];
-  std::string ab_alldata;
-
-  /**
-    The child calls this function in the parent once the child enters the barrier
-  */
-  void __ab_child_to_parent_barrier_trigger(procid_t source, std::string collect) {
-    ab_barrier_mut.lock();
-    // assert childbase <= source <= childbase + BARRIER_BRANCH_FACTOR
-    ASSERT_GE(source, childbase);
-    ASSERT_LT(source, childbase + BARRIER_BRANCH_FACTOR);
-    ab_children_data[source - childbase] = collect;
-    ab_child_barrier_counter.inc(ab_barrier_sense);
-    ab_barrier_cond.signal();
-    ab_barrier_mut.unlock();
-  }
-
-  /**
-    This is on the downward pass of the barrier. The parent calls this function
-    to release all the children's barriers
-  */
-  void __ab_parent_to_child_barrier_release(int releaseval,
-                                            std::string allstrings,
-                                            int use_control_calls) {
-    // send the release downwards
-    // get my largest child
-    logger(LOG_DEBUG, "AB Barrier Release %d", releaseval);
-    ab_alldata = allstrings;
-    for (procid_t i = 0;i < numchild; ++i) {
-      if (use_control_calls) {
-        internal_control_call((procid_t)(childbase + i),
-                              &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
-                              releaseval,
-                              ab_alldata,
-                              use_control_calls);
-      }
-      else {
-        internal_call((procid_t)(childbase + i),
-                      &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
-                      releaseval,
-                      ab_alldata,
-                      use_control_calls);
-      }
-    }
-    ab_barrier_mut.lock();
-    ab_barrier_release = releaseval;
-    ab_barrier_cond.signal();
-    ab_barrier_mut.unlock();
-  }
-
-
  public:
 
   /// \copydoc distributed_control::all_gather()
   template <typename U>
   void all_gather(std::vector<U>& data, bool control = false) {
     if (numprocs() == 1) return;
-    // get the string representation of the data
+    const size_t seq = coll_seq++;
+    // the serialized entries of the subtree, in machine order
     charstream strm(128);
     oarchive oarc(strm);
     oarc << data[procid()];
     strm.flush();
-    // upward message
-    int ab_barrier_val = ab_barrier_sense;
-    ab_barrier_mut.lock();
-    // wait for all children to be done
-    while(1) {
-      if ((ab_barrier_sense == -1 && ab_child_barrier_counter.value == 0) ||
-          (ab_barrier_sense == 1 && ab_child_barrier_counter.value == (int)(numchild))) {
-        // flip the barrier sense
-        ab_barrier_sense = -ab_barrier_sense;
-        // call child to parent in parent
-        ab_barrier_mut.unlock();
-        if (procid() != 0) {
-          // collect all my children data
-          charstream strstrm(128);
-          oarchive oarc2(strstrm);
-          oarc2 << std::string(strm->c_str(), strm->size());
-          for (procid_t i = 0;i < numchild; ++i) {
-            strstrm.write(ab_children_data[i].c_str(), ab_children_data[i].length());
-          }
-          strstrm.flush();
-          if (control) {
-            internal_control_call(parent,
-                            &dc_dist_object<T>::__ab_child_to_parent_barrier_trigger,
-                            procid(),
-                            std::string(strstrm->c_str(), strstrm->size()));
-          }
-          else {
-            internal_call(parent,
-                          &dc_dist_object<T>::__ab_child_to_parent_barrier_trigger,
-                          procid(),
-                          std::string(strstrm->c_str(), strstrm->size()));
-          }
-        }
-        break;
-      }
-      ab_barrier_cond.wait(ab_barrier_mut);
-    }
-
-
-    logger(LOG_DEBUG, "AB barrier phase 1 complete");
-    // I am root. send the barrier release downwards
-    if (procid() == 0) {
-      ab_barrier_release = ab_barrier_val;
-      // build the downward data
-      charstream strstrm(128);
-      oarchive oarc2(strstrm);
-      oarc2 << std::string(strm->c_str(), strm->size());
-      for (procid_t i = 0;i < numchild; ++i) {
-        strstrm.write(ab_children_data[i].c_str(), ab_children_data[i].length());
-      }
-      strstrm.flush();
-      ab_alldata = std::string(strstrm->c_str(), strstrm->size());
-      for (procid_t i = 0;i < numchild; ++i) {
-        logger(LOG_DEBUG, "Sending AB release to %d", childbase + i);
-        internal_control_call((procid_t)(childbase + i),
-                             &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
-                             ab_barrier_val,
-                             ab_alldata,
-                             (int)control);
-
-      }
-    }
-    // wait for the downward message releasing the barrier
-    logger(LOG_DEBUG, "AB barrier waiting for %d", ab_barrier_val);
-    ab_barrier_mut.lock();
-    while(1) {
-      if (ab_barrier_release == ab_barrier_val) break;
-      ab_barrier_cond.wait(ab_barrier_mut);
-    }
-    // read the collected data and release the lock
-    std::string local_ab_alldata = ab_alldata;
-    ab_barrier_mut.unlock();
-
-    logger(LOG_DEBUG, "barrier phase 2 complete");
-    // now the data is a DFS search of a heap
-    // I need to unpack it
-    size_t heappos = 0;
-    std::stringstream istrm(local_ab_alldata);
-    iarchive iarc(istrm);
+    std::string collected(strm->c_str(), strm->size());
+    coll_gather_subtree(seq, collected, control);
+    if (procid() == 0) coll_broadcast_root(seq, collected, control);
+    else coll_broadcast_recv(seq, collected, control);
 
+    iarchive iarc(collected.c_str(), collected.length());
     for (size_t i = 0;i < numprocs(); ++i) {
-      std::string s;
-      iarc >> s;
-
-      std::stringstream strm2(s);
-      iarchive iarc2(strm2);
-      iarc2 >> data[heappos];
-
-      if (i + 1 == numprocs()) break;
-      // advance heappos
-      // leftbranch
-      bool lefttraverseblock = false;
-      while (1) {
-        // can we continue going deaper down the left?
-        size_t leftbranch = heappos * BARRIER_BRANCH_FACTOR + 1;
-        if (lefttraverseblock == false && leftbranch < numprocs()) {
-          heappos = leftbranch;
-          break;
-        }
-        // ok. can't go down the left
-        bool this_is_a_right_branch = (((heappos - 1) % BARRIER_BRANCH_FACTOR) == BARRIER_BRANCH_FACTOR - 1);
-        // if we are a left branch, go to sibling
-        if (this_is_a_right_branch == false) {
-          size_t sibling = heappos + 1;
-          if (sibling < numprocs()) {
-            heappos = sibling;
-            break;
-          }
-        }
-
-        // we have finished this subtree, go back up to parent
-        // and block the depth traversal on the next round
-        // unless heappos is 0
-
-        heappos = (heappos - 1) / BARRIER_BRANCH_FACTOR;
-        lefttraverseblock = true;
-        continue;
-        // go to sibling
-      }
-
+      iarc >> data[i];
     }
   }
 
@@ -1131,102 +1105,31 @@ private:
   template <typename U, typename PlusEqual>
   void all_reduce2(U& data, PlusEqual plusequal, bool control = false) {
     if (numprocs() == 1) return;
-    // get the string representation of the data
-   /* charstream strm(128);
+    const size_t seq = coll_seq++;
+    // accumulate the subtrees of the children
+    const size_t rank = procid();
+    const size_t span = coll_span(rank);
+    coll_message msg;
+    for (size_t step = 1; step < span && rank + step < numprocs(); step <<= 1) {
+      coll_recv(seq, rank + step, msg);
+      iarchive iarc(msg.data.c_str(), msg.data.length());
+      U tmp;
+      iarc >> tmp;
+      plusequal(data, tmp);
+    }
+    charstream strm(128);
     oarchive oarc(strm);
     oarc << data;
-    strm.flush();*/
-    // upward message
-    int ab_barrier_val = ab_barrier_sense;
-    ab_barrier_mut.lock();
-    // wait for all children to be done
-    while(1) {
-      if ((ab_barrier_sense == -1 && ab_child_barrier_counter.value == 0) ||
-          (ab_barrier_sense == 1 && ab_child_barrier_counter.value == (int)(numchild))) {
-        // flip the barrier sense
-        ab_barrier_sense = -ab_barrier_sense;
-        // call child to parent in parent
-        ab_barrier_mut.unlock();
-        if (procid() != 0) {
-          // accumulate my children data
-          for (procid_t i = 0;i < numchild; ++i) {
-            std::stringstream istrm(ab_children_data[i]);
-            iarchive iarc(istrm);
-            U tmp;
-            iarc >> tmp;
-            plusequal(data, tmp);
-          }
-          // upward message
-          charstream ostrm(128);
-          oarchive oarc(ostrm);
-          oarc << data;
-          ostrm.flush();
-          if (control) {
-            internal_control_call(parent,
-                            &dc_dist_object<T>::__ab_child_to_parent_barrier_trigger,
-                            procid(),
-                            std::string(ostrm->c_str(), ostrm->size()));
-          }
-          else {
-            internal_call(parent,
-                          &dc_dist_object<T>::__ab_child_to_parent_barrier_trigger,
-                          procid(),
-                          std::string(ostrm->c_str(), ostrm->size()));
-          }
-        }
-        break;
-      }
-      ab_barrier_cond.wait(ab_barrier_mut);
-    }
-
-
-    logger(LOG_DEBUG, "AB barrier phase 1 complete");
-    // I am root. send the barrier release downwards
-    if (procid() == 0) {
-      ab_barrier_release = ab_barrier_val;
-      for (procid_t i = 0;i < numchild; ++i) {
-        std::stringstream istrm(ab_children_data[i]);
-        iarchive iarc(istrm);
-        U tmp;
-        iarc >> tmp;
-        plusequal(data, tmp);
-      }
-      // build the downward data
-      charstream ostrm(128);
-      oarchive oarc(ostrm);
-      oarc << data;
-      ostrm.flush();
-      ab_alldata = std::string(ostrm->c_str(), ostrm->size());
-      for (procid_t i = 0;i < numchild; ++i) {
-        internal_control_call((procid_t)(childbase + i),
-                             &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
-                             ab_barrier_val,
-                             ab_alldata,
-                             (int)control);
-
-      }
-    }
-    // wait for the downward message releasing the barrier
-    logger(LOG_DEBUG, "AB barrier waiting for %d", ab_barrier_val);
-    ab_barrier_mut.lock();
-    while(1) {
-      if (ab_barrier_release == ab_barrier_val) break;
-      ab_barrier_cond.wait(ab_barrier_mut);
-    }
-
-    if (procid() != 0) {
-      // read the collected data and release the lock
-      std::string local_ab_alldata = ab_alldata;
-      ab_barrier_mut.unlock();
-
-      logger(LOG_DEBUG, "barrier phase 2 complete");
-
-      std::stringstream istrm(local_ab_alldata);
-      iarchive iarc(istrm);
-      iarc >> data;
+    strm.flush();
+    std::string reduced(strm->c_str(), strm->size());
+    if (rank == 0) {
+      coll_broadcast_root(seq, reduced, control);
     }
     else {
-      ab_barrier_mut.unlock();
+      coll_send(rank - span, seq, rank, 0, 0, reduced, control);
+      coll_broadcast_recv(seq, reduced, control);
+      iarchive iarc(reduced.c_str(), reduced.length());
+      iarc >> data;
     }
   }
 
@@ -49,9 +49,20 @@ bool init_param_from_env(dc_init_param& param) {
   }
   // set defaults
   param.numhandlerthreads = RPC_DEFAULT_NUMHANDLERTHREADS;
-  param.commtype = RPC_DEFAULT_COMMTYPE;
+  param.commtype = comm_type_from_env(RPC_DEFAULT_COMMTYPE);
   return true;
 }
 
+dc_comm_type comm_type_from_env(dc_comm_type defaulttype) {
+  char* commtype = getenv("GRAPHLAB_COMMTYPE");
+  if (commtype == NULL) return defaulttype;
+  std::string commstr = commtype;
+  if (commstr == "tcp") return TCP_COMM;
+  else if (commstr == "shm") return SHM_COMM;
+  logstream(LOG_FATAL) << "Unknown GRAPHLAB_COMMTYPE " << commstr
+                       << ". Expected tcp or shm" << std::endl;
+  return defaulttype;
+}
+
 } // namespace graphlab
 
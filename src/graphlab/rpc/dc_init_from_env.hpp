@@ -29,6 +29,13 @@ namespace graphlab {
    * \ingroup rpc
    * initializes parameters from environment. Returns true on success */
   bool init_param_from_env(dc_init_param& param);
+
+  /**
+   * \ingroup rpc
+   * Returns the communication type named by the GRAPHLAB_COMMTYPE
+   * environment variable ("tcp" or "shm"), or defaulttype if it is not
+   * set. */
+  dc_comm_type comm_type_from_env(dc_comm_type defaulttype);
 }
 
 #endif // GRAPHLAB_DC_INIT_FROM_ENV_HPP
@@ -27,6 +27,7 @@
 #include <string>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/rpc/dc_init_from_env.hpp>
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab/util/net_util.hpp>
 #include <graphlab/logger/logger.hpp>
@@ -38,7 +39,9 @@ namespace graphlab {
 
 bool init_param_from_mpi(dc_init_param& param,dc_comm_type commtype) {
 #ifdef HAS_MPI
-  ASSERT_MSG(commtype == TCP_COMM, "MPI initialization only supports TCP at the moment");
+  commtype = comm_type_from_env(commtype);
+  ASSERT_MSG(commtype == TCP_COMM || commtype == SHM_COMM,
+             "MPI initialization only supports TCP and SHM at the moment");
   // Look for a free port to use. 
   std::pair<size_t, int> port_and_sock = get_free_tcp_port();
   size_t port = port_and_sock.first;
@@ -80,6 +80,20 @@ struct packet_hdr {
 
 typedef uint32_t block_header_type;
 
+/**
+ * \internal
+ * \ingroup rpc
+ * Set in the block header of a compressed block. The block is then the
+ * uncompressed length as a uint32_t followed by the lz_block
+ * compressed data. */
+const block_header_type COMPRESSED_BLOCK_FLAG = block_header_type(1) << 31;
+
+/**
+ * \internal
+ * \ingroup rpc
+ * Flags exchanged by the TCP comm when a connection is established */
+const unsigned char LINK_ACCEPTS_COMPRESSION = 1;
+
 /**
  * \internal
  * \ingroup rpc
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstdlib>
+#include <vector>
+#include <pthread.h>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/dc_compile_parameters.hpp>
+#include <graphlab/rpc/dc_recv_buffer.hpp>
+namespace graphlab {
+namespace dc_impl {
+
+struct recv_buffer_pool {
+  /// free buffers of each size class. Class i holds buffers of
+  /// RPC_RECV_BUFFER_POOL_MIN << i bytes
+  std::vector<std::vector<recv_buffer*> > free_buffers;
+  size_t pooled_bytes;
+  mutex lock;
+  /// the buffer being dispatched by each thread
+  pthread_key_t current_key;
+
+  recv_buffer_pool() : free_buffers(64), pooled_bytes(0) {
+    pthread_key_create(&current_key, NULL);
+  }
+
+  ~recv_buffer_pool() {
+    for (size_t i = 0; i < free_buffers.size(); ++i) {
+      for (size_t j = 0; j < free_buffers[i].size(); ++j) {
+        free(free_buffers[i][j]);
+      }
+    }
+    pthread_key_delete(current_key);
+  }
+
+  static size_t size_class(size_t len) {
+    size_t c = 0;
+    while ((size_t(RPC_RECV_BUFFER_POOL_MIN) << c) < len) ++c;
+    return c;
+  }
+};
+
+static recv_buffer_pool pool;
+
+recv_buffer* allocate_recv_buffer(size_t len) {
+  recv_buffer* buf = NULL;
+  if (len < RPC_RECV_BUFFER_POOL_MIN) {
+    buf = (recv_buffer*)malloc(sizeof(recv_buffer) + len);
+    buf->capacity = len;
+  } else {
+    const size_t c = recv_buffer_pool::size_class(len);
+    pool.lock.lock();
+    if (!pool.free_buffers[c].empty()) {
+      buf = pool.free_buffers[c].back();
+      pool.free_buffers[c].pop_back();
+      pool.pooled_bytes -= buf->capacity;
+    }
+    pool.lock.unlock();
+    if (buf == NULL) {
+      const size_t capacity = size_t(RPC_RECV_BUFFER_POOL_MIN) << c;
+      buf = (recv_buffer*)malloc(sizeof(recv_buffer) + capacity);
+      buf->capacity = capacity;
+    }
+  }
+  buf->refcount.value = 1;
+  return buf;
+}
+
+void release_recv_buffer(recv_buffer* buf, size_t count) {
+  if (buf->refcount.dec(count) != 0) return;
+  if (buf->capacity >= RPC_RECV_BUFFER_POOL_MIN) {
+    pool.lock.lock();
+    if (pool.pooled_bytes + buf->capacity <= RPC_RECV_BUFFER_POOL_LIMIT) {
+      pool.free_buffers[recv_buffer_pool::size_class(buf->capacity)].push_back(buf);
+      pool.pooled_bytes += buf->capacity;
+      buf = NULL;
+    }
+    pool.lock.unlock();
+  }
+  if (buf != NULL) free(buf);
+}
+
+recv_buffer* current_recv_buffer() {
+  return reinterpret_cast<recv_buffer*>(pthread_getspecific(pool.current_key));
+}
+
+void set_current_recv_buffer(recv_buffer* buf) {
+  pthread_setspecific(pool.current_key, buf);
+}
+
+} // dc_impl
+} // graphlab
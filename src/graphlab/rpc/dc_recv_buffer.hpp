@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_RPC_DC_RECV_BUFFER_HPP
+#define GRAPHLAB_RPC_DC_RECV_BUFFER_HPP
+#include <cstring>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc
+ * \internal
+ * A reference counted block of received data. The data follows the
+ * header. Blocks of at least RPC_RECV_BUFFER_POOL_MIN bytes come from a
+ * pool so that large blocks do not pay for a fresh mapping and page
+ * faults every time.
+ */
+struct recv_buffer {
+  atomic<size_t> refcount;
+  size_t capacity;
+
+  inline char* data() {
+    return reinterpret_cast<char*>(this) + sizeof(recv_buffer);
+  }
+};
+
+/// Returns a buffer of at least len bytes with a reference count of 1
+recv_buffer* allocate_recv_buffer(size_t len);
+
+/// Increments the reference count of the buffer by count
+inline void retain_recv_buffer(recv_buffer* buf, size_t count = 1) {
+  buf->refcount.inc(count);
+}
+
+/// Decrements the reference count by count, freeing the buffer at 0
+void release_recv_buffer(recv_buffer* buf, size_t count = 1);
+
+/**
+ * Returns the buffer holding the call being dispatched by this
+ * thread, or NULL if the call is not dispatched from a received buffer.
+ */
+recv_buffer* current_recv_buffer();
+
+/// Sets the value returned by current_recv_buffer() on this thread
+void set_current_recv_buffer(recv_buffer* buf);
+
+
+/**
+ * \ingroup rpc
+ * \internal
+ * A view of a range of bytes in a received buffer. The view keeps the
+ * buffer alive, so the bytes can be read after the RPC call which
+ * delivered them returns, without being copied.
+ *
+ * A recv_view may be used as an argument of an RPC call. It is
+ * serialized as a length followed by the bytes, and deserializes to a
+ * view of those bytes in the received buffer.
+ */
+class recv_view {
+ public:
+  recv_view() : buf(NULL), ptr(NULL), len(0) { }
+
+  /**
+   * Views len bytes at ptr, if they are in the buffer of the call
+   * being dispatched by this thread. Makes a copy otherwise, for
+   * instance for calls made locally or bytes in another archive.
+   */
+  recv_view(const char* ptr, size_t len) : buf(NULL), ptr(NULL), len(0) {
+    assign(ptr, len);
+  }
+
+  recv_view(const recv_view& other) : buf(other.buf), ptr(other.ptr),
+                                      len(other.len) {
+    if (buf != NULL) retain_recv_buffer(buf);
+  }
+
+  recv_view& operator=(const recv_view& other) {
+    if (other.buf != NULL) retain_recv_buffer(other.buf);
+    clear();
+    buf = other.buf; ptr = other.ptr; len = other.len;
+    return *this;
+  }
+
+  ~recv_view() {
+    clear();
+  }
+
+  /// Releases the viewed bytes
+  inline void clear() {
+    if (buf != NULL) release_recv_buffer(buf);
+    buf = NULL; ptr = NULL; len = 0;
+  }
+
+  /// Views len bytes at ptr. See the constructor
+  void assign(const char* newptr, size_t newlen) {
+    clear();
+    recv_buffer* cur = current_recv_buffer();
+    if (cur == NULL || newptr < cur->data() ||
+        newptr + newlen > cur->data() + cur->capacity) {
+      // make a buffer of our own
+      cur = allocate_recv_buffer(newlen);
+      memcpy(cur->data(), newptr, newlen);
+      newptr = cur->data();
+    } else {
+      retain_recv_buffer(cur);
+    }
+    buf = cur; ptr = newptr; len = newlen;
+  }
+
+  inline const char* data() const { return ptr; }
+  inline size_t size() const { return len; }
+  inline bool empty() const { return len == 0; }
+
+  void save(oarchive& oarc) const {
+    oarc << len;
+    serialize(oarc, ptr, len);
+  }
+
+  void load(iarchive& iarc) {
+    size_t newlen;
+    iarc >> newlen;
+    ASSERT_TRUE(iarc.buf != NULL);
+    ASSERT_LE(iarc.off + newlen, iarc.len);
+    assign(iarc.buf + iarc.off, newlen);
+    iarc.off += newlen;
+  }
+
+ private:
+  recv_buffer* buf;
+  const char* ptr;
+  size_t len;
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
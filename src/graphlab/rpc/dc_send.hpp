@@ -78,6 +78,16 @@ class dc_send{
     return 0;
   }
 
+  /// Number of bytes which were compressed before sending
+  virtual size_t compression_input_bytes() const {
+    return 0;
+  }
+
+  /// Number of bytes the compressed data occupied
+  virtual size_t compression_output_bytes() const {
+    return 0;
+  }
+
   /**
    * Returns length if there is data, 0 otherwise. This function
    * must be reentrant, but it is guaranteed that only one thread will
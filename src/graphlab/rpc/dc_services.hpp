@@ -113,6 +113,11 @@ namespace graphlab {
       rmi.all_reduce2(data, plusequal, control);
     }
 
+    /// \copydoc distributed_control::set_collective_algorithm()
+    inline void set_collective_algorithm(collective_algorithm algorithm) {
+      rmi.set_collective_algorithm(algorithm);
+    }
+
     /// \copydoc distributed_control::barrier()
     inline void barrier() {
       rmi.barrier();
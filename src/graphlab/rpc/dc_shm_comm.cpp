@@ -0,0 +1,451 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <string>
+#include <map>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/rpc/dc_shm_comm.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  namespace dc_impl {
+
+    namespace {
+      /// the default size of each ring
+      const size_t SHM_DEFAULT_RING_SIZE = 4 * 1024 * 1024;
+      /// number of empty polls before the receive thread sleeps
+      const size_t SHM_SPIN_COUNT = 1000;
+
+      /**
+       * A sender with nothing to send. Handed to the tcp comm in place
+       * of the senders of the local peers.
+       */
+      class null_send: public dc_send {
+       public:
+        void send_data(procid_t target, unsigned char packet_type_mask,
+                       char* data, size_t len) {
+          logstream(LOG_FATAL) << "Unexpected send to local peer" << std::endl;
+        }
+        void copy_and_send_data(procid_t target, unsigned char packet_type_mask,
+                                char* data, size_t len) {
+          logstream(LOG_FATAL) << "Unexpected send to local peer" << std::endl;
+        }
+        size_t bytes_sent() { return 0; }
+        void flush() { }
+        size_t send_queue_length() const { return 0; }
+        size_t get_outgoing_data(circular_iovec_buffer& outdata) { return 0; }
+      };
+
+      null_send null_sender;
+
+      /// Waits till *addr differs from val or the timeout expires
+      inline void futex_wait(volatile uint32_t* addr, uint32_t val,
+                             size_t timeout_ms) {
+#ifdef __linux__
+        struct timespec t;
+        t.tv_sec = timeout_ms / 1000;
+        t.tv_nsec = (timeout_ms % 1000) * 1000000;
+        // not FUTEX_PRIVATE: the word is shared between processes
+        syscall(SYS_futex, addr, FUTEX_WAIT, val, &t, NULL, 0);
+#else
+        // no futex. poll the doorbell instead
+        if (*addr == val) usleep(100);
+#endif
+      }
+
+      /// Wakes up a waiter on addr
+      inline void futex_wake(volatile uint32_t* addr) {
+#ifdef __linux__
+        syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+      }
+
+      /// Returns the IP address of the host in a machine string
+      uint32_t host_address(const std::string& machine) {
+        size_t pos = machine.find(":");
+        ASSERT_NE(pos, std::string::npos);
+        std::string address = machine.substr(0, pos);
+        struct hostent* ent = gethostbyname(address.c_str());
+        ASSERT_TRUE(ent != NULL);
+        ASSERT_EQ(ent->h_length, 4);
+        return *reinterpret_cast<uint32_t*>(ent->h_addr_list[0]);
+      }
+    } // anonymous namespace
+
+
+    size_t shm_ring::write(const char* buf, size_t len) {
+      const uint64_t h = head;
+      const uint64_t t = tail;
+      len = std::min<size_t>(len, capacity - (h - t));
+      if (len == 0) return 0;
+      const size_t start = h % capacity;
+      const size_t first = std::min<size_t>(len, capacity - start);
+      memcpy(data() + start, buf, first);
+      memcpy(data(), buf + first, len - first);
+      // the data must be visible before the new head
+      __sync_synchronize();
+      head = h + len;
+      return len;
+    }
+
+    size_t shm_ring::read(char* buf, size_t len) {
+      const uint64_t t = tail;
+      const uint64_t h = head;
+      // the data must be read after the head
+      __sync_synchronize();
+      len = std::min<size_t>(len, h - t);
+      if (len == 0) return 0;
+      const size_t start = t % capacity;
+      const size_t first = std::min<size_t>(len, capacity - start);
+      memcpy(buf, data() + start, first);
+      memcpy(buf + first, data(), len - first);
+      // the data must be copied out before the space is released
+      __sync_synchronize();
+      tail = t + len;
+      return len;
+    }
+
+
+    void dc_shm_comm::init(const std::vector<std::string> &machines,
+                           const std::map<std::string,std::string> &initopts,
+                           procid_t curmachineid,
+                           std::vector<dc_receive*> receiver_,
+                           std::vector<dc_send*> sender_) {
+      curid = curmachineid;
+      ASSERT_LT(machines.size(), std::numeric_limits<procid_t>::max());
+      nprocs = (procid_t)(machines.size());
+      receiver = receiver_;
+      sender = sender_;
+      shm_bytessent = 0;
+      shm_bytesreceived = 0;
+      shm_buffered_len = 0;
+      done = false;
+      unlinked = false;
+      segment = NULL;
+      header = NULL;
+
+      ring_size = SHM_DEFAULT_RING_SIZE;
+      std::map<std::string, std::string>::const_iterator iter =
+        initopts.find("shm_ring_size");
+      if (iter != initopts.end()) {
+        ring_size = boost::lexical_cast<size_t>(iter->second);
+        if (ring_size < 4096) {
+          logstream(LOG_FATAL) << "shm_ring_size must be at least 4096"
+                               << std::endl;
+        }
+      }
+
+      // find the processes which share my host
+      const uint32_t myaddr = host_address(machines[curid]);
+      local_index.resize(nprocs, size_t(-1));
+      tcp_sender = sender;
+      for (procid_t i = 0; i < nprocs; ++i) {
+        if (host_address(machines[i]) != myaddr) continue;
+        local_group.push_back(i);
+        // messages to myself go through the tcp loopback as before
+        if (i == curid) continue;
+        local_index[i] = local_peers.size();
+        peer_info* peer = new peer_info;
+        peer->id = i;
+        peer->out = NULL;
+        peer->outheader = NULL;
+        peer->outmap = NULL;
+        peer->outmaplen = 0;
+        peer->in = NULL;
+        peer->triggered = false;
+        local_peers.push_back(peer);
+        tcp_sender[i] = &null_sender;
+      }
+      logstream(LOG_INFO) << "Proc " << curid << " has " << local_peers.size()
+                          << " local peers" << std::endl;
+
+      // My segment must exist before the local peers can connect to me.
+      // Once the tcp comm is up, every peer has created its segment.
+      if (!local_peers.empty()) create_segment(machines);
+      tcp.init(machines, initopts, curmachineid, receiver, tcp_sender);
+      foreach(peer_info* peer, local_peers) {
+        open_peer_segment(*peer, machines);
+        peer->in = ring_at(header, ring_index(peer->id, curid));
+      }
+
+      if (!local_peers.empty()) {
+        shmthreads.launch(boost::bind(&dc_shm_comm::receive_loop, this));
+        shmthreads.launch(boost::bind(&dc_shm_comm::send_loop, this));
+      }
+      is_closed = false;
+    }
+
+
+    std::string dc_shm_comm::segment_name_of(
+                                const std::vector<std::string>& machines,
+                                procid_t id) const {
+      // the machine list identifies the job
+      size_t h = boost::hash_range(machines.begin(), machines.end());
+      return "/graphlab_" + boost::lexical_cast<std::string>(h) + "_" +
+        boost::lexical_cast<std::string>(id);
+    }
+
+
+    size_t dc_shm_comm::ring_index(procid_t src, procid_t dest) const {
+      // the rings in the segment of dest are in the order of local_group,
+      // skipping dest itself
+      size_t srcpos = std::lower_bound(local_group.begin(), local_group.end(),
+                                       src) - local_group.begin();
+      return src > dest ? srcpos - 1 : srcpos;
+    }
+
+
+    shm_ring* dc_shm_comm::ring_at(shm_segment_header* h, size_t i) const {
+      char* base = reinterpret_cast<char*>(h) + sizeof(shm_segment_header);
+      return reinterpret_cast<shm_ring*>(base +
+                                         i * (sizeof(shm_ring) + h->ring_size));
+    }
+
+
+    void dc_shm_comm::create_segment(const std::vector<std::string>& machines) {
+      segment_name = segment_name_of(machines, curid);
+      const size_t nrings = local_peers.size();
+      segment_len = sizeof(shm_segment_header) +
+        nrings * (sizeof(shm_ring) + ring_size);
+      int fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (fd < 0 && errno == EEXIST) {
+        // left behind by an earlier run which died during initialization
+        logstream(LOG_WARNING) << "Removing stale shared memory segment "
+                               << segment_name << std::endl;
+        shm_unlink(segment_name.c_str());
+        fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      }
+      if (fd < 0) {
+        logstream(LOG_FATAL) << "Unable to create shared memory segment "
+                             << segment_name << ": " << strerror(errno)
+                             << std::endl;
+      }
+      if (ftruncate(fd, segment_len) != 0) {
+        logstream(LOG_FATAL) << "Unable to size shared memory segment "
+                             << segment_name << ": " << strerror(errno)
+                             << std::endl;
+      }
+      segment = mmap(NULL, segment_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (segment == MAP_FAILED) {
+        logstream(LOG_FATAL) << "Unable to map shared memory segment "
+                             << segment_name << ": " << strerror(errno)
+                             << std::endl;
+      }
+      // the new pages are zero filled
+      header = reinterpret_cast<shm_segment_header*>(segment);
+      header->num_rings = nrings;
+      header->ring_size = ring_size;
+      for (size_t i = 0; i < nrings; ++i) {
+        ring_at(header, i)->capacity = ring_size;
+      }
+      __sync_synchronize();
+    }
+
+
+    void dc_shm_comm::open_peer_segment(peer_info& peer,
+                                    const std::vector<std::string>& machines) {
+      std::string name = segment_name_of(machines, peer.id);
+      int fd = shm_open(name.c_str(), O_RDWR, 0600);
+      if (fd < 0) {
+        logstream(LOG_FATAL) << "Unable to open shared memory segment "
+                             << name << ": " << strerror(errno) << std::endl;
+      }
+      struct stat st;
+      ASSERT_EQ(fstat(fd, &st), 0);
+      peer.outmaplen = st.st_size;
+      peer.outmap = mmap(NULL, peer.outmaplen, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (peer.outmap == MAP_FAILED) {
+        logstream(LOG_FATAL) << "Unable to map shared memory segment "
+                             << name << ": " << strerror(errno) << std::endl;
+      }
+      peer.outheader = reinterpret_cast<shm_segment_header*>(peer.outmap);
+      ASSERT_EQ(peer.outheader->num_rings, local_group.size() - 1);
+      peer.out = ring_at(peer.outheader, ring_index(curid, peer.id));
+      // let the owner know it may unlink the segment
+      __sync_fetch_and_add(&(peer.outheader->attached), 1);
+    }
+    void dc_shm_comm::trigger_send_timeout(procid_t target, bool urgent) {
+      if (!is_local(target)) {
+        tcp.trigger_send_timeout(target, urgent);
+        return;
+      }
+      peer_info& peer = *local_peers[local_index[target]];
+      if (urgent) {
+        process_peer(peer);
+      } else if (peer.triggered == false) {
+        peer.triggered = true;
+        send_lock.lock();
+        send_cond.signal();
+        send_lock.unlock();
+      }
+    }
+
+
+    void dc_shm_comm::close() {
+      if (is_closed) return;
+      logstream(LOG_INFO) << "Closing shared memory rings" << std::endl;
+      done = true;
+      send_lock.lock();
+      send_cond.signal();
+      send_lock.unlock();
+      shmthreads.join();
+      tcp.close();
+      foreach(peer_info* peer, local_peers) {
+        if (peer->outmap != NULL) munmap(peer->outmap, peer->outmaplen);
+        delete peer;
+      }
+      local_peers.clear();
+      if (segment != NULL) {
+        munmap(segment, segment_len);
+        segment = NULL;
+      }
+      if (!unlinked && !segment_name.empty()) {
+        shm_unlink(segment_name.c_str());
+        unlinked = true;
+      }
+      is_closed = true;
+    }
+
+
+    void dc_shm_comm::notify_peer(peer_info& peer) {
+      __sync_fetch_and_add(&(peer.outheader->doorbell), 1);
+      // pairs with the barrier between setting sleeping and the wait
+      __sync_synchronize();
+      if (peer.outheader->sleeping) futex_wake(&(peer.outheader->doorbell));
+    }
+
+
+    void dc_shm_comm::process_peer(peer_info& peer) {
+      if (!peer.m.try_lock()) return;
+      peer.triggered = false;
+      shm_buffered_len.inc(sender[peer.id]->get_outgoing_data(peer.outvec));
+      size_t written = 0;
+      while(!peer.outvec.empty()) {
+        const iovec& entry = peer.outvec.parallel_v[peer.outvec.head];
+        size_t ret = peer.out->write((const char*)entry.iov_base,
+                                     entry.iov_len);
+        if (ret == 0) break;
+        written += ret;
+        peer.outvec.sent(ret);
+      }
+      if (written > 0) {
+        shm_bytessent.inc(written);
+        notify_peer(peer);
+      }
+      peer.m.unlock();
+    }
+
+
+////////////////////////////////////////////////////////////////////////////
+//       These stuff run in seperate threads                              //
+////////////////////////////////////////////////////////////////////////////
+
+    void dc_shm_comm::send_loop() {
+      logstream(LOG_INFO) << "Shared memory send loop Started" << std::endl;
+      while(!done) {
+        bool pending = false;
+        foreach(peer_info* peer, local_peers) {
+          process_peer(*peer);
+          pending |= !peer->outvec.empty();
+        }
+        if (pending) {
+          // a ring is full. wait for the peer to drain it
+          sched_yield();
+          continue;
+        }
+        send_lock.lock();
+        bool triggered = false;
+        foreach(peer_info* peer, local_peers) triggered |= peer->triggered;
+        // flush everything at least every 10ms, as the tcp comm does
+        if (!triggered && !done) send_cond.timedwait_ms(send_lock, 10);
+        send_lock.unlock();
+      }
+      logstream(LOG_INFO) << "Shared memory send loop Stopped" << std::endl;
+    }
+
+
+    void dc_shm_comm::receive_loop() {
+      logstream(LOG_INFO) << "Shared memory receive loop Started" << std::endl;
+      size_t idle = 0;
+      while(!done) {
+        const uint32_t bell = header->doorbell;
+        bool received = false;
+        foreach(peer_info* peer, local_peers) {
+          dc_receive* recv = receiver[peer->id];
+          size_t buflength;
+          char* c = recv->get_buffer(buflength);
+          while(1) {
+            size_t msglen = peer->in->read(c, buflength);
+            if (msglen == 0) break;
+            shm_bytesreceived.inc(msglen);
+            received = true;
+            c = recv->advance_buffer(c, msglen, buflength);
+          }
+        }
+        if (!unlinked && header->attached == local_peers.size()) {
+          // everyone has mapped my segment
+          shm_unlink(segment_name.c_str());
+          unlinked = true;
+        }
+        if (received) {
+          idle = 0;
+        } else if (++idle < SHM_SPIN_COUNT) {
+          cpu_relax();
+        } else {
+          header->sleeping = 1;
+          __sync_synchronize();
+          futex_wait(&(header->doorbell), bell, 10);
+          header->sleeping = 0;
+        }
+      }
+      logstream(LOG_INFO) << "Shared memory receive loop Stopped" << std::endl;
+    }
+  }; // end of namespace dc_impl
+}; // end of namespace graphlab
@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef DC_SHM_COMM_HPP
+#define DC_SHM_COMM_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <map>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_tcp_comm.hpp>
+#include <graphlab/rpc/circular_iovec_buffer.hpp>
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ \ingroup rpc
+ \internal
+ A lock free single producer / single consumer byte ring which lives
+ in shared memory. head and tail are the total number of bytes ever
+ written and read, so the ring is empty when they are equal and full
+ when they differ by the capacity. Only the producer writes head and
+ only the consumer writes tail.
+*/
+struct shm_ring {
+  volatile uint64_t head;
+  char pad0[64 - sizeof(uint64_t)];
+  volatile uint64_t tail;
+  char pad1[64 - sizeof(uint64_t)];
+  uint64_t capacity;
+  char pad2[64 - sizeof(uint64_t)];
+
+  /// The ring data. capacity bytes follow the header
+  inline char* data() {
+    return reinterpret_cast<char*>(this) + sizeof(shm_ring);
+  }
+
+  /// Copies up to len bytes into the ring. Returns the number written.
+  size_t write(const char* buf, size_t len);
+
+  /// Copies up to len bytes out of the ring. Returns the number read.
+  size_t read(char* buf, size_t len);
+
+  /// Returns true if there is nothing to read. Only a hint for the producer
+  inline bool empty() const {
+    return head == tail;
+  }
+};
+
+
+/**
+ \ingroup rpc
+ \internal
+ The header of the shared memory segment owned by each process. The
+ segment holds one shm_ring for every other process on the same host,
+ in which that process writes the data sent to the owner.
+*/
+struct shm_segment_header {
+  /// incremented by the producers after every write
+  volatile uint32_t doorbell;
+  /// set by the consumer before it waits on the doorbell
+  volatile uint32_t sleeping;
+  /// number of producers which have mapped the segment
+  volatile uint32_t attached;
+  uint32_t num_rings;
+  uint64_t ring_size;
+  char pad[64 - 3 * sizeof(uint32_t) - sizeof(uint32_t) - sizeof(uint64_t)];
+};
+
+
+/**
+ \ingroup rpc
+ \internal
+Shared memory implementation of the communications subsystem.
+
+Processes which share a host (machines with the same address) exchange
+data through lock free single producer/single consumer rings in POSIX
+shared memory, avoiding the socket stack altogether. Remote peers
+are reached through an internal dc_tcp_comm. The TCP connections to
+the local peers are still established, and serve as the rendezvous
+which guarantees that all the segments exist before they are opened.
+
+Each process creates one segment, named after the machine list and
+its process ID, containing a ring for each local peer. The segment is
+unlinked as soon as all the local peers have mapped it, so that
+nothing is left behind in /dev/shm if a process dies.
+
+The following initialization options are accepted:
+\li \b shm_ring_size The size in bytes of each ring. Default 4MB.
+*/
+class dc_shm_comm:public dc_comm_base {
+ public:
+
+  inline dc_shm_comm() {
+    is_closed = true;
+  }
+
+  size_t capabilities() const {
+    return COMM_STREAM;
+  }
+
+  /**
+   Sets up the rings to the local peers and the TCP connections to the
+   remote peers. Pauses until all communication has been set up.
+   See dc_comm_base::init()
+  */
+  void init(const std::vector<std::string> &machines,
+            const std::map<std::string,std::string> &initopts,
+            procid_t curmachineid,
+            std::vector<dc_receive*> receiver,
+            std::vector<dc_send*> senders);
+
+  /** shuts down all rings and sockets and cleans up */
+  void close();
+
+  ~dc_shm_comm() {
+    close();
+  }
+
+  inline procid_t numprocs() const {
+    return nprocs;
+  }
+
+  inline procid_t procid() const {
+    return curid;
+  }
+
+  /// Returns the total number of bytes sent, including the rings
+  inline size_t network_bytes_sent() const {
+    return tcp.network_bytes_sent() + shm_bytessent.value;
+  }
+
+  /// Returns the total number of bytes received, including the rings
+  inline size_t network_bytes_received() const {
+    return tcp.network_bytes_received() + shm_bytesreceived.value;
+  }
+
+  inline size_t send_queue_length() const {
+    size_t a = shm_bytessent.value;
+    size_t b = shm_buffered_len.value;
+    return tcp.send_queue_length() + (b - a);
+  }
+
+  /// Returns true if the target is reached through shared memory
+  inline bool is_local(procid_t target) const {
+    return local_index[target] != size_t(-1);
+  }
+
+  void trigger_send_timeout(procid_t target, bool urgent);
+
+  /// The rings are not compressed. Remote peers are as negotiated by TCP
+  inline bool accepts_compressed(procid_t target) const {
+    return !is_local(target) && tcp.accepts_compressed(target);
+  }
+
+ private:
+  /// The state of the ring to a local peer
+  struct peer_info {
+    procid_t id;     /// which process this is
+    shm_ring* out;   /// ring in the segment of the peer
+    shm_segment_header* outheader;  /// header of the segment of the peer
+    void* outmap;    /// mapping of the segment of the peer
+    size_t outmaplen;
+    shm_ring* in;    /// ring in my segment written by the peer
+    mutex m;
+    circular_iovec_buffer outvec;  /// outgoing data not yet in the ring
+    volatile bool triggered;
+  };
+
+  procid_t curid;
+  procid_t nprocs;
+  bool is_closed;
+
+  /// for remote peers
+  dc_tcp_comm tcp;
+  /// replaces the local senders in the tcp comm
+  std::vector<dc_send*> tcp_sender;
+
+  std::vector<dc_receive*> receiver;
+  std::vector<dc_send*> sender;
+
+  /// the processes on this host, including this one, in increasing order
+  std::vector<procid_t> local_group;
+  /// local_index[i] is the index of i in local_peers, or -1 if remote
+  std::vector<size_t> local_index;
+  std::vector<peer_info*> local_peers;
+
+  /// the segment of this process
+  std::string segment_name;
+  shm_segment_header* header;
+  void* segment;
+  size_t segment_len;
+  bool unlinked;
+
+  size_t ring_size;
+
+  atomic<size_t> shm_bytessent;
+  atomic<size_t> shm_bytesreceived;
+  atomic<size_t> shm_buffered_len;
+
+  volatile bool done;
+  mutex send_lock;
+  conditional send_cond;
+  thread_group shmthreads;
+
+  /// name of the segment owned by a process
+  std::string segment_name_of(const std::vector<std::string>& machines,
+                              procid_t id) const;
+  /// creates the segment of this process
+  void create_segment(const std::vector<std::string>& machines);
+  /// maps the segment of a local peer
+  void open_peer_segment(peer_info& peer,
+                         const std::vector<std::string>& machines);
+  /// the index of the ring written by procid src in the segment of dest
+  size_t ring_index(procid_t src, procid_t dest) const;
+  /// returns the ring at index i of a segment
+  shm_ring* ring_at(shm_segment_header* h, size_t i) const;
+
+  /// moves as much outgoing data into the ring as possible
+  void process_peer(peer_info& peer);
+  /// rings the doorbell of a peer
+  void notify_peer(peer_info& peer);
+
+  void send_loop();
+  void receive_loop();
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -27,6 +27,7 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_stream_receive.hpp>
+#include <graphlab/util/lz_block_codec.hpp>
 
 //#define DC_RECEIVE_DEBUG
 namespace graphlab {
@@ -62,7 +63,10 @@ char* dc_stream_receive::advance_buffer(char* c, size_t wrotelength,
       // ok header is full. construct the return
       // bufer and switch to it.
       ASSERT_TRUE(writebuffer == NULL);
-      writebuffer = (char*)malloc(cur_chunk_header);
+      compressed = (cur_chunk_header & COMPRESSED_BLOCK_FLAG) != 0;
+      cur_chunk_header &= ~COMPRESSED_BLOCK_FLAG;
+      cur_buffer = allocate_recv_buffer(cur_chunk_header);
+      writebuffer = cur_buffer->data();
       retbuflength = cur_chunk_header;
       write_buffer_written = 0;
       return writebuffer;
@@ -80,8 +84,23 @@ char* dc_stream_receive::advance_buffer(char* c, size_t wrotelength,
   }
 
   // if we reach here, we have an available block
+  if (compressed) {
+    // the uncompressed length followed by the compressed data
+    ASSERT_GE(cur_chunk_header, sizeof(uint32_t));
+    uint32_t rawlen;
+    memcpy(&rawlen, writebuffer, sizeof(uint32_t));
+    recv_buffer* raw = allocate_recv_buffer(rawlen);
+    bool ok = lz_block::decompress(writebuffer + sizeof(uint32_t),
+                                   cur_chunk_header - sizeof(uint32_t),
+                                   raw->data(), rawlen);
+    ASSERT_MSG(ok, "Corrupt compressed block from %d", int(associated_proc));
+    release_recv_buffer(cur_buffer);
+    cur_buffer = raw;
+    cur_chunk_header = rawlen;
+  }
   // give away the buffer to dc
-  dc->deferred_function_call_chunk(writebuffer, cur_chunk_header, associated_proc);
+  dc->deferred_function_call_chunk(cur_buffer, cur_chunk_header, associated_proc);
+  cur_buffer = NULL;
   writebuffer = NULL;
   write_buffer_written = 0;
   header_read = 0;
@@ -28,6 +28,7 @@
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_receive.hpp>
+#include <graphlab/rpc/dc_recv_buffer.hpp>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/logger/logger.hpp>
@@ -45,12 +46,17 @@ namespace dc_impl {
   This can be thought of as a receiving end of a multiplexor.
   
   This is the default unbuffered receiver.
+
+  Each block is read straight into a reference counted recv_buffer
+  which is handed to the dc, so that the calls in it may keep views of
+  their arguments instead of copying them.
 */
 class dc_stream_receive: public dc_receive{
  public:
   
   dc_stream_receive(distributed_control* dc, procid_t associated_proc): 
-                  header_read(0), writebuffer(NULL), 
+                  header_read(0), compressed(false), cur_buffer(NULL),
+                  writebuffer(NULL), 
                   write_buffer_written(0), dc(dc), associated_proc(associated_proc)
                    { }
 
@@ -58,6 +64,9 @@ class dc_stream_receive: public dc_receive{
 
   size_t header_read;
   block_header_type cur_chunk_header;
+  /// whether the block being read is compressed
+  bool compressed;
+  recv_buffer* cur_buffer;
   char* writebuffer;
   size_t write_buffer_written;
   
@@ -31,6 +31,9 @@
 #include <netinet/tcp.h>
 #include <ifaddrs.h>
 #include <poll.h>
+#ifdef HAS_IO_URING
+#include <sys/eventfd.h>
+#endif
 
 #include <event2/event.h>
 #include <event2/thread.h>
@@ -70,8 +73,25 @@ namespace graphlab {
       // insert machines into the address map
       all_addrs.resize(nprocs);
       portnums.resize(nprocs);
-      assert(triggered_timeouts.size() >= nprocs);
+      triggered_timeouts.resize(nprocs);
       triggered_timeouts.clear();
+      link_flags.resize(nprocs, 0);
+      // compressed blocks are decoded unless compression is disabled
+      std::map<std::string, std::string>::const_iterator compiter =
+        initopts.find("compression");
+      my_link_flags = (compiter == initopts.end() || compiter->second == "no") ?
+                        0 : LINK_ACCEPTS_COMPRESSION;
+      // the socket driver
+      use_uring = false;
+      std::map<std::string, std::string>::const_iterator ioiter =
+        initopts.find("tcp_io");
+      if (ioiter != initopts.end()) {
+        if (ioiter->second == "uring") use_uring = true;
+        else if (ioiter->second != "event") {
+          logstream(LOG_FATAL) << "Invalid value for tcp_io: " << ioiter->second
+                               << ". Expected event or uring" << std::endl;
+        }
+      }
       // fill all the socks
       sock.resize(nprocs);
       for (size_t i = 0;i < nprocs; ++i) {
@@ -89,6 +109,10 @@ namespace graphlab {
         sock[i].data.msg_flags = 0;
         sock[i].data.msg_iovlen = 0;
         sock[i].data.msg_iov = NULL;
+        sock[i].send_inflight = false;
+        sock[i].recv_inflight = false;
+        sock[i].recvbuf = NULL;
+        sock[i].recvlen = 0;
       }
       // parse the machines list, and extract the relevant address information
       for (size_t i = 0;i < machines.size(); ++i) {
@@ -138,6 +162,26 @@ namespace graphlab {
       insock_lock.unlock();
       
       // everyone is connected.
+#ifdef HAS_IO_URING
+      if (use_uring && !construct_rings()) {
+        logstream(LOG_WARNING) << "io_uring is not available. "
+                               << "Falling back to libevent" << std::endl;
+        use_uring = false;
+      }
+      if (use_uring) {
+        // we reserve the last 2 cores for communication
+        inthreads.launch(boost::bind(&dc_tcp_comm::uring_receive_loop, this), thread::cpu_count() - 2);
+        outthreads.launch(boost::bind(&dc_tcp_comm::uring_send_loop, this), thread::cpu_count() - 1);
+        is_closed = false;
+        return;
+      }
+#else
+      if (use_uring) {
+        logstream(LOG_WARNING) << "io_uring support was not compiled. "
+                               << "Falling back to libevent" << std::endl;
+        use_uring = false;
+      }
+#endif
       // Construct the eventbase
       construct_events();
       // we reserve the last 2 cores for communication
@@ -188,6 +232,18 @@ namespace graphlab {
     }
 
     void dc_tcp_comm::trigger_send_timeout(procid_t target, bool urgent) {
+#ifdef HAS_IO_URING
+      if (use_uring) {
+        if (urgent) {
+          uring_send_urgent(sock[target]);
+        } else if (triggered_timeouts.set_bit(target) == false) {
+          uint64_t one = 1;
+          ssize_t ret = write(send_wakeup_fd, &one, sizeof(one));
+          ASSERT_EQ(ret, (ssize_t)sizeof(one));
+        }
+        return;
+      }
+#endif
       if (!urgent) {
         if (sock[target].wouldblock == false && 
             triggered_timeouts.get(target) == false) {
@@ -211,6 +267,41 @@ namespace graphlab {
       }
       // shutdown the listening thread
       listenthread.join();
+#ifdef HAS_IO_URING
+      if (use_uring) {
+        // the send loop quits once its queued sends complete
+        uring_stopping = true;
+        uint64_t one = 1;
+        ssize_t ret = write(send_wakeup_fd, &one, sizeof(one));
+        ASSERT_EQ(ret, (ssize_t)sizeof(one));
+        outthreads.join();
+        outring.destroy();
+        ::close(send_wakeup_fd);
+        logstream(LOG_INFO) << "Closing outgoing sockets" << std::endl;
+        for (size_t i = 0;i < sock.size(); ++i) {
+          if (sock[i].outsock > 0) {
+            ::close(sock[i].outsock);
+            sock[i].outsock = -1;
+          }
+        }
+        // the queued receives complete with 0 bytes once the sockets
+        // are shut down, which stops the receive loop
+        for (size_t i = 0;i < sock.size(); ++i) {
+          if (sock[i].insock > 0) ::shutdown(sock[i].insock, SHUT_RDWR);
+        }
+        inthreads.join();
+        inring.destroy();
+        logstream(LOG_INFO) << "Closing incoming sockets" << std::endl;
+        for (size_t i = 0;i < sock.size(); ++i) {
+          if (sock[i].insock > 0) {
+            ::close(sock[i].insock);
+            sock[i].insock = -1;
+          }
+        }
+        is_closed = true;
+        return;
+      }
+#endif
       
       // clear the outevent loop
       event_base_loopbreak(outevbase);
@@ -313,6 +404,22 @@ namespace graphlab {
       // set nonblocking
     }
     
+    int dc_tcp_comm::new_outgoing_socket() {
+      int newsock = socket(AF_INET, SOCK_STREAM, 0);
+      set_tcp_no_delay(newsock);
+      sockaddr_in my_addr;
+      my_addr.sin_family = AF_INET;
+      my_addr.sin_port = 0;
+      my_addr.sin_addr = *(struct in_addr*)&(all_addrs[curid]);
+      memset(&(my_addr.sin_zero), '\0', 8);
+      // the address may not be local (NAT). Let the kernel pick then
+      if (bind(newsock, (sockaddr*)&my_addr, sizeof(my_addr)) < 0) {
+        logstream(LOG_INFO) << "Unable to bind to my address: "
+                            << strerror(errno) << std::endl;
+      }
+      return newsock;
+    }
+
     void dc_tcp_comm::set_non_blocking(int fd) {
       int flag = fcntl(fd, F_GETFL);
       if (flag < 0) {
@@ -327,7 +434,7 @@ namespace graphlab {
 
 
     void dc_tcp_comm::new_socket(int newsock, sockaddr_in* otheraddr, 
-                                 procid_t id) {
+                                 procid_t id, unsigned char flags) {
       // figure out the address of the incoming connection
       uint32_t addr = *reinterpret_cast<uint32_t*>(&(otheraddr->sin_addr));
       // locate the incoming address in the list
@@ -337,6 +444,7 @@ namespace graphlab {
       ASSERT_EQ(all_addrs[id], addr);
       insock_lock.lock();
       ASSERT_EQ(sock[id].insock, -1);
+      link_flags[id] = flags;
       sock[id].insock = newsock;
       insock_cond.signal();
       insock_lock.unlock();
@@ -369,7 +477,7 @@ namespace graphlab {
       }
       logstream(LOG_INFO) << "Proc " << procid() 
                           << " listening on " << portnums[curid] << "\n";
-      ASSERT_EQ(0, listen(listensock, 128));
+      ASSERT_EQ(0, listen(listensock, SOMAXCONN));
       // spawn a thread which loops around accept
       listenthread.launch(boost::bind(&dc_tcp_comm::accept_handler, this));
     } // end of open_listening
@@ -378,8 +486,7 @@ namespace graphlab {
       if (sock[target].outsock != -1) {
         return;
       } else {
-        int newsock = socket(AF_INET, SOCK_STREAM, 0);
-        set_tcp_no_delay(newsock);
+        int newsock = new_outgoing_socket();
         sockaddr_in serv_addr;
         serv_addr.sin_family = AF_INET;
         // set the target port
@@ -405,11 +512,13 @@ namespace graphlab {
                Conforming applications should close the file descriptor and 
                create a new socket before attempting to reconnect. */
             ::close(newsock);
-            newsock = socket(AF_INET, SOCK_STREAM, 0);
-            set_tcp_no_delay(newsock);
+            newsock = new_outgoing_socket();
           } else {
-            // send my machine id
-            sendtosock(newsock, reinterpret_cast<char*>(&curid), sizeof(curid));
+            // send my machine id followed by the link flags
+            char hello[sizeof(procid_t) + 1];
+            memcpy(hello, &curid, sizeof(procid_t));
+            hello[sizeof(procid_t)] = (char)my_link_flags;
+            sendtosock(newsock, hello, sizeof(hello));
             set_non_blocking(newsock);
             success = true;
             break;
@@ -458,11 +567,12 @@ namespace graphlab {
           // set the socket options and inform the 
           set_tcp_no_delay(newsock);
           // before accepting the socket, get the machine number
-          procid_t remotemachineid = (procid_t)(-1);
+          // and the link flags
+          char hello[sizeof(procid_t) + 1];
           ssize_t msglen = 0;
-          while(msglen != sizeof(procid_t)) {
-            int retval = recv(newsock, (char*)(&remotemachineid) + msglen,
-                           sizeof(procid_t) - msglen, 0);
+          while(msglen != sizeof(hello)) {
+            int retval = recv(newsock, hello + msglen,
+                           sizeof(hello) - msglen, 0);
             if (retval < 0) {
               if (errno == EWOULDBLOCK || errno == EAGAIN) {
                 continue;
@@ -484,7 +594,10 @@ namespace graphlab {
           if (newsock != -1) {
             // register the new socket
             set_non_blocking(newsock);
-            new_socket(newsock, &their_addr, remotemachineid);
+            procid_t remotemachineid;
+            memcpy(&remotemachineid, hello, sizeof(procid_t));
+            new_socket(newsock, &their_addr, remotemachineid,
+                       (unsigned char)hello[sizeof(procid_t)]);
             ++numsocks_connected;
           }
         }
@@ -601,6 +714,240 @@ namespace graphlab {
         logstream(LOG_INFO) << "Send loop Stopped" << std::endl;
       }
     }
+
+
+#ifdef HAS_IO_URING
+////////////////////////////////////////////////////////////////////////////
+//       io_uring driver                                                  //
+////////////////////////////////////////////////////////////////////////////
+
+    // user data of the requests which are not socket sends or receives
+    static const uint64_t URING_WAKEUP_TAG = uint64_t(-1);
+    static const uint64_t URING_TIMEOUT_TAG = uint64_t(-2);
+    // set in the user data of a poll, together with the socket id
+    static const uint64_t URING_POLL_FLAG = uint64_t(1) << 32;
+
+    bool dc_tcp_comm::construct_rings() {
+      // every socket has at most one request queued in a ring,
+      // plus the wakeup read and the timer of the send ring
+      const unsigned entries = (unsigned)(nprocs + 2);
+      if (!inring.init(entries) || !outring.init(entries)) {
+        inring.destroy();
+        outring.destroy();
+        return false;
+      }
+      std::vector<int> infds(nprocs), outfds(nprocs);
+      for (size_t i = 0;i < sock.size(); ++i) {
+        infds[i] = sock[i].insock;
+        outfds[i] = sock[i].outsock;
+      }
+      send_wakeup_fd = eventfd(0, 0);
+      if (send_wakeup_fd < 0 || 
+          !inring.register_files(infds) || !outring.register_files(outfds)) {
+        if (send_wakeup_fd >= 0) ::close(send_wakeup_fd);
+        inring.destroy();
+        outring.destroy();
+        return false;
+      }
+      uring_stopping = false;
+      logstream(LOG_INFO) << "Sockets driven by io_uring" << std::endl;
+      return true;
+    }
+
+
+    void dc_tcp_comm::uring_post_recv(socket_info& sockinfo) {
+      struct io_uring_sqe* sqe = inring.get_sqe();
+      ASSERT_TRUE(sqe != NULL);
+      uring_prep_recv(sqe, sockinfo.id, sockinfo.recvbuf, sockinfo.recvlen,
+                      sockinfo.id);
+      sockinfo.recv_inflight = true;
+    }
+
+
+    void dc_tcp_comm::uring_post_poll(uring_queue& ring, socket_info& sockinfo,
+                                      unsigned events) {
+      struct io_uring_sqe* sqe = ring.get_sqe();
+      ASSERT_TRUE(sqe != NULL);
+      uring_prep_poll_add(sqe, sockinfo.id, events,
+                          sockinfo.id | URING_POLL_FLAG);
+    }
+
+
+    void dc_tcp_comm::uring_receive_loop() {
+      logstream(LOG_INFO) << "Receive loop Started" << std::endl;
+      size_t num_inflight = 0;
+      for (size_t i = 0;i < sock.size(); ++i) {
+        sock[i].recvbuf = receiver[i]->get_buffer(sock[i].recvlen);
+        uring_post_recv(sock[i]);
+        ++num_inflight;
+      }
+      while(num_inflight > 0) {
+        int ret = inring.submit_and_wait(1);
+        if (ret < 0) {
+          logstream(LOG_FATAL) << "io_uring receive error: "
+                               << strerror(-ret) << std::endl;
+        }
+        // collect all the completions before submitting again
+        struct io_uring_cqe* cqe;
+        while((cqe = inring.peek_cqe()) != NULL) {
+          const uint64_t tag = cqe->user_data;
+          socket_info& sockinfo = sock[tag & ~URING_POLL_FLAG];
+          const int res = cqe->res;
+          inring.cqe_seen();
+          if (tag & URING_POLL_FLAG) {
+            // the socket has data, or was shut down
+            uring_post_recv(sockinfo);
+            continue;
+          }
+          sockinfo.recv_inflight = false;
+          if (res > 0) {
+            network_bytesreceived.inc(res);
+#ifdef COMM_DEBUG
+            logstream(LOG_INFO) << res << " bytes <-- "
+                                << sockinfo.id  << std::endl;
+#endif
+            sockinfo.recvbuf = receiver[sockinfo.id]->advance_buffer(
+                                  sockinfo.recvbuf, res, sockinfo.recvlen);
+            uring_post_recv(sockinfo);
+          } else if (res == -EAGAIN || res == -EINTR) {
+            // wait for data instead of retrying at once
+            sockinfo.recv_inflight = true;
+            uring_post_poll(inring, sockinfo, POLLIN);
+          } else if (res == 0 || uring_stopping) {
+            // socket closed
+            --num_inflight;
+          } else {
+            logstream(LOG_FATAL) << "receive error: " << strerror(-res) << std::endl;
+          }
+        }
+      }
+      logstream(LOG_INFO) << "Receive loop Stopped" << std::endl;
+    }
+
+
+    bool dc_tcp_comm::uring_post_send(socket_info& sockinfo) {
+      if (sockinfo.send_inflight) return false;
+      check_for_new_data(sockinfo);
+      if (sockinfo.outvec.empty()) return false;
+      struct io_uring_sqe* sqe = outring.get_sqe();
+      ASSERT_TRUE(sqe != NULL);
+      sockinfo.outvec.fill_msghdr(sockinfo.data);
+      uring_prep_sendmsg(sqe, sockinfo.id, &sockinfo.data, sockinfo.id);
+      sockinfo.send_inflight = true;
+      return true;
+    }
+
+
+    void dc_tcp_comm::uring_send_complete(socket_info& sockinfo, int res) {
+      sockinfo.m.lock();
+      if (res == -EAGAIN || res == -EINTR) {
+        // the socket is full. outvec stays with the ring, which sends
+        // it once the socket is writable instead of retrying at once
+        uring_post_poll(outring, sockinfo, POLLOUT);
+        sockinfo.m.unlock();
+        return;
+      }
+      sockinfo.send_inflight = false;
+      if (res >= 0) {
+#ifdef COMM_DEBUG
+        logstream(LOG_INFO) << res << " bytes --> " << sockinfo.id << std::endl;
+#endif
+        network_bytessent.inc(res);
+        sockinfo.outvec.sent(res);
+      } else {
+        logstream(LOG_FATAL) << "send error: " << strerror(-res) << std::endl;
+      }
+      // keep going with whatever remains, and whatever was added
+      uring_post_send(sockinfo);
+      sockinfo.m.unlock();
+    }
+
+
+    void dc_tcp_comm::uring_send_urgent(socket_info& sockinfo) {
+      // a send queued in the ring owns outvec. The completion of that
+      // send picks up the new data.
+      if (sockinfo.m.try_lock()) {
+        if (!sockinfo.send_inflight) {
+          check_for_new_data(sockinfo);
+          if (!sockinfo.outvec.empty() && !send_till_block(sockinfo)) {
+            // leave the rest to the ring, which waits for the socket
+            sockinfo.m.unlock();
+            trigger_send_timeout(sockinfo.id, false);
+            return;
+          }
+        }
+        sockinfo.m.unlock();
+      }
+    }
+
+
+    void dc_tcp_comm::uring_send_loop() {
+      logstream(LOG_INFO) << "Send loop Started" << std::endl;
+      uint64_t wakeup_count;
+      struct __kernel_timespec send_all_interval;
+      send_all_interval.tv_sec = 0;
+      send_all_interval.tv_nsec = 10000000;
+      uring_prep_read(outring.get_sqe(), send_wakeup_fd, &wakeup_count,
+                      sizeof(wakeup_count), URING_WAKEUP_TAG);
+      uring_prep_timeout(outring.get_sqe(), &send_all_interval,
+                         URING_TIMEOUT_TAG);
+      // the wakeup read, the timer and the queued sends
+      size_t num_inflight = 2;
+      while(num_inflight > 0) {
+        int ret = outring.submit_and_wait(1);
+        if (ret < 0) {
+          logstream(LOG_FATAL) << "io_uring send error: "
+                               << strerror(-ret) << std::endl;
+        }
+        bool send_all = false;
+        struct io_uring_cqe* cqe;
+        while((cqe = outring.peek_cqe()) != NULL) {
+          const uint64_t tag = cqe->user_data;
+          const int res = cqe->res;
+          outring.cqe_seen();
+          if (tag == URING_WAKEUP_TAG) {
+            if (uring_stopping) {
+              --num_inflight;
+            } else {
+              uring_prep_read(outring.get_sqe(), send_wakeup_fd,
+                              &wakeup_count, sizeof(wakeup_count),
+                              URING_WAKEUP_TAG);
+            }
+          } else if (tag == URING_TIMEOUT_TAG) {
+            send_all = true;
+            if (uring_stopping) {
+              --num_inflight;
+            } else {
+              uring_prep_timeout(outring.get_sqe(), &send_all_interval,
+                                 URING_TIMEOUT_TAG);
+            }
+          } else if (tag & URING_POLL_FLAG) {
+            // the socket is writable again
+            socket_info& sockinfo = sock[tag & ~URING_POLL_FLAG];
+            sockinfo.m.lock();
+            sockinfo.send_inflight = false;
+            uring_post_send(sockinfo);
+            sockinfo.m.unlock();
+            if (!sockinfo.send_inflight) --num_inflight;
+          } else {
+            socket_info& sockinfo = sock[tag];
+            uring_send_complete(sockinfo, res);
+            if (!sockinfo.send_inflight) --num_inflight;
+          }
+        }
+        // queue the sends of all the sockets with data together
+        for (uint32_t i = 0;i < sock.size(); ++i) {
+          if (send_all || triggered_timeouts.get(i)) {
+            triggered_timeouts.clear_bit(i);
+            sock[i].m.lock();
+            num_inflight += uring_post_send(sock[i]);
+            sock[i].m.unlock();
+          }
+        }
+      }
+      logstream(LOG_INFO) << "Send loop Stopped" << std::endl;
+    }
+#endif
   }; // end of namespace dc_impl
 }; // end of namespace graphlab
 
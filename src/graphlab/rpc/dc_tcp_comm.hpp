@@ -36,6 +36,7 @@
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_comm_base.hpp>
 #include <graphlab/rpc/circular_iovec_buffer.hpp>
+#include <graphlab/rpc/dc_uring.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/dense_bitset.hpp>
 namespace graphlab {
@@ -51,6 +52,13 @@ void on_send_event(int fd, short ev, void* arg);
 TCP implementation of the communications subsystem.
 Provides a single object interface to sending/receiving data streams to
 a collection of machines.
+
+By default the sockets are driven by libevent. With the init option
+tcp_io=uring, and where the kernel supports it, one thread drives all
+outgoing sockets and one thread all incoming sockets through io_uring
+instead: the sends and receives of every socket ready at a given time
+are submitted together, and their completions collected, in a single
+system call.
 */
 class dc_tcp_comm:public dc_comm_base {
  public:
@@ -74,7 +82,7 @@ class dc_tcp_comm:public dc_comm_base {
    attached receiver
    
    machines: a vector of strings where each string is of the form [IP]:[portnumber]
-   initopts: unused
+   initopts: "compression" and "tcp_io". See dc_init_param
    curmachineid: The ID of the current machine. machines[curmachineid] will be 
                  the listening address of this machine
    
@@ -142,6 +150,11 @@ class dc_tcp_comm:public dc_comm_base {
   void send(size_t target, const char* buf, size_t len);
   
   void trigger_send_timeout(procid_t target, bool urgent);
+
+  /// Returns true if the target announced that it decodes compressed blocks
+  inline bool accepts_compressed(procid_t target) const {
+    return link_flags[target] & LINK_ACCEPTS_COMPRESSION;
+  }
   
  private:
   /// Sets TCP_NO_DELAY on the socket passed in fd
@@ -149,8 +162,16 @@ class dc_tcp_comm:public dc_comm_base {
   
   void set_non_blocking(int fd);
 
+  /**
+   * Creates a socket for a connection to another machine. The socket is
+   * bound to the address of this machine in the machine list, so that
+   * the other end sees the expected address on multi-homed hosts.
+   */
+  int new_outgoing_socket();
+
   /// called when listener receives an incoming socket request
-  void new_socket(int newsock, sockaddr_in* otheraddr, procid_t remotemachineid);
+  void new_socket(int newsock, sockaddr_in* otheraddr, procid_t remotemachineid,
+                  unsigned char flags);
   
   /** opens the listening sock and spawns a thread to listen on it.
    * Uses sockhandle if non-zero
@@ -178,6 +199,13 @@ class dc_tcp_comm:public dc_comm_base {
   std::vector<dc_receive*> receiver;
   std::vector<dc_send*> sender;
   atomic<size_t> buffered_len;
+
+  /// the flags sent by each machine when it connects to this machine
+  std::vector<unsigned char> link_flags;
+  /// the flags this machine sends when connecting
+  unsigned char my_link_flags;
+  /// whether the sockets are driven by io_uring instead of libevent
+  bool use_uring;
   
  
   
@@ -197,6 +225,12 @@ class dc_tcp_comm:public dc_comm_base {
 
     circular_iovec_buffer outvec;  /// outgoing data
     struct msghdr data; 
+
+    // io_uring state. send_inflight is protected by m.
+    bool send_inflight; /// whether outvec is being sent by the send ring
+    bool recv_inflight; /// whether a receive is queued in the receive ring
+    char* recvbuf;      /// where the next receive goes
+    size_t recvlen;     /// the room at recvbuf
   };
 
   mutex insock_lock; /// locks the insock field in socket_info
@@ -245,7 +279,40 @@ class dc_tcp_comm:public dc_comm_base {
   timeout_event send_triggered_timeout;
   timeout_event send_all_timeout;
 
-  fixed_dense_bitset<256> triggered_timeouts;  
+  dense_bitset triggered_timeouts;
+
+#ifdef HAS_IO_URING
+  ////////////       io_uring      //////////////////////
+  uring_queue inring;
+  uring_queue outring;
+  /// an eventfd waking up the send ring when a send is triggered
+  int send_wakeup_fd;
+  /// set by close() to stop the rings
+  volatile bool uring_stopping;
+
+  /// Sets up the rings. Returns false if io_uring cannot be used
+  bool construct_rings();
+  void uring_receive_loop();
+  void uring_send_loop();
+  /// Queues a receive of the socket into its receiver's buffer
+  void uring_post_recv(socket_info& sockinfo);
+  /**
+   * Queues a wait in ring until the socket has the events (POLLIN or
+   * POLLOUT). Used when a receive or send would block, in place of
+   * retrying it at once.
+   */
+  void uring_post_poll(uring_queue& ring, socket_info& sockinfo,
+                       unsigned events);
+  /**
+   * Queues a send of the data waiting for the socket, unless a send is
+   * already queued. Returns true if a send was queued.
+   */
+  bool uring_post_send(socket_info& sockinfo);
+  /// Handles the completion of a queued send with result res
+  void uring_send_complete(socket_info& sockinfo, int res);
+  /// Sends the data waiting for the socket from the calling thread
+  void uring_send_urgent(socket_info& sockinfo);
+#endif
   ////////////       Listening Sockets     //////////////////////
   int listensock;
   thread listenthread;
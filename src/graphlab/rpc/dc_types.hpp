@@ -36,10 +36,22 @@ namespace graphlab {
    */
   enum dc_comm_type {
     TCP_COMM,   ///< TCP/IP
-    SCTP_COMM   ///< SCTP (limited support)
+    SCTP_COMM,  ///< SCTP (limited support)
+    SHM_COMM    ///< Shared memory between processes on the same host, TCP/IP otherwise
   };
 
 
+  /**
+   * \ingroup rpc
+   * How broadcast(), all_gather() and all_reduce() distribute their
+   * result. See distributed_control::set_collective_algorithm()
+   */
+  enum collective_algorithm {
+    COLLECTIVE_AUTO,  ///< Chosen by payload size and number of machines
+    COLLECTIVE_TREE,  ///< Binomial tree. Latency optimal
+    COLLECTIVE_RING   ///< Pipelined ring. Bandwidth optimal
+  };
+
   /**
    * \internal
    * \ingroup rpc
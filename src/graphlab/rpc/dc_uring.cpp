@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <graphlab/rpc/dc_uring.hpp>
+
+#ifdef HAS_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace graphlab {
+namespace dc_impl {
+
+uring_queue::uring_queue() : ringfd(-1), sq_ptr(MAP_FAILED), sq_ptr_len(0),
+                             sqes(NULL), sqes_len(0), sq_local_tail(0),
+                             sq_entries(0), cq_ptr(MAP_FAILED),
+                             cq_ptr_len(0) { }
+
+bool uring_queue::init(unsigned entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  ringfd = (int)syscall(__NR_io_uring_setup, entries, &p);
+  if (ringfd < 0) {
+    ringfd = -1;
+    return false;
+  }
+  sq_entries = p.sq_entries;
+  sq_ptr_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_ptr_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  // newer kernels map both rings with a single mmap
+  const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap && cq_ptr_len > sq_ptr_len) sq_ptr_len = cq_ptr_len;
+  sq_ptr = mmap(NULL, sq_ptr_len, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED) {
+    destroy();
+    return false;
+  }
+  if (single_mmap) {
+    cq_ptr = sq_ptr;
+  } else {
+    cq_ptr = mmap(NULL, cq_ptr_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      destroy();
+      return false;
+    }
+  }
+  sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes_ptr = mmap(NULL, sqes_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+  if (sqes_ptr == MAP_FAILED) {
+    destroy();
+    return false;
+  }
+  sqes = (struct io_uring_sqe*)sqes_ptr;
+
+  char* sq = (char*)sq_ptr;
+  sq_head = (unsigned*)(sq + p.sq_off.head);
+  sq_tail = (unsigned*)(sq + p.sq_off.tail);
+  sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+  sq_array = (unsigned*)(sq + p.sq_off.array);
+  sq_local_tail = *sq_tail;
+  char* cq = (char*)cq_ptr;
+  cq_head = (unsigned*)(cq + p.cq_off.head);
+  cq_tail = (unsigned*)(cq + p.cq_off.tail);
+  cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+  cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+  return true;
+}
+
+void uring_queue::destroy() {
+  if (sqes != NULL) munmap(sqes, sqes_len);
+  if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_ptr_len);
+  if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_ptr_len);
+  if (ringfd >= 0) ::close(ringfd);
+  ringfd = -1;
+  sqes = NULL;
+  sq_ptr = cq_ptr = MAP_FAILED;
+}
+
+bool uring_queue::register_files(const std::vector<int>& fds) {
+  return syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_FILES,
+                 &(fds[0]), (unsigned)fds.size()) == 0;
+}
+
+struct io_uring_sqe* uring_queue::get_sqe() {
+  const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+  if (sq_local_tail - head >= sq_entries) return NULL;
+  const unsigned index = sq_local_tail & *sq_mask;
+  sq_array[index] = index;
+  ++sq_local_tail;
+  return &sqes[index];
+}
+
+int uring_queue::submit_and_wait(unsigned min_complete) {
+  const unsigned to_submit = sq_local_tail - *sq_tail;
+  __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+  while (1) {
+    int ret = (int)syscall(__NR_io_uring_enter, ringfd, to_submit,
+                           min_complete,
+                           min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                           NULL, 0);
+    if (ret >= 0) return ret;
+    // the entries were consumed if the wait was interrupted
+    if (errno == EINTR) return 0;
+    if (errno != EAGAIN && errno != EBUSY) return -errno;
+  }
+}
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
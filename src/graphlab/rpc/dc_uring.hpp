@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_RPC_DC_URING_HPP
+#define GRAPHLAB_RPC_DC_URING_HPP
+
+#ifdef HAS_IO_URING
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc
+ * \internal
+ * A minimal io_uring submission/completion queue pair, talking to the
+ * kernel through the raw system calls.
+ *
+ * Only one thread may use a queue. Entries are obtained with get_sqe(),
+ * filled with one of the prep functions, and handed to the kernel in a
+ * single system call by submit_and_wait(), which also waits for
+ * completions. Completions are then consumed with peek_cqe() and
+ * cqe_seen().
+ */
+class uring_queue {
+ public:
+  uring_queue();
+
+  ~uring_queue() {
+    destroy();
+  }
+
+  /**
+   * Creates a queue with room for at least entries submissions.
+   * Returns false if the kernel does not support io_uring.
+   */
+  bool init(unsigned entries);
+
+  /// Releases the queue. Pending requests are cancelled by the kernel
+  void destroy();
+
+  inline bool initialized() const {
+    return ringfd >= 0;
+  }
+
+  /**
+   * Registers the file descriptors. The prep functions with a fixed
+   * file take an index into fds instead of a file descriptor, which
+   * saves a file table lookup and reference count per request.
+   */
+  bool register_files(const std::vector<int>& fds);
+
+  /// Returns an empty submission entry or NULL if the queue is full
+  struct io_uring_sqe* get_sqe();
+
+  /**
+   * Submits all the entries obtained since the last call and waits
+   * until at least min_complete completions are available.
+   * Returns a negative errno on failure.
+   */
+  int submit_and_wait(unsigned min_complete);
+
+  /// Returns the oldest unconsumed completion, or NULL if there is none
+  inline struct io_uring_cqe* peek_cqe() {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &cqes[head & *cq_mask];
+  }
+
+  /// Consumes the completion returned by peek_cqe()
+  inline void cqe_seen() {
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+  }
+
+ private:
+  int ringfd;
+  // submission ring
+  void* sq_ptr;
+  size_t sq_ptr_len;
+  unsigned* sq_head;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  struct io_uring_sqe* sqes;
+  size_t sqes_len;
+  /// entries obtained by get_sqe() which were not yet submitted
+  unsigned sq_local_tail;
+  unsigned sq_entries;
+  // completion ring
+  void* cq_ptr;
+  size_t cq_ptr_len;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+
+  uring_queue(const uring_queue&);
+  uring_queue& operator=(const uring_queue&);
+};
+
+
+/// \internal Fills sqe with an operation on a file or a fixed file
+inline void uring_prep_rw(struct io_uring_sqe* sqe, unsigned char opcode,
+                          int fd, bool fixed_file, const void* addr,
+                          unsigned len, uint64_t user_data) {
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  if (fixed_file) sqe->flags = IOSQE_FIXED_FILE;
+  sqe->addr = (uint64_t)(uintptr_t)addr;
+  sqe->len = len;
+  sqe->user_data = user_data;
+}
+
+/// Prepares a sendmsg() on the fixed file index
+inline void uring_prep_sendmsg(struct io_uring_sqe* sqe, int index,
+                               const struct msghdr* msg, uint64_t user_data) {
+  uring_prep_rw(sqe, IORING_OP_SENDMSG, index, true, msg, 1, user_data);
+  sqe->msg_flags = MSG_NOSIGNAL;
+}
+
+/// Prepares a recv() of at most len bytes on the fixed file index
+inline void uring_prep_recv(struct io_uring_sqe* sqe, int index,
+                            char* buf, size_t len, uint64_t user_data) {
+  uring_prep_rw(sqe, IORING_OP_RECV, index, true, buf, (unsigned)len,
+                user_data);
+}
+
+/**
+ * Prepares a one shot poll() for events (POLLIN, POLLOUT) on the fixed
+ * file index. Completes once the socket is ready, with the ready events.
+ */
+inline void uring_prep_poll_add(struct io_uring_sqe* sqe, int index,
+                                unsigned events, uint64_t user_data) {
+  uring_prep_rw(sqe, IORING_OP_POLL_ADD, index, true, NULL, 0, user_data);
+  // the 16 bit field is read correctly by all kernels and byte orders
+  sqe->poll_events = (uint16_t)events;
+}
+
+/// Prepares a read() of len bytes on the file descriptor
+inline void uring_prep_read(struct io_uring_sqe* sqe, int fd,
+                            void* buf, size_t len, uint64_t user_data) {
+  uring_prep_rw(sqe, IORING_OP_READ, fd, false, buf, (unsigned)len,
+                user_data);
+  sqe->off = (uint64_t)-1;
+}
+
+/// Prepares a timer completing after the time in ts
+inline void uring_prep_timeout(struct io_uring_sqe* sqe,
+                               const struct __kernel_timespec* ts,
+                               uint64_t user_data) {
+  uring_prep_rw(sqe, IORING_OP_TIMEOUT, -1, false, ts, 1, user_data);
+}
+
+} // namespace dc_impl
+} // namespace graphlab
+
+#endif
+#endif
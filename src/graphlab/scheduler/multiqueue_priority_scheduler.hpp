@@ -0,0 +1,287 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_MULTIQUEUE_PRIORITY_SCHEDULER_HPP
+#define GRAPHLAB_MULTIQUEUE_PRIORITY_SCHEDULER_HPP
+
+#include <vector>
+#include <limits>
+#include <stdint.h>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
+#include <graphlab/util/random.hpp>
+
+#include <graphlab/util/mutable_queue.hpp>
+#include <graphlab/scheduler/ischeduler.hpp>
+#include <graphlab/parallel/atomic_add_vector2.hpp>
+#include <graphlab/scheduler/get_message_priority.hpp>
+#include <graphlab/options/graphlab_options.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup group_schedulers
+   *
+   * A relaxed concurrent priority scheduler (MultiQueue, Rihani,
+   * Sanders and Dementiev, SPAA 2015). The vertices are spread over
+   * multi * ncpus locked priority queues. To find the next vertex a
+   * thread looks at the tops of two randomly chosen queues and pops
+   * from the one with the higher priority. The vertices are therefore
+   * returned in approximate priority order while the threads rarely
+   * contend for a lock.
+   *
+   * A vertex always lives in the same queue, chosen by a hash of its
+   * id, so that the priority of a vertex which is already queued is
+   * updated in place as messages are combined.
+   */
+  template<typename Message>
+  class multiqueue_priority_scheduler : public ischeduler<Message> {
+  public:
+
+    typedef Message message_type;
+
+    typedef mutable_queue<lvid_type, double> queue_type;
+
+  private:
+    atomic_add_vector2<message_type> messages;
+    std::vector<queue_type> queues;
+    std::vector<simple_spinlock> locks;
+    // the priority of the top of each queue, or -inf if it is empty.
+    // read without holding the lock.
+    std::vector<cache_line_pad<double> > top_priority;
+    // per thread random number generator state
+    std::vector<cache_line_pad<size_t> > rand_state;
+    size_t multi;
+    double min_priority;
+
+    /** The queue holding a vertex */
+    size_t queue_of(const lvid_type vid) const {
+      return size_t((uint64_t(vid) * 0x9E3779B97F4A7C15ULL) >> 32)
+        % queues.size();
+    }
+
+    /** A fast xorshift generator. Owner only. */
+    size_t next_rand(const size_t cpuid) {
+      size_t x = rand_state[cpuid].value;
+      x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+      rand_state[cpuid].value = x;
+      return x;
+    }
+
+    /** Updates the cached top priority of a queue. Lock must be held. */
+    void update_top(const size_t idx) {
+      top_priority[idx].value = queues[idx].empty() ?
+        -std::numeric_limits<double>::max() : queues[idx].top().second;
+    }
+
+    /** Inserts or raises the priority of a vertex */
+    void push(const lvid_type vid, const double priority) {
+      const size_t idx = queue_of(vid);
+      locks[idx].lock();
+      queues[idx].push_or_update(vid, priority);
+      update_top(idx);
+      locks[idx].unlock();
+    }
+
+    /**
+     * Pops the top of the queue if it is above min_priority.
+     * Returns false if there is no such vertex.
+     */
+    bool try_pop(const size_t idx, lvid_type& ret_vid) {
+      bool success = false;
+      locks[idx].lock();
+      if(!queues[idx].empty() &&
+         queues[idx].top().second >= min_priority) {
+        ret_vid = queues[idx].pop().first;
+        update_top(idx);
+        success = true;
+      }
+      locks[idx].unlock();
+      return success;
+    }
+
+  public:
+
+    multiqueue_priority_scheduler(size_t num_vertices,
+                                  const graphlab_options& opts) :
+      messages(num_vertices), multi(2),
+      min_priority(-std::numeric_limits<double>::max()) {
+      set_options(opts);
+    }
+
+    void set_options(const graphlab_options& opts) {
+      size_t new_ncpus = opts.get_ncpus();
+      // check if ncpus changed
+      if (new_ncpus != rand_state.size()) {
+        logstream(LOG_INFO) << "Changing ncpus from " << rand_state.size()
+                            << " to " << new_ncpus << std::endl;
+        ASSERT_GE(new_ncpus, 1);
+        rand_state.resize(new_ncpus);
+        for (size_t i = 0; i < rand_state.size(); ++i) {
+          rand_state[i].value = i + 1;
+        }
+      }
+
+      std::vector<std::string> keys = opts.get_scheduler_args().get_option_keys();
+      foreach(std::string opt, keys) {
+        if (opt == "multi") {
+          opts.get_scheduler_args().get_option("multi", multi);
+        } else if (opt == "min_priority") {
+          opts.get_scheduler_args().get_option("min_priority", min_priority);
+        } else {
+          logstream(LOG_FATAL) << "Unexpected Scheduler Option: " << opt << std::endl;
+        }
+      }
+
+      // the two choice pop needs at least two queues
+      const size_t nqueues = std::max(multi * rand_state.size(), size_t(2));
+      // changing the number of queues.
+      // reinsert everything
+      if (nqueues != queues.size()) {
+        std::vector<queue_type> old_queues;
+        std::swap(old_queues, queues);
+        queues.resize(nqueues);
+        locks.resize(nqueues);
+        top_priority.resize(nqueues);
+        for (size_t i = 0; i < nqueues; ++i) update_top(i);
+        for (size_t i = 0;i < old_queues.size(); ++i) {
+          while (!old_queues[i].empty()) {
+            push(old_queues[i].top().first, old_queues[i].top().second);
+            old_queues[i].pop();
+          }
+        }
+      }
+    }
+
+    void start() {  }
+
+
+    void schedule(const lvid_type vid,
+                  const message_type& msg) {
+      message_type combined_message;
+      messages.add(vid, msg, combined_message);
+      const double priority =
+        scheduler_impl::get_message_priority(combined_message);
+      // If the new priority will is above priority, put it in the queue
+      if (priority >= min_priority) push(vid, priority);
+    } // end of schedule
+
+
+    void schedule_from_execution_thread(const size_t cpuid,
+                                        const lvid_type vid) {
+      message_type combined_message;
+      if (!messages.peek(vid, combined_message)) return;
+      const double priority =
+        scheduler_impl::get_message_priority(combined_message);
+      // If the new priority will is above priority, put it in the queue
+      if (priority >= min_priority) push(vid, priority);
+    } // end of schedule_from_execution_thread
+
+
+    void schedule_all(const message_type& msg,
+                      const std::string& order) {
+      if(order == "shuffle") {
+        std::vector<lvid_type> permutation =
+          random::permutation<lvid_type>(messages.size());
+        foreach(lvid_type vid, permutation)  schedule(vid, msg);
+      } else {
+        for (lvid_type vid = 0; vid < messages.size(); ++vid)
+          schedule(vid, msg);
+      }
+    } // end of schedule_all
+
+    void completed(const size_t cpuid,
+                   const lvid_type vid,
+                   const message_type& msg) { }
+
+
+    /** Get the next element in the queue */
+    sched_status::status_enum get_next(const size_t cpuid,
+                                       lvid_type& ret_vid,
+                                       message_type& ret_msg) {
+      ASSERT_LT(cpuid, rand_state.size());
+      const size_t nqueues = queues.size();
+      // pop the better of two random queues while they are not empty
+      size_t misses = 0;
+      while (misses < 2) {
+        const size_t i = next_rand(cpuid) % nqueues;
+        const size_t j = next_rand(cpuid) % nqueues;
+        const size_t idx =
+          top_priority[i].value >= top_priority[j].value ? i : j;
+        if (try_pop(idx, ret_vid)) {
+          if (messages.test_and_get(ret_vid, ret_msg))
+            return sched_status::NEW_TASK;
+        } else {
+          ++misses;
+        }
+      }
+      // most queues are empty. check all of them
+      const size_t start = next_rand(cpuid) % nqueues;
+      for (size_t i = 0; i < nqueues; ++i) {
+        const size_t idx = (start + i) % nqueues;
+        while (top_priority[idx].value >= min_priority &&
+               try_pop(idx, ret_vid)) {
+          if (messages.test_and_get(ret_vid, ret_msg))
+            return sched_status::NEW_TASK;
+        }
+      }
+      return sched_status::EMPTY;
+    } // end of get_next
+
+
+    size_t num_joins() const {
+      return messages.num_joins();
+    }
+
+
+    sched_status::status_enum
+    get_specific(lvid_type vid,
+                 message_type& ret_msg) {
+      bool get_success = messages.test_and_get(vid, ret_msg);
+      if (get_success) return sched_status::NEW_TASK;
+      else return sched_status::EMPTY;
+    }
+
+    void place(lvid_type vid,
+               const message_type& msg) {
+      messages.add(vid, msg);
+    }
+
+
+    static void print_options_help(std::ostream& out) {
+      out << "\t multi = [number of queues per thread. Default = 2].\n"
+          << "min_priority = [double, minimum priority required to receive \n"
+          << "\t a message, default = -inf]\n";
+    }
+
+  }; // end of class multiqueue_priority_scheduler
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -25,9 +25,11 @@
 #include <graphlab/scheduler/fifo_scheduler.hpp>
 #include <graphlab/scheduler/get_message_priority.hpp>
 #include <graphlab/scheduler/ischeduler.hpp>
+#include <graphlab/scheduler/multiqueue_priority_scheduler.hpp>
 #include <graphlab/scheduler/priority_scheduler.hpp>
 #include <graphlab/scheduler/queued_fifo_scheduler.hpp>
 #include <graphlab/scheduler/scheduler_factory.hpp>
 #include <graphlab/scheduler/scheduler_list.hpp>
 #include <graphlab/scheduler/sweep_scheduler.hpp>
+#include <graphlab/scheduler/work_stealing_scheduler.hpp>
 #endif
\ No newline at end of file
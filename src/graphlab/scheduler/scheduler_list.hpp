@@ -43,12 +43,24 @@
     "This scheduler maintains a shared FIFO queue of FIFO queues. "     \
     "Each thread maintains its own smaller in and out queues. When a "  \
     "threads out queue is too large (greater than \"queuesize\") then " \
-    "the thread puts its out queue at the end of the master queue."))   
+    "the thread puts its out queue at the end of the master queue."))   \
+  (("work_stealing", work_stealing_scheduler,                          \
+    "Each thread maintains its own lock free deque of vertices and "    \
+    "runs the vertices it signals itself. Idle threads steal work "     \
+    "from the deques of randomly chosen threads. Low contention "       \
+    "with many threads per machine."))                                  \
+  (("multiqueue_priority", multiqueue_priority_scheduler,              \
+    "Relaxed priority scheduler. Vertices are spread over several "     \
+    "locked priority queues per thread and each thread pops the "      \
+    "higher priority top of two random queues. Approximate priority "  \
+    "order with good parallelism."))
   
 #include <graphlab/scheduler/fifo_scheduler.hpp>
 #include <graphlab/scheduler/sweep_scheduler.hpp>
 #include <graphlab/scheduler/priority_scheduler.hpp>
 #include <graphlab/scheduler/queued_fifo_scheduler.hpp>
+#include <graphlab/scheduler/work_stealing_scheduler.hpp>
+#include <graphlab/scheduler/multiqueue_priority_scheduler.hpp>
 
 
 namespace graphlab {
@@ -0,0 +1,356 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_WORK_STEALING_SCHEDULER_HPP
+#define GRAPHLAB_WORK_STEALING_SCHEDULER_HPP
+
+#include <vector>
+#include <limits>
+#include <pthread.h>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/chase_lev_deque.hpp>
+#include <graphlab/util/random.hpp>
+
+#include <graphlab/scheduler/ischeduler.hpp>
+#include <graphlab/parallel/atomic_add_vector2.hpp>
+
+#include <graphlab/scheduler/get_message_priority.hpp>
+#include <graphlab/options/graphlab_options.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup group_schedulers
+   *
+   * A work stealing scheduler. Every processor owns a lock free
+   * Chase-Lev deque of vertices. Vertices signaled by an execution
+   * thread are pushed to the bottom of its own deque and popped from
+   * there in LIFO order. A processor whose deque is empty steals from
+   * the top of the deques of randomly chosen victims.
+   *
+   * Vertices scheduled from other threads (such as the RPC threads)
+   * are placed in the small locked inbox of a random processor, which
+   * its owner moves into its deque. Idle processors may take over the
+   * inbox of a victim as well.
+   *
+   * Messages to the same vertex are combined in place in the message
+   * array. A vertex is only queued when it receives its first pending
+   * message, so repeated signals do not grow the deques.
+   */
+  template<typename Message>
+  class work_stealing_scheduler : public ischeduler<Message> {
+
+  public:
+
+    typedef Message message_type;
+
+  private:
+    typedef chase_lev_deque<lvid_type> deque_type;
+
+    /** The per processor state */
+    struct thread_queue {
+      deque_type deque;
+      simple_spinlock inbox_lock;
+      std::vector<lvid_type> inbox;
+      // the thread which last called get_next for this processor
+      pthread_t owner;
+      bool has_owner;
+      // state of the owner's random number generator
+      size_t rand_state;
+      // avoid false sharing with the neighbouring queues
+      char pad[64];
+      thread_queue(size_t seed) : has_owner(false), rand_state(seed + 1) { }
+    };
+
+    atomic_add_vector2<message_type> messages;
+    std::vector<thread_queue*> queues;
+    size_t steal_attempts;
+    double min_priority;
+
+    /** Not copyable */
+    work_stealing_scheduler(const work_stealing_scheduler&);
+    void operator=(const work_stealing_scheduler&);
+
+    /** Returns true if the calling thread owns the deque of cpuid */
+    bool is_owner(const size_t cpuid) const {
+      const thread_queue& q = *queues[cpuid];
+      return q.has_owner && pthread_equal(q.owner, pthread_self());
+    }
+
+    /** A fast xorshift generator. Owner only. */
+    size_t next_rand(thread_queue& q) {
+      size_t x = q.rand_state;
+      x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+      q.rand_state = x;
+      return x;
+    }
+
+    /** Adds a vertex to the inbox of a processor */
+    void push_inbox(const size_t cpuid, const lvid_type vid) {
+      thread_queue& q = *queues[cpuid];
+      q.inbox_lock.lock();
+      q.inbox.push_back(vid);
+      q.inbox_lock.unlock();
+    }
+
+    /**
+     * Moves the inbox of the victim into the deque of cpuid.
+     * Returns false if the inbox was empty or busy.
+     */
+    bool take_inbox(const size_t cpuid, const size_t victim) {
+      thread_queue& v = *queues[victim];
+      if (v.inbox.empty()) return false;
+      std::vector<lvid_type> vids;
+      if (!v.inbox_lock.try_lock()) return false;
+      vids.swap(v.inbox);
+      v.inbox_lock.unlock();
+      foreach(lvid_type vid, vids) queues[cpuid]->deque.push(vid);
+      return !vids.empty();
+    }
+
+    /** Steals a vertex from the deque of the victim */
+    bool steal_from(const size_t victim, lvid_type& ret_vid) {
+      while (1) {
+        switch (queues[victim]->deque.steal(ret_vid)) {
+        case deque_type::STEAL_SUCCESS: return true;
+        case deque_type::STEAL_EMPTY: return false;
+        case deque_type::STEAL_ABORT: break;
+        }
+      }
+    }
+
+    /** Finds the next vertex for cpuid, stealing if necessary */
+    bool next_vertex(const size_t cpuid, lvid_type& ret_vid) {
+      thread_queue& q = *queues[cpuid];
+      if (q.deque.pop(ret_vid)) return true;
+      if (take_inbox(cpuid, cpuid) && q.deque.pop(ret_vid)) return true;
+      const size_t ncpus = queues.size();
+      if (ncpus == 1) return false;
+      // random victims first
+      for (size_t i = 0; i < steal_attempts; ++i) {
+        const size_t victim = next_rand(q) % ncpus;
+        if (victim == cpuid) continue;
+        if (steal_from(victim, ret_vid)) return true;
+      }
+      // then every victim in turn, so that EMPTY is only returned if
+      // all the queues were seen empty
+      const size_t start = next_rand(q) % ncpus;
+      for (size_t i = 0; i < ncpus; ++i) {
+        const size_t victim = (start + i) % ncpus;
+        if (victim == cpuid) continue;
+        if (steal_from(victim, ret_vid)) return true;
+        if (take_inbox(cpuid, victim) && q.deque.pop(ret_vid)) return true;
+      }
+      // the inbox of this processor may have been filled meanwhile
+      return take_inbox(cpuid, cpuid) && q.deque.pop(ret_vid);
+    }
+
+    void clear_queues() {
+      for (size_t i = 0; i < queues.size(); ++i) delete queues[i];
+      queues.clear();
+    }
+
+  public:
+
+    work_stealing_scheduler(size_t num_vertices,
+                            const graphlab_options& opts) :
+      messages(num_vertices),
+      steal_attempts(2 * opts.get_ncpus()),
+      min_priority(-std::numeric_limits<double>::max()) {
+      for (size_t i = 0; i < opts.get_ncpus(); ++i) {
+        queues.push_back(new thread_queue(i));
+      }
+      set_options(opts);
+    }
+
+    ~work_stealing_scheduler() {
+      clear_queues();
+    }
+
+    void set_options(const graphlab_options& opts) {
+      size_t new_ncpus = opts.get_ncpus();
+      // check if ncpus changed
+      if (new_ncpus != queues.size()) {
+        logstream(LOG_INFO) << "Changing ncpus from " << queues.size()
+                            << " to " << new_ncpus << std::endl;
+        ASSERT_GE(new_ncpus, 1);
+        // collect all the queued vertices and hand them to processor 0
+        std::vector<lvid_type> vids;
+        for (size_t i = 0; i < queues.size(); ++i) {
+          lvid_type vid;
+          while (queues[i]->deque.pop(vid)) vids.push_back(vid);
+          vids.insert(vids.end(), queues[i]->inbox.begin(),
+                      queues[i]->inbox.end());
+        }
+        clear_queues();
+        for (size_t i = 0; i < new_ncpus; ++i) {
+          queues.push_back(new thread_queue(i));
+        }
+        queues[0]->inbox.swap(vids);
+      }
+
+      // read the remaining options.
+      std::vector<std::string> keys = opts.get_scheduler_args().get_option_keys();
+      foreach(std::string opt, keys) {
+        if (opt == "steal_attempts") {
+          opts.get_scheduler_args().get_option("steal_attempts", steal_attempts);
+        } else if (opt == "min_priority") {
+          opts.get_scheduler_args().get_option("min_priority", min_priority);
+        } else {
+          logstream(LOG_FATAL) << "Unexpected Scheduler Option: " << opt << std::endl;
+        }
+      }
+    }
+
+    void start() {
+      // the execution threads claim their deques in get_next
+      for (size_t i = 0; i < queues.size(); ++i) {
+        queues[i]->has_owner = false;
+      }
+    }
+
+    void schedule(const lvid_type vid,
+                  const message_type& msg) {
+      // If this is a new message, schedule it
+      // the min priority will be taken care of by the get_next function
+      if (messages.add(vid, msg)) {
+        push_inbox(random::rand() % queues.size(), vid);
+      }
+    } // end of schedule
+
+    void schedule_from_execution_thread(const size_t cpuid,
+                                        const lvid_type vid,
+                                        const message_type& msg) {
+      if (messages.add(vid, msg)) {
+        if (cpuid < queues.size() && is_owner(cpuid)) {
+          queues[cpuid]->deque.push(vid);
+        } else {
+          push_inbox(random::rand() % queues.size(), vid);
+        }
+      }
+    } // end of schedule_from_execution_thread
+
+    void schedule_from_execution_thread(const size_t cpuid,
+                                        const lvid_type vid) {
+      if (!messages.empty(vid)) {
+        if (cpuid < queues.size() && is_owner(cpuid)) {
+          queues[cpuid]->deque.push(vid);
+        } else {
+          push_inbox(random::rand() % queues.size(), vid);
+        }
+      }
+    } // end of schedule_from_execution_thread
+
+    void schedule_all(const message_type& msg,
+                      const std::string& order) {
+      if(order == "shuffle") {
+        std::vector<lvid_type> permutation =
+          random::permutation<lvid_type>(messages.size());
+        foreach(lvid_type vid, permutation)  schedule(vid, msg);
+      } else {
+        for (lvid_type vid = 0; vid < messages.size(); ++vid)
+          schedule(vid, msg);
+      }
+    } // end of schedule_all
+
+    void completed(const size_t cpuid,
+                   const lvid_type vid,
+                   const message_type& msg) {
+    }
+
+
+    sched_status::status_enum
+    get_specific(lvid_type vid,
+                 message_type& ret_msg) {
+      bool get_success = messages.test_and_get(vid, ret_msg);
+      if (get_success) return sched_status::NEW_TASK;
+      else return sched_status::EMPTY;
+    }
+
+    void place(lvid_type vid,
+                 const message_type& msg) {
+      messages.add(vid, msg);
+    }
+
+
+    /** Get the next element in the queue */
+    sched_status::status_enum get_next(const size_t cpuid,
+                                       lvid_type& ret_vid,
+                                       message_type& ret_msg) {
+      ASSERT_LT(cpuid, queues.size());
+      thread_queue& q = *queues[cpuid];
+      if (!q.has_owner) {
+        q.owner = pthread_self();
+        __sync_synchronize();
+        q.has_owner = true;
+      }
+      while(next_vertex(cpuid, ret_vid)) {
+        // the message may have been taken by get_specific
+        if(messages.test_and_get(ret_vid, ret_msg)) {
+          if (scheduler_impl::get_message_priority(ret_msg) >= min_priority) {
+            return sched_status::NEW_TASK;
+          } else {
+            // it is below priority. try to put it back. If putting it back
+            // makes it exceed priority, reschedule it
+            message_type combined_message;
+            messages.add(ret_vid, ret_msg, combined_message);
+            double ret_priority =
+              scheduler_impl::get_message_priority(combined_message);
+            if(ret_priority >= min_priority) {
+              push_inbox(cpuid, ret_vid);
+            }
+          }
+        }
+      }
+      return sched_status::EMPTY;
+    } // end of get_next
+
+
+    size_t num_joins() const {
+      return messages.num_joins();
+    }
+    /**
+     * Print a help string describing the options that this scheduler
+     * accepts.
+     */
+    static void print_options_help(std::ostream& out) {
+      out << "\t steal_attempts: [the number of random victims an idle "
+          << "thread tries to steal from before scanning all the other "
+          << "threads. default = 2 * ncpus]\n"
+          << "min_priority = [double, minimum priority required to receive \n"
+          << "\t a message, default = -inf]\n";
+    }
+
+
+  };
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
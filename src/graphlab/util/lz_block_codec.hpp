@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * \file lz_block_codec.hpp
+ *
+ * A fast LZ77 block compressor in the style of LZ4, trading
+ * compression ratio for speed. A block is a sequence of
+ *
+ * \verbatim
+ *   [token] [extra literal length] [literals] [offset] [extra match length]
+ * \endverbatim
+ *
+ * The high nibble of the token is the number of literals and the low
+ * nibble the match length minus 4. A nibble of 15 is followed by
+ * extra length bytes which are summed until a byte below 255. The
+ * offset is 2 bytes little endian. The last sequence of a block only
+ * has literals.
+ */
+
+#ifndef GRAPHLAB_LZ_BLOCK_CODEC_HPP
+#define GRAPHLAB_LZ_BLOCK_CODEC_HPP
+
+#include <cstring>
+#include <stdint.h>
+
+namespace graphlab {
+
+  namespace lz_block {
+
+    /// \internal the shortest match which is encoded
+    const size_t MIN_MATCH = 4;
+    /// \internal the largest match distance
+    const size_t MAX_OFFSET = 65535;
+    /// \internal log2 of the size of the match finder hash table
+    const size_t HASH_LOG = 12;
+
+    /** \internal */
+    inline uint32_t read32(const unsigned char* p) {
+      uint32_t ret;
+      memcpy(&ret, p, sizeof(uint32_t));
+      return ret;
+    }
+
+    /** \internal */
+    inline size_t hash32(uint32_t v) {
+      return (v * 2654435761U) >> (32 - HASH_LOG);
+    }
+
+    /** \internal Writes the extra bytes of a length. Returns the new output
+     * position or NULL if it does not fit. */
+    inline unsigned char* write_length(unsigned char* op,
+                                       const unsigned char* oend,
+                                       size_t len) {
+      for (; len >= 255; len -= 255) {
+        if (op >= oend) return NULL;
+        *op++ = 255;
+      }
+      if (op >= oend) return NULL;
+      *op++ = (unsigned char)len;
+      return op;
+    }
+
+    /** \internal Writes one sequence. A match length of 0 writes the last
+     * (literals only) sequence. Returns NULL if it does not fit. */
+    inline unsigned char* write_sequence(unsigned char* op,
+                                         const unsigned char* oend,
+                                         const unsigned char* literals,
+                                         size_t litlen,
+                                         size_t offset, size_t matchlen) {
+      if (op >= oend) return NULL;
+      unsigned char* token = op++;
+      const size_t mcode = matchlen == 0 ? 0 : matchlen - MIN_MATCH;
+      *token = (unsigned char)(((litlen < 15 ? litlen : 15) << 4) |
+                               (mcode < 15 ? mcode : 15));
+      if (litlen >= 15 && (op = write_length(op, oend, litlen - 15)) == NULL) {
+        return NULL;
+      }
+      if (size_t(oend - op) < litlen) return NULL;
+      memcpy(op, literals, litlen);
+      op += litlen;
+      if (matchlen == 0) return op;
+      if (oend - op < 2) return NULL;
+      *op++ = (unsigned char)(offset & 0xff);
+      *op++ = (unsigned char)(offset >> 8);
+      if (mcode >= 15) op = write_length(op, oend, mcode - 15);
+      return op;
+    }
+
+    /**
+     * \brief Returns the largest possible compressed size of len bytes.
+     */
+    inline size_t compress_bound(size_t len) {
+      return len + len / 255 + 16;
+    }
+
+    /**
+     * \brief Compresses len bytes of src into dst, which has room for
+     * dstlen bytes.
+     *
+     * Returns the compressed size, or 0 if the output did not fit in
+     * dstlen bytes. Passing a dstlen smaller than len gives up early on
+     * incompressible data.
+     */
+    inline size_t compress(const char* src, size_t len,
+                           char* dst, size_t dstlen) {
+      const unsigned char* const base = (const unsigned char*)src;
+      const unsigned char* const iend = base + len;
+      unsigned char* op = (unsigned char*)dst;
+      unsigned char* const oend = op + dstlen;
+      // positions + 1 of the last occurrences of each hash. 0 is empty.
+      uint32_t table[1 << HASH_LOG];
+      memset(table, 0, sizeof(table));
+
+      const unsigned char* anchor = base;
+      const unsigned char* ip = base;
+      while (ip + MIN_MATCH <= iend) {
+        const uint32_t seq = read32(ip);
+        const size_t h = hash32(seq);
+        const uint32_t candidate = table[h];
+        table[h] = uint32_t(ip - base) + 1;
+        const unsigned char* ref = base + candidate - 1;
+        if (candidate == 0 || size_t(ip - ref) > MAX_OFFSET ||
+            read32(ref) != seq) {
+          // skip faster through data which does not compress
+          ip += 1 + ((ip - anchor) >> 6);
+          continue;
+        }
+        const unsigned char* matchend = ip + MIN_MATCH;
+        const unsigned char* r = ref + MIN_MATCH;
+        while (matchend < iend && *matchend == *r) {
+          ++matchend;
+          ++r;
+        }
+        op = write_sequence(op, oend, anchor, ip - anchor, ip - ref,
+                            matchend - ip);
+        if (op == NULL) return 0;
+        ip = matchend;
+        anchor = ip;
+      }
+      op = write_sequence(op, oend, anchor, iend - anchor, 0, 0);
+      if (op == NULL) return 0;
+      return op - (unsigned char*)dst;
+    }
+
+    /**
+     * \brief Decompresses len bytes of src into exactly dstlen bytes at
+     * dst. Returns false if the input is corrupt.
+     */
+    inline bool decompress(const char* src, size_t len,
+                           char* dst, size_t dstlen) {
+      const unsigned char* ip = (const unsigned char*)src;
+      const unsigned char* const iend = ip + len;
+      unsigned char* op = (unsigned char*)dst;
+      unsigned char* const obase = op;
+      unsigned char* const oend = op + dstlen;
+      while (true) {
+        // a block always ends with a literals only sequence
+        if (ip >= iend) return false;
+        const unsigned char token = *ip++;
+        size_t litlen = token >> 4;
+        if (litlen == 15) {
+          unsigned char c;
+          do {
+            if (ip >= iend) return false;
+            c = *ip++;
+            litlen += c;
+          } while (c == 255);
+        }
+        if (size_t(iend - ip) < litlen || size_t(oend - op) < litlen) {
+          return false;
+        }
+        memcpy(op, ip, litlen);
+        ip += litlen;
+        op += litlen;
+        // the last sequence has no match
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t matchlen = token & 15;
+        if (matchlen == 15) {
+          unsigned char c;
+          do {
+            if (ip >= iend) return false;
+            c = *ip++;
+            matchlen += c;
+          } while (c == 255);
+        }
+        matchlen += MIN_MATCH;
+        if (offset == 0 || offset > size_t(op - obase) ||
+            size_t(oend - op) < matchlen) {
+          return false;
+        }
+        // the match may overlap the output. copy byte by byte
+        const unsigned char* ref = op - offset;
+        for (size_t i = 0; i < matchlen; ++i) op[i] = ref[i];
+        op += matchlen;
+      }
+      return op == oend;
+    }
+
+  } // end of namespace lz_block
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PROCID_SET_HPP
+#define GRAPHLAB_PROCID_SET_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <stdint.h>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * A set of process IDs, such as the mirrors of a vertex, with no
+   * limit on the number of processes.
+   *
+   * Up to INLINE_CAPACITY IDs are kept inline as a sorted array. A set
+   * which grows beyond that switches to a heap allocated bitset just
+   * large enough for its largest ID. Either way the object itself is
+   * 16 bytes, the size of a fixed_dense_bitset<128>. Most vertices have
+   * few replicas, so only the hubs pay for a bitset.
+   *
+   * The interface follows fixed_dense_bitset: get(), set_bit(),
+   * clear_bit(), first_bit(), next_bit(), popcount() and iteration over
+   * the IDs in increasing order. Unlike the bitsets this class is not
+   * thread safe.
+   */
+  class procid_set {
+  public:
+    /// The number of IDs stored without a heap allocation
+    static const size_t INLINE_CAPACITY = 7;
+
+    procid_set() : nelem(0) { }
+
+    procid_set(const procid_set& other) : nelem(0) {
+      *this = other;
+    }
+
+    ~procid_set() {
+      clear();
+    }
+
+    procid_set& operator=(const procid_set& other) {
+      if (this == &other) return *this;
+      clear();
+      if (other.is_dense()) {
+        const size_t nwords = other.num_words();
+        size_t* words = (size_t*)malloc(nwords * sizeof(size_t));
+        memcpy(words, other.dense_words(), nwords * sizeof(size_t));
+        data[0] = (procid_t)nwords;
+        set_dense_words(words);
+      } else {
+        memcpy(data, other.data, sizeof(data));
+      }
+      nelem = other.nelem;
+      return *this;
+    }
+
+    /// Removes all the IDs
+    inline void clear() {
+      if (is_dense()) free(dense_words());
+      nelem = 0;
+    }
+
+    /// Returns true if the set is empty
+    inline bool empty() const {
+      return nelem == 0;
+    }
+
+    /// Returns the number of IDs in the set
+    inline size_t popcount() const {
+      return nelem;
+    }
+
+    /// Returns true if b is in the set
+    inline bool get(size_t b) const {
+      if (is_dense()) {
+        const size_t arrpos = b / (8 * sizeof(size_t));
+        return arrpos < num_words() &&
+          (dense_words()[arrpos] & (size_t(1) << (b % (8 * sizeof(size_t)))));
+      }
+      for (size_t i = 0; i < nelem; ++i) {
+        if (data[i] == b) return true;
+        if (data[i] > b) return false;
+      }
+      return false;
+    }
+
+    /// Adds b to the set returning true if it was already there
+    bool set_bit(size_t b) {
+      ASSERT_LE(b, size_t(procid_t(-1)));
+      if (is_dense()) {
+        if (dense_set(b)) return true;
+        ++nelem;
+        return false;
+      }
+      // find the insertion point in the sorted array
+      size_t pos = 0;
+      while (pos < nelem && data[pos] < b) ++pos;
+      if (pos < nelem && data[pos] == b) return true;
+      if (nelem < INLINE_CAPACITY) {
+        for (size_t i = nelem; i > pos; --i) data[i] = data[i - 1];
+        data[pos] = (procid_t)b;
+        ++nelem;
+        return false;
+      }
+      // full. move everything to a bitset
+      const size_t largest = std::max<size_t>(b, data[nelem - 1]);
+      const size_t nwords = largest / (8 * sizeof(size_t)) + 1;
+      size_t* words = (size_t*)calloc(nwords, sizeof(size_t));
+      for (size_t i = 0; i < nelem; ++i) {
+        words[data[i] / (8 * sizeof(size_t))] |=
+          size_t(1) << (data[i] % (8 * sizeof(size_t)));
+      }
+      data[0] = (procid_t)nwords;
+      set_dense_words(words);
+      ++nelem;
+      dense_set(b);
+      return false;
+    }
+
+    /// Removes b from the set returning true if it was there
+    bool clear_bit(size_t b) {
+      if (!get(b)) return false;
+      if (!is_dense()) {
+        size_t pos = 0;
+        while (data[pos] != b) ++pos;
+        for (size_t i = pos + 1; i < nelem; ++i) data[i - 1] = data[i];
+        --nelem;
+        return true;
+      }
+      size_t* words = dense_words();
+      words[b / (8 * sizeof(size_t))] &= ~(size_t(1) << (b % (8 * sizeof(size_t))));
+      if (nelem > INLINE_CAPACITY + 1) {
+        --nelem;
+        return true;
+      }
+      // small enough to go back inline
+      const size_t nwords = num_words();
+      size_t n = 0;
+      for (size_t i = 0; i < nwords * 8 * sizeof(size_t); ++i) {
+        if (words[i / (8 * sizeof(size_t))] & (size_t(1) << (i % (8 * sizeof(size_t))))) {
+          data[n++] = (procid_t)i;
+        }
+      }
+      free(words);
+      nelem = n;
+      return true;
+    }
+
+    /// Sets b to the smallest ID. Returns false if the set is empty
+    inline bool first_bit(size_t& b) const {
+      if (nelem == 0) return false;
+      if (!is_dense()) {
+        b = data[0];
+        return true;
+      }
+      return dense_next(0, b);
+    }
+
+    /**
+     * Sets b to the smallest ID larger than b. Returns false if there
+     * is no such ID.
+     */
+    inline bool next_bit(size_t& b) const {
+      if (!is_dense()) {
+        for (size_t i = 0; i < nelem; ++i) {
+          if (data[i] > b) {
+            b = data[i];
+            return true;
+          }
+        }
+        return false;
+      }
+      return dense_next(b + 1, b);
+    }
+
+    /// Iterates over the IDs in increasing order
+    struct bit_pos_iterator {
+      typedef std::input_iterator_tag iterator_category;
+      typedef size_t value_type;
+      typedef size_t difference_type;
+      typedef const size_t reference;
+      typedef const size_t* pointer;
+      size_t pos;
+      const procid_set* s;
+      bit_pos_iterator():pos(-1),s(NULL) {}
+      bit_pos_iterator(const procid_set* const s, size_t pos):pos(pos),s(s) {}
+
+      size_t operator*() const {
+        return pos;
+      }
+      size_t operator++(){
+        if (s->next_bit(pos) == false) pos = (size_t)(-1);
+        return pos;
+      }
+      size_t operator++(int){
+        size_t prevpos = pos;
+        if (s->next_bit(pos) == false) pos = (size_t)(-1);
+        return prevpos;
+      }
+      bool operator==(const bit_pos_iterator& other) const {
+        ASSERT_TRUE(s == other.s);
+        return other.pos == pos;
+      }
+      bool operator!=(const bit_pos_iterator& other) const {
+        ASSERT_TRUE(s == other.s);
+        return other.pos != pos;
+      }
+    };
+
+    typedef bit_pos_iterator iterator;
+    typedef bit_pos_iterator const_iterator;
+
+    bit_pos_iterator begin() const {
+      size_t pos;
+      if (first_bit(pos) == false) pos = size_t(-1);
+      return bit_pos_iterator(this, pos);
+    }
+
+    bit_pos_iterator end() const {
+      return bit_pos_iterator(this, (size_t)(-1));
+    }
+
+    /// Serializes the IDs in increasing order
+    void save(oarchive& oarc) const {
+      oarc << nelem;
+      size_t b;
+      if (first_bit(b)) {
+        do {
+          oarc << (procid_t)b;
+        } while (next_bit(b));
+      }
+    }
+
+    /// Deserializes the set from an archive
+    void load(iarchive& iarc) {
+      clear();
+      uint16_t n;
+      iarc >> n;
+      for (size_t i = 0; i < n; ++i) {
+        procid_t b;
+        iarc >> b;
+        set_bit(b);
+      }
+    }
+
+  private:
+    /// number of IDs in the set. The set is dense if this exceeds
+    /// INLINE_CAPACITY.
+    uint16_t nelem;
+    /**
+     * If the set is not dense, the sorted IDs.
+     * If it is dense, data[0] is the number of words in the bitset and
+     * data[1..4] hold the pointer to it.
+     */
+    procid_t data[INLINE_CAPACITY];
+
+    inline bool is_dense() const {
+      return nelem > INLINE_CAPACITY;
+    }
+
+    inline size_t num_words() const {
+      return data[0];
+    }
+
+    inline size_t* dense_words() const {
+      size_t* words;
+      memcpy(&words, data + 1, sizeof(size_t*));
+      return words;
+    }
+
+    inline void set_dense_words(size_t* words) {
+      memcpy(data + 1, &words, sizeof(size_t*));
+    }
+
+    /// Sets a bit of the bitset, growing it if necessary.
+    /// Returns the old value. Does not change nelem.
+    bool dense_set(size_t b) {
+      const size_t arrpos = b / (8 * sizeof(size_t));
+      const size_t mask = size_t(1) << (b % (8 * sizeof(size_t)));
+      size_t* words = dense_words();
+      const size_t nwords = num_words();
+      if (arrpos >= nwords) {
+        words = (size_t*)realloc(words, (arrpos + 1) * sizeof(size_t));
+        memset(words + nwords, 0, (arrpos + 1 - nwords) * sizeof(size_t));
+        data[0] = (procid_t)(arrpos + 1);
+        set_dense_words(words);
+      }
+      const bool ret = words[arrpos] & mask;
+      words[arrpos] |= mask;
+      return ret;
+    }
+
+    /// Finds the first bit of the bitset at or after start
+    bool dense_next(size_t start, size_t& b) const {
+      const size_t* words = dense_words();
+      const size_t nwords = num_words();
+      size_t arrpos = start / (8 * sizeof(size_t));
+      if (arrpos >= nwords) return false;
+      // mask out the bits before start in the first word
+      size_t block = words[arrpos] &
+        (size_t(-1) << (start % (8 * sizeof(size_t))));
+      while (block == 0) {
+        if (++arrpos >= nwords) return false;
+        block = words[arrpos];
+      }
+      b = arrpos * 8 * sizeof(size_t) + __builtin_ctzl(block);
+      return true;
+    }
+  }; // end of procid_set
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_VARINT_HPP
+#define GRAPHLAB_VARINT_HPP
+
+#include <vector>
+#include <stdint.h>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Variable length (LEB128) encoding of unsigned integers.
+   * Every byte stores 7 bits of the value, least significant group
+   * first. The high bit of a byte is set if more bytes follow.
+   * Values below 128 therefore take a single byte.
+   */
+  namespace varint {
+
+    /** \brief Appends the encoding of value to out. */
+    inline void append(std::vector<unsigned char>& out, uint64_t value) {
+      while (value >= 0x80) {
+        out.push_back((unsigned char)(value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      out.push_back((unsigned char)value);
+    }
+
+    /** \brief Decodes the value at pos without advancing pos. */
+    inline uint64_t peek(const unsigned char* pos) {
+      uint64_t value = 0;
+      size_t shift = 0;
+      while (*pos & 0x80) {
+        value |= uint64_t(*pos & 0x7f) << shift;
+        shift += 7;
+        ++pos;
+      }
+      return value | (uint64_t(*pos) << shift);
+    }
+
+    /** \brief Decodes the value at pos and advances pos past it. */
+    inline uint64_t read(const unsigned char*& pos) {
+      uint64_t value = 0;
+      size_t shift = 0;
+      while (*pos & 0x80) {
+        value |= uint64_t(*pos & 0x7f) << shift;
+        shift += 7;
+        ++pos;
+      }
+      value |= uint64_t(*pos) << shift;
+      ++pos;
+      return value;
+    }
+
+    /** \brief Advances pos past the value without decoding it. */
+    inline void skip(const unsigned char*& pos) {
+      while (*pos & 0x80) ++pos;
+      ++pos;
+    }
+
+  } // end of namespace varint
+
+} // end of namespace graphlab
+#endif
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_EDGE_BATCH_HPP
+#define GRAPHLAB_EDGE_BATCH_HPP
+
+#include <boost/utility/enable_if.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief A contiguous run of the in or out edges of a vertex,
+   * passed to the optional batched gather of a vertex program (see
+   * \ref ivertex_program::edge_batch_type).
+   *
+   * The neighbor ids are local vertex ids and index directly into
+   * the local vertex data array so that simple gathers can be written
+   * as tight loops:
+   *
+   * \code
+   * gather_type gather_batch(icontext_type& context,
+   *                          const vertex_type& vertex,
+   *                          edge_batch_type& batch) const {
+   *   double sum = 0;
+   *   for(size_t i = 0; i < batch.size; ++i)
+   *     sum += batch.neighbor_data(i);
+   *   return sum;
+   * }
+   * \endcode
+   */
+  template<typename Graph>
+  struct edge_batch {
+    typedef typename Graph::vertex_data_type vertex_data_type;
+    typedef typename Graph::edge_data_type edge_data_type;
+    typedef typename Graph::vertex_type vertex_type;
+
+    /** The direction of the edges: IN_EDGES or OUT_EDGES */
+    edge_dir_type dir;
+    /** The number of edges in the batch */
+    size_t size;
+    /** nbr[i] is the local id of the other end point of edge i */
+    const lvid_type* nbr;
+    /** The local vertex data array, indexed by local vertex id */
+    vertex_data_type* vdata;
+    /** The edge data. See eid. */
+    edge_data_type* edata;
+    /** If NULL the data of edge i is edata[i], otherwise edata[eid[i]] */
+    const edge_id_type* eid;
+    /** The number of out edges in the whole graph, indexed by local
+     * vertex id */
+    const vertex_id_type* out_degree;
+    /** The graph the batch belongs to */
+    Graph* graph;
+
+    /** \brief Returns the data of the other end point of edge i */
+    vertex_data_type& neighbor_data(size_t i) const {
+      return vdata[nbr[i]];
+    }
+    /** \brief Returns the data on edge i */
+    edge_data_type& edge_data(size_t i) const {
+      return eid == NULL ? edata[i] : edata[eid[i]];
+    }
+    /** \brief Returns the number of out edges of the other end point
+     * of edge i. Same as neighbor(i).num_out_edges() */
+    size_t neighbor_num_out_edges(size_t i) const {
+      return out_degree[nbr[i]];
+    }
+    /** \brief Returns the other end point of edge i */
+    vertex_type neighbor(size_t i) const {
+      return vertex_type(*graph, nbr[i]);
+    }
+  }; // end of edge_batch
+
+
+  namespace vertex_program_impl {
+
+    /**
+     * \internal
+     * value is true if the vertex program implements
+     * \code
+     * gather_type gather_batch(icontext_type& context,
+     *                          const vertex_type& vertex,
+     *                          edge_batch_type& batch) const;
+     * \endcode
+     */
+    template <typename VertexProgram>
+    struct implements_gather_batch {
+      typedef typename VertexProgram::gather_type gather_type;
+      typedef typename VertexProgram::icontext_type icontext_type;
+      typedef typename VertexProgram::vertex_type vertex_type;
+      typedef typename VertexProgram::edge_batch_type edge_batch_type;
+      template<typename U,
+               gather_type (U::*)(icontext_type&, const vertex_type&,
+                                  edge_batch_type&) const>
+      struct SFINAE {};
+      template <typename U> static char test(SFINAE<U, &U::gather_batch>*);
+      template <typename U> static int test(...);
+      static const bool value = (sizeof(test<VertexProgram>(0)) == sizeof(char));
+    };
+
+    /** \internal Calls the batched gather of the vertex program. */
+    template <typename VertexProgram>
+    typename boost::enable_if_c<
+      implements_gather_batch<VertexProgram>::value,
+      typename VertexProgram::gather_type>::type
+    gather_batch(const VertexProgram& vprog,
+                 typename VertexProgram::icontext_type& context,
+                 const typename VertexProgram::vertex_type& vertex,
+                 typename VertexProgram::edge_batch_type& batch) {
+      return vprog.gather_batch(context, vertex, batch);
+    }
+
+    /** \internal Never called: the engines check
+     * implements_gather_batch first. */
+    template <typename VertexProgram>
+    typename boost::disable_if_c<
+      implements_gather_batch<VertexProgram>::value,
+      typename VertexProgram::gather_type>::type
+    gather_batch(const VertexProgram& vprog,
+                 typename VertexProgram::icontext_type& context,
+                 const typename VertexProgram::vertex_type& vertex,
+                 typename VertexProgram::edge_batch_type& batch) {
+      logstream(LOG_FATAL) << "gather_batch not implemented!" << std::endl;
+      return typename VertexProgram::gather_type();
+    }
+
+  } // namespace vertex_program_impl
+} // namespace graphlab
+
+#endif
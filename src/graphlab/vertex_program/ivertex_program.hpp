@@ -33,6 +33,7 @@
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 #include <graphlab/vertex_program/op_plus_eq_concept.hpp>
+#include <graphlab/vertex_program/edge_batch.hpp>
 
 #include <graphlab/macros_def.hpp>
 
@@ -506,6 +507,30 @@ namespace graphlab {
      *
      */
     typedef icontext<graph_type, gather_type, message_type> icontext_type;
+
+    /**
+     * \brief A contiguous run of in or out edges passed to the
+     * optional batched gather.
+     *
+     * A vertex program may implement
+     *
+     * \code
+     * gather_type gather_batch(icontext_type& context,
+     *                          const vertex_type& vertex,
+     *                          edge_batch_type& batch) const;
+     * \endcode
+     *
+     * in which case the synchronous engine calls it once per run of
+     * edges instead of calling \ref ivertex_program::gather once per
+     * edge. The result must equal the sum of gather over the edges in
+     * the batch, which is never empty. The method is detected at
+     * compile time and is therefore not declared here. Engines fall
+     * back to gather when it is absent or the edges are not stored
+     * contiguously (e.g., a compressed adjacency).
+     *
+     * See \ref graphlab::edge_batch for details.
+     */
+    typedef edge_batch<graph_type> edge_batch_type;
    
     // Functions ==============================================================
     /**
@@ -308,6 +308,73 @@ void test_aggregator(graphlab::distributed_control& dc,
 
 
 
+// Counts every vertex up to 10, one update at a time, so that the
+// snapshots see vertices with pending and in-progress updates.
+class count_to_ten :
+  public graphlab::ivertex_program<graph_type, int, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type
+  gather(icontext_type& context, const vertex_type& vertex,
+         edge_type& edge) const {
+    return 1;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    graphlab::timer::sleep_ms(1);
+    // restarted updates may run on a vertex which is already done
+    if (vertex.data() < 10) ++vertex.data();
+    if (vertex.data() < 10) context.signal(vertex);
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of count to ten
+
+void set_vertex_to_zero(graph_type::vertex_type vtx) {
+  vtx.data() = 0;
+}
+
+size_t vertex_equals_ten(const graph_type::vertex_type& vtx) {
+  return vtx.data() == 10;
+}
+
+void test_snapshot(graphlab::distributed_control& dc,
+                   graphlab::command_line_options& clopts,
+                   graph_type& graph) {
+  typedef graphlab::async_consistent_engine<count_to_ten> engine_type;
+  const std::string snapshot_path = "async_snapshot_test";
+  graph.transform_vertices(set_vertex_to_zero);
+  std::cout << "Running with snapshots" << std::endl;
+  {
+    graphlab::command_line_options snapopts = clopts;
+    snapopts.get_engine_args().set_option("snapshot_interval", 0.05);
+    snapopts.get_engine_args().set_option("snapshot_path", snapshot_path);
+    engine_type engine(dc, graph, snapopts);
+    engine.signal_all();
+    engine.start();
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_equals_ten),
+            graph.num_vertices());
+
+  const std::string prefix = engine_type::latest_snapshot(snapshot_path);
+  ASSERT_NE(prefix, "");
+  std::cout << "Resuming from " << prefix << std::endl;
+  graph_type graph2(dc, clopts);
+  graph2.load_binary(prefix);
+  engine_type engine(dc, graph2, clopts);
+  engine.resume_snapshot(prefix);
+  engine.start();
+  ASSERT_EQ(graph2.map_reduce_vertices<size_t>(vertex_equals_ten),
+            graph2.num_vertices());
+  std::cout << "Finished" << std::endl;
+}
+
 
 
 int main(int argc, char** argv) {
@@ -329,6 +396,7 @@ int main(int argc, char** argv) {
   test_out_neighbors(dc, clopts, graph);
   test_all_neighbors(dc, clopts, graph);
   test_aggregator(dc, clopts, graph);
+  test_snapshot(dc, clopts, graph);
   graphlab::mpi_tools::finalize();
 } // end of main
 
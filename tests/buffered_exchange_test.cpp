@@ -0,0 +1,276 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/rpc/combining_buffered_exchange.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+using namespace graphlab;
+
+
+typedef buffered_exchange<size_t> exchange_type;
+
+// the value number i sent by proc src
+size_t make_value(procid_t src, size_t i) {
+  return i * 1000 + src;
+}
+
+/*
+ * Sends the same values through an exchange to every machine: first a
+ * few at a time with pauses, so that adaptive buffers are sent on
+ * their deadline, then a burst which fills them. Returns the number
+ * and the sum of the values received from each machine.
+ */
+void run_traffic(distributed_control& dc, exchange_type& exchange,
+                 std::vector<size_t>& counts, std::vector<size_t>& sums) {
+  const size_t npaced = 500, nburst = 100000;
+  size_t i = 0;
+  for (; i < npaced; ++i) {
+    for (procid_t p = 0; p < dc.numprocs(); ++p) {
+      exchange.send(p, make_value(dc.procid(), i));
+    }
+    usleep(1000);
+  }
+  for (; i < npaced + nburst; ++i) {
+    for (procid_t p = 0; p < dc.numprocs(); ++p) {
+      exchange.send(p, make_value(dc.procid(), i));
+    }
+  }
+  exchange.flush();
+  counts.assign(dc.numprocs(), 0);
+  sums.assign(dc.numprocs(), 0);
+  procid_t proc;
+  exchange_type::buffer_type buffer;
+  while (exchange.recv(proc, buffer)) {
+    for (size_t k = 0; k < buffer.size(); ++k) {
+      ASSERT_EQ(buffer[k] % 1000, proc);
+      ++counts[proc];
+      sums[proc] += buffer[k];
+    }
+  }
+  for (procid_t p = 0; p < dc.numprocs(); ++p) {
+    ASSERT_EQ(counts[p], npaced + nburst);
+    size_t expected = 0;
+    for (size_t j = 0; j < npaced + nburst; ++j) expected += make_value(p, j);
+    ASSERT_EQ(sums[p], expected);
+  }
+}
+
+
+void test_adaptive(distributed_control& dc) {
+  std::vector<size_t> counts, sums, adaptive_counts, adaptive_sums;
+  const size_t max_size = 64 * 1024;
+  {
+    exchange_type exchange(dc, 1, max_size);
+    run_traffic(dc, exchange, counts, sums);
+    std::vector<exchange_type::peer_stats> stats = exchange.get_stats();
+    for (procid_t p = 0; p < dc.numprocs(); ++p) {
+      ASSERT_EQ(stats[p].buffer_size, max_size);
+      ASSERT_EQ(stats[p].rtt_us, 0.0);
+      ASSERT_EQ(stats[p].bytes_per_second, 0.0);
+      ASSERT_EQ(stats[p].flushes[exchange_type::FLUSH_DEADLINE], size_t(0));
+    }
+  }
+  {
+    exchange_type exchange(dc, 1, max_size);
+    exchange.set_adaptive(true);
+    ASSERT_TRUE(exchange.adaptive_enabled());
+    run_traffic(dc, exchange, adaptive_counts, adaptive_sums);
+    ASSERT_TRUE(adaptive_counts == counts);
+    ASSERT_TRUE(adaptive_sums == sums);
+    std::vector<exchange_type::peer_stats> stats = exchange.get_stats();
+    for (procid_t p = 0; p < dc.numprocs(); ++p) {
+      const exchange_type::peer_stats& s = stats[p];
+      // the rate and the round trip time were measured
+      ASSERT_GT(s.rtt_us, 0.0);
+      ASSERT_GT(s.bytes_per_second, 0.0);
+      ASSERT_GE(s.buffer_size, size_t(RPC_EXCHANGE_MIN_BUFFER_SIZE));
+      ASSERT_LE(s.buffer_size, max_size);
+      // the paced values were sent on the deadline, the burst when full
+      ASSERT_GT(s.flushes[exchange_type::FLUSH_DEADLINE], size_t(0));
+      ASSERT_GT(s.flushes[exchange_type::FLUSH_SIZE], size_t(0));
+      ASSERT_EQ(s.flushes[exchange_type::FLUSH_SIZE] +
+                s.flushes[exchange_type::FLUSH_DEADLINE] +
+                s.flushes[exchange_type::FLUSH_EXPLICIT], s.buffers_sent);
+      ASSERT_GT(s.average_buffer_bytes(), 0.0);
+      dc.cout() << "to " << p << ": rtt " << s.rtt_us << "us, "
+                << s.bytes_per_second << " B/s, buffer size "
+                << s.buffer_size << ", " << s.buffers_sent << " buffers"
+                << std::endl;
+    }
+  }
+  dc.cout() << "+ Pass test: adaptive exchange" << std::endl;
+}
+
+
+// the first buffer sent to every machine is acknowledged, and the
+// exchange is destroyed while the acknowledgements are on the way
+void test_destroy_with_acks_outstanding(distributed_control& dc) {
+  for (size_t i = 0; i < 50; ++i) {
+    exchange_type exchange(dc);
+    exchange.set_adaptive(true);
+    for (procid_t p = 0; p < dc.numprocs(); ++p) {
+      exchange.send(p, make_value(dc.procid(), i));
+    }
+    exchange.flush();
+    procid_t proc;
+    exchange_type::buffer_type buffer;
+    size_t count = 0;
+    while (exchange.recv(proc, buffer)) count += buffer.size();
+    ASSERT_EQ(count, dc.numprocs());
+  }
+  dc.cout() << "+ Pass test: destroy with acknowledgements outstanding"
+            << std::endl;
+}
+
+
+// values sent many at a time arrive in order, across buffer boundaries
+void test_bulk_send(distributed_control& dc) {
+  const size_t nvalues = 100000;
+  exchange_type exchange(dc, 1, 4096);
+  std::vector<size_t> values;
+  for (size_t i = 0; i < nvalues; ++i) {
+    values.push_back(make_value(dc.procid(), i));
+    if (values.size() == 1000 || i + 1 == nvalues) {
+      for (procid_t p = 0; p < dc.numprocs(); ++p) {
+        exchange.send(p, &(values[0]), values.size());
+      }
+      values.clear();
+    }
+  }
+  exchange.flush();
+  std::vector<size_t> counts(dc.numprocs(), 0);
+  procid_t proc;
+  exchange_type::buffer_type buffer;
+  while (exchange.recv(proc, buffer)) {
+    for (size_t k = 0; k < buffer.size(); ++k) {
+      ASSERT_EQ(buffer[k], make_value(proc, counts[proc]));
+      ++counts[proc];
+    }
+  }
+  for (procid_t p = 0; p < dc.numprocs(); ++p) {
+    ASSERT_EQ(counts[p], nvalues);
+  }
+  dc.cout() << "+ Pass test: bulk send" << std::endl;
+}
+
+
+// received views stay valid while later buffers arrive
+void test_recv_view(distributed_control& dc) {
+  const size_t nvalues = 100000;
+  exchange_type exchange(dc, 1, 4096);
+  for (size_t i = 0; i < nvalues; ++i) {
+    for (procid_t p = 0; p < dc.numprocs(); ++p) {
+      exchange.send(p, make_value(dc.procid(), i));
+    }
+  }
+  exchange.flush();
+  std::vector<std::pair<procid_t, exchange_type::view_type> > views;
+  procid_t proc;
+  exchange_type::view_type view;
+  while (exchange.recv(proc, view)) {
+    ASSERT_GT(view.size(), size_t(0));
+    views.push_back(std::make_pair(proc, view));
+  }
+  ASSERT_GT(views.size(), size_t(dc.numprocs()));
+  std::vector<size_t> counts(dc.numprocs(), 0);
+  for (size_t k = 0; k < views.size(); ++k) {
+    const procid_t src = views[k].first;
+    size_t n = 0;
+    const exchange_type::view_type& v = views[k].second;
+    for (exchange_type::view_type::iterator it = v.begin();
+         it != v.end(); ++it) {
+      ASSERT_EQ(*it, make_value(src, counts[src]));
+      ++counts[src];
+      ++n;
+    }
+    ASSERT_EQ(n, v.size());
+  }
+  for (procid_t p = 0; p < dc.numprocs(); ++p) {
+    ASSERT_EQ(counts[p], nvalues);
+  }
+  dc.cout() << "+ Pass test: recv views" << std::endl;
+}
+
+
+// the sum received for every key is the same with and without combining
+void test_combining(distributed_control& dc) {
+  typedef combining_buffered_exchange<size_t, size_t> combining_type;
+  const size_t nkeys = 100, nrounds = 50;
+  std::vector<size_t> sums[2];
+  for (size_t enable = 0; enable < 2; ++enable) {
+    combining_type exchange(dc);
+    exchange.set_combining(enable);
+    for (size_t r = 0; r < nrounds; ++r) {
+      for (size_t key = 0; key < nkeys; ++key) {
+        for (procid_t p = 0; p < dc.numprocs(); ++p) {
+          exchange.send(p, key, make_value(dc.procid(), r));
+        }
+      }
+    }
+    exchange.flush();
+    sums[enable].assign(nkeys, 0);
+    procid_t proc;
+    combining_type::buffer_type buffer;
+    size_t received = 0;
+    while (exchange.recv(proc, buffer)) {
+      for (size_t k = 0; k < buffer.size(); ++k) {
+        sums[enable][buffer[k].first] += buffer[k].second;
+        ++received;
+      }
+    }
+    ASSERT_EQ(exchange.num_sent(), nkeys * nrounds * dc.numprocs());
+    if (enable) {
+      ASSERT_GT(exchange.num_combined(), size_t(0));
+      ASSERT_LT(received, nkeys * nrounds * dc.numprocs());
+    } else {
+      ASSERT_EQ(exchange.num_combined(), size_t(0));
+      ASSERT_EQ(received, nkeys * nrounds * dc.numprocs());
+    }
+  }
+  ASSERT_TRUE(sums[0] == sums[1]);
+  dc.cout() << "+ Pass test: combining exchange" << std::endl;
+}
+
+
+int main(int argc, char ** argv) {
+  /** Initialization */
+  mpi_tools::init(argc, argv);
+  global_logger().set_log_level(LOG_INFO);
+
+  dc_init_param param;
+  if (init_param_from_mpi(param) == false) {
+    return 0;
+  }
+  distributed_control dc(param);
+  test_adaptive(dc);
+  test_destroy_with_acks_outstanding(dc);
+  test_bulk_send(dc);
+  test_recv_view(dc);
+  test_combining(dc);
+  mpi_tools::finalize();
+}
@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_recv_buffer.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+using namespace graphlab;
+using dc_impl::recv_buffer;
+using dc_impl::recv_view;
+
+
+// the payload number i sent by proc src. Repetitive, so it compresses
+std::string make_payload(procid_t src, size_t i, size_t len) {
+  std::string s(len, 0);
+  for (size_t k = 0; k < len; ++k) s[k] = char('a' + (src + i + k / 64) % 26);
+  return s;
+}
+
+bool in_buffer(recv_buffer* buf, const char* ptr, size_t len) {
+  return ptr >= buf->data() && ptr + len <= buf->data() + buf->capacity;
+}
+
+
+// copies and destroys views of buf, published as the current buffer
+void copy_views(recv_buffer* buf, size_t n) {
+  dc_impl::set_current_recv_buffer(buf);
+  recv_view view(buf->data(), buf->capacity);
+  dc_impl::set_current_recv_buffer(NULL);
+  ASSERT_TRUE(view.data() == buf->data());
+  std::vector<recv_view> copies;
+  for (size_t i = 0; i < n; ++i) {
+    copies.push_back(view);
+    if (copies.size() == 10) copies.clear();
+  }
+}
+
+void test_refcount() {
+  const size_t nthreads = 8, per_thread = 100000;
+  recv_buffer* buf = dc_impl::allocate_recv_buffer(1024);
+  ASSERT_EQ(buf->refcount.value, size_t(1));
+  thread_group thrgrp;
+  for (size_t t = 0; t < nthreads; ++t) {
+    thrgrp.launch(boost::bind(copy_views, buf, per_thread));
+  }
+  thrgrp.join();
+  // every view released what it retained
+  ASSERT_EQ(buf->refcount.value, size_t(1));
+  dc_impl::retain_recv_buffer(buf, 3);
+  ASSERT_EQ(buf->refcount.value, size_t(4));
+  dc_impl::release_recv_buffer(buf, 3);
+  ASSERT_EQ(buf->refcount.value, size_t(1));
+  dc_impl::release_recv_buffer(buf);
+  std::cout << "+ Pass test: reference counts across threads" << std::endl;
+}
+
+
+void test_copy_fallback() {
+  recv_buffer* buf = dc_impl::allocate_recv_buffer(1024);
+  memset(buf->data(), 'x', buf->capacity);
+  std::string outside(100, 'y');
+  // no current buffer: the bytes are copied
+  {
+    recv_view view(buf->data(), 100);
+    ASSERT_TRUE(view.data() != buf->data());
+    ASSERT_TRUE(std::string(view.data(), view.size()) == std::string(100, 'x'));
+    ASSERT_EQ(buf->refcount.value, size_t(1));
+  }
+  dc_impl::set_current_recv_buffer(buf);
+  // inside the current buffer: a view which holds the buffer
+  recv_view inside(buf->data() + 10, 100);
+  ASSERT_TRUE(inside.data() == buf->data() + 10);
+  ASSERT_EQ(buf->refcount.value, size_t(2));
+  // outside of it, or overrunning its end: copies
+  recv_view copy(outside.c_str(), outside.length());
+  ASSERT_TRUE(copy.data() != outside.c_str());
+  ASSERT_TRUE(std::string(copy.data(), copy.size()) == outside);
+  recv_view overrun(buf->data() + buf->capacity - 10, 20);
+  ASSERT_FALSE(in_buffer(buf, overrun.data(), overrun.size()));
+  ASSERT_EQ(buf->refcount.value, size_t(2));
+  // a view deserialized from an archive over the buffer is a view
+  oarchive oarc;
+  oarc << recv_view(outside.c_str(), outside.length());
+  memcpy(buf->data(), oarc.buf, oarc.off);
+  iarchive iarc(buf->data(), oarc.off);
+  recv_view loaded;
+  iarc >> loaded;
+  ASSERT_TRUE(in_buffer(buf, loaded.data(), loaded.size()));
+  ASSERT_TRUE(std::string(loaded.data(), loaded.size()) == outside);
+  ASSERT_EQ(buf->refcount.value, size_t(3));
+  free(oarc.buf);
+  dc_impl::set_current_recv_buffer(NULL);
+  inside.clear();
+  loaded.clear();
+  ASSERT_EQ(buf->refcount.value, size_t(1));
+  dc_impl::release_recv_buffer(buf);
+  std::cout << "+ Pass test: copies of bytes outside the buffer" << std::endl;
+}
+
+
+void test_pool_reuse() {
+  // small buffers are exactly the size asked for and are not pooled
+  recv_buffer* small = dc_impl::allocate_recv_buffer(RPC_RECV_BUFFER_POOL_MIN - 1);
+  ASSERT_EQ(small->capacity, size_t(RPC_RECV_BUFFER_POOL_MIN - 1));
+  dc_impl::release_recv_buffer(small);
+  // large ones are rounded up to their size class and reused
+  recv_buffer* buf = dc_impl::allocate_recv_buffer(RPC_RECV_BUFFER_POOL_MIN);
+  ASSERT_EQ(buf->capacity, size_t(RPC_RECV_BUFFER_POOL_MIN));
+  dc_impl::release_recv_buffer(buf);
+  recv_buffer* again = dc_impl::allocate_recv_buffer(RPC_RECV_BUFFER_POOL_MIN);
+  ASSERT_TRUE(again == buf);
+  ASSERT_EQ(again->refcount.value, size_t(1));
+
+  recv_buffer* larger = dc_impl::allocate_recv_buffer(RPC_RECV_BUFFER_POOL_MIN + 1);
+  ASSERT_EQ(larger->capacity, size_t(2 * RPC_RECV_BUFFER_POOL_MIN));
+  dc_impl::release_recv_buffer(larger);
+  // a smaller request of the same class gets the same buffer
+  recv_buffer* same_class =
+    dc_impl::allocate_recv_buffer(RPC_RECV_BUFFER_POOL_MIN + 100);
+  ASSERT_TRUE(same_class == larger);
+  // a buffer held by a view is not reused until the view goes away
+  dc_impl::set_current_recv_buffer(same_class);
+  recv_view view(same_class->data(), 10);
+  dc_impl::set_current_recv_buffer(NULL);
+  dc_impl::release_recv_buffer(same_class);
+  recv_buffer* other = dc_impl::allocate_recv_buffer(RPC_RECV_BUFFER_POOL_MIN + 1);
+  ASSERT_TRUE(other != same_class);
+  view.clear();
+  dc_impl::release_recv_buffer(other);
+  dc_impl::release_recv_buffer(again);
+  std::cout << "+ Pass test: pooled buffer reuse" << std::endl;
+}
+
+
+/*
+ * Payloads sent with compression=always arrive in blocks which were
+ * decompressed into a fresh buffer. The handler gets a view into that
+ * buffer, and keeps it after it returns.
+ */
+class view_test {
+ public:
+  dc_dist_object<view_test> rmi;
+  mutex lock;
+  std::vector<std::pair<std::pair<procid_t, size_t>, recv_view> > views;
+
+  view_test(distributed_control &dc):rmi(dc, this) {
+    rmi.barrier();
+  }
+
+  void recv(procid_t src, size_t i, const recv_view& view) {
+    recv_buffer* cur = dc_impl::current_recv_buffer();
+    ASSERT_TRUE(cur != NULL);
+    ASSERT_TRUE(in_buffer(cur, view.data(), view.size()));
+    lock.lock();
+    views.push_back(std::make_pair(std::make_pair(src, i), view));
+    lock.unlock();
+  }
+
+  void test_compressed_views() {
+    const size_t nrounds = 20, len = 100000;
+    for (size_t i = 0; i < nrounds; ++i) {
+      std::string s = make_payload(rmi.procid(), i, len);
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (p == rmi.procid()) continue;
+        rmi.remote_call(p, &view_test::recv, rmi.procid(), i,
+                        recv_view(s.c_str(), s.length()));
+      }
+    }
+    rmi.full_barrier();
+    ASSERT_EQ(views.size(), nrounds * (rmi.numprocs() - 1));
+    // the buffers outlived the calls and were not reused meanwhile
+    for (size_t k = 0; k < views.size(); ++k) {
+      const recv_view& view = views[k].second;
+      ASSERT_TRUE(std::string(view.data(), view.size()) ==
+                  make_payload(views[k].first.first, views[k].first.second, len));
+    }
+    ASSERT_GT(rmi.dc().compression_input_bytes(), nrounds * len / 2);
+    ASSERT_LT(rmi.dc().compression_output_bytes(),
+              rmi.dc().compression_input_bytes());
+    views.clear();
+    rmi.barrier();
+    rmi.dc().cout() << "+ Pass test: views of decompressed blocks"
+                    << std::endl;
+  }
+};
+
+
+int main(int argc, char ** argv) {
+  /** Initialization */
+  mpi_tools::init(argc, argv);
+  global_logger().set_log_level(LOG_INFO);
+
+  dc_init_param param;
+  if (init_param_from_mpi(param) == false) {
+    return 0;
+  }
+  // the buffer tests run before the handler threads touch the pool
+  if (mpi_tools::rank() == 0) {
+    test_refcount();
+    test_copy_fallback();
+    test_pool_reuse();
+  }
+  param.initstring += " compression=always ";
+  distributed_control dc(param);
+  if (dc.numprocs() < 2) {
+    dc.cout() << "Run with at least 2 processes to test received views"
+              << std::endl;
+  } else {
+    view_test test(dc);
+    test.test_compressed_views();
+  }
+  mpi_tools::finalize();
+}
@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+using namespace graphlab;
+
+
+/*
+ * Makes a known number of calls to two functions with the same
+ * signature, whose payloads differ by a known number of bytes, and
+ * checks the counts and bytes of both call sites in the profile.
+ * Run it with 2 processes or more.
+ */
+const size_t NUM_CALLS = 250;
+const size_t SMALL_PAYLOAD = 100;
+const size_t LARGE_PAYLOAD = 1100;
+
+class profile_test;
+typedef void (profile_test::*handler_type)(const std::string&);
+
+/// The call site id of the handler, as read by the profiler
+std::string site_function(handler_type f) {
+  size_t address;
+  memcpy(&address, &f, sizeof(size_t));
+  std::stringstream strm;
+  strm << "\"function\":\"0x" << std::hex << address << "\"";
+  return strm.str();
+}
+
+/// The value of the first "key":value after pos in the JSON
+size_t json_value(const std::string& json, size_t pos, const std::string& key) {
+  pos = json.find("\"" + key + "\":", pos);
+  ASSERT_NE(pos, std::string::npos);
+  return strtoul(json.c_str() + pos + key.length() + 3, NULL, 10);
+}
+
+size_t count_occurrences(const std::string& s, const std::string& sub) {
+  size_t ret = 0;
+  for (size_t pos = s.find(sub); pos != std::string::npos;
+       pos = s.find(sub, pos + 1)) {
+    ++ret;
+  }
+  return ret;
+}
+
+
+struct site_totals {
+  size_t calls_sent, bytes_sent, calls_received, bytes_received;
+};
+
+/// Reads the totals of the call site of f from a machine's profile
+site_totals get_site(const std::string& json, handler_type f) {
+  const std::string function = site_function(f);
+  ASSERT_EQ(count_occurrences(json, function), size_t(1));
+  const size_t pos = json.find(function);
+  site_totals ret;
+  ret.calls_sent = json_value(json, pos, "calls_sent");
+  ret.bytes_sent = json_value(json, pos, "bytes_sent");
+  ret.calls_received = json_value(json, pos, "calls_received");
+  ret.bytes_received = json_value(json, pos, "bytes_received");
+  return ret;
+}
+
+
+class profile_test {
+ public:
+  dc_dist_object<profile_test> rmi;
+  atomic<size_t> num_received;
+
+  profile_test(distributed_control &dc):rmi(dc, this) {
+    rmi.barrier();
+  }
+
+  void recv_small(const std::string& s) {
+    ASSERT_EQ(s.length(), SMALL_PAYLOAD);
+    num_received.inc();
+  }
+
+  void recv_large(const std::string& s) {
+    ASSERT_EQ(s.length(), LARGE_PAYLOAD);
+    num_received.inc();
+  }
+
+  void test_call_sites() {
+    ASSERT_TRUE(rmi.dc().rpc_profiling());
+    const std::string small(SMALL_PAYLOAD, 's'), large(LARGE_PAYLOAD, 'l');
+    for (size_t i = 0; i < NUM_CALLS; ++i) {
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (p == rmi.procid()) continue;
+        rmi.remote_call(p, &profile_test::recv_small, small);
+        rmi.remote_call(p, &profile_test::recv_large, large);
+      }
+    }
+    rmi.full_barrier();
+    const size_t npeers = rmi.numprocs() - 1;
+    ASSERT_EQ(num_received.value, 2 * NUM_CALLS * npeers);
+
+    const std::string json = rmi.dc().rpc_profile_json();
+    site_totals s = get_site(json, &profile_test::recv_small);
+    site_totals l = get_site(json, &profile_test::recv_large);
+    ASSERT_EQ(s.calls_sent, NUM_CALLS * npeers);
+    ASSERT_EQ(s.calls_received, NUM_CALLS * npeers);
+    ASSERT_EQ(l.calls_sent, NUM_CALLS * npeers);
+    ASSERT_EQ(l.calls_received, NUM_CALLS * npeers);
+    // every call of a site has the same size: the payload and a header
+    ASSERT_EQ(s.bytes_sent % s.calls_sent, size_t(0));
+    const size_t call_bytes = s.bytes_sent / s.calls_sent;
+    ASSERT_GT(call_bytes, SMALL_PAYLOAD);
+    ASSERT_LT(call_bytes, SMALL_PAYLOAD + 100);
+    ASSERT_EQ(l.bytes_sent,
+              s.bytes_sent + (LARGE_PAYLOAD - SMALL_PAYLOAD) * s.calls_sent);
+    // the peers sent the same calls back
+    ASSERT_EQ(s.bytes_received, s.bytes_sent);
+    ASSERT_EQ(l.bytes_received, l.bytes_sent);
+    // and the calls to and from each machine are counted separately
+    const std::string per_machine =
+      ",\"calls_sent\":" + tostr(NUM_CALLS) +
+      ",\"bytes_sent\":" + tostr(call_bytes * NUM_CALLS) +
+      ",\"calls_received\":" + tostr(NUM_CALLS) +
+      ",\"bytes_received\":" + tostr(call_bytes * NUM_CALLS) + "}";
+    for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+      const std::string entry = "{\"procid\":" + tostr(p) + per_machine;
+      ASSERT_EQ(count_occurrences(json, entry),
+                size_t(p == rmi.procid() ? 0 : 1));
+    }
+    rmi.dc().cout() << "+ Pass test: call site counts and bytes" << std::endl;
+  }
+};
+
+
+int main(int argc, char ** argv) {
+  /** Initialization */
+  mpi_tools::init(argc, argv);
+  global_logger().set_log_level(LOG_INFO);
+
+  dc_init_param param;
+  if (init_param_from_mpi(param) == false) {
+    return 0;
+  }
+  param.initstring += " rpc_profile=yes ";
+  if (mpi_tools::rank() == 0) remove("rpc_profile.json");
+  procid_t numprocs;
+  {
+    distributed_control dc(param);
+    numprocs = dc.numprocs();
+    if (numprocs < 2) {
+      dc.cout() << "Run with at least 2 processes" << std::endl;
+    } else {
+      profile_test test(dc);
+      test.test_call_sites();
+    }
+  }
+  // machine 0 gathered the profiles when the distributed_control went away
+  if (mpi_tools::rank() == 0) {
+    std::ifstream fin("rpc_profile.json");
+    ASSERT_TRUE(fin.good());
+    std::stringstream strm;
+    strm << fin.rdbuf();
+    const std::string json = strm.str();
+    for (procid_t p = 0; p < numprocs; ++p) {
+      ASSERT_EQ(count_occurrences(json, "{\"procid\":" + tostr(p) +
+                                  ",\"call_sites\":"), size_t(1));
+    }
+    if (numprocs >= 2) {
+      ASSERT_EQ(count_occurrences(json,
+                                  site_function(&profile_test::recv_small)),
+                size_t(numprocs));
+    }
+    remove("rpc_profile.json");
+    std::cout << "+ Pass test: rpc_profile.json gathered on machine 0"
+              << std::endl;
+  }
+  mpi_tools::finalize();
+}
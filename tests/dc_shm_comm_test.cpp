@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+using namespace graphlab;
+
+
+/*
+ * Runs the shared memory comm with the smallest rings, so that the
+ * rings wrap around and fill up all the time. Run it with at least 3
+ * processes: the odd processes then pretend to be on another host (a
+ * second loopback address), so that every process has local peers
+ * reached through the rings and remote peers reached through TCP.
+ */
+const size_t RING_SIZE = 4096;
+
+// the contents of the message number i sent by proc src
+std::string make_message(procid_t src, size_t i, size_t len) {
+  std::string s(len, 0);
+  for (size_t k = 0; k < len; ++k) s[k] = char((src * 31 + i + k) % 251);
+  return s;
+}
+
+class shm_test {
+ public:
+  dc_dist_object<shm_test> rmi;
+  atomic<size_t> num_received;
+  atomic<size_t> bytes_received;
+
+  shm_test(distributed_control &dc):rmi(dc, this) {
+    rmi.barrier();
+  }
+
+  void recv(procid_t src, size_t i, const std::string& s) {
+    ASSERT_TRUE(s == make_message(src, i, s.length()));
+    num_received.inc();
+    bytes_received.inc(s.length());
+  }
+
+  std::string echo(const std::string& s) {
+    return s;
+  }
+
+  void reset() {
+    num_received.value = 0;
+    bytes_received.value = 0;
+    rmi.barrier();
+  }
+
+  // every sent message is received exactly once, intact
+  void check(size_t nmessages, size_t nbytes) {
+    rmi.full_barrier();
+    ASSERT_EQ(num_received.value, nmessages * rmi.numprocs());
+    ASSERT_EQ(bytes_received.value, nbytes * rmi.numprocs());
+    reset();
+  }
+
+  // odd sizes, so the ring wraps around at every offset
+  void send_range(size_t begin, size_t end, size_t& nbytes) {
+    for (size_t i = begin; i < end; ++i) {
+      const size_t len = 1 + (i * 37) % 3000;
+      std::string s = make_message(rmi.procid(), i, len);
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        rmi.remote_call(p, &shm_test::recv, rmi.procid(), i, s);
+      }
+      nbytes += len;
+    }
+  }
+
+  void test_wrap_around() {
+    size_t nbytes = 0;
+    send_range(0, 5000, nbytes);
+    check(5000, nbytes);
+    rmi.dc().cout() << "+ Pass test: ring wrap around" << std::endl;
+  }
+
+  // many threads flood the peers without waiting. The rings are
+  // full most of the time, and the senders have to wait for them
+  void test_back_pressure() {
+    const size_t nthreads = 4, per_thread = 5000;
+    std::vector<size_t> nbytes(nthreads, 0);
+    thread_group thrgrp;
+    for (size_t t = 0; t < nthreads; ++t) {
+      thrgrp.launch(boost::bind(&shm_test::send_range, this,
+                                t * per_thread, (t + 1) * per_thread,
+                                boost::ref(nbytes[t])));
+    }
+    thrgrp.join();
+    size_t total = 0;
+    for (size_t t = 0; t < nthreads; ++t) total += nbytes[t];
+    check(nthreads * per_thread, total);
+    rmi.dc().cout() << "+ Pass test: full ring back pressure" << std::endl;
+  }
+
+  // messages many times the size of the ring
+  void test_large_payloads() {
+    size_t nbytes = 0, nmessages = 0;
+    for (size_t len = RING_SIZE + 1; len <= 1024 * RING_SIZE; len *= 4) {
+      std::string s = make_message(rmi.procid(), nmessages, len);
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        rmi.remote_call(p, &shm_test::recv, rmi.procid(), nmessages, s);
+        const procid_t target = (procid_t)((rmi.procid() + p) % rmi.numprocs());
+        ASSERT_TRUE(rmi.remote_request(target, &shm_test::echo, s) == s);
+      }
+      nbytes += len;
+      ++nmessages;
+    }
+    check(nmessages, nbytes);
+    rmi.dc().cout() << "+ Pass test: payloads larger than the ring"
+                    << std::endl;
+  }
+};
+
+
+int main(int argc, char ** argv) {
+  /** Initialization */
+  mpi_tools::init(argc, argv);
+  global_logger().set_log_level(LOG_INFO);
+
+  dc_init_param param;
+  if (init_param_from_mpi(param, SHM_COMM) == false) {
+    return 0;
+  }
+  param.commtype = SHM_COMM;
+  param.initstring += " shm_ring_size=" + tostr(RING_SIZE) + " ";
+  // split the processes over two "hosts"
+  const bool mixed = param.machines.size() >= 3;
+  for (size_t i = 0; i < param.machines.size(); ++i) {
+    std::string& machine = param.machines[i];
+    const std::string port = machine.substr(machine.find(":"));
+    machine = ((mixed && i % 2) ? "127.0.0.2" : "127.0.0.1") + port;
+  }
+  distributed_control dc(param);
+  if (!mixed) {
+    dc.cout() << "Run with at least 3 processes to mix local "
+              << "and remote peers" << std::endl;
+  }
+  shm_test test(dc);
+  test.test_wrap_around();
+  test.test_back_pressure();
+  test.test_large_payloads();
+  mpi_tools::finalize();
+}
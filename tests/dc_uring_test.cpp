@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <iostream>
+#include <string>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+using namespace graphlab;
+
+
+/*
+ * Round trips over the default comm with tcp_io=uring. The floods are
+ * much larger than the socket buffers, so the sends and receives run
+ * into EAGAIN and have to wait for the socket to be ready again.
+ */
+class uring_test {
+ public:
+  dc_dist_object<uring_test> rmi;
+  atomic<size_t> num_received;
+  atomic<size_t> bytes_received;
+
+  uring_test(distributed_control &dc):rmi(dc, this) {
+    rmi.barrier();
+  }
+
+  std::string echo(const std::string& s) {
+    return s;
+  }
+
+  void recv(size_t i, const std::string& s) {
+    ASSERT_EQ(s.length(), i);
+    ASSERT_EQ(s[0], char(i % 128));
+    num_received.inc();
+    bytes_received.inc(s.length());
+  }
+
+  void run(size_t nmessages, size_t maxlen) {
+    const procid_t next = (procid_t)((rmi.procid() + 1) % rmi.numprocs());
+    // round trips of a growing size
+    for (size_t len = 1; len <= maxlen; len *= 4) {
+      std::string s(len, char(len % 128));
+      ASSERT_TRUE(rmi.remote_request(next, &uring_test::echo, s) == s);
+    }
+    // a flood to every machine, sent without waiting
+    for (size_t i = 1; i <= nmessages; ++i) {
+      std::string s(i, char(i % 128));
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        rmi.remote_call(p, &uring_test::recv, i, s);
+      }
+    }
+    rmi.full_barrier();
+    ASSERT_EQ(num_received.value, nmessages * rmi.numprocs());
+    ASSERT_EQ(bytes_received.value,
+              nmessages * (nmessages + 1) / 2 * rmi.numprocs());
+  }
+};
+
+
+int main(int argc, char ** argv) {
+  /** Initialization */
+  mpi_tools::init(argc, argv);
+  global_logger().set_log_level(LOG_INFO);
+
+  dc_init_param param;
+  if (init_param_from_mpi(param, RPC_DEFAULT_COMMTYPE) == false) {
+    return 0;
+  }
+  param.initstring += " tcp_io=uring ";
+  distributed_control dc(param);
+  uring_test test(dc);
+  test.run(4000, 16 * 1024 * 1024);
+  dc.cout() << "uring round trips passed" << std::endl;
+  mpi_tools::finalize();
+}
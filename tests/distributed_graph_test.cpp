@@ -81,6 +81,52 @@ void assign_data_j_to_i(VType& vtype, const U& u) {
 }
 
 
+// builds a dim x dim grid with edges in both directions on proc 0
+void add_grid(graphlab::distributed_control& dc, graph_type& g, size_t dim) {
+  if (dc.procid() != 0) return;
+  for (size_t i = 0; i < dim * dim; ++i) {
+    vertex_data vdata;
+    vdata.i = i;
+    g.add_vertex(i, vdata);
+  }
+  for (size_t i = 0;i < dim; ++i) {
+    for (size_t j = 0;j < dim - 1; ++j) {
+      g.add_edge(dim * i + j, dim * i + j + 1, edge_data(dim*i+j, dim*i+j+1));
+      g.add_edge(dim * i + j + 1, dim * i + j, edge_data(dim*i+j+1, dim*i+j));
+      g.add_edge(dim * j + i, dim * (j + 1) + i, edge_data(dim*j+i, dim*(j+1)+i));
+      g.add_edge(dim * (j + 1) + i, dim * j + i, edge_data(dim*(j+1)+i, dim*j+i));
+    }
+  }
+}
+
+// adds the edges of a dim x dim grid with add_edges(), a few at a
+// time. Every machine adds a part of the edges.
+void add_grid_edges(graphlab::distributed_control& dc, graph_type& g,
+                    size_t dim) {
+  std::vector<graphlab::vertex_id_type> sources, targets;
+  std::vector<edge_data> edata;
+  size_t nedges = 0;
+  for (size_t i = 0;i < dim; ++i) {
+    for (size_t j = 0;j < dim - 1; ++j) {
+      const size_t ends[4][2] = {{dim * i + j, dim * i + j + 1},
+                                 {dim * i + j + 1, dim * i + j},
+                                 {dim * j + i, dim * (j + 1) + i},
+                                 {dim * (j + 1) + i, dim * j + i}};
+      for (size_t k = 0; k < 4; ++k) {
+        if (nedges++ % dc.numprocs() != dc.procid()) continue;
+        sources.push_back(ends[k][0]);
+        targets.push_back(ends[k][1]);
+        edata.push_back(edge_data(ends[k][0], ends[k][1]));
+        if (sources.size() == 7) {
+          g.add_edges(sources, targets, edata);
+          sources.clear(); targets.clear(); edata.clear();
+        }
+      }
+    }
+  }
+  g.add_edges(sources, targets, edata);
+}
+
 int main(int argc, char** argv) {
   graphlab::mpi_tools::init(argc, argv);
   global_logger().set_log_level(LOG_INFO);
@@ -211,6 +257,96 @@ int main(int argc, char** argv) {
   }
 dc.barrier();
   dc.cout() << "Injective join pass\n";
+
+  dc.cout() << "Testing vertex reordering\n";
+  const char* reorder_methods[] = {"degree", "rcm", "hub_cluster"};
+  for (size_t m = 0; m < 3; ++m) {
+    graphlab::graphlab_options opts;
+    opts.get_graph_args().set_option("reorder", std::string(reorder_methods[m]));
+    graph_type rg(dc, opts);
+    add_grid(dc, rg, 5);
+    rg.finalize();
+    ASSERT_EQ(rg.num_vertices(), 25);
+    ASSERT_EQ(rg.num_edges(), 80);
+    for (graphlab::lvid_type i = 0; i < rg.num_local_vertices(); ++i) {
+      local_vertex_type v = local_vertex_type(rg.l_vertex(i));
+      ASSERT_EQ(rg.local_vid(v.global_id()), i);
+      ASSERT_EQ(v.data().i, v.global_id());
+      foreach(local_edge_type edge, v.out_edges()) {
+        ASSERT_EQ(edge.data().from, edge.source().global_id());
+        ASSERT_EQ(edge.data().to, edge.target().global_id());
+      }
+      foreach(local_edge_type edge, v.in_edges()) {
+        ASSERT_EQ(edge.data().from, edge.source().global_id());
+        ASSERT_EQ(edge.data().to, edge.target().global_id());
+      }
+    }
+    dc.cout() << "+ Pass test: " << reorder_methods[m] << " reordering\n";
+  }
+
+  dc.cout() << "Testing hybrid ingress\n";
+  {
+    // vertex 0 has an in edge from every other vertex, the others have
+    // at most 2. Every machine adds a part of the edges.
+    const size_t nverts = 200, threshold = 10;
+    std::vector<size_t> in_degree(nverts, 0);
+    graphlab::graphlab_options opts;
+    opts.get_graph_args().set_option("ingress", std::string("hybrid"));
+    opts.get_graph_args().set_option("threshold", threshold);
+    graph_type hg(dc, opts);
+    size_t nedges = 0;
+    for (size_t i = 1; i < nverts; ++i) {
+      std::vector<size_t> targets;
+      targets.push_back(0);
+      if (i + 1 < nverts) targets.push_back(i + 1);
+      if (i + 2 < nverts) targets.push_back(i + 2);
+      foreach(size_t target, targets) {
+        ++in_degree[target]; ++nedges;
+        if (i % dc.numprocs() == dc.procid()) {
+          hg.add_edge(i, target, edge_data(i, target));
+        }
+      }
+    }
+    hg.finalize();
+    ASSERT_EQ(hg.num_vertices(), nverts);
+    ASSERT_EQ(hg.num_edges(), nedges);
+    for (graphlab::lvid_type i = 0; i < hg.num_local_vertices(); ++i) {
+      local_vertex_type v = local_vertex_type(hg.l_vertex(i));
+      const size_t degree = in_degree[v.global_id()];
+      if (degree > threshold) continue;
+      // the master holds all the in edges of a low degree vertex
+      const size_t expected = v.owned() ? degree : 0;
+      ASSERT_EQ(v.in_edges().size(), expected);
+    }
+    dc.cout() << "+ Pass test: hybrid ingress\n";
+  }
+
+  dc.cout() << "Testing add_edges\n";
+  const char* ingress_methods[] = {"random", "oblivious", "identity",
+                                   "batch", "hybrid"};
+  for (size_t m = 0; m < 5; ++m) {
+    graphlab::graphlab_options opts;
+    opts.get_graph_args().set_option("ingress",
+                                     std::string(ingress_methods[m]));
+    graph_type bg(dc, opts);
+    add_grid_edges(dc, bg, 10);
+    bg.finalize();
+    ASSERT_EQ(bg.num_vertices(), 100);
+    ASSERT_EQ(bg.num_edges(), 360);
+    size_t num_in_edges = 0;
+    for (graphlab::lvid_type i = 0; i < bg.num_local_vertices(); ++i) {
+      local_vertex_type v = local_vertex_type(bg.l_vertex(i));
+      foreach(local_edge_type edge, v.in_edges()) {
+        ASSERT_EQ(edge.data().from, edge.source().global_id());
+        ASSERT_EQ(edge.data().to, edge.target().global_id());
+        ++num_in_edges;
+      }
+    }
+    dc.all_reduce(num_in_edges);
+    ASSERT_EQ(num_in_edges, 360);
+    dc.cout() << "+ Pass test: add_edges with " << ingress_methods[m]
+              << " ingress\n";
+  }
   graphlab::mpi_tools::finalize();
 }
 
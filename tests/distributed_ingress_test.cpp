@@ -125,6 +125,7 @@ int main(int argc, char** argv) {
    std::string bufsize = "50000";
    bool usehash = false; 
    bool userecent = false; 
+   size_t threshold = 100;
 
    foreach (std::string opt, keys) {
      if (opt == "ingress") {
@@ -135,6 +136,8 @@ int main(int argc, char** argv) {
        clopts.get_graph_args().get_option("usehash", usehash);
      } else if (opt == "userecent") {
        clopts.get_graph_args().get_option("userecent", userecent);
+     } else if (opt == "threshold") {
+       clopts.get_graph_args().get_option("threshold", threshold);
      } else if (opt == "constrained_graph") {
        clopts.get_graph_args().get_option("constrained_graph", constraint_graph);
      }
@@ -145,7 +148,8 @@ int main(int argc, char** argv) {
      << "#constraint: " << constraint_graph << std::endl
      << "#bufsize: " << bufsize << std::endl
      << "#usehash: " << usehash << std::endl
-     << "#userecent: " << userecent
+     << "#userecent: " << userecent << std::endl
+     << "#threshold: " << threshold
      << std::endl;
 
    fout << "Num procs: " << dc.numprocs() << std::endl;
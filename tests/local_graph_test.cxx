@@ -23,11 +23,14 @@
 
 // standard C++ headers
 #include <iostream>
+#include <sstream>
+#include <set>
 
 #include <cxxtest/TestSuite.h>
 
 // includes the entire graphlab framework
 #include <graphlab/graph/local_graph.hpp>
+#include <graphlab/util/timer.hpp>
 #include <graphlab/macros_def.hpp>
 
 
@@ -37,12 +40,16 @@ public:
   struct vertex_data {
     size_t num_flips;
     vertex_data() : num_flips(0) { }
+    void save(graphlab::oarchive& oarc) const { oarc << num_flips; }
+    void load(graphlab::iarchive& iarc) { iarc >> num_flips; }
   };
 
   struct edge_data { 
     int from; 
     int to;
     edge_data (int f = 0, int t = 0) : from(f), to(t) {}
+    void save(graphlab::oarchive& oarc) const { oarc << from << to; }
+    void load(graphlab::iarchive& iarc) { iarc >> from >> to; }
   };
 
   struct edge_data_empty { };
@@ -337,6 +344,135 @@ public:
     printf("+ Pass test: iterate edgelist and get data. :) \n");
     std::cout << "-----------End Grid Test--------------------" << std::endl;
   }
+
+  /**
+   * Builds the same random power-law-ish graph with plain and
+   * compressed adjacency lists, checks that both return identical
+   * edges, and reports memory use and edge iteration throughput.
+   */
+  void test_compressed_graph() {
+    std::cout << "-----------Begin Compressed Graph Test-------" << std::endl;
+    const size_t num_v = 5000;
+    const size_t num_e = 50000;
+    graph_type plain, comp;
+    comp.set_use_compression(true);
+    for (size_t i = 0; i < num_v; ++i) {
+      plain.add_vertex(vertex_id_type(i), vertex_data());
+      comp.add_vertex(vertex_id_type(i), vertex_data());
+    }
+    std::set<std::pair<vertex_id_type, vertex_id_type> > edges;
+    srand(0);
+    while (edges.size() < num_e) {
+      // skew the sources so that some vertices have large degree
+      vertex_id_type src = (rand() % num_v) * (rand() % num_v) / num_v;
+      vertex_id_type dst = rand() % num_v;
+      if (src == dst) continue;
+      if (edges.insert(std::make_pair(src, dst)).second) {
+        plain.add_edge(src, dst, edge_data(src, dst));
+        comp.add_edge(src, dst, edge_data(src, dst));
+      }
+    }
+    plain.finalize();
+    comp.finalize();
+    ASSERT_EQ(plain.num_edges(), comp.num_edges());
+
+    for (vertex_id_type i = 0; i < num_v; ++i) {
+      edge_list_type plain_in = plain.in_edges(i), cmp_in = comp.in_edges(i);
+      edge_list_type plain_out = plain.out_edges(i), cmp_out = comp.out_edges(i);
+      ASSERT_EQ(plain_in.size(), cmp_in.size());
+      ASSERT_EQ(plain_out.size(), cmp_out.size());
+      ASSERT_EQ(plain.num_in_edges(i), comp.num_in_edges(i));
+      ASSERT_EQ(plain.num_out_edges(i), comp.num_out_edges(i));
+      edge_list_type::iterator pit = plain_in.begin();
+      foreach(edge_type edge, cmp_in) {
+        ASSERT_EQ(edge.source().id(), (*pit).source().id());
+        ASSERT_EQ(edge.target().id(), i);
+        ASSERT_EQ(edge.id(), (*pit).id());
+        ASSERT_EQ(edge.data().from, edge.source().id());
+        ++pit;
+      }
+      edge_list_type::iterator pit2 = plain_out.begin();
+      foreach(edge_type edge, cmp_out) {
+        ASSERT_EQ(edge.target().id(), (*pit2).target().id());
+        ASSERT_EQ(edge.source().id(), i);
+        ASSERT_EQ(edge.data().to, edge.target().id());
+        ++pit2;
+      }
+      if (cmp_out.size() > 2) {
+        ASSERT_EQ(cmp_out[2].target().id(), plain_out[2].target().id());
+      }
+      // seeking through the block index, including into the middle
+      // of the blocks of the long lists
+      for (size_t k = 0; k <= cmp_in.size(); ++k) {
+        edge_list_type::iterator cit = cmp_in.iterator_at(k);
+        ASSERT_TRUE(cit == plain_in.begin() + k);
+        if (k < cmp_in.size()) {
+          ASSERT_EQ((*cit).source().id(), plain_in[k].source().id());
+        }
+      }
+      for (size_t k = 0; k <= cmp_out.size(); ++k) {
+        edge_list_type::iterator cit = cmp_out.iterator_at(k);
+        ASSERT_TRUE(cit == plain_out.begin() + k);
+        if (k < cmp_out.size()) {
+          ASSERT_EQ((*cit).target().id(), plain_out[k].target().id());
+          ++cit;
+          if (k + 1 < cmp_out.size()) {
+            ASSERT_EQ((*cit).target().id(), plain_out[k + 1].target().id());
+          }
+        }
+      }
+    }
+    typedef std::pair<vertex_id_type, vertex_id_type> edge_pair;
+    foreach(const edge_pair& e, edges) {
+      ASSERT_EQ(comp.edge_data(e.first, e.second).from, e.first);
+      ASSERT_EQ(comp.edge_data(e.first, e.second).to, e.second);
+    }
+
+    // Saved in the uncompressed format and compressed again on load
+    std::stringstream strm;
+    graphlab::oarchive oarc(strm);
+    oarc << comp;
+    strm.flush();
+    graph_type loaded;
+    loaded.set_use_compression(true);
+    graphlab::iarchive iarc(strm);
+    iarc >> loaded;
+    ASSERT_EQ(loaded.num_edges(), comp.num_edges());
+    for (vertex_id_type i = 0; i < num_v; ++i) {
+      edge_list_type plain_out = plain.out_edges(i), loaded_out = loaded.out_edges(i);
+      ASSERT_EQ(plain_out.size(), loaded_out.size());
+      edge_list_type::iterator pit = plain_out.begin();
+      foreach(edge_type edge, loaded_out) {
+        ASSERT_EQ(edge.target().id(), (*pit).target().id());
+        ++pit;
+      }
+    }
+
+    // Memory and throughput comparison
+    graphlab::timer ti;
+    size_t psum = 0, csum = 0;
+    ti.start();
+    for (size_t iter = 0; iter < 10; ++iter)
+      for (vertex_id_type i = 0; i < num_v; ++i) {
+        foreach(edge_type edge, plain.in_edges(i)) psum += edge.source().id();
+        foreach(edge_type edge, plain.out_edges(i)) psum += edge.target().id();
+      }
+    const double ptime = ti.current_time();
+    ti.start();
+    for (size_t iter = 0; iter < 10; ++iter)
+      for (vertex_id_type i = 0; i < num_v; ++i) {
+        foreach(edge_type edge, comp.in_edges(i)) csum += edge.source().id();
+        foreach(edge_type edge, comp.out_edges(i)) csum += edge.target().id();
+      }
+    const double ctime = ti.current_time();
+    ASSERT_EQ(psum, csum);
+    std::cout << "Plain graph: " << plain.estimate_sizeof() << " bytes, "
+              << ptime << " secs to iterate\n"
+              << "Compressed graph: " << comp.estimate_sizeof() << " bytes, "
+              << ctime << " secs to iterate" << std::endl;
+    ASSERT_LT(comp.estimate_sizeof(), plain.estimate_sizeof());
+    std::cout << "-----------End Compressed Graph Test---------" << std::endl;
+  }
 };
 
 #include <graphlab/macros_undef.hpp>
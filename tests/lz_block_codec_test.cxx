@@ -0,0 +1,94 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <cstdlib>
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/lz_block_codec.hpp>
+using namespace graphlab;
+
+class LzBlockCodecTestSuite : public CxxTest::TestSuite {
+public:
+
+  /// compresses and decompresses, returning the compressed size
+  size_t round_trip(const std::vector<char>& src) {
+    std::vector<char> compressed(lz_block::compress_bound(src.size()));
+    size_t clen = lz_block::compress(&src[0], src.size(),
+                                     &compressed[0], compressed.size());
+    TS_ASSERT(clen > 0);
+    std::vector<char> out(src.size() + 1);
+    TS_ASSERT(lz_block::decompress(&compressed[0], clen,
+                                   &out[0], src.size()));
+    out.resize(src.size());
+    TS_ASSERT(out == src);
+    return clen;
+  }
+
+  void test_random(void) {
+    srand(1);
+    for (size_t len = 1; len < 100000; len = len * 3 + 1) {
+      std::vector<char> src(len);
+      for (size_t i = 0; i < len; ++i) src[i] = (char)rand();
+      round_trip(src);
+    }
+  }
+
+  void test_repetitive(void) {
+    // long runs, short periods and matches longer than 15 + 255
+    std::vector<char> src(200000);
+    for (size_t i = 0; i < src.size(); ++i) {
+      src[i] = (i % 5000 < 1000) ? 'a' : (char)(i % 7);
+    }
+    size_t clen = round_trip(src);
+    TS_ASSERT_LESS_THAN(clen, src.size() / 20);
+  }
+
+  void test_incompressible_limit(void) {
+    std::vector<char> src(10000);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = (char)rand();
+    std::vector<char> compressed(src.size() / 2);
+    TS_ASSERT_EQUALS(lz_block::compress(&src[0], src.size(),
+                                        &compressed[0], compressed.size()),
+                     size_t(0));
+  }
+
+  void test_corrupt(void) {
+    std::vector<char> src(50000);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = (char)(i % 13);
+    std::vector<char> compressed(lz_block::compress_bound(src.size()));
+    size_t clen = lz_block::compress(&src[0], src.size(),
+                                     &compressed[0], compressed.size());
+    std::vector<char> out(src.size());
+    // truncated input or the wrong output length are rejected
+    TS_ASSERT(!lz_block::decompress(&compressed[0], clen - 1,
+                                    &out[0], out.size()));
+    TS_ASSERT(!lz_block::decompress(&compressed[0], clen,
+                                    &out[0], out.size() - 1));
+    // random damage must never write out of bounds
+    for (size_t i = 0; i < 1000; ++i) {
+      std::vector<char> damaged(compressed.begin(), compressed.begin() + clen);
+      damaged[rand() % clen] ^= (char)(1 << (rand() % 8));
+      lz_block::decompress(&damaged[0], clen, &out[0], out.size());
+    }
+  }
+};
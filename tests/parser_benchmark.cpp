@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/**
+ * Measures the throughput of the built-in text parsers, line by line and
+ * with the block parsers, on generated snap, tsv and adj text, and checks
+ * that both give the same edges.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <graphlab/graph/distributed_graph.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/macros_def.hpp>
+
+using namespace graphlab;
+
+/// Stands in for the graph, and counts and checksums the edges
+struct counting_graph {
+  size_t nedges;
+  size_t checksum;
+  counting_graph() : nedges(0), checksum(0) { }
+  void add_edge(vertex_id_type source, vertex_id_type target) {
+    ++nedges;
+    checksum += size_t(source) * 31 + target;
+  }
+  void add_edges(const std::vector<vertex_id_type>& source_arr,
+                 const std::vector<vertex_id_type>& target_arr) {
+    for (size_t i = 0; i < source_arr.size(); ++i) {
+      add_edge(source_arr[i], target_arr[i]);
+    }
+  }
+};
+
+typedef bool (*line_parser_type)(counting_graph&, const std::string&,
+                                 const std::string&);
+typedef bool (*block_parser_type)(counting_graph&, const std::string&,
+                                  const char*, const char*);
+
+std::string generate(const std::string& format, size_t nverts) {
+  std::string text;
+  char buf[64];
+  if (format == "snap") text += "# generated graph\n";
+  for (size_t i = 0; i < nverts; ++i) {
+    const size_t ntargets = 1 + rand() % 16;
+    if (format == "adj") {
+      sprintf(buf, "%lu %lu", i, ntargets);
+      text += buf;
+    }
+    for (size_t j = 0; j < ntargets; ++j) {
+      const size_t target = rand() % nverts;
+      if (format == "adj") sprintf(buf, " %lu", target);
+      else sprintf(buf, "%lu\t%lu\n", i, target);
+      text += buf;
+    }
+    if (format == "adj") text += "\n";
+  }
+  return text;
+}
+
+void run(const std::string& format, line_parser_type line_parser,
+         block_parser_type block_parser, size_t nverts) {
+  const std::string text = generate(format, nverts);
+  const double mb = double(text.length()) / 1024 / 1024;
+
+  counting_graph line_graph;
+  timer ti;
+  ti.start();
+  for (size_t i = 0; i < text.length(); ) {
+    size_t eol = text.find('\n', i);
+    if (eol == std::string::npos) eol = text.length();
+    const std::string line = text.substr(i, eol - i);
+    if (!line.empty()) ASSERT_TRUE(line_parser(line_graph, format, line));
+    i = eol + 1;
+  }
+  const double line_time = ti.current_time();
+
+  counting_graph block_graph;
+  ti.start();
+  ASSERT_TRUE(block_parser(block_graph, format, text.c_str(),
+                           text.c_str() + text.length()));
+  const double block_time = ti.current_time();
+
+  ASSERT_EQ(line_graph.nedges, block_graph.nedges);
+  ASSERT_EQ(line_graph.checksum, block_graph.checksum);
+  std::cout << format << "\t" << line_graph.nedges << " edges\t"
+            << "line: " << mb / line_time << " MB/s\t"
+            << "block: " << mb / block_time << " MB/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  const size_t nverts = argc > 1 ? atol(argv[1]) : 1000000;
+  run("snap", builtin_parsers::snap_parser<counting_graph>,
+      builtin_parsers::snap_block_parser<counting_graph>, nverts);
+  run("tsv", builtin_parsers::tsv_parser<counting_graph>,
+      builtin_parsers::tsv_block_parser<counting_graph>, nverts);
+  run("adj", builtin_parsers::adj_parser<counting_graph>,
+      builtin_parsers::adj_block_parser<counting_graph>, nverts);
+}
@@ -0,0 +1,110 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <set>
+#include <sstream>
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/procid_set.hpp>
+#include <graphlab/macros_def.hpp>
+using namespace graphlab;
+
+class ProcidSetTestSuite : public CxxTest::TestSuite {
+public:
+
+  void check_equal(const procid_set& s, const std::set<size_t>& expected) {
+    TS_ASSERT_EQUALS(s.popcount(), expected.size());
+    TS_ASSERT_EQUALS(s.empty(), expected.empty());
+    std::set<size_t>::const_iterator iter = expected.begin();
+    foreach(size_t b, s) {
+      TS_ASSERT(iter != expected.end());
+      TS_ASSERT_EQUALS(b, *iter);
+      TS_ASSERT(s.get(b));
+      ++iter;
+    }
+    TS_ASSERT(iter == expected.end());
+  }
+
+  void test_small(void) {
+    procid_set s;
+    std::set<size_t> expected;
+    size_t probelocations[5] = {12, 3, 99, 0, 40};
+    for (size_t i = 0;i < 5; ++i) {
+      TS_ASSERT_EQUALS(s.set_bit(probelocations[i]), false);
+      expected.insert(probelocations[i]);
+    }
+    TS_ASSERT_EQUALS(s.set_bit(12), true);
+    TS_ASSERT_EQUALS(s.get(13), false);
+    check_equal(s, expected);
+
+    size_t b = 0;
+    TS_ASSERT(s.first_bit(b));
+    TS_ASSERT_EQUALS(b, 0);
+    TS_ASSERT(s.next_bit(b));
+    TS_ASSERT_EQUALS(b, 3);
+    b = 99;
+    TS_ASSERT_EQUALS(s.next_bit(b), false);
+
+    TS_ASSERT_EQUALS(s.clear_bit(3), true);
+    TS_ASSERT_EQUALS(s.clear_bit(3), false);
+    expected.erase(3);
+    check_equal(s, expected);
+  }
+
+  void test_dense(void) {
+    // grows past the inline capacity, beyond 128 processes,
+    // and shrinks back
+    procid_set s;
+    std::set<size_t> expected;
+    for (size_t i = 0;i < 40; ++i) {
+      size_t b = (i * 37) % 600;
+      s.set_bit(b);
+      expected.insert(b);
+      check_equal(s, expected);
+    }
+    TS_ASSERT_EQUALS(s.set_bit(37), true);
+
+    procid_set copy(s);
+    check_equal(copy, expected);
+
+    std::stringstream strm;
+    graphlab::oarchive oarc(strm);
+    oarc << s;
+    strm.flush();
+    graphlab::iarchive iarc(strm);
+    procid_set s2;
+    s2.set_bit(5);
+    iarc >> s2;
+    check_equal(s2, expected);
+
+    while(!expected.empty()) {
+      size_t b = *expected.rbegin();
+      TS_ASSERT_EQUALS(s.clear_bit(b), true);
+      expected.erase(b);
+      check_equal(s, expected);
+    }
+    s = copy;
+    s.clear();
+    TS_ASSERT(s.empty());
+    TS_ASSERT_EQUALS(sizeof(procid_set), 16);
+  }
+};
@@ -274,6 +274,8 @@ public:
     test_scheduler_basic_functionality_single_threaded<fifo_scheduler<message_type> >();
     test_scheduler_basic_functionality_single_threaded<priority_scheduler<message_type> >();
     test_scheduler_basic_functionality_single_threaded<queued_fifo_scheduler<message_type> >();
+    test_scheduler_basic_functionality_single_threaded<work_stealing_scheduler<message_type> >();
+    test_scheduler_basic_functionality_single_threaded<multiqueue_priority_scheduler<message_type> >();
   }
   
   void test_scheduler_basic_parallel() {
@@ -281,6 +283,8 @@ public:
     test_scheduler_basic_functionality_parallel<fifo_scheduler<message_type> >();
     test_scheduler_basic_functionality_parallel<priority_scheduler<message_type> >();
     test_scheduler_basic_functionality_parallel<queued_fifo_scheduler<message_type> >();
+    test_scheduler_basic_functionality_parallel<work_stealing_scheduler<message_type> >();
+    test_scheduler_basic_functionality_parallel<multiqueue_priority_scheduler<message_type> >();
   }
   
     
@@ -289,6 +293,8 @@ public:
     test_scheduler_min_priority_parallel<fifo_scheduler<message_type> >();
     test_scheduler_min_priority_parallel<priority_scheduler<message_type> >();
     test_scheduler_min_priority_parallel<queued_fifo_scheduler<message_type> >();
+    test_scheduler_min_priority_parallel<work_stealing_scheduler<message_type> >();
+    test_scheduler_min_priority_parallel<multiqueue_priority_scheduler<message_type> >();
   }
 
 };
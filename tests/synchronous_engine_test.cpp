@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <map>
 #include <iostream>
 
 
@@ -149,6 +150,108 @@ void test_all_neighbors(graphlab::distributed_control& dc,
 
 
 
+// A hash of the other end point and the data of an edge, summed by
+// both the per edge and the batched gather below
+size_t neighbor_hash(graphlab::vertex_id_type nbr, size_t nbr_out_edges,
+                     int nbr_data, int edata) {
+  return (nbr + 1) * 2654435761u ^ (nbr_out_edges + 1) * 40503u ^
+    size_t(nbr_data) * 97u ^ size_t(edata) * 13u;
+}
+
+// The totals of gather() over all edges of the vertices mastered here
+graphlab::mutex expected_totals_lock;
+std::map<graphlab::vertex_id_type, size_t> expected_totals;
+
+class hash_all_neighbors : 
+  public graphlab::ivertex_program<graph_type, size_t>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type 
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type 
+  gather(icontext_type& context, const vertex_type& vertex, 
+         edge_type& edge) const {
+    vertex_type nbr = edge.source().id() == vertex.id() ?
+      edge.target() : edge.source();
+    return neighbor_hash(nbr.id(), nbr.num_out_edges(), nbr.data(),
+                         edge.data());
+  }
+  void apply(icontext_type& context, vertex_type& vertex, 
+             const gather_type& total) {
+    expected_totals_lock.lock();
+    expected_totals[vertex.id()] = total;
+    expected_totals_lock.unlock();
+  }
+  edge_dir_type 
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of hash all neighbors
+
+class hash_all_neighbors_batch : 
+  public graphlab::ivertex_program<graph_type, size_t>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type 
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type 
+  gather(icontext_type& context, const vertex_type& vertex, 
+         edge_type& edge) const {
+    ASSERT_MSG(false, "gather_batch should be used");
+    return 0;
+  }
+  gather_type 
+  gather_batch(icontext_type& context, const vertex_type& vertex, 
+               edge_batch_type& batch) const {
+    ASSERT_GT(batch.size, 0);
+    size_t total = 0;
+    for (size_t i = 0; i < batch.size; ++i) {
+      vertex_type nbr = batch.neighbor(i);
+      ASSERT_NE(nbr.id(), vertex.id());
+      ASSERT_EQ(batch.neighbor_num_out_edges(i), nbr.num_out_edges());
+      total += neighbor_hash(nbr.id(), batch.neighbor_num_out_edges(i),
+                             batch.neighbor_data(i), batch.edge_data(i));
+    }
+    return total;
+  }
+  void apply(icontext_type& context, vertex_type& vertex, 
+             const gather_type& total) {
+    expected_totals_lock.lock();
+    ASSERT_EQ(expected_totals.count(vertex.id()), 1);
+    ASSERT_EQ(total, expected_totals[vertex.id()]);
+    expected_totals_lock.unlock();
+    context.signal(vertex);
+  }
+  edge_dir_type 
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of hash all neighbors batch
+
+void test_all_neighbors_batch(graphlab::distributed_control& dc,
+                              graphlab::command_line_options& clopts,
+                              graph_type& graph) {
+  std::cout << "Constructing a syncrhonous engine for batched all neighbors" << std::endl;
+  {
+    typedef graphlab::synchronous_engine<hash_all_neighbors> engine_type;
+    engine_type engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+  }
+  typedef graphlab::synchronous_engine<hash_all_neighbors_batch> engine_type;
+  engine_type engine(dc, graph, clopts);
+  std::cout << "Scheduling all vertices to compare the batched gather" << std::endl;
+  engine.signal_all();
+  std::cout << "Running!" << std::endl;
+  engine.start();
+  expected_totals.clear();
+  std::cout << "Finished" << std::endl;
+}
+
 class basic_messages : 
   public graphlab::ivertex_program<graph_type, int, int>,
   public graphlab::IS_POD_TYPE {
@@ -212,6 +315,85 @@ void test_messages(graphlab::distributed_control& dc,
 
 
 
+// The messages and the gathers received by the vertices mastered here,
+// summed over the iterations, to compare runs with each other
+graphlab::mutex message_totals_lock;
+std::map<graphlab::vertex_id_type, size_t> message_totals;
+
+class sum_messages : 
+  public graphlab::ivertex_program<graph_type, int, int>,
+  public graphlab::IS_POD_TYPE {
+  int message_value;
+public:
+  void init(icontext_type& context, const vertex_type& vertex,
+            const message_type& msg) {
+    message_value = msg;
+  } 
+
+  edge_dir_type 
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::IN_EDGES;
+  }
+
+  gather_type gather(icontext_type& context, const vertex_type& vertex, 
+                     edge_type& edge) const {
+    return int(edge.source().id() % 5);
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex, 
+             const gather_type& total) {
+    message_totals_lock.lock();
+    message_totals[vertex.id()] += (context.iteration() + 1) *
+      (size_t(message_value) * 31 + size_t(total));
+    message_totals_lock.unlock();
+    context.signal(vertex, 1);
+  }
+
+  edge_dir_type 
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex, 
+               edge_type& edge) const {
+    context.signal(edge.target(), int(vertex.id() % 7) + 1);
+  }
+}; // end of sum messages
+
+void run_sum_messages(graphlab::distributed_control& dc,
+                      graphlab::command_line_options& clopts,
+                      graph_type& graph) {
+  typedef graphlab::synchronous_engine<sum_messages> engine_type;
+  engine_type engine(dc, graph, clopts);
+  engine.signal_all(1);
+  engine.start();
+}
+
+// the gathers and messages combined before they are sent add up to
+// the same totals as the ones sent one by one
+void test_combined_messages(graphlab::distributed_control& dc,
+                            graphlab::command_line_options& clopts,
+                            graph_type& graph) {
+  std::cout << "Comparing combined and uncombined messages" << std::endl;
+  clopts.engine_args.set_option("combine_exchange", false);
+  run_sum_messages(dc, clopts, graph);
+  std::map<graphlab::vertex_id_type, size_t> uncombined_totals;
+  uncombined_totals.swap(message_totals);
+  clopts.engine_args.set_option("combine_exchange", true);
+  run_sum_messages(dc, clopts, graph);
+  clopts.engine_args.set_option("combine_exchange", false);
+  ASSERT_EQ(message_totals.size(), uncombined_totals.size());
+  ASSERT_TRUE(message_totals == uncombined_totals);
+  size_t nvertices = message_totals.size();
+  dc.all_reduce(nvertices);
+  ASSERT_EQ(nvertices, graph.num_vertices());
+  message_totals.clear();
+  std::cout << "Finished" << std::endl;
+}
+
+
+
+
 class count_aggregators : 
   public graphlab::ivertex_program<graph_type, int>,
   public graphlab::IS_POD_TYPE {
@@ -271,6 +453,154 @@ void test_count_aggregators(graphlab::distributed_control& dc,
 
 
 
+// Counts every vertex up and copies the count onto its out edges so
+// that every snapshot changes both vertex and edge data.
+class count_and_copy :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    ++vertex.data();
+    context.signal(vertex);
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    edge.data() = vertex.data();
+  }
+}; // end of count and copy
+
+void set_vertex_to_zero(graph_type::vertex_type vtx) {
+  vtx.data() = 0;
+}
+
+void set_edge_to_zero(graph_type::edge_type edge) {
+  edge.data() = 0;
+}
+
+size_t vertex_equals_six(const graph_type::vertex_type& vtx) {
+  return vtx.data() == 6;
+}
+
+size_t edge_equals_six(const graph_type::edge_type& edge) {
+  return edge.data() == 6;
+}
+
+/*
+ * Gathers the ids of the neighbors and scatters the ids of the end
+ * points into the edge data, so that the edges every hub chunk visits
+ * are checked and not just counted.
+ */
+class sum_neighbor_ids :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type
+  gather(icontext_type& context, const vertex_type& vertex,
+         edge_type& edge) const {
+    return int(edge.source().id() + edge.target().id() - vertex.id());
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex.data() = total;
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    edge.data() = int(edge.source().id() ^ edge.target().id());
+  }
+}; // end of sum neighbor ids
+
+size_t vertex_data(const graph_type::vertex_type& vtx) {
+  return vtx.data();
+}
+
+size_t edge_end_point_sum(const graph_type::edge_type& edge) {
+  return edge.source().id() + edge.target().id();
+}
+
+size_t edge_data_errors(const graph_type::edge_type& edge) {
+  return edge.data() != int(edge.source().id() ^ edge.target().id());
+}
+
+void test_compressed_hubs(graphlab::distributed_control& dc,
+                          graphlab::command_line_options clopts) {
+  std::cout << "Splitting hubs of a compressed graph" << std::endl;
+  clopts.get_graph_args().set_option("compress_adjacency", true);
+  graph_type graph(dc, clopts);
+  // power law out degrees, and a vertex with half the graph as in
+  // neighbors
+  graph.load_synthetic_powerlaw(10000);
+  for (size_t vid = 2 * dc.procid(); vid < 10000; vid += 2 * dc.numprocs()) {
+    graph.add_edge(vid, 10000);
+  }
+  graph.finalize();
+  // every edge adds each end point to the sum of the other
+  const size_t expected = graph.map_reduce_edges<size_t>(edge_end_point_sum);
+  typedef graphlab::synchronous_engine<sum_neighbor_ids> engine_type;
+  // chunks of 40 edges begin in the middle of the 32 edge blocks of
+  // the compressed adjacency
+  const size_t thresholds[] = {0, 4, 40};
+  for (size_t i = 0; i < 3; ++i) {
+    clopts.engine_args.set_option("hub_degree_threshold", thresholds[i]);
+    graph.transform_vertices(set_vertex_to_zero);
+    graph.transform_edges(set_edge_to_zero);
+    engine_type engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+    ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_data), expected);
+    ASSERT_EQ(graph.map_reduce_edges<size_t>(edge_data_errors), 0);
+  }
+  std::cout << "Finished" << std::endl;
+}
+
+
+void test_delta_snapshots(graphlab::distributed_control& dc,
+                          graphlab::command_line_options& clopts,
+                          graph_type& graph) {
+  std::cout << "Testing incremental snapshots" << std::endl;
+  typedef graphlab::synchronous_engine<count_and_copy> engine_type;
+  const std::string snapshot_path = "sync_snapshot_test";
+  graph.transform_vertices(set_vertex_to_zero);
+  graph.transform_edges(set_edge_to_zero);
+  // a full snapshot after iterations 1 and 4, deltas after the others
+  graphlab::command_line_options snapopts = clopts;
+  snapopts.engine_args.set_option("max_iterations", 6);
+  snapopts.engine_args.set_option("snapshot_interval", 1);
+  snapopts.engine_args.set_option("snapshot_deltas", 2);
+  snapopts.engine_args.set_option("snapshot_path", snapshot_path);
+  engine_type engine(dc, graph, snapopts);
+  engine.signal_all();
+  engine.start();
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_equals_six),
+            graph.num_vertices());
+
+  graph_type graph2(dc, clopts);
+  engine_type::load_snapshot(graph2, snapshot_path);
+  ASSERT_EQ(graph2.num_vertices(), graph.num_vertices());
+  ASSERT_EQ(graph2.map_reduce_vertices<size_t>(vertex_equals_six),
+            graph2.num_vertices());
+  ASSERT_EQ(graph2.map_reduce_edges<size_t>(edge_equals_six),
+            graph2.num_edges());
+  std::cout << "Finished" << std::endl;
+}
+
+
 
 int main(int argc, char** argv) {
   ///! Initialize control plain using mpi
@@ -288,9 +618,60 @@ int main(int argc, char** argv) {
   test_in_neighbors(dc, clopts, graph);
   test_out_neighbors(dc, clopts, graph);
   test_all_neighbors(dc, clopts, graph);
+  test_all_neighbors_batch(dc, clopts, graph);
   test_messages(dc, clopts, graph);
   test_count_aggregators(dc, clopts, graph);
 
+  // rerun with the sparse frontier forced on
+  clopts.engine_args.set_option("frontier_mode", "sparse");
+  test_in_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+
+  // rerun splitting every vertex with more than 4 edges into chunks
+  clopts.engine_args.set_option("frontier_mode", "dense");
+  clopts.engine_args.set_option("hub_degree_threshold", 4);
+  test_in_neighbors(dc, clopts, graph);
+  test_out_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_all_neighbors_batch(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+  test_compressed_hubs(dc, clopts);
+
+  // rerun with the vertices partitioned over the NUMA nodes
+  clopts.engine_args.set_option("numa", true);
+  test_in_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+
+  // rerun applying every vertex as soon as its gathers have arrived
+  clopts.engine_args.set_option("numa", false);
+  clopts.engine_args.set_option("pipeline", true);
+  test_in_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_all_neighbors_batch(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+  clopts.engine_args.set_option("pipeline", false);
+
+  // rerun sizing the exchange buffers from the measured rates and
+  // round trip times
+  clopts.engine_args.set_option("adaptive_exchange", true);
+  test_in_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_all_neighbors_batch(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+  clopts.engine_args.set_option("adaptive_exchange", false);
+
+  // rerun combining the gathers and messages sent to the same vertex
+  test_combined_messages(dc, clopts, graph);
+  clopts.engine_args.set_option("combine_exchange", true);
+  test_in_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+  clopts.engine_args.set_option("combine_exchange", false);
+
+  test_delta_snapshots(dc, clopts, graph);
+
   graphlab::mpi_tools::finalize();
 } // end of main
 
@@ -118,6 +118,124 @@ void test_save_load(graphlab::distributed_control& dc) {
 }
 
 
+template <typename EdgeType>
+void set_edge_data(EdgeType& edge) {
+  edge.data() = edge.source().id() * 1000 + edge.target().id();
+}
+
+template <typename EdgeType>
+size_t edge_data_errors(const EdgeType& edge) {
+  return edge.data() != edge.source().id() * 1000 + edge.target().id();
+}
+
+void set_vertex_data(graph_type::vertex_type& vertex) {
+  vertex.data() = vertex.id() * 7;
+}
+
+size_t vertex_data_errors(const graph_type::vertex_type& vertex) {
+  return vertex.data() != vertex.id() * 7;
+}
+
+void test_binary_save_load(graphlab::distributed_control& dc) {
+  graphlab::distributed_graph<size_t, size_t> graph(dc);
+  graph.load_synthetic_powerlaw(1000);
+  graph.finalize();
+  graph.transform_vertices(set_vertex_data);
+  graph.transform_edges(set_edge_data<graph_type::edge_type>);
+  const char* formats[] = {"bintsv4", "bintsv8", "binweighted", "binmap"};
+  for (size_t i = 0; i < 4; ++i) {
+    for (size_t gzip = 0; gzip < 2; ++gzip) {
+      const std::string prefix = std::string("data/plawtest_") +
+                                 (gzip ? "gz_" : "raw_") + formats[i];
+      graph.save_format(prefix, formats[i], gzip);
+      // load it back
+      graphlab::distributed_graph<size_t, size_t> graph2(dc);
+      graph2.load_format(prefix, formats[i]);
+      graph2.finalize();
+      ASSERT_EQ(graph.num_vertices(), graph2.num_vertices());
+      ASSERT_EQ(graph.num_edges(), graph2.num_edges());
+      if (std::string(formats[i]) == "binweighted" ||
+          std::string(formats[i]) == "binmap") {
+        ASSERT_EQ(graph2.map_reduce_edges<size_t>(
+            edge_data_errors<graph_type::edge_type>), 0);
+      }
+      if (std::string(formats[i]) == "binmap") {
+        ASSERT_EQ(graph2.map_reduce_vertices<size_t>(vertex_data_errors), 0);
+      }
+    }
+  }
+}
+
+
+// the binmap format serializes vertex data which is not POD, and stores
+// compressed adjacency lists decoded
+typedef graphlab::distributed_graph<std::string, size_t> string_graph_type;
+
+void set_vertex_name(string_graph_type::vertex_type& vertex) {
+  vertex.data() = "v" + graphlab::tostr(vertex.id());
+}
+
+size_t vertex_name_errors(const string_graph_type::vertex_type& vertex) {
+  return vertex.data() != "v" + graphlab::tostr(vertex.id());
+}
+
+void test_binmap_save_load(graphlab::distributed_control& dc) {
+  for (size_t compress = 0; compress < 2; ++compress) {
+    graphlab::graphlab_options opts;
+    opts.get_graph_args().set_option("compress_adjacency", compress);
+    string_graph_type graph(dc, opts);
+    graph.load_synthetic_powerlaw(1000);
+    graph.finalize();
+    graph.transform_vertices(set_vertex_name);
+    graph.transform_edges(set_edge_data<string_graph_type::edge_type>);
+    const std::string prefix = std::string("data/plawtest_str_") +
+                               (compress ? "compressed_" : "") + "binmap";
+    graph.save_format(prefix, "binmap");
+    // load it back
+    string_graph_type graph2(dc, opts);
+    graph2.load_format(prefix, "binmap");
+    graph2.finalize();
+    ASSERT_EQ(graph.num_vertices(), graph2.num_vertices());
+    ASSERT_EQ(graph.num_edges(), graph2.num_edges());
+    ASSERT_EQ(graph2.map_reduce_vertices<size_t>(vertex_name_errors), 0);
+    ASSERT_EQ(graph2.map_reduce_edges<size_t>(
+        edge_data_errors<string_graph_type::edge_type>), 0);
+  }
+}
+
+
+// loads a graph stored in several files, so that every machine parses
+// them with several threads
+void test_parallel_ingress(graphlab::distributed_control& dc) {
+  const size_t nfiles = 8;
+  const size_t nverts = 1000;
+  if (dc.procid() == 0) {
+    boost::filesystem::create_directory("data/mt_ingress");
+    for (size_t f = 0; f < nfiles; ++f) {
+      std::ofstream fout(("data/mt_ingress/part_" + graphlab::tostr(f)).c_str());
+      for (size_t i = 0; i < nverts; ++i) {
+        fout << i << "\t" << (i + f + 1) % nverts << "\n";
+      }
+    }
+  }
+  dc.barrier();
+  const char* methods[] = {"random", "oblivious", "batch", "hybrid"};
+  for (size_t m = 0; m < 4; ++m) {
+    graphlab::graphlab_options opts;
+    opts.get_graph_args().set_option("ingress", std::string(methods[m]));
+    opts.get_graph_args().set_option("loading_threads", 4);
+    // flush the batch ingress often
+    opts.get_graph_args().set_option("bufsize", 16);
+    graph_type graph(dc, opts);
+    graph.load_format("data/mt_ingress/part_", "tsv");
+    graph.finalize();
+    ASSERT_EQ(graph.num_vertices(), nverts);
+    ASSERT_EQ(graph.num_edges(), nfiles * nverts);
+    std::cout << methods[m] << " ingress with 4 loading threads\n";
+  }
+}
+
+
 int main(int argc, char** argv) {
   graphlab::distributed_control dc;
   test_adj(dc);
@@ -125,5 +243,8 @@ int main(int argc, char** argv) {
   test_tsv(dc);
   test_powerlaw(dc);
   test_save_load(dc);
+  test_binary_save_load(dc);
+  test_binmap_save_load(dc);
+  test_parallel_ingress(dc);
 };
 
@@ -93,6 +93,17 @@ public:
     return (edge.source().data() / edge.source().num_out_edges()); 
   }
 
+  /* Batched gather over a run of in edges, used by the synchronous
+   * engine in place of one gather call per edge */
+  double gather_batch(icontext_type& context, const vertex_type& vertex,
+                      edge_batch_type& batch) const {
+    double total = 0;
+    for (size_t i = 0; i < batch.size; ++i) {
+      total += batch.neighbor_data(i) / batch.neighbor_num_out_edges(i);
+    }
+    return total;
+  }
+
   /* Use the total rank of adjacent pages to update this page */
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& total) {